@@ -493,6 +493,7 @@ int agxset(void *obj, Agsym_t * sym, const char *value)
     assert(sym->id >= 0 && sym->id < topdictsize(obj));
     agstrfree(g, data->str[sym->id]);
     data->str[sym->id] = agstrdup(g, value);
+    agattrcacheinval(obj, sym);
     if (hdr->tag.objtype == AGRAPH) {
 	/* also update dict default */
 	Dict_t *dict;
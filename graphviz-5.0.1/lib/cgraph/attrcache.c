@@ -0,0 +1,201 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/// \file
+/// \brief typed caches of parsed attribute values
+///
+/// Layout code reads numeric attributes through strtod and friends, often
+/// more than once per object. The first typed read of an attribute creates a
+/// column for it: an array indexed by object sequence number that holds the
+/// parsed value and whether there was one. Later reads of the same object
+/// return the cached value until `agxset` changes the attribute's string.
+///
+/// Columns belong to the root graph and are keyed on the kind and ID of the
+/// symbol, so a subgraph's local declaration of an attribute shares the
+/// column of the root's. An attribute read as more than one type keeps
+/// separate values for each.
+
+#include <cgraph/cghdr.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef enum { COL_DOUBLE, COL_INT, COL_POINT, COL_TYPES } coltype_t;
+
+/* per object state */
+enum { UNPARSED, PARSED, NOVALUE };
+
+/* the parsed values of one attribute, as each type it has been read as */
+typedef struct {
+    size_t cap[COL_TYPES];	///< number of sequence numbers covered
+    unsigned char *state[COL_TYPES];
+    void *val[COL_TYPES];	///< for points, 2 doubles per object
+} column_t;
+
+struct Agattrcache_s {
+    column_t *col[3];		///< per kind, indexed by symbol ID
+    size_t ncol[3];
+};
+
+/* kindof:
+ * Kind of obj, as an index into the sequence counters of the root.
+ */
+static int kindof(void *obj)
+{
+    switch (AGTYPE(obj)) {
+    case AGRAPH:
+	return AGRAPH;
+    case AGNODE:
+	return AGNODE;
+    default:
+	return AGEDGE;
+    }
+}
+
+static const size_t Valsize[COL_TYPES] = {
+    sizeof(double), sizeof(int), 2 * sizeof(double)
+};
+
+/* column:
+ * The column for sym, with its values of type grown to cover obj.
+ */
+static column_t *column(void *obj, Agsym_t * sym, coltype_t type)
+{
+    Agraph_t *root = agroot(agraphof(obj));
+    struct Agattrcache_s *cache = root->clos->attrcache;
+    int kind = kindof(obj);
+    size_t id = (size_t) sym->id, seq = AGSEQ(obj);
+    column_t *c;
+
+    if (cache == NULL)
+	cache = root->clos->attrcache =
+	    agalloc(root, sizeof(struct Agattrcache_s));
+    if (id >= cache->ncol[kind]) {
+	size_t n = id + 1;
+	cache->col[kind] = agrealloc(root, cache->col[kind],
+				     cache->ncol[kind] * sizeof(column_t),
+				     n * sizeof(column_t));
+	cache->ncol[kind] = n;
+    }
+    c = &cache->col[kind][id];
+
+    if (seq >= c->cap[type]) {
+	/* cover every object created so far, so that the column rarely grows
+	 * once the graph is built
+	 */
+	size_t old = c->cap[type];
+	size_t n = (size_t) root->clos->seq[kind] + 1;
+	if (n <= seq)
+	    n = seq + 1;
+	if (n < 2 * old)
+	    n = 2 * old;
+	c->state[type] = agrealloc(root, c->state[type], old, n);
+	c->val[type] = agrealloc(root, c->val[type], old * Valsize[type],
+				 n * Valsize[type]);
+	c->cap[type] = n;
+    }
+    return c;
+}
+
+int agxgetdouble(void *obj, Agsym_t * sym, double *value)
+{
+    column_t *c = column(obj, sym, COL_DOUBLE);
+    unsigned char *state = &c->state[COL_DOUBLE][AGSEQ(obj)];
+    double *v = (double *) c->val[COL_DOUBLE] + AGSEQ(obj);
+
+    if (*state == UNPARSED) {
+	char *p = agxget(obj, sym);
+	char *endp;
+	*v = strtod(p, &endp);
+	*state = endp == p ? NOVALUE : PARSED;
+    }
+    if (*state == NOVALUE)
+	return 0;
+    *value = *v;
+    return 1;
+}
+
+int agxgetint(void *obj, Agsym_t * sym, int *value)
+{
+    column_t *c = column(obj, sym, COL_INT);
+    unsigned char *state = &c->state[COL_INT][AGSEQ(obj)];
+    int *v = (int *) c->val[COL_INT] + AGSEQ(obj);
+
+    if (*state == UNPARSED) {
+	char *p = agxget(obj, sym);
+	char *endp;
+	*v = (int) strtol(p, &endp, 10);
+	*state = endp == p ? NOVALUE : PARSED;
+    }
+    if (*state == NOVALUE)
+	return 0;
+    *value = *v;
+    return 1;
+}
+
+int agxgetpoint(void *obj, Agsym_t * sym, double *x, double *y)
+{
+    column_t *c = column(obj, sym, COL_POINT);
+    unsigned char *state = &c->state[COL_POINT][AGSEQ(obj)];
+    double *pt = (double *) c->val[COL_POINT] + 2 * AGSEQ(obj);
+
+    if (*state == UNPARSED)
+	*state = sscanf(agxget(obj, sym), "%lf,%lf", &pt[0], &pt[1]) == 2
+	    ? PARSED : NOVALUE;
+    if (*state == NOVALUE)
+	return 0;
+    *x = pt[0];
+    *y = pt[1];
+    return 1;
+}
+
+void agattrcacheinval(void *obj, Agsym_t * sym)
+{
+    struct Agattrcache_s *cache = agraphof(obj)->clos->attrcache;
+    int kind;
+    size_t seq;
+    column_t *c;
+    int t;
+
+    if (cache == NULL)
+	return;
+    kind = kindof(obj);
+    if ((size_t) sym->id >= cache->ncol[kind])
+	return;
+    c = &cache->col[kind][sym->id];
+    seq = AGSEQ(obj);
+    for (t = 0; t < COL_TYPES; t++)
+	if (seq < c->cap[t])
+	    c->state[t][seq] = UNPARSED;
+}
+
+void agattrcacheclose(Agraph_t * g)
+{
+    struct Agattrcache_s *cache = g->clos->attrcache;
+    size_t i;
+    int k, t;
+
+    if (cache == NULL)
+	return;
+    for (k = 0; k < 3; k++) {
+	for (i = 0; i < cache->ncol[k]; i++) {
+	    for (t = 0; t < COL_TYPES; t++) {
+		agfree(g, cache->col[k][i].state[t]);
+		agfree(g, cache->col[k][i].val[t]);
+	    }
+	}
+	if (cache->col[k])
+	    agfree(g, cache->col[k]);
+    }
+    agfree(g, cache);
+    g->clos->attrcache = NULL;
+}
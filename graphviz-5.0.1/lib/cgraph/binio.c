@@ -0,0 +1,677 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/// \file
+/// \brief compact binary images of graphs
+///
+/// An image is the magic bytes `\x89GVB`, the format version and the length
+/// of the body, all but the magic as unsigned LEB128 varints. The body holds,
+/// in order:
+///
+///   - the graph descriptor flags
+///   - the string table: each distinct string once, as its length, an HTML
+///     flag byte, its bytes and a terminating NUL
+///   - the name of the graph
+///   - the graph, node and edge attribute declarations, in ID order
+///   - the subgraphs in preorder, each with the index of its parent, its
+///     name and its local attribute defaults
+///   - the node table: a column of names
+///   - the edge table: columns of tail and head node indices and of keys
+///   - one column of values per node, edge and graph attribute
+///   - for each subgraph, the indices of its nodes and of its edges
+///
+/// Strings are referenced by their index in the table plus one, 0 meaning no
+/// string; in attribute columns 0 stands for the default instead. Nodes and
+/// edges are numbered in the order of the root graph's sets, so reading an
+/// image back recreates them in the same order.
+
+#include <cgraph/agxbuf.h>
+#include <cgraph/alloc.h>
+#include <cgraph/cghdr.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GVB_MAGIC	"\x89GVB"
+#define GVB_MAGICLEN	4
+enum { GVB_VERSION = 1 };
+
+enum {
+    GVB_DIRECTED = 1,
+    GVB_STRICT = 2,
+    GVB_NO_LOOP = 4,
+};
+
+static const int Kinds[] = { AGRAPH, AGNODE, AGEDGE };
+
+static void putvarint(agxbuf * xb, uint64_t v)
+{
+    while (v >= 0x80) {
+	agxbputc(xb, (char) (v | 0x80));
+	v >>= 7;
+    }
+    agxbputc(xb, (char) v);
+}
+
+/* string table under construction, with an open addressing index over
+ * the contents of the strings
+ */
+typedef struct {
+    agxbuf data;		///< serialized entries
+    size_t *off;		///< offset of each string's bytes in `data`
+    bool *html;
+    size_t size;
+    size_t *slot;		///< string index + 1, or 0 if free
+    size_t cap;			///< power of 2
+} strtab_t;
+
+static size_t strhash(const char *s, bool html)
+{
+    uint64_t h = 14695981039346656037ull;	/* FNV-1a */
+    for (; *s; s++) {
+	h ^= (unsigned char) *s;
+	h *= 1099511628211ull;
+    }
+    return (size_t) (h ^ html);
+}
+
+static void strtab_grow(strtab_t * t)
+{
+    size_t ncap = t->cap ? t->cap * 2 : 1024;
+    size_t *nslot = gv_calloc(ncap, sizeof(size_t));
+    size_t i, j;
+
+    for (i = 0; i < t->size; i++) {
+	const char *s = agxbstart(&t->data) + t->off[i];
+	for (j = strhash(s, t->html[i]) & (ncap - 1); nslot[j];
+	     j = (j + 1) & (ncap - 1));
+	nslot[j] = i + 1;
+    }
+    free(t->slot);
+    t->slot = nslot;
+    t->cap = ncap;
+    t->off = gv_recalloc(t->off, t->size, ncap / 2, sizeof(size_t));
+    t->html = gv_recalloc(t->html, t->size, ncap / 2, sizeof(bool));
+}
+
+/* strref:
+ * Reference to s, adding it to the table on first use. Attribute strings
+ * are refstrs and may be HTML-like; names of objects are never.
+ */
+static uint64_t strref(strtab_t * t, const char *s, bool attr)
+{
+    bool html;
+    size_t j, len;
+
+    if (s == NULL)
+	return 0;
+    html = attr && aghtmlstr(s);
+    if (2 * (t->size + 1) > t->cap)
+	strtab_grow(t);
+    for (j = strhash(s, html) & (t->cap - 1); t->slot[j];
+	 j = (j + 1) & (t->cap - 1)) {
+	size_t i = t->slot[j] - 1;
+	if (t->html[i] == html && streq(agxbstart(&t->data) + t->off[i], s))
+	    return i + 1;
+    }
+    len = strlen(s);
+    putvarint(&t->data, len);
+    agxbputc(&t->data, html);
+    t->off[t->size] = agxblen(&t->data);
+    t->html[t->size] = html;
+    agxbput_n(&t->data, s, len + 1);
+    t->slot[j] = ++t->size;
+    return t->size;
+}
+
+/* graphname:
+ * Like agwrite, treat internally generated names as anonymous.
+ */
+static char *graphname(Agraph_t * g)
+{
+    char *name = agnameof(g);
+    return (name && name[0] != LOCALNAMEPREFIX) ? name : NULL;
+}
+
+typedef struct {
+    Agraph_t **subg;		///< subgraphs in preorder
+    size_t nsubg;
+    size_t cap;
+} subglist_t;
+
+static void collectsubg(subglist_t * l, Agraph_t * g)
+{
+    Agraph_t *subg;
+
+    for (subg = agfstsubg(g); subg; subg = agnxtsubg(subg)) {
+	if (l->nsubg == l->cap) {
+	    size_t ncap = l->cap ? l->cap * 2 : 16;
+	    l->subg = gv_recalloc(l->subg, l->cap, ncap, sizeof(Agraph_t *));
+	    l->cap = ncap;
+	}
+	l->subg[l->nsubg++] = subg;
+	collectsubg(l, subg);
+    }
+}
+
+/* declsyms:
+ * The attributes of kind as seen from g, indexed by ID.
+ */
+static Agsym_t **declsyms(Agraph_t * g, int kind, size_t * n)
+{
+    Agsym_t *sym, **syms;
+    size_t cnt = 0;
+
+    for (sym = agnxtattr(g, kind, NULL); sym; sym = agnxtattr(g, kind, sym))
+	cnt++;
+    syms = gv_calloc(cnt, sizeof(Agsym_t *));
+    for (sym = agnxtattr(g, kind, NULL); sym; sym = agnxtattr(g, kind, sym)) {
+	assert(sym->id >= 0 && (size_t) sym->id < cnt);
+	syms[sym->id] = sym;
+    }
+    *n = cnt;
+    return syms;
+}
+
+static void putvalue(agxbuf * xb, strtab_t * t, void *obj, Agsym_t * sym)
+{
+    char *v = agxget(obj, sym);
+    putvarint(xb, v == sym->defval ? 0 : strref(t, v, true));
+}
+
+/* putlocaldefs:
+ * Attribute defaults declared in subgraph g itself.
+ */
+static void putlocaldefs(agxbuf * xb, strtab_t * t, Agraph_t * g)
+{
+    Agdatadict_t *dd = agdatadict(g, FALSE);
+    Dict_t *dicts[3], *view;
+    Agsym_t *sym;
+    int i;
+
+    if (dd == NULL) {
+	for (i = 0; i < 3; i++)
+	    putvarint(xb, 0);
+	return;
+    }
+    dicts[0] = dd->dict.g;
+    dicts[1] = dd->dict.n;
+    dicts[2] = dd->dict.e;
+    for (i = 0; i < 3; i++) {
+	view = dtview(dicts[i], NULL);
+	putvarint(xb, (uint64_t) dtsize(dicts[i]));
+	for (sym = dtfirst(dicts[i]); sym; sym = dtnext(dicts[i], sym)) {
+	    putvarint(xb, strref(t, sym->name, false));
+	    putvarint(xb, strref(t, sym->defval, true));
+	    agxbputc(xb, (char) sym->print);
+	}
+	dtview(dicts[i], view);
+    }
+}
+
+int agwrite_binaryfn(Agraph_t * g, void *chan,
+		     size_t (*putbuf) (void *chan, const char *buf,
+				       size_t len))
+{
+    Agraph_t *root = agroot(g);
+    strtab_t tab = { 0 };
+    subglist_t subgs = { 0 };
+    agxbuf body, hdr;
+    Agsym_t **syms[3];
+    size_t nsyms[3];
+    size_t nnodes = 0, nedges = 0, i, k;
+    size_t *nodeidx, *edgeidx;
+    Agnode_t *n;
+    Agedge_t *e;
+    uint64_t flags;
+    int rv = 0;
+
+    agxbinit(&body, 0, NULL);
+    agxbinit(&hdr, 64, NULL);
+    agxbinit(&tab.data, 0, NULL);
+
+    /* node and edge numbers, keyed on sequence numbers of the root */
+    nodeidx = gv_calloc((size_t) root->clos->seq[AGNODE] + 1, sizeof(size_t));
+    edgeidx = gv_calloc((size_t) root->clos->seq[AGEDGE] + 1, sizeof(size_t));
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	nodeidx[AGSEQ(n)] = nnodes++;
+	for (e = agfstout(g, n); e; e = agnxtout(g, e))
+	    edgeidx[AGSEQ(e)] = nedges++;
+    }
+    collectsubg(&subgs, g);
+
+    flags = (g->desc.directed ? GVB_DIRECTED : 0)
+	| (g->desc.strict ? GVB_STRICT : 0)
+	| (g->desc.no_loop ? GVB_NO_LOOP : 0);
+    putvarint(&body, flags);
+    putvarint(&body, strref(&tab, graphname(g), false));
+
+    for (k = 0; k < 3; k++) {
+	syms[k] = declsyms(g, Kinds[k], &nsyms[k]);
+	putvarint(&body, nsyms[k]);
+	for (i = 0; i < nsyms[k]; i++) {
+	    putvarint(&body, strref(&tab, syms[k][i]->name, false));
+	    putvarint(&body, strref(&tab, syms[k][i]->defval, true));
+	    agxbputc(&body, (char) syms[k][i]->print);
+	}
+    }
+
+    putvarint(&body, subgs.nsubg);
+    for (i = 0; i < subgs.nsubg; i++) {
+	Agraph_t *par = agparent(subgs.subg[i]);
+	size_t p = 0;
+	/* parents precede their children */
+	if (par != g)
+	    for (p = i; subgs.subg[p - 1] != par; p--);
+	putvarint(&body, p);
+	putvarint(&body, strref(&tab, graphname(subgs.subg[i]), false));
+	putlocaldefs(&body, &tab, subgs.subg[i]);
+    }
+
+    putvarint(&body, nnodes);
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	putvarint(&body, strref(&tab, agnameof(n), false));
+
+    putvarint(&body, nedges);
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	for (e = agfstout(g, n); e; e = agnxtout(g, e))
+	    putvarint(&body, nodeidx[AGSEQ(agtail(e))]);
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	for (e = agfstout(g, n); e; e = agnxtout(g, e))
+	    putvarint(&body, nodeidx[AGSEQ(aghead(e))]);
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	for (e = agfstout(g, n); e; e = agnxtout(g, e))
+	    putvarint(&body, strref(&tab, agnameof(e), false));
+
+    for (i = 0; i < nsyms[1]; i++)
+	for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	    putvalue(&body, &tab, n, syms[1][i]);
+    for (i = 0; i < nsyms[2]; i++)
+	for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	    for (e = agfstout(g, n); e; e = agnxtout(g, e))
+		putvalue(&body, &tab, e, syms[2][i]);
+    for (i = 0; i < nsyms[0]; i++) {
+	putvalue(&body, &tab, g, syms[0][i]);
+	for (k = 0; k < subgs.nsubg; k++)
+	    putvalue(&body, &tab, subgs.subg[k], syms[0][i]);
+    }
+
+    for (i = 0; i < subgs.nsubg; i++) {
+	Agraph_t *subg = subgs.subg[i];
+	putvarint(&body, (uint64_t) agnnodes(subg));
+	for (n = agfstnode(subg); n; n = agnxtnode(subg, n))
+	    putvarint(&body, nodeidx[AGSEQ(n)]);
+	putvarint(&body, (uint64_t) agnedges(subg));
+	for (n = agfstnode(subg); n; n = agnxtnode(subg, n))
+	    for (e = agfstout(subg, n); e; e = agnxtout(subg, e))
+		putvarint(&body, edgeidx[AGSEQ(e)]);
+    }
+
+    /* the string table goes first, so prefix it to the rest of the body */
+    agxbput_n(&hdr, GVB_MAGIC, GVB_MAGICLEN);
+    putvarint(&hdr, GVB_VERSION);
+    {
+	agxbuf cnt;
+	agxbinit(&cnt, 16, NULL);
+	putvarint(&cnt, tab.size);
+	putvarint(&hdr, agxblen(&cnt) + agxblen(&tab.data) + agxblen(&body));
+	agxbput_n(&hdr, agxbstart(&cnt), agxblen(&cnt));
+	agxbfree(&cnt);
+    }
+    if (putbuf(chan, agxbstart(&hdr), agxblen(&hdr)) != agxblen(&hdr)
+	|| putbuf(chan, agxbstart(&tab.data),
+		  agxblen(&tab.data)) != agxblen(&tab.data)
+	|| putbuf(chan, agxbstart(&body), agxblen(&body)) != agxblen(&body))
+	rv = EOF;
+
+    for (k = 0; k < 3; k++)
+	free(syms[k]);
+    free(subgs.subg);
+    free(nodeidx);
+    free(edgeidx);
+    free(tab.off);
+    free(tab.html);
+    free(tab.slot);
+    agxbfree(&tab.data);
+    agxbfree(&body);
+    agxbfree(&hdr);
+    return rv;
+}
+
+static size_t filewrite(void *chan, const char *buf, size_t len)
+{
+    return fwrite(buf, 1, len, chan);
+}
+
+int agwrite_binary(Agraph_t * g, void *chan)
+{
+    if (agwrite_binaryfn(g, chan, filewrite))
+	return EOF;
+    return fflush(chan);
+}
+
+int agisbinary(void *chan)
+{
+    int c = getc(chan);
+
+    if (c == EOF)
+	return 0;
+    ungetc(c, chan);
+    return c == (unsigned char) GVB_MAGIC[0];
+}
+
+/* reading */
+
+typedef struct {
+    unsigned char *p;	///< the body, which strings point into
+    unsigned char *end;
+    bool error;
+} rd_t;
+
+static uint64_t getvarint(rd_t * r)
+{
+    uint64_t v = 0;
+    unsigned shift = 0;
+
+    while (r->p < r->end && shift < 64) {
+	unsigned char c = *r->p++;
+	v |= (uint64_t) (c & 0x7f) << shift;
+	if (!(c & 0x80))
+	    return v;
+	shift += 7;
+    }
+    r->error = true;
+    return 0;
+}
+
+/* getcount:
+ * A count of items, each taking at least min bytes of what is left.
+ */
+static size_t getcount(rd_t * r, size_t min)
+{
+    uint64_t v = getvarint(r);
+
+    if (v > (uint64_t) (r->end - r->p) / (min ? min : 1)) {
+	r->error = true;
+	return 0;
+    }
+    return (size_t) v;
+}
+
+/* getindex:
+ * An index in [0, limit).
+ */
+static size_t getindex(rd_t * r, size_t limit)
+{
+    uint64_t v = getvarint(r);
+
+    if (v >= limit) {
+	r->error = true;
+	return 0;
+    }
+    return (size_t) v;
+}
+
+static int getbyte(rd_t * r)
+{
+    if (r->p >= r->end) {
+	r->error = true;
+	return 0;
+    }
+    return *r->p++;
+}
+
+typedef struct {
+    char **str;			///< interned strings, or raw ones before agopen
+    bool *html;
+    size_t size;
+} rdtab_t;
+
+/* getstr:
+ * A string reference. The result may be NULL, unless required.
+ */
+static char *getstr(rd_t * r, const rdtab_t * t, bool required)
+{
+    size_t i = getindex(r, t->size + 1);
+
+    if (i == 0 && required)
+	r->error = true;
+    return i ? t->str[i - 1] : NULL;
+}
+
+/* setvalue:
+ * Set the attribute of obj from a column entry, unless it already holds it.
+ * Strings are interned in the graph, so that is a pointer comparison.
+ */
+static void setvalue(rd_t * r, const rdtab_t * t, void *obj, Agsym_t * sym,
+		     char *dflt)
+{
+    char *v = getstr(r, t, false);
+
+    if (v == NULL)
+	v = dflt;
+    if (agxget(obj, sym) != v)
+	agxset(obj, sym, v);
+}
+
+static Agraph_t *readbody(rd_t * r, Agdisc_t * disc)
+{
+    rdtab_t tab = { 0 };
+    Agraph_t *g = NULL, **subg = NULL;
+    Agsym_t **syms[3] = { NULL, NULL, NULL };
+    char **dflt[3] = { NULL, NULL, NULL };
+    size_t nsyms[3] = { 0, 0, 0 };
+    Agnode_t **node = NULL;
+    Agedge_t **edge = NULL;
+    size_t nsubg = 0, nnodes = 0, nedges = 0, i, j, k, cnt;
+    size_t *ends = NULL;
+    uint64_t flags;
+    Agdesc_t desc = { 0 };
+    char *name;
+
+    tab.size = getcount(r, 3);
+    tab.str = gv_calloc(tab.size, sizeof(char *));
+    tab.html = gv_calloc(tab.size, sizeof(bool));
+    for (i = 0; i < tab.size && !r->error; i++) {
+	size_t len = getcount(r, 1);
+	tab.html[i] = getbyte(r);
+	if (r->error || len >= (size_t) (r->end - r->p) || r->p[len] != '\0') {
+	    r->error = true;
+	    break;
+	}
+	tab.str[i] = (char *) r->p;
+	r->p += len + 1;
+    }
+    flags = getvarint(r);
+    name = getstr(r, &tab, false);
+    if (r->error)
+	goto done;
+
+    desc.directed = !!(flags & GVB_DIRECTED);
+    desc.strict = !!(flags & GVB_STRICT);
+    desc.no_loop = !!(flags & GVB_NO_LOOP);
+    desc.maingraph = TRUE;
+    g = agopen(name, desc, disc);
+
+    /* from here on, work with strings interned in the graph */
+    for (i = 0; i < tab.size; i++)
+	tab.str[i] = tab.html[i] ? agstrdup_html(g, tab.str[i])
+				 : agstrdup(g, tab.str[i]);
+
+    for (k = 0; k < 3 && !r->error; k++) {
+	nsyms[k] = getcount(r, 3);
+	syms[k] = gv_calloc(nsyms[k], sizeof(Agsym_t *));
+	dflt[k] = gv_calloc(nsyms[k], sizeof(char *));
+	for (i = 0; i < nsyms[k] && !r->error; i++) {
+	    char *aname = getstr(r, &tab, true);
+	    char *def = getstr(r, &tab, true);
+	    int print = getbyte(r);
+	    if (r->error)
+		break;
+	    syms[k][i] = agattr(g, Kinds[k], aname, def);
+	    syms[k][i]->print = (unsigned char) print;
+	    dflt[k][i] = def;
+	}
+    }
+
+    nsubg = getcount(r, 5);
+    subg = gv_calloc(nsubg + 1, sizeof(Agraph_t *));
+    subg[0] = g;
+    for (i = 1; i <= nsubg && !r->error; i++) {
+	size_t p = getindex(r, i);
+	name = getstr(r, &tab, false);
+	if (r->error)
+	    break;
+	subg[i] = agsubg(subg[p], name, TRUE);
+	for (k = 0; k < 3 && !r->error; k++) {
+	    cnt = getcount(r, 3);
+	    for (j = 0; j < cnt && !r->error; j++) {
+		char *aname = getstr(r, &tab, true);
+		char *def = getstr(r, &tab, true);
+		int print = getbyte(r);
+		if (r->error)
+		    break;
+		agattr(subg[i], Kinds[k], aname, def)->print =
+		    (unsigned char) print;
+	    }
+	}
+    }
+    if (r->error)
+	goto done;
+
+    nnodes = getcount(r, 1);
+    node = gv_calloc(nnodes, sizeof(Agnode_t *));
+    for (i = 0; i < nnodes && !r->error; i++)
+	node[i] = agnode(g, getstr(r, &tab, false), TRUE);
+
+    nedges = getcount(r, 3);
+    edge = gv_calloc(nedges, sizeof(Agedge_t *));
+    ends = gv_calloc(2 * nedges, sizeof(size_t));	/* tails, then heads */
+    for (i = 0; i < 2 * nedges && !r->error; i++)
+	ends[i] = getindex(r, nnodes);
+    for (i = 0; i < nedges && !r->error; i++) {
+	edge[i] = agedge(g, node[ends[i]], node[ends[nedges + i]],
+			 getstr(r, &tab, false), TRUE);
+	if (edge[i] == NULL)
+	    r->error = true;
+    }
+    if (r->error)
+	goto done;
+
+    for (i = 0; i < nsyms[1] && !r->error; i++)
+	for (j = 0; j < nnodes; j++)
+	    setvalue(r, &tab, node[j], syms[1][i], dflt[1][i]);
+    for (i = 0; i < nsyms[2] && !r->error; i++)
+	for (j = 0; j < nedges; j++)
+	    setvalue(r, &tab, edge[j], syms[2][i], dflt[2][i]);
+    for (i = 0; i < nsyms[0] && !r->error; i++)
+	for (j = 0; j <= nsubg; j++)
+	    setvalue(r, &tab, subg[j], syms[0][i], dflt[0][i]);
+
+    for (i = 1; i <= nsubg && !r->error; i++) {
+	cnt = getcount(r, 1);
+	for (j = 0; j < cnt && !r->error; j++) {
+	    k = getindex(r, nnodes);
+	    if (!r->error)
+		agsubnode(subg[i], node[k], TRUE);
+	}
+	cnt = getcount(r, 1);
+	for (j = 0; j < cnt && !r->error; j++) {
+	    k = getindex(r, nedges);
+	    if (!r->error)
+		agsubedge(subg[i], edge[k], TRUE);
+	}
+    }
+
+  done:
+    if (g)
+	for (i = 0; i < tab.size; i++)
+	    agstrfree(g, tab.str[i]);
+    if (r->error || r->p != r->end) {
+	agerr(AGERR, "corrupt binary graph image\n");
+	if (g)
+	    agclose(g);
+	g = NULL;
+    }
+    for (k = 0; k < 3; k++) {
+	free(syms[k]);
+	free(dflt[k]);
+    }
+    free(tab.str);
+    free(tab.html);
+    free(subg);
+    free(node);
+    free(edge);
+    free(ends);
+    return g;
+}
+
+/* filevarint:
+ * As getvarint, from a stream.
+ */
+static int filevarint(FILE * fp, uint64_t * v)
+{
+    unsigned shift;
+    int c;
+
+    *v = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+	if ((c = getc(fp)) == EOF)
+	    return -1;
+	*v |= (uint64_t) (c & 0x7f) << shift;
+	if (!(c & 0x80))
+	    return 0;
+    }
+    return -1;
+}
+
+Agraph_t *agread_binary(void *chan, Agdisc_t * disc)
+{
+    char magic[GVB_MAGICLEN];
+    uint64_t version, len;
+    unsigned char *buf;
+    Agraph_t *g;
+    rd_t r;
+
+    if (fread(magic, 1, GVB_MAGICLEN, chan) != GVB_MAGICLEN)
+	return NULL;
+    if (memcmp(magic, GVB_MAGIC, GVB_MAGICLEN)) {
+	agerr(AGERR, "not a binary graph image\n");
+	return NULL;
+    }
+    if (filevarint(chan, &version) || filevarint(chan, &len)) {
+	agerr(AGERR, "truncated binary graph image\n");
+	return NULL;
+    }
+    if (version != GVB_VERSION) {
+	agerr(AGERR, "unsupported binary graph image version %" PRIu64 "\n",
+	      version);
+	return NULL;
+    }
+    if (len > SIZE_MAX || (buf = malloc((size_t) len)) == NULL) {
+	agerr(AGERR, "binary graph image too large\n");
+	return NULL;
+    }
+    if (fread(buf, 1, (size_t) len, chan) != len) {
+	agerr(AGERR, "truncated binary graph image\n");
+	free(buf);
+	return NULL;
+    }
+    r.p = buf;
+    r.end = buf + len;
+    r.error = false;
+    g = readbody(&r, disc);
+    free(buf);
+    return g;
+}
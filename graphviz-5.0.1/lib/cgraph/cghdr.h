@@ -79,6 +79,22 @@ enum { SEQ_MASK = (1 << (sizeof(unsigned) * 8 - 4)) - 1 };
 Agnode_t *agfindnode_by_id(Agraph_t * g, IDTYPE id);
 uint64_t agnextseq(Agraph_t * g, int objtype);
 
+	/* hashed index of the root graph's nodes and edges by ID */
+bool agidhashnodes(Agraph_t * g);
+bool agidhashedges(Agraph_t * g);
+void agidhashinsnode(Agraph_t * g, Agnode_t * n);
+void agidhashdelnode(Agraph_t * g, Agnode_t * n);
+Agnode_t *agidhashfindnode(Agraph_t * g, IDTYPE id);
+void agidhashinsedge(Agraph_t * g, Agedge_t * e);
+void agidhashdeledge(Agraph_t * g, Agedge_t * e);
+Agedge_t *agidhashfindedge(Agraph_t * g, Agnode_t * t, Agnode_t * h,
+			   IDTYPE id);
+void agidhashclose(Agraph_t * g);
+
+	/* typed caches of parsed attribute values */
+void agattrcacheinval(void *obj, Agsym_t * sym);
+void agattrcacheclose(Agraph_t * g);
+
 /* dict helper functions */
 Dict_t *agdtopen(Agraph_t * g, Dtdisc_t * disc, Dtmethod_t * method);
 void agdtdisc(Agraph_t * g, Dict_t * dict, Dtdisc_t * disc);
@@ -105,6 +121,9 @@ void aglexinit(Agdisc_t * disc, void *ifile);
 int aaglex(void);
 void aglexeof(void);
 void aglexbad(void);
+int aglexbuffer(char *buf, size_t len,
+		void (*consumed)(void *ctx, const char *upto), void *ctx);
+void aglexunbuffer(void);
 
 	/* ID management */
 int agmapnametoid(Agraph_t * g, int objtype, char *str,
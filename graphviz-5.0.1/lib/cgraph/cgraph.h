@@ -207,6 +207,8 @@ struct Agdisc_s {
 	/* default resource disciplines */
 
 CGRAPH_API extern Agmemdisc_t AgMemDisc;
+/// allocates from per-graph arenas that are released all at once by agclose
+CGRAPH_API extern Agmemdisc_t AgArenaDisc;
 CGRAPH_API extern Agiddisc_t AgIdDisc;
 CGRAPH_API extern Agiodisc_t AgIoDisc;
 
@@ -248,6 +250,8 @@ struct Agclos_s {
     unsigned char callbacks_enabled;	/* issue user callbacks or hold them? */
     Dict_t *lookup_by_name[3];
     Dict_t *lookup_by_id[3];
+    struct Agidhash_s *idhash;	/* hashed index of root objects by ID */
+    struct Agattrcache_s *attrcache;	/* parsed attribute values */
 };
 
 struct Agraph_s {
@@ -271,11 +275,25 @@ CGRAPH_API Agraph_t *agopen(char *name, Agdesc_t desc, Agdisc_t * disc);
 CGRAPH_API int agclose(Agraph_t * g);
 CGRAPH_API Agraph_t *agread(void *chan, Agdisc_t * disc);
 CGRAPH_API Agraph_t *agmemread(const char *cp);
+/// read the first graph in the file at `path`, scanning it through a
+/// memory mapping where the platform supports it
+CGRAPH_API Agraph_t *agmmapread(const char *path);
 CGRAPH_API Agraph_t *agmemconcat(Agraph_t *g, const char *cp);
 CGRAPH_API void agreadline(int);
 CGRAPH_API void agsetfile(const char *);
 CGRAPH_API Agraph_t *agconcat(Agraph_t * g, void *chan, Agdisc_t * disc);
 CGRAPH_API int agwrite(Agraph_t * g, void *chan);
+/// write `g` to the stdio stream `chan` as a binary image, which
+/// \ref agread_binary loads much faster than \ref agread parses DOT
+CGRAPH_API int agwrite_binary(Agraph_t * g, void *chan);
+/// write a binary image of `g`, handing it to `putbuf` in pieces
+CGRAPH_API int agwrite_binaryfn(Agraph_t * g, void *chan,
+                                size_t (*putbuf)(void *chan, const char *buf,
+                                                 size_t len));
+/// read the next binary image from the stdio stream `chan`
+CGRAPH_API Agraph_t *agread_binary(void *chan, Agdisc_t * disc);
+/// whether the next byte of the stdio stream `chan` starts a binary image
+CGRAPH_API int agisbinary(void *chan);
 CGRAPH_API int agisdirected(Agraph_t * g);
 CGRAPH_API int agisundirected(Agraph_t * g);
 CGRAPH_API int agisstrict(Agraph_t * g);
@@ -376,6 +394,17 @@ CGRAPH_API int agxset(void *obj, Agsym_t * sym, const char *value);
 CGRAPH_API int agsafeset(void* obj, char* name, const char* value,
                          const char* def);
 
+/* typed attribute values */
+/// These parse the attribute `sym` of `obj` the way strtod, strtol and
+/// `sscanf("%lf,%lf")` would, keeping the result in a per-attribute column
+/// indexed by sequence number until \ref agxset next changes the attribute.
+/// Each returns 1 and stores the value if the string starts with one, or 0
+/// otherwise. Reads update the cache, so they must not run concurrently on
+/// the same root graph.
+CGRAPH_API int agxgetdouble(void *obj, Agsym_t * sym, double *value);
+CGRAPH_API int agxgetint(void *obj, Agsym_t * sym, int *value);
+CGRAPH_API int agxgetpoint(void *obj, Agsym_t * sym, double *x, double *y);
+
 /* definitions for subgraphs */
 CGRAPH_API Agraph_t *agsubg(Agraph_t * g, char *name, int cflag);	/* constructor */
 CGRAPH_API Agraph_t *agidsubg(Agraph_t * g, IDTYPE id, int cflag);	/* constructor */
@@ -390,6 +419,34 @@ CGRAPH_API int agnsubg(Agraph_t * g);
 CGRAPH_API int agdegree(Agraph_t * g, Agnode_t * n, int in, int out);
 CGRAPH_API int agcountuniqedges(Agraph_t * g, Agnode_t * n, int in, int out);
 
+/* compressed sparse row snapshots */
+/// read-only copy of the adjacency of a graph or subgraph
+///
+/// Node `i` is the `i`th node visited by agfstnode/agnxtnode. Its out-edges
+/// occupy positions `out_offset[i]` up to `out_offset[i + 1]` of `out_target`
+/// and `out_edge`, in agfstout/agnxtout order; in-edges are laid out the same
+/// way in the `in_` arrays. A loop appears in both lists, so a walk that wants
+/// agfstedge/agnxtedge semantics should skip in-edges whose source is `i`.
+/// The snapshot does not track later changes to the graph.
+typedef struct {
+    int nnodes;
+    int nedges;
+    Agnode_t **node;      ///< index → node
+    int *out_offset;      ///< `nnodes + 1` entries
+    int *out_target;      ///< index of the head of each out-edge
+    Agedge_t **out_edge;  ///< the out-edges themselves
+    int *in_offset;       ///< `nnodes + 1` entries
+    int *in_source;       ///< index of the tail of each in-edge
+    Agedge_t **in_edge;   ///< the in-edges themselves
+    int *index;           ///< node sequence number → index, or -1
+    size_t nindex;        ///< number of entries in `index`
+} Agcsr_t;
+
+CGRAPH_API Agcsr_t *agcsr(Agraph_t * g);
+/// index of `n` in the snapshot, or -1 if it was not in the graph
+CGRAPH_API int agcsrindex(const Agcsr_t * csr, Agnode_t * n);
+CGRAPH_API void agcsrfree(Agcsr_t * csr);
+
 /* memory */
 CGRAPH_API void *agalloc(Agraph_t * g, size_t size);
 CGRAPH_API void *agrealloc(Agraph_t * g, void *ptr, size_t oldsize,
@@ -0,0 +1,94 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/// \file
+/// \brief read-only compressed sparse row snapshots of a graph
+
+#include <cgraph/alloc.h>
+#include <cgraph/cghdr.h>
+#include <stdlib.h>
+
+Agcsr_t *agcsr(Agraph_t *g)
+{
+    Agcsr_t *csr = gv_alloc(sizeof(Agcsr_t));
+    Agnode_t *n;
+    Agedge_t *e;
+    int i, k;
+
+    csr->nnodes = agnnodes(g);
+    csr->nedges = agnedges(g);
+
+    // node sequence numbers are unique within the root graph, so they make a
+    // dense enough key for the reverse mapping
+    csr->nindex = (size_t)agroot(g)->clos->seq[AGNODE] + 1;
+    csr->index = gv_calloc(csr->nindex, sizeof(int));
+    for (size_t j = 0; j < csr->nindex; j++)
+	csr->index[j] = -1;
+
+    csr->node = gv_calloc((size_t)csr->nnodes, sizeof(Agnode_t *));
+    i = 0;
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	csr->index[AGSEQ(n)] = i;
+	csr->node[i++] = n;
+    }
+
+    csr->out_offset = gv_calloc((size_t)csr->nnodes + 1, sizeof(int));
+    csr->out_target = gv_calloc((size_t)csr->nedges, sizeof(int));
+    csr->out_edge = gv_calloc((size_t)csr->nedges, sizeof(Agedge_t *));
+    csr->in_offset = gv_calloc((size_t)csr->nnodes + 1, sizeof(int));
+    csr->in_source = gv_calloc((size_t)csr->nedges, sizeof(int));
+    csr->in_edge = gv_calloc((size_t)csr->nedges, sizeof(Agedge_t *));
+
+    k = 0;
+    for (i = 0; i < csr->nnodes; i++) {
+	csr->out_offset[i] = k;
+	for (e = agfstout(g, csr->node[i]); e; e = agnxtout(g, e)) {
+	    csr->out_target[k] = csr->index[AGSEQ(aghead(e))];
+	    csr->out_edge[k++] = e;
+	}
+    }
+    csr->out_offset[i] = k;
+
+    k = 0;
+    for (i = 0; i < csr->nnodes; i++) {
+	csr->in_offset[i] = k;
+	for (e = agfstin(g, csr->node[i]); e; e = agnxtin(g, e)) {
+	    csr->in_source[k] = csr->index[AGSEQ(agtail(e))];
+	    csr->in_edge[k++] = e;
+	}
+    }
+    csr->in_offset[i] = k;
+
+    return csr;
+}
+
+int agcsrindex(const Agcsr_t *csr, Agnode_t *n)
+{
+    uint64_t seq = AGSEQ(n);
+
+    if (seq >= csr->nindex)
+	return -1;
+    return csr->index[seq];
+}
+
+void agcsrfree(Agcsr_t *csr)
+{
+    if (!csr)
+	return;
+    free(csr->node);
+    free(csr->index);
+    free(csr->out_offset);
+    free(csr->out_target);
+    free(csr->out_edge);
+    free(csr->in_offset);
+    free(csr->in_source);
+    free(csr->in_edge);
+    free(csr);
+}
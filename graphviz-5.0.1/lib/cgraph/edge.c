@@ -115,6 +115,9 @@ static Agedge_t *agfindedge_by_key(Agraph_t * g, Agnode_t * t, Agnode_t * h,
 
     if (t == NULL || h == NULL)
 	return NULL;
+    /* exact lookups on the root graph go through the hash index */
+    if (g == agroot(g) && key.objtype != 0 && agidhashedges(g))
+	return agidhashfindedge(g, t, h, key.id);
     template.base.tag = key;
     template.node = t;		/* guess that fan-in < fan-out */
     sn = agsubrep(g, h);
@@ -167,7 +170,11 @@ static void del(Dict_t * d, Dtlink_t ** set, Agedge_t * e)
     *set = dtextract(d);
 }
 
-static void installedge(Agraph_t * g, Agedge_t * e)
+/* installedge:
+ * Insert e into g and its ancestors, up to the first one that already has
+ * it. A new edge is in none of them, so there is no need to look.
+ */
+static void installedge(Agraph_t * g, Agedge_t * e, bool isnew)
 {
     Agnode_t *t, *h;
     Agedge_t *out, *in;
@@ -178,20 +185,22 @@ static void installedge(Agraph_t * g, Agedge_t * e)
     t = agtail(e);
     h = aghead(e);
     while (g) {
-	if (agfindedge_by_key(g, t, h, AGTAG(e))) break;
+	if (!isnew && agfindedge_by_key(g, t, h, AGTAG(e))) break;
 	sn = agsubrep(g, t);
 	ins(g->e_seq, &sn->out_seq, out);
 	ins(g->e_id, &sn->out_id, out);
 	sn = agsubrep(g, h);
 	ins(g->e_seq, &sn->in_seq, in);
 	ins(g->e_id, &sn->in_id, in);
+	if (g == agroot(g))
+	    agidhashinsedge(g, e);
 	g = agparent(g);
     }
 }
 
 static void subedge(Agraph_t * g, Agedge_t * e)
 {
-    installedge(g, e);
+    installedge(g, e, false);
     /* might an init method call be needed here? */
 }
 
@@ -215,7 +224,7 @@ static Agedge_t *newedge(Agraph_t * g, Agnode_t * t, Agnode_t * h,
     in->node = t;
     out->node = h;
 
-    installedge(g, out);
+    installedge(g, out, true);
     if (g->desc.has_attrs) {
 	(void)agbindrec(out, AgDataRecName, sizeof(Agattr_t), false);
 	agedgeattr_init(g, out);
@@ -325,6 +334,8 @@ void agdeledgeimage(Agraph_t * g, Agedge_t * e, void *ignored)
     }
     t = in->node;
     h = out->node;
+    if (g == agroot(g))
+	agidhashdeledge(g, e);
     sn = agsubrep(g, t);
     del(g->e_seq, &sn->out_seq, out);
     del(g->e_id, &sn->out_id, out);
@@ -371,7 +382,7 @@ Agedge_t *agsubedge(Agraph_t * g, Agedge_t * e, int cflag)
     if (t && h) {
 	rv = agfindedge_by_key(g, t, h, AGTAG(e));
 	if (cflag && rv == NULL) {
-	installedge(g, e);
+	installedge(g, e, false);
 	rv = e;
 	}
 	if (rv && (AGTYPE(rv) != AGTYPE(e)))
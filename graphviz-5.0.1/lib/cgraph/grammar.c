@@ -1954,6 +1954,22 @@ static void attrstmt(int tkind, char *macroname)
 
 /* nodes */
 
+/* findnode:
+ * Return the node called name in the current graph, creating it if need be.
+ * The lexer has already interned name in G's string dictionary, and with
+ * the default ID discipline that address is the node's ID, so a node seen
+ * before can be found in the root's hash index without mapping the name.
+ */
+static Agnode_t *findnode(char *name)
+{
+	Agnode_t	*n;
+
+	if (AGDISC(G, id) == &AgIdDisc && agidhashnodes(G) &&
+	    (n = agidhashfindnode(G, (IDTYPE)(uintptr_t)name)))
+		return agsubnode(S->g,n,TRUE);
+	return agnode(S->g,name,TRUE);
+}
+
 static void appendnode(char *name, char *port, char *sport)
 {
 	item		*elt;
@@ -1961,7 +1977,7 @@ static void appendnode(char *name, char *port, char *sport)
 	if (sport) {
 		port = concatPort (port, sport);
 	}
-	elt = cons_node(agnode(S->g,name,TRUE),port);
+	elt = cons_node(findnode(name),port);
 	listapp(&(S->nodelist),elt);
 	agstrfree(G,name);
 }
@@ -143,6 +143,8 @@ int agclose(Agraph_t * g)
 	while (g->clos->cb)
 	    agpopdisc(g, g->clos->cb->f);
 	AGDISC(g, id)->close(AGCLOS(g, id));
+	agidhashclose(g);
+	agattrcacheclose(g);
 	if (agstrclose(g)) return FAILURE;
 	memdisc = AGDISC(g, mem);
 	memclos = AGCLOS(g, mem);
@@ -0,0 +1,284 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/// \file
+/// \brief hashed lookup of the nodes and edges of a root graph by ID
+///
+/// The ID-ordered trees of a graph remain the authoritative object sets, but
+/// searching them costs a tree descent per lookup, and parsing does one or
+/// more lookups for every node and edge statement. This index shadows the
+/// root graph's sets in open addressing tables so that exact lookups on the
+/// root take constant expected time. With the default ID discipline, the ID of
+/// a named object is the address of its interned name, so the node table is
+/// effectively keyed on the refstr pointer.
+///
+/// Small graphs are not indexed, as their trees are shallow and plenty of
+/// them are short-lived scratch graphs built by the layout engines. A table
+/// is built from the root's sets once it has seen `IDHASH_MIN` objects of
+/// the kind. Subgraphs are never indexed.
+
+#include <cgraph/cghdr.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum { IDHASH_MIN = 1024 };
+
+struct Agidhash_s {
+    Agnode_t **node;	///< open addressing table of nodes
+    size_t node_cap;	///< power of 2, or 0 before first use
+    size_t node_size;
+    Agedge_t **edge;	///< in-edges, as found by the ID tree lookup
+    size_t edge_cap;
+    size_t edge_size;
+};
+
+/* 64-bit finalizer from MurmurHash3. IDs are often aligned pointers, so the
+ * low bits need mixing in from above.
+ */
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static size_t nodehash(IDTYPE id)
+{
+    return (size_t)mix(id);
+}
+
+static size_t edgehash(Agnode_t * t, Agnode_t * h, IDTYPE id)
+{
+    uint64_t x = mix(id);
+    x = mix(x ^ (uint64_t)(uintptr_t)t);
+    return (size_t)mix(x ^ (uint64_t)(uintptr_t)h);
+}
+
+static Agnode_t *tailof(Agedge_t * in)
+{
+    return in->node;
+}
+
+static Agnode_t *headof(Agedge_t * in)
+{
+    return AGIN2OUT(in)->node;
+}
+
+static struct Agidhash_s *idhash(Agraph_t * g)
+{
+    Agclos_t *clos = g->clos;
+
+    if (clos->idhash == NULL)
+	clos->idhash = agalloc(agroot(g), sizeof(struct Agidhash_s));
+    return clos->idhash;
+}
+
+bool agidhashnodes(Agraph_t * g)
+{
+    return g->clos->idhash && g->clos->idhash->node_cap;
+}
+
+bool agidhashedges(Agraph_t * g)
+{
+    return g->clos->idhash && g->clos->idhash->edge_cap;
+}
+
+/* A generic open addressing table over pointers, parameterized by the hash
+ * of a stored element. Used for both the node and the edge table.
+ */
+typedef size_t (*slothash_t)(void *);
+
+static size_t nodeslothash(void *n)
+{
+    return nodehash(AGID((Agnode_t *) n));
+}
+
+static size_t edgeslothash(void *e)
+{
+    return edgehash(tailof(e), headof(e), AGID((Agedge_t *) e));
+}
+
+static void **grow(Agraph_t * g, void **tab, size_t * cap, slothash_t hash)
+{
+    size_t ncap = *cap ? *cap * 2 : 64;
+    void **ntab = agalloc(g, ncap * sizeof(void *));
+    size_t i, j;
+
+    for (i = 0; i < *cap; i++) {
+	if (tab[i] == NULL)
+	    continue;
+	for (j = hash(tab[i]) & (ncap - 1); ntab[j]; j = (j + 1) & (ncap - 1));
+	ntab[j] = tab[i];
+    }
+    if (tab)
+	agfree(g, tab);
+    *cap = ncap;
+    return ntab;
+}
+
+static void **insert(Agraph_t * g, void **tab, size_t * cap, size_t * size,
+		     void *obj, slothash_t hash)
+{
+    size_t j;
+
+    if (2 * (*size + 1) > *cap)
+	tab = grow(g, tab, cap, hash);
+    for (j = hash(obj) & (*cap - 1); tab[j]; j = (j + 1) & (*cap - 1));
+    tab[j] = obj;
+    ++*size;
+    return tab;
+}
+
+/* Backward shift deletion: close the gap at i by moving up any later element
+ * of the same probe run whose home slot does not lie cyclically in (i, j].
+ */
+static void erase(void **tab, size_t cap, size_t * size, size_t i,
+		  slothash_t hash)
+{
+    size_t j, k;
+
+    for (j = (i + 1) & (cap - 1); tab[j]; j = (j + 1) & (cap - 1)) {
+	k = hash(tab[j]) & (cap - 1);
+	if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+	    continue;
+	tab[i] = tab[j];
+	i = j;
+    }
+    tab[i] = NULL;
+    --*size;
+}
+
+/* agidhashinsnode:
+ * Called once n is in the root's sets, so building the table from
+ * those sets picks n up as well.
+ */
+void agidhashinsnode(Agraph_t * g, Agnode_t * n)
+{
+    struct Agidhash_s *h;
+    Agnode_t *v;
+
+    if (agidhashnodes(g)) {
+	h = g->clos->idhash;
+	h->node = (Agnode_t **) insert(g, (void **) h->node, &h->node_cap,
+				       &h->node_size, n, nodeslothash);
+    } else if (g->clos->seq[AGNODE] >= IDHASH_MIN) {
+	h = idhash(g);
+	for (v = agfstnode(g); v; v = agnxtnode(g, v))
+	    h->node = (Agnode_t **) insert(g, (void **) h->node,
+					   &h->node_cap, &h->node_size, v,
+					   nodeslothash);
+    }
+}
+
+void agidhashdelnode(Agraph_t * g, Agnode_t * n)
+{
+    struct Agidhash_s *h = g->clos->idhash;
+    size_t mask, j;
+
+    if (!agidhashnodes(g))
+	return;
+    mask = h->node_cap - 1;
+    for (j = nodehash(AGID(n)) & mask; h->node[j]; j = (j + 1) & mask) {
+	if (h->node[j] == n) {
+	    erase((void **) h->node, h->node_cap, &h->node_size, j,
+		  nodeslothash);
+	    return;
+	}
+    }
+}
+
+Agnode_t *agidhashfindnode(Agraph_t * g, IDTYPE id)
+{
+    struct Agidhash_s *h = g->clos->idhash;
+    size_t mask, j;
+
+    assert(agidhashnodes(g));
+    mask = h->node_cap - 1;
+    for (j = nodehash(id) & mask; h->node[j]; j = (j + 1) & mask) {
+	if (AGID(h->node[j]) == id)
+	    return h->node[j];
+    }
+    return NULL;
+}
+
+/* agidhashinsedge:
+ * As for nodes, e is already in the root's sets.
+ */
+void agidhashinsedge(Agraph_t * g, Agedge_t * e)
+{
+    struct Agidhash_s *h;
+    Agnode_t *v;
+    Agedge_t *f;
+
+    if (agidhashedges(g)) {
+	h = g->clos->idhash;
+	h->edge = (Agedge_t **) insert(g, (void **) h->edge, &h->edge_cap,
+				       &h->edge_size, AGMKIN(e), edgeslothash);
+    } else if (g->clos->seq[AGEDGE] >= IDHASH_MIN) {
+	h = idhash(g);
+	for (v = agfstnode(g); v; v = agnxtnode(g, v))
+	    for (f = agfstout(g, v); f; f = agnxtout(g, f))
+		h->edge = (Agedge_t **) insert(g, (void **) h->edge,
+					       &h->edge_cap, &h->edge_size,
+					       AGMKIN(f), edgeslothash);
+    }
+}
+
+void agidhashdeledge(Agraph_t * g, Agedge_t * e)
+{
+    struct Agidhash_s *h = g->clos->idhash;
+    Agedge_t *in = AGMKIN(e);
+    size_t mask, j;
+
+    if (!agidhashedges(g))
+	return;
+    mask = h->edge_cap - 1;
+    for (j = edgeslothash(in) & mask; h->edge[j]; j = (j + 1) & mask) {
+	if (h->edge[j] == in) {
+	    erase((void **) h->edge, h->edge_cap, &h->edge_size, j,
+		  edgeslothash);
+	    return;
+	}
+    }
+}
+
+Agedge_t *agidhashfindedge(Agraph_t * g, Agnode_t * t, Agnode_t * h,
+			   IDTYPE id)
+{
+    struct Agidhash_s *x = g->clos->idhash;
+    Agedge_t *e;
+    size_t mask, j;
+
+    assert(agidhashedges(g));
+    mask = x->edge_cap - 1;
+    for (j = edgehash(t, h, id) & mask; (e = x->edge[j]); j = (j + 1) & mask) {
+	if (AGID(e) == id && tailof(e) == t && headof(e) == h)
+	    return e;
+    }
+    return NULL;
+}
+
+void agidhashclose(Agraph_t * g)
+{
+    struct Agidhash_s *h = g->clos->idhash;
+
+    if (h == NULL)
+	return;
+    if (h->node)
+	agfree(g, h->node);
+    if (h->edge)
+	agfree(g, h->edge);
+    agfree(g, h);
+    g->clos->idhash = NULL;
+}
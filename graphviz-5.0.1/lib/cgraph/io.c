@@ -14,6 +14,12 @@
 #if defined(_WIN32)
 #include <io.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 static int iofread(void *chan, char *buf, int bufsize)
 {
@@ -108,3 +114,96 @@ Agraph_t *agmemconcat(Agraph_t *g, const char *cp)
 {
     return agmemread0(g, cp);
 }
+
+#ifdef HAVE_SYS_MMAN_H
+/* Amount of scanned input to let build up before handing it back */
+#define MMAP_RELEASE (8 * 1024 * 1024)
+
+typedef struct {
+    char *base;
+    size_t released;	/* bytes at base already handed back */
+    size_t pagesize;
+} mmaprdr_t;
+
+/* mmapconsumed:
+ * The scanner writes into every page it tokenizes, so each one becomes a
+ * private copy of the file page. Once the scanner is past them, drop
+ * those copies; the mapping falls back to the clean file pages, which the
+ * system is free to evict.
+ */
+static void mmapconsumed(void *ctx, const char *upto)
+{
+    mmaprdr_t *m = ctx;
+    size_t done = (size_t)(upto - m->base) & ~(m->pagesize - 1);
+
+    if (done >= m->released + MMAP_RELEASE) {
+	(void)madvise(m->base + m->released, done - m->released,
+		      MADV_DONTNEED);
+	m->released = done;
+    }
+}
+
+Agraph_t *agmmapread(const char *path)
+{
+    Agraph_t *g = NULL;
+    struct stat st;
+    mmaprdr_t rdr;
+    size_t len, maplen;
+    char *base;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+	return NULL;
+    if (fstat(fd, &st) < 0) {
+	close(fd);
+	return NULL;
+    }
+    len = (size_t)st.st_size;
+    rdr.pagesize = (size_t)sysconf(_SC_PAGESIZE);
+
+    /* Reserve room for the file plus the two NULs the scanner needs after
+     * it, then map the file over the front. Whatever lies past the end of
+     * the file reads as zero.
+     */
+    maplen = (len + 2 + rdr.pagesize - 1) & ~(rdr.pagesize - 1);
+    base = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+	close(fd);
+	return NULL;
+    }
+    if (len > 0 && mmap(base, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+	munmap(base, maplen);
+	close(fd);
+	return NULL;
+    }
+    close(fd);
+    (void)madvise(base, len, MADV_SEQUENTIAL);
+
+    rdr.base = base;
+    rdr.released = 0;
+    if (aglexbuffer(base, len, mmapconsumed, &rdr)) {
+	agsetfile(path);
+	g = agread(NULL, NULL);	/* input comes from the buffer */
+	aglexunbuffer();
+	agsetfile(NULL);
+    }
+    munmap(base, maplen);
+    return g;
+}
+#else
+Agraph_t *agmmapread(const char *path)
+{
+    Agraph_t *g;
+    FILE *fp;
+
+    if (!(fp = fopen(path, "r")))
+	return NULL;
+    agsetfile(path);
+    g = agread(fp, NULL);
+    agsetfile(NULL);
+    fclose(fp);
+    return g;
+}
+#endif
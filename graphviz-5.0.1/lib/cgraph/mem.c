@@ -10,6 +10,7 @@
 
 #include <cgraph/cghdr.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* memory management discipline and entry points */
 static void *memopen(Agdisc_t* disc)
@@ -48,6 +49,190 @@ static void memfree(void *heap, void *ptr)
 Agmemdisc_t AgMemDisc =
     { memopen, memalloc, memresize, memfree, NULL };
 
+/* Arena memory discipline.
+ *
+ * Small objects are carved out of large chunks with a bump pointer. Each
+ * object is preceded by a header recording its size class, so freed
+ * objects go onto a per-class free list and are reused by later requests
+ * of the same class (e.g. agdelnode followed by agnode). Requests too big
+ * for a size class are passed through to malloc but remembered, so that
+ * everything is released in one pass when the root graph is closed. As
+ * the discipline has a close method, agclose of a root graph skips the
+ * object-by-object teardown entirely.
+ */
+
+#define ARENA_ALIGN	16	/* granularity of size classes */
+#define ARENA_NCLASSES	32	/* small objects are <= 512 bytes */
+#define ARENA_MAXSMALL	(ARENA_ALIGN * ARENA_NCLASSES)
+#define ARENA_MINCHUNK	(16 * 1024)
+#define ARENA_MAXCHUNK	(4 * 1024 * 1024)
+
+/* header preceding each object; the union keeps payloads aligned for any
+ * type the object records may contain
+ */
+typedef union {
+    size_t size;	/* usable size of the object that follows */
+    long double align;
+    void *p;
+} arena_hdr_t;
+
+typedef struct arena_chunk_s {
+    struct arena_chunk_s *next;
+    arena_hdr_t hdr;	/* only here to align what follows */
+} arena_chunk_t;
+
+/* a pass-through allocation, linked so it can be found at close */
+typedef struct arena_big_s {
+    struct arena_big_s *prev, *next;
+    arena_hdr_t hdr;
+} arena_big_t;
+
+/* a free object, overlaying its payload */
+typedef struct arena_free_s {
+    struct arena_free_s *next;
+} arena_free_t;
+
+typedef struct {
+    arena_chunk_t *chunks;	/* all chunks, most recent first */
+    char *cur;			/* bump pointer into the current chunk */
+    size_t avail;		/* bytes left after cur */
+    size_t chunksize;		/* size of the next chunk to allocate */
+    arena_free_t *freelist[ARENA_NCLASSES];
+    arena_big_t *bigs;
+} arena_t;
+
+#define ARENA_HDR(ptr)	((arena_hdr_t *)(ptr) - 1)
+
+static void *arenaopen(Agdisc_t* disc)
+{
+    arena_t *arena;
+
+    (void)disc;
+    arena = calloc(1, sizeof(arena_t));
+    if (arena)
+	arena->chunksize = ARENA_MINCHUNK;
+    return arena;
+}
+
+static void *arenabig(arena_t * arena, size_t request)
+{
+    arena_big_t *big = calloc(1, sizeof(arena_big_t) + request);
+
+    if (big == NULL)
+	return NULL;
+    big->hdr.size = request;
+    big->next = arena->bigs;
+    if (arena->bigs)
+	arena->bigs->prev = big;
+    arena->bigs = big;
+    return big + 1;
+}
+
+static void *arenaalloc(void *heap, size_t request)
+{
+    arena_t *arena = heap;
+    arena_hdr_t *hdr;
+    size_t cls, size, need;
+
+    if (request > ARENA_MAXSMALL)
+	return arenabig(arena, request);
+
+    cls = request == 0 ? 0 : (request - 1) / ARENA_ALIGN;
+    size = (cls + 1) * ARENA_ALIGN;
+
+    /* reuse a freed object of the same class */
+    if (arena->freelist[cls]) {
+	arena_free_t *obj = arena->freelist[cls];
+	arena->freelist[cls] = obj->next;
+	memset(obj, 0, size);
+	return obj;
+    }
+
+    need = sizeof(arena_hdr_t) + size;
+    if (need > arena->avail) {
+	arena_chunk_t *chunk = calloc(1, sizeof(arena_chunk_t) +
+				      arena->chunksize);
+	if (chunk == NULL)
+	    return NULL;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->cur = (char *)(chunk + 1);
+	arena->avail = arena->chunksize;
+	if (arena->chunksize < ARENA_MAXCHUNK)
+	    arena->chunksize *= 2;
+    }
+
+    /* chunks come from calloc, so fresh memory is already zeroed */
+    hdr = (arena_hdr_t *)arena->cur;
+    hdr->size = size;
+    arena->cur += need;
+    arena->avail -= need;
+    return hdr + 1;
+}
+
+static void arenafree(void *heap, void *ptr)
+{
+    arena_t *arena = heap;
+    arena_hdr_t *hdr = ARENA_HDR(ptr);
+
+    if (hdr->size > ARENA_MAXSMALL) {
+	arena_big_t *big = (arena_big_t *)ptr - 1;
+	if (big->prev)
+	    big->prev->next = big->next;
+	else
+	    arena->bigs = big->next;
+	if (big->next)
+	    big->next->prev = big->prev;
+	free(big);
+    } else {
+	arena_free_t *obj = ptr;
+	size_t cls = hdr->size / ARENA_ALIGN - 1;
+	obj->next = arena->freelist[cls];
+	arena->freelist[cls] = obj;
+    }
+}
+
+static void *arenaresize(void *heap, void *ptr, size_t oldsize,
+			 size_t request)
+{
+    arena_hdr_t *hdr = ARENA_HDR(ptr);
+    void *rv;
+
+    /* grow or shrink in place if the object's class has room */
+    if (request <= hdr->size) {
+	if (request > oldsize)
+	    memset((char *) ptr + oldsize, 0, request - oldsize);
+	return ptr;
+    }
+
+    rv = arenaalloc(heap, request);
+    if (rv == NULL)
+	return NULL;
+    memcpy(rv, ptr, oldsize < hdr->size ? oldsize : hdr->size);
+    arenafree(heap, ptr);
+    return rv;
+}
+
+static void arenaclose(void *heap)
+{
+    arena_t *arena = heap;
+    arena_chunk_t *chunk, *nextchunk;
+    arena_big_t *big, *nextbig;
+
+    for (chunk = arena->chunks; chunk; chunk = nextchunk) {
+	nextchunk = chunk->next;
+	free(chunk);
+    }
+    for (big = arena->bigs; big; big = nextbig) {
+	nextbig = big->next;
+	free(big);
+    }
+    free(arena);
+}
+
+Agmemdisc_t AgArenaDisc =
+    { arenaopen, arenaalloc, arenaresize, arenafree, arenaclose };
+
 void *agalloc(Agraph_t * g, size_t size)
 {
     void *mem;
@@ -19,6 +19,8 @@ Agnode_t *agfindnode_by_id(Agraph_t * g, IDTYPE id)
     static Agsubnode_t template;
     static Agnode_t dummy;
 
+    if (g == agroot(g) && agidhashnodes(g))
+	return agidhashfindnode(g, id);
     dummy.base.tag.id = id;
     template.node = &dummy;
     sn = dtsearch(g->n_id, &template);
@@ -99,6 +101,8 @@ static void installnode(Agraph_t * g, Agnode_t * n)
     sn->node = n;
     dtinsert(g->n_id, sn);
     dtinsert(g->n_seq, sn);
+    if (g == agroot(g))
+	agidhashinsnode(g, n);
     assert(dtsize(g->n_id) == dtsize(g->n_seq));
     assert(dtsize(g->n_id) == osize + 1);
 }
@@ -188,6 +192,8 @@ void agdelnodeimage(Agraph_t * g, Agnode_t * n, void *ignored)
     /* If the following lines are switched, switch the discpline using
      * free_subnode below.
      */ 
+    if (g == agroot(g))
+	agidhashdelnode(g, n);
     dtdelete(g->n_id, &template);
     dtdelete(g->n_seq, &template);
 }
@@ -224,9 +230,11 @@ static void dict_relabel(Agnode_t * n, void *arg)
 
     g = agraphof(n);
     new_id = *(uint64_t *) arg;
+    agidhashdelnode(g, n);
     dtdelete(g->n_id, n);	/* wrong, should be subrep */
     AGID(n) = new_id;
     dtinsert(g->n_id, n);	/* also wrong */
+    agidhashinsnode(g, n);
     /* because all the subgraphs share the same node now, this
        now requires a separate deletion and insertion phase */
 }
@@ -0,0 +1,93 @@
+/// \file
+/// \brief Run a set of independent jobs on a small pool of threads
+///
+/// Worker threads pull job indices from a shared counter, so jobs of uneven
+/// size balance out across the pool without any up-front partitioning. When
+/// Graphviz is built without POSIX threads, or a single thread is requested,
+/// the jobs simply run in order on the calling thread. Callers are responsible
+/// for ensuring the jobs do not touch shared mutable state.
+
+#pragma once
+
+#include "config.h"
+
+#include <assert.h>
+#include <cgraph/alloc.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/// a unit of work, called once for each index in `[0, count)`
+typedef void (*gv_job_fn)(void *ctx, size_t index);
+
+typedef struct {
+  gv_job_fn job;
+  void *ctx;
+  size_t count; ///< total number of jobs
+  size_t next;  ///< index of the next job to hand out
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_t lock; ///< protects `next`
+#endif
+} gv_jobs_t;
+
+#ifdef HAVE_PTHREAD_H
+static inline void *gv_jobs_worker_(void *arg) {
+  gv_jobs_t *jobs = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&jobs->lock);
+    size_t i = jobs->next;
+    if (i < jobs->count) {
+      ++jobs->next;
+    }
+    pthread_mutex_unlock(&jobs->lock);
+
+    if (i >= jobs->count) {
+      return NULL;
+    }
+    jobs->job(jobs->ctx, i);
+  }
+}
+#endif
+
+/// call `job(ctx, i)` for every `i` in `[0, count)` using up to `nthreads`
+/// threads, including the calling one, and return once all jobs are done
+static inline void gv_parallel_for(size_t count, int nthreads, gv_job_fn job,
+                                   void *ctx) {
+  assert(job != NULL);
+
+#ifdef HAVE_PTHREAD_H
+  if (nthreads > 1 && count > 1) {
+    size_t nworkers = (size_t)nthreads < count ? (size_t)nthreads : count;
+    gv_jobs_t jobs = {.job = job, .ctx = ctx, .count = count};
+    pthread_mutex_init(&jobs.lock, NULL);
+
+    // the calling thread acts as worker 0; spawn the rest
+    pthread_t *tids = gv_calloc(nworkers - 1, sizeof(tids[0]));
+    size_t spawned = 0;
+    for (; spawned < nworkers - 1; ++spawned) {
+      if (pthread_create(&tids[spawned], NULL, gv_jobs_worker_, &jobs) != 0) {
+        // carry on with however many threads we managed to start
+        break;
+      }
+    }
+    gv_jobs_worker_(&jobs);
+    for (size_t i = 0; i < spawned; ++i) {
+      pthread_join(tids[i], NULL);
+    }
+
+    free(tids);
+    pthread_mutex_destroy(&jobs.lock);
+    return;
+  }
+#else
+  (void)nthreads;
+#endif
+
+  for (size_t i = 0; i < count; ++i) {
+    job(ctx, i);
+  }
+}
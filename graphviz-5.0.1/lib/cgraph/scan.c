@@ -827,6 +827,13 @@ static Agdisc_t	*Disc;
 static void 	*Ifile;
 static int graphType;
 
+  /* Optional hook told, before each token, how far into a buffer being
+   * scanned in place (see aglexbuffer) the scanner has got.
+   */
+static void	(*Consumed)(void *ctx, const char *upto);
+static void	*ConsumedCtx;
+#define YY_USER_ACTION if (Consumed) Consumed(ConsumedCtx, aagtext);
+
   /* Reset line number */
 void agreadline(int n) { line_num = n; }
 
@@ -956,9 +963,9 @@ static int chkNum(void) {
  * accepted. This is not likely and, from dot's stand, shouldn't do any
  * harm. (Presumably undefined characters will be ignored in display.) And,
  * it allows a greater wealth of names. */
-#line 960 "scan.c"
+#line 967 "scan.c"
 
-#line 962 "scan.c"
+#line 969 "scan.c"
 
 #define INITIAL 0
 #define comment 1
@@ -1181,9 +1188,9 @@ YY_DECL
 		}
 
 	{
-#line 184 "../../lib/cgraph/scan.l"
+#line 191 "../../lib/cgraph/scan.l"
 
-#line 1187 "scan.c"
+#line 1194 "scan.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -1243,184 +1250,184 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 185 "../../lib/cgraph/scan.l"
+#line 192 "../../lib/cgraph/scan.l"
 return(EOF);
 	YY_BREAK
 case 2:
 /* rule 2 can match eol */
 YY_RULE_SETUP
-#line 186 "../../lib/cgraph/scan.l"
+#line 193 "../../lib/cgraph/scan.l"
 line_num++;
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 187 "../../lib/cgraph/scan.l"
+#line 194 "../../lib/cgraph/scan.l"
 BEGIN(comment);
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 188 "../../lib/cgraph/scan.l"
+#line 195 "../../lib/cgraph/scan.l"
 /* eat anything not a '*' */
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 189 "../../lib/cgraph/scan.l"
+#line 196 "../../lib/cgraph/scan.l"
 /* eat up '*'s not followed by '/'s */
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 190 "../../lib/cgraph/scan.l"
+#line 197 "../../lib/cgraph/scan.l"
 BEGIN(INITIAL);
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 191 "../../lib/cgraph/scan.l"
+#line 198 "../../lib/cgraph/scan.l"
 /* ignore C++-style comments */
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 192 "../../lib/cgraph/scan.l"
+#line 199 "../../lib/cgraph/scan.l"
 ppDirective ();
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 193 "../../lib/cgraph/scan.l"
+#line 200 "../../lib/cgraph/scan.l"
 /* ignore shell-like comments */
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 194 "../../lib/cgraph/scan.l"
+#line 201 "../../lib/cgraph/scan.l"
 /* ignore whitespace */
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 195 "../../lib/cgraph/scan.l"
+#line 202 "../../lib/cgraph/scan.l"
 /* ignore BOM */
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 196 "../../lib/cgraph/scan.l"
+#line 203 "../../lib/cgraph/scan.l"
 return(T_node);			/* see tokens in agcanonstr */
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 197 "../../lib/cgraph/scan.l"
+#line 204 "../../lib/cgraph/scan.l"
 return(T_edge);
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 198 "../../lib/cgraph/scan.l"
+#line 205 "../../lib/cgraph/scan.l"
 if (!graphType) graphType = T_graph; return(T_graph);
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 199 "../../lib/cgraph/scan.l"
+#line 206 "../../lib/cgraph/scan.l"
 if (!graphType) graphType = T_digraph; return(T_digraph);
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 200 "../../lib/cgraph/scan.l"
+#line 207 "../../lib/cgraph/scan.l"
 return(T_strict);
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 201 "../../lib/cgraph/scan.l"
+#line 208 "../../lib/cgraph/scan.l"
 return(T_subgraph);
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 202 "../../lib/cgraph/scan.l"
+#line 209 "../../lib/cgraph/scan.l"
 if (graphType == T_digraph) return(T_edgeop); else return('-');
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 203 "../../lib/cgraph/scan.l"
+#line 210 "../../lib/cgraph/scan.l"
 if (graphType == T_graph) return(T_edgeop); else return('-');
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 204 "../../lib/cgraph/scan.l"
+#line 211 "../../lib/cgraph/scan.l"
 { aaglval.str = agstrdup(Ag_G_global,aagtext); return(T_atom); }
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 205 "../../lib/cgraph/scan.l"
+#line 212 "../../lib/cgraph/scan.l"
 { if (chkNum()) yyless(aagleng-1); aaglval.str = agstrdup(Ag_G_global,aagtext); return(T_atom); }
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 206 "../../lib/cgraph/scan.l"
+#line 213 "../../lib/cgraph/scan.l"
 BEGIN(qstring); beginstr();
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 207 "../../lib/cgraph/scan.l"
+#line 214 "../../lib/cgraph/scan.l"
 BEGIN(INITIAL); endstr(); return (T_qatom);
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 208 "../../lib/cgraph/scan.l"
+#line 215 "../../lib/cgraph/scan.l"
 addstr ("\"");
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 209 "../../lib/cgraph/scan.l"
+#line 216 "../../lib/cgraph/scan.l"
 addstr ("\\\\");
 	YY_BREAK
 case 26:
 /* rule 26 can match eol */
 YY_RULE_SETUP
-#line 210 "../../lib/cgraph/scan.l"
+#line 217 "../../lib/cgraph/scan.l"
 line_num++; /* ignore escaped newlines */
 	YY_BREAK
 case 27:
 /* rule 27 can match eol */
 YY_RULE_SETUP
-#line 211 "../../lib/cgraph/scan.l"
+#line 218 "../../lib/cgraph/scan.l"
 addstr ("\n"); line_num++;
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 212 "../../lib/cgraph/scan.l"
+#line 219 "../../lib/cgraph/scan.l"
 addstr(aagtext);
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 213 "../../lib/cgraph/scan.l"
+#line 220 "../../lib/cgraph/scan.l"
 BEGIN(hstring); html_nest = 1; beginstr();
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 214 "../../lib/cgraph/scan.l"
+#line 221 "../../lib/cgraph/scan.l"
 html_nest--; if (html_nest) addstr(aagtext); else {BEGIN(INITIAL); endstr_html(); return (T_qatom);}
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 215 "../../lib/cgraph/scan.l"
+#line 222 "../../lib/cgraph/scan.l"
 html_nest++; addstr(aagtext);
 	YY_BREAK
 case 32:
 /* rule 32 can match eol */
 YY_RULE_SETUP
-#line 216 "../../lib/cgraph/scan.l"
+#line 223 "../../lib/cgraph/scan.l"
 addstr(aagtext); line_num++; /* add newlines */
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 217 "../../lib/cgraph/scan.l"
+#line 224 "../../lib/cgraph/scan.l"
 addstr(aagtext);
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 218 "../../lib/cgraph/scan.l"
+#line 225 "../../lib/cgraph/scan.l"
 return aagtext[0];
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 219 "../../lib/cgraph/scan.l"
+#line 226 "../../lib/cgraph/scan.l"
 ECHO;
 	YY_BREAK
-#line 1424 "scan.c"
+#line 1431 "scan.c"
 case YY_STATE_EOF(INITIAL):
 case YY_STATE_EOF(comment):
 case YY_STATE_EOF(qstring):
@@ -2431,7 +2438,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 219 "../../lib/cgraph/scan.l"
+#line 226 "../../lib/cgraph/scan.l"
 
 
 void aagerror(const char *str)
@@ -2489,4 +2496,41 @@ int aagwrap(YY_CALL_ONLY_ARG)
 	return 1;
 }
 
+static YY_BUFFER_STATE Savedbuf;
+
+/* aglexbuffer:
+ * Scan the len bytes at buf in place, instead of reading through the IO
+ * discipline, until aglexunbuffer is called. buf[len] and buf[len+1] must
+ * be NUL, and the whole buffer writable, as the scanner marks the end of
+ * each token inside it. If consumed is not NULL, it is called with ctx and
+ * the start of each token before the token is acted on; the scanner will
+ * not look at anything before that again.
+ * Returns FALSE if the buffer is not suitably terminated.
+ */
+int aglexbuffer(char *buf, size_t len,
+		void (*consumed)(void *ctx, const char *upto), void *ctx)
+{
+	YY_BUFFER_STATE prev = YY_CURRENT_BUFFER;
+
+	if (!aag_scan_buffer(buf, len + 2))
+		return FALSE;
+	Savedbuf = prev;
+	Consumed = consumed;
+	ConsumedCtx = ctx;
+	return TRUE;
+}
+
+/* aglexunbuffer:
+ * Drop the buffer set up by aglexbuffer and go back to the previous input.
+ */
+void aglexunbuffer(void)
+{
+	aag_delete_buffer(YY_CURRENT_BUFFER);
+	if (Savedbuf)
+		aag_switch_to_buffer(Savedbuf);
+	Savedbuf = NULL;
+	Consumed = NULL;
+	ConsumedCtx = NULL;
+}
+
 
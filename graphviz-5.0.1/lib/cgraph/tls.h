@@ -0,0 +1,16 @@
+#pragma once
+
+/** Storage class for variables with one instance per thread.
+ *
+ * Scratch buffers that a function keeps between calls can be made safe to use
+ * from several threads at once by declaring them thread-local:
+ *
+ *   static GV_THREAD_LOCAL int *buffer;
+ *
+ * Each thread then grows and reuses its own copy.
+ */
+#ifdef _MSC_VER
+#define GV_THREAD_LOCAL __declspec(thread)
+#else
+#define GV_THREAD_LOCAL _Thread_local
+#endif
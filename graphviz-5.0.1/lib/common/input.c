@@ -513,6 +513,7 @@ graph_t *gvNextInputGraph(GVC_t *gvc)
     static FILE *fp;
     static FILE *oldfp;
     static int fidx, gidx;
+    static bool binary;		/* file holds binary graph images */
 
     while (!g) {
 	if (!fp) {
@@ -532,8 +533,9 @@ graph_t *gvNextInputGraph(GVC_t *gvc)
 	if (oldfp != fp) {
 	    agsetfile(fn ? fn : "<stdin>");
 	    oldfp = fp;
+	    binary = agisbinary(fp);
 	}
-	g = agread(fp,NULL);
+	g = binary ? agread_binary(fp, NULL) : agread(fp,NULL);
 	if (g) {
 	    gvg_init(gvc, g, fn, gidx++);
 	    break;
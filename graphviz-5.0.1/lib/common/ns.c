@@ -15,6 +15,7 @@
 
 #include <common/render.h>
 #include <stdbool.h>
+#include <time.h>
 
 static void dfs_cutval(node_t * v, edge_t * par);
 static int dfs_range(node_t * v, edge_t * par, int low);
@@ -28,16 +29,30 @@ static void check_cycles(graph_t * g);
 #define SEQ(a,b,c)		((a) <= (b) && (b) <= (c))
 #define TREE_EDGE(e)	(ED_tree_index(e) >= 0)
 
-static graph_t *G;
-static int N_nodes, N_edges;
-static int Minrank, Maxrank;
-static int S_i;			/* search index for enter_edge */
-static int Search_size;
 #define SEARCHSIZE 30
-static nlist_t Tree_node;
-static elist Tree_edge;
 
-static int add_tree_edge(edge_t * e)
+/* Solver state for one invocation of network simplex.
+ * Everything a solve touches lives either here or in the node and edge
+ * records of the graph being ranked, so distinct graphs can be ranked
+ * concurrently.
+ */
+typedef struct {
+    graph_t *G;
+    node_t *nlist;		/* nodes being ranked, linked by ND_next */
+    const char *tbbalance;	/* TBbalance value; NULL => look it up */
+    bool seeded;		/* ND_rank holds lower bounds to start from */
+    int N_nodes, N_edges;
+    int Minrank, Maxrank;
+    int S_i;			/* search index for enter_edge */
+    int Search_size;
+    nlist_t Tree_node;
+    elist Tree_edge;
+    /* scratch for the enter_edge search */
+    edge_t *Enter;
+    int Low, Lim, Slack;
+} ns_t;
+
+static int add_tree_edge(ns_t * ns, edge_t * e)
 {
     node_t *n;
     //fprintf(stderr,"add tree edge %p %s ", (void*)e, agnameof(agtail(e))) ; fprintf(stderr,"%s\n", agnameof(aghead(e))) ;
@@ -45,12 +60,12 @@ static int add_tree_edge(edge_t * e)
 	agerr(AGERR, "add_tree_edge: missing tree edge\n");
 	return -1;
     }
-    ED_tree_index(e) = Tree_edge.size;
-    Tree_edge.list[Tree_edge.size++] = e;
+    ED_tree_index(e) = ns->Tree_edge.size;
+    ns->Tree_edge.list[ns->Tree_edge.size++] = e;
     if (!ND_mark(agtail(e)))
-	Tree_node.list[Tree_node.size++] = agtail(e);
+	ns->Tree_node.list[ns->Tree_node.size++] = agtail(e);
     if (!ND_mark(aghead(e)))
-	Tree_node.list[Tree_node.size++] = aghead(e);
+	ns->Tree_node.list[ns->Tree_node.size++] = aghead(e);
     n = agtail(e);
     ND_mark(n) = TRUE;
     ND_tree_out(n).list[ND_tree_out(n).size++] = e;
@@ -70,13 +85,13 @@ static int add_tree_edge(edge_t * e)
     return 0;
 }
 
-static void exchange_tree_edges(edge_t * e, edge_t * f)
+static void exchange_tree_edges(ns_t * ns, edge_t * e, edge_t * f)
 {
     int i, j;
     node_t *n;
 
     ED_tree_index(f) = ED_tree_index(e);
-    Tree_edge.list[ED_tree_index(e)] = f;
+    ns->Tree_edge.list[ED_tree_index(e)] = f;
     ED_tree_index(e) = -1;
 
     n = agtail(e);
@@ -102,24 +117,30 @@ static void exchange_tree_edges(edge_t * e, edge_t * f)
     ND_tree_in(n).list[ND_tree_in(n).size] = NULL;
 }
 
+/* init_rank:
+ * Assign each node the least rank its in-edges allow. When seeded, the
+ * rank a node already has is kept as a lower bound, so a ranking from an
+ * earlier layout is disturbed only where it violates an edge.
+ */
 static
-void init_rank(void)
+void init_rank(ns_t * ns)
 {
     int i, ctr;
     nodequeue *Q;
     node_t *v;
     edge_t *e;
 
-    Q = new_queue(N_nodes);
+    Q = new_queue(ns->N_nodes);
     ctr = 0;
 
-    for (v = GD_nlist(G); v; v = ND_next(v)) {
+    for (v = ns->nlist; v; v = ND_next(v)) {
 	if (ND_priority(v) == 0)
 	    enqueue(Q, v);
     }
 
     while ((v = dequeue(Q))) {
-	ND_rank(v) = 0;
+	if (!ns->seeded)
+	    ND_rank(v) = 0;
 	ctr++;
 	for (i = 0; (e = ND_in(v).list[i]); i++)
 	    ND_rank(v) = MAX(ND_rank(v), ND_rank(agtail(e)) + ED_minlen(e));
@@ -128,99 +149,96 @@ void init_rank(void)
 		enqueue(Q, aghead(e));
 	}
     }
-    if (ctr != N_nodes) {
+    if (ctr != ns->N_nodes) {
 	agerr(AGERR, "trouble in init_rank\n");
-	for (v = GD_nlist(G); v; v = ND_next(v))
+	for (v = ns->nlist; v; v = ND_next(v))
 	    if (ND_priority(v))
 		agerr(AGPREV, "\t%s %d\n", agnameof(v), ND_priority(v));
     }
     free_queue(Q);
 }
 
-static edge_t *leave_edge(void)
+static edge_t *leave_edge(ns_t * ns)
 {
     edge_t *f, *rv = NULL;
     int j, cnt = 0;
 
-    j = S_i;
-    while (S_i < Tree_edge.size) {
-	if (ED_cutvalue(f = Tree_edge.list[S_i]) < 0) {
+    j = ns->S_i;
+    while (ns->S_i < ns->Tree_edge.size) {
+	if (ED_cutvalue(f = ns->Tree_edge.list[ns->S_i]) < 0) {
 	    if (rv) {
 		if (ED_cutvalue(rv) > ED_cutvalue(f))
 		    rv = f;
 	    } else
-		rv = Tree_edge.list[S_i];
-	    if (++cnt >= Search_size)
+		rv = ns->Tree_edge.list[ns->S_i];
+	    if (++cnt >= ns->Search_size)
 		return rv;
 	}
-	S_i++;
+	ns->S_i++;
     }
     if (j > 0) {
-	S_i = 0;
-	while (S_i < j) {
-	    if (ED_cutvalue(f = Tree_edge.list[S_i]) < 0) {
+	ns->S_i = 0;
+	while (ns->S_i < j) {
+	    if (ED_cutvalue(f = ns->Tree_edge.list[ns->S_i]) < 0) {
 		if (rv) {
 		    if (ED_cutvalue(rv) > ED_cutvalue(f))
 			rv = f;
 		} else
-		    rv = Tree_edge.list[S_i];
-		if (++cnt >= Search_size)
+		    rv = ns->Tree_edge.list[ns->S_i];
+		if (++cnt >= ns->Search_size)
 		    return rv;
 	    }
-	    S_i++;
+	    ns->S_i++;
 	}
     }
     return rv;
 }
 
-static edge_t *Enter;
-static int Low, Lim, Slack;
-
-static void dfs_enter_outedge(node_t * v)
+static void dfs_enter_outedge(ns_t * ns, node_t * v)
 {
     int i, slack;
     edge_t *e;
 
     for (i = 0; (e = ND_out(v).list[i]); i++) {
 	if (!TREE_EDGE(e)) {
-	    if (!SEQ(Low, ND_lim(aghead(e)), Lim)) {
+	    if (!SEQ(ns->Low, ND_lim(aghead(e)), ns->Lim)) {
 		slack = SLACK(e);
-		if (slack < Slack || Enter == NULL) {
-		    Enter = e;
-		    Slack = slack;
+		if (slack < ns->Slack || ns->Enter == NULL) {
+		    ns->Enter = e;
+		    ns->Slack = slack;
 		}
 	    }
 	} else if (ND_lim(aghead(e)) < ND_lim(v))
-	    dfs_enter_outedge(aghead(e));
+	    dfs_enter_outedge(ns, aghead(e));
     }
-    for (i = 0; (e = ND_tree_in(v).list[i]) && (Slack > 0); i++)
+    for (i = 0; (e = ND_tree_in(v).list[i]) && (ns->Slack > 0); i++)
 	if (ND_lim(agtail(e)) < ND_lim(v))
-	    dfs_enter_outedge(agtail(e));
+	    dfs_enter_outedge(ns, agtail(e));
 }
 
-static void dfs_enter_inedge(node_t * v)
+static void dfs_enter_inedge(ns_t * ns, node_t * v)
 {
     int i, slack;
     edge_t *e;
 
     for (i = 0; (e = ND_in(v).list[i]); i++) {
 	if (!TREE_EDGE(e)) {
-	    if (!SEQ(Low, ND_lim(agtail(e)), Lim)) {
+	    if (!SEQ(ns->Low, ND_lim(agtail(e)), ns->Lim)) {
 		slack = SLACK(e);
-		if (slack < Slack || Enter == NULL) {
-		    Enter = e;
-		    Slack = slack;
+		if (slack < ns->Slack || ns->Enter == NULL) {
+		    ns->Enter = e;
+		    ns->Slack = slack;
 		}
 	    }
 	} else if (ND_lim(agtail(e)) < ND_lim(v))
-	    dfs_enter_inedge(agtail(e));
+	    dfs_enter_inedge(ns, agtail(e));
     }
-    for (i = 0; (e = ND_tree_out(v).list[i]) && Slack > 0; i++)
+    for (i = 0; (e = ND_tree_out(v).list[i]) && ns->Slack > 0; i++)
 	if (ND_lim(aghead(e)) < ND_lim(v))
-	    dfs_enter_inedge(aghead(e));
+	    dfs_enter_inedge(ns, aghead(e));
 }
 
-static edge_t *enter_edge(edge_t * e)
+static edge_t *enter_edge(ns_t * ns, edge_t * e)
 {
     node_t *v;
     int outsearch;
@@ -233,21 +251,21 @@ static edge_t *enter_edge(edge_t * e)
 	v = aghead(e);
 	outsearch = TRUE;
     }
-    Enter = NULL;
-    Slack = INT_MAX;
-    Low = ND_low(v);
-    Lim = ND_lim(v);
+    ns->Enter = NULL;
+    ns->Slack = INT_MAX;
+    ns->Low = ND_low(v);
+    ns->Lim = ND_lim(v);
     if (outsearch)
-	dfs_enter_outedge(v);
+	dfs_enter_outedge(ns, v);
     else
-	dfs_enter_inedge(v);
-    return Enter;
+	dfs_enter_inedge(ns, v);
+    return ns->Enter;
 }
 
-static void init_cutvalues(void)
+static void init_cutvalues(ns_t * ns)
 {
-    dfs_range(GD_nlist(G), NULL, 1);
-    dfs_cutval(GD_nlist(G), NULL);
+    dfs_range(ns->nlist, NULL, 1);
+    dfs_cutval(ns->nlist, NULL);
 }
 
 /* functions for initial tight tree construction */
@@ -263,7 +281,7 @@ typedef struct subtree_s {
 } subtree_t;
 
 /* find initial tight subtrees */
-static int tight_subtree_search(Agnode_t *v, subtree_t *st)
+static int tight_subtree_search(ns_t *ns, Agnode_t *v, subtree_t *st)
 {
     Agedge_t *e;
     int     i;
@@ -274,30 +292,30 @@ static int tight_subtree_search(Agnode_t *v, subtree_t *st)
     for (i = 0; (e = ND_in(v).list[i]); i++) {
         if (TREE_EDGE(e)) continue;
         if (ND_subtree(agtail(e)) == 0 && SLACK(e) == 0) {
-               if (add_tree_edge(e) != 0) {
+               if (add_tree_edge(ns, e) != 0) {
                    return -1;
                }
-               rv += tight_subtree_search(agtail(e),st);
+               rv += tight_subtree_search(ns, agtail(e),st);
         }
     }
     for (i = 0; (e = ND_out(v).list[i]); i++) {
         if (TREE_EDGE(e)) continue;
         if (ND_subtree(aghead(e)) == 0 && SLACK(e) == 0) {
-               if (add_tree_edge(e) != 0) {
+               if (add_tree_edge(ns, e) != 0) {
                    return -1;
                }
-               rv += tight_subtree_search(aghead(e),st);
+               rv += tight_subtree_search(ns, aghead(e),st);
         }
     }
     return rv;
 }
 
-static subtree_t *find_tight_subtree(Agnode_t *v)
+static subtree_t *find_tight_subtree(ns_t *ns, Agnode_t *v)
 {
     subtree_t       *rv;
     rv = NEW(subtree_t);
     rv->rep = v;
-    rv->size = tight_subtree_search(v,rv);
+    rv->size = tight_subtree_search(ns, v,rv);
     if (rv->size < 0) {
         free(rv);
         return NULL;
@@ -457,7 +475,7 @@ void tree_adjust(Agnode_t *v, Agnode_t *from, int delta)
 }
 
 static
-subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
+subtree_t *merge_trees(ns_t *ns, Agedge_t *e)   /* entering tree edge */
 {
   int       delta;
   subtree_t *t0, *t1, *rv;
@@ -477,7 +495,7 @@ subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
     delta = -SLACK(e);
     tree_adjust(t1->rep,NULL,delta);
   }
-  if (add_tree_edge(e) != 0) {
+  if (add_tree_edge(ns, e) != 0) {
     return NULL;
   }
   rv = STsetUnion(t0,t1);
@@ -491,7 +509,7 @@ subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
  * Return 1 if input graph is not connected; 0 on success.
  */
 static
-int feasible_tree(void)
+int feasible_tree(ns_t *ns)
 {
   Agnode_t *n;
   Agedge_t *ee;
@@ -501,15 +519,15 @@ int feasible_tree(void)
   int error = 0;
 
   /* initialization */
-  for (n = GD_nlist(G); n; n = ND_next(n)) {
+  for (n = ns->nlist; n; n = ND_next(n)) {
       ND_subtree_set(n,0);
   }
 
-  tree = N_NEW(N_nodes,subtree_t*);
+  tree = N_NEW(ns->N_nodes,subtree_t*);
   /* given init_rank, find all tight subtrees */
-  for (n = GD_nlist(G); n; n = ND_next(n)) {
+  for (n = ns->nlist; n; n = ND_next(n)) {
         if (ND_subtree(n) == 0) {
-                tree[subtree_count] = find_tight_subtree(n);
+                tree[subtree_count] = find_tight_subtree(ns, n);
                 if (tree[subtree_count] == NULL) {
                     error = 2;
                     goto end;
@@ -526,7 +544,7 @@ int feasible_tree(void)
       error = 1;
       break;
     }
-    tree1 = merge_trees(ee);
+    tree1 = merge_trees(ns, ee);
     if (tree1 == NULL) {
       error = 2;
       break;
@@ -539,8 +557,8 @@ end:
   for (i = 0; i < subtree_count; i++) free(tree[i]);
   free(tree);
   if (error) return error;
-  assert(Tree_edge.size == N_nodes - 1);
-  init_cutvalues();
+  assert(ns->Tree_edge.size == ns->N_nodes - 1);
+  init_cutvalues(ns);
   return 0;
 }
 
@@ -586,7 +604,7 @@ static void rerank(Agnode_t * v, int delta)
  * is entering.  compute new cut values, ranks, and exchange e and f.
  */
 static int
-update(edge_t * e, edge_t * f)
+update(ns_t * ns, edge_t * e, edge_t * f)
 {
     int cutvalue, delta;
     Agnode_t *lca;
@@ -619,51 +637,51 @@ update(edge_t * e, edge_t * f)
     }
     ED_cutvalue(f) = -cutvalue;
     ED_cutvalue(e) = 0;
-    exchange_tree_edges(e, f);
+    exchange_tree_edges(ns, e, f);
     dfs_range(lca, ND_par(lca), ND_low(lca));
     return 0;
 }
 
-static void scan_and_normalize(void)
+static void scan_and_normalize(ns_t * ns)
 {
     node_t *n;
 
-    Minrank = INT_MAX;
-    Maxrank = -INT_MAX;
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
+    ns->Minrank = INT_MAX;
+    ns->Maxrank = -INT_MAX;
+    for (n = ns->nlist; n; n = ND_next(n)) {
 	if (ND_node_type(n) == NORMAL) {
-	    Minrank = MIN(Minrank, ND_rank(n));
-	    Maxrank = MAX(Maxrank, ND_rank(n));
+	    ns->Minrank = MIN(ns->Minrank, ND_rank(n));
+	    ns->Maxrank = MAX(ns->Maxrank, ND_rank(n));
 	}
     }
-    if (Minrank != 0) {
-	for (n = GD_nlist(G); n; n = ND_next(n))
-	    ND_rank(n) -= Minrank;
-	Maxrank -= Minrank;
-	Minrank = 0;
+    if (ns->Minrank != 0) {
+	for (n = ns->nlist; n; n = ND_next(n))
+	    ND_rank(n) -= ns->Minrank;
+	ns->Maxrank -= ns->Minrank;
+	ns->Minrank = 0;
     }
 }
 
 static void
-freeTreeList (graph_t* g)
+freeTreeList (ns_t * ns)
 {
     node_t *n;
-    for (n = GD_nlist(g); n; n = ND_next(n)) {
+    for (n = ns->nlist; n; n = ND_next(n)) {
 	free_list(ND_tree_in(n));
 	free_list(ND_tree_out(n));
 	ND_mark(n) = FALSE;
     }
 }
 
-static void LR_balance(void)
+static void LR_balance(ns_t * ns)
 {
     int i, delta;
     edge_t *e, *f;
 
-    for (i = 0; i < Tree_edge.size; i++) {
-	e = Tree_edge.list[i];
+    for (i = 0; i < ns->Tree_edge.size; i++) {
+	e = ns->Tree_edge.list[i];
 	if (ED_cutvalue(e) == 0) {
-	    f = enter_edge(e);
+	    f = enter_edge(ns, e);
 	    if (f == NULL)
 		continue;
 	    delta = SLACK(f);
@@ -675,7 +693,7 @@ static void LR_balance(void)
 		rerank(aghead(e), -delta / 2);
 	}
     }
-    freeTreeList (G);
+    freeTreeList (ns);
 }
 
 static int decreasingrankcmpf(node_t **n0, node_t **n1) {
@@ -698,53 +716,54 @@ static int increasingrankcmpf(node_t **n0, node_t **n1) {
   return 0;
 }
 
-static void TB_balance(void)
+static void TB_balance(ns_t * ns)
 {
     node_t *n;
     edge_t *e;
     int i, ii, low, high, choice, *nrank;
     int inweight, outweight;
     int adj = 0;
-    char *s;
+    const char *s;
 
-    scan_and_normalize();
+    scan_and_normalize(ns);
 
     /* find nodes that are not tight and move to less populated ranks */
-    nrank = N_NEW(Maxrank + 1, int);
-    for (i = 0; i <= Maxrank; i++)
+    nrank = N_NEW(ns->Maxrank + 1, int);
+    for (i = 0; i <= ns->Maxrank; i++)
 	nrank[i] = 0;
-    if ( (s = agget(G,"TBbalance")) ) {
+    s = ns->tbbalance ? ns->tbbalance : agget(ns->G, "TBbalance");
+    if (s) {
          if (streq(s,"min")) adj = 1;
          else if (streq(s,"max")) adj = 2;
-         if (adj) for (n = GD_nlist(G); n; n = ND_next(n))
+         if (adj) for (n = ns->nlist; n; n = ND_next(n))
               if (ND_node_type(n) == NORMAL) {
                 if (ND_in(n).size == 0 && adj == 1) {
-                   ND_rank(n) = Minrank;
+                   ND_rank(n) = ns->Minrank;
                 }
                 if (ND_out(n).size == 0 && adj == 2) {
-                   ND_rank(n) = Maxrank;
+                   ND_rank(n) = ns->Maxrank;
                 }
               }
     }
-    for (ii = 0, n = GD_nlist(G); n; ii++, n = ND_next(n)) {
-      Tree_node.list[ii] = n;
+    for (ii = 0, n = ns->nlist; n; ii++, n = ND_next(n)) {
+      ns->Tree_node.list[ii] = n;
     }
-    Tree_node.size = ii;
-    qsort(Tree_node.list, Tree_node.size, sizeof(Tree_node.list[0]),
+    ns->Tree_node.size = ii;
+    qsort(ns->Tree_node.list, ns->Tree_node.size, sizeof(ns->Tree_node.list[0]),
         adj > 1? (int(*)(const void*,const void*))decreasingrankcmpf
                : (int(*)(const void*,const void*))increasingrankcmpf);
-    for (i = 0; i < Tree_node.size; i++) {
-        n = Tree_node.list[i];
+    for (i = 0; i < ns->Tree_node.size; i++) {
+        n = ns->Tree_node.list[i];
         if (ND_node_type(n) == NORMAL)
           nrank[ND_rank(n)]++;
     }
-    for (ii = 0; ii < Tree_node.size; ii++) {
-      n = Tree_node.list[ii];
+    for (ii = 0; ii < ns->Tree_node.size; ii++) {
+      n = ns->Tree_node.list[ii];
       if (ND_node_type(n) != NORMAL)
         continue;
       inweight = outweight = 0;
       low = 0;
-      high = Maxrank;
+      high = ns->Maxrank;
       for (i = 0; (e = ND_in(n).list[i]); i++) {
         inweight += ED_weight(e);
         low = MAX(low, ND_rank(agtail(e)) + ED_minlen(e));
@@ -777,28 +796,28 @@ static void TB_balance(void)
     free(nrank);
 }
 
-static int init_graph(graph_t * g)
+static int init_graph(ns_t * ns, graph_t * g)
 {
     int i, feasible;
     node_t *n;
     edge_t *e;
 
-    G = g;
-    N_nodes = N_edges = S_i = 0;
-    for (n = GD_nlist(g); n; n = ND_next(n)) {
+    ns->G = g;
+    ns->N_nodes = ns->N_edges = ns->S_i = 0;
+    for (n = ns->nlist; n; n = ND_next(n)) {
 	ND_mark(n) = FALSE;
-	N_nodes++;
+	ns->N_nodes++;
 	for (i = 0; (e = ND_out(n).list[i]); i++)
-	    N_edges++;
+	    ns->N_edges++;
     }
 
-    Tree_node.list = ALLOC(N_nodes, Tree_node.list, node_t *);
-    Tree_node.size = 0;
-    Tree_edge.list = ALLOC(N_nodes, Tree_edge.list, edge_t *);
-    Tree_edge.size = 0;
+    ns->Tree_node.list = N_NEW(ns->N_nodes, node_t *);
+    ns->Tree_node.size = 0;
+    ns->Tree_edge.list = N_NEW(ns->N_nodes, edge_t *);
+    ns->Tree_edge.size = 0;
 
     feasible = TRUE;
-    for (n = GD_nlist(g); n; n = ND_next(n)) {
+    for (n = ns->nlist; n; n = ND_next(n)) {
 	ND_priority(n) = 0;
 	for (i = 0; (e = ND_in(n).list[i]); i++) {
 	    ND_priority(n)++;
@@ -818,17 +837,17 @@ static int init_graph(graph_t * g)
 }
 
 /* graphSize:
- * Compute no. of nodes and edges in the graph
+ * Compute no. of nodes and edges in the node list
  */
 static void
-graphSize (graph_t * g, int* nn, int* ne)
+graphSize (node_t * nlist, int* nn, int* ne)
 {
     int i, nnodes, nedges;
     node_t *n;
     edge_t *e;
    
     nnodes = nedges = 0;
-    for (n = GD_nlist(g); n; n = ND_next(n)) {
+    for (n = nlist; n; n = ND_next(n)) {
 	nnodes++;
 	for (i = 0; (e = ND_out(n).list[i]); i++) {
 	    nedges++;
@@ -838,67 +857,74 @@ graphSize (graph_t * g, int* nn, int* ne)
     *ne = nedges;
 }
 
-/* rank:
+/* rank3:
  * Apply network simplex to rank the nodes in a graph.
  * Uses ED_minlen as the internode constraint: if a->b with minlen=ml,
  * rank b - rank a >= ml.
  * Assumes the graph has the following additional structure:
- *   A list of all nodes, starting at GD_nlist, and linked using ND_next.
+ *   A list of all nodes, starting at GD_nlist (or params->nlist), and
+ *   linked using ND_next.
  *   Out and in edges lists stored in ND_out and ND_in, even if the node
  *  doesn't have any out or in edges.
- * The node rank values are stored in ND_rank.
+ * The node rank values are stored in ND_rank. If the ranks already in
+ * ND_rank are feasible, they are the starting point; if params->seeded,
+ * infeasible ones are raised just enough to become so instead of being
+ * recomputed from scratch.
+ * All solver state is local to the call, so different graphs may be
+ * ranked concurrently from different threads.
  * Returns 0 if successful; returns 1 if the graph was not connected;
  * returns 2 if something seriously wrong;
  */
-int rank2(graph_t * g, int balance, int maxiter, int search_size)
+int rank3(graph_t * g, nsparams_t * params)
 {
-    int iter = 0, feasible;
-    char *ns = "network simplex: ";
+    int iter = 0, feasible, err = 0;
+    const int maxiter = params->maxiter;
+    const char *msg = "network simplex: ";
+    clock_t start = 0;
     edge_t *e, *f;
+    ns_t ns = {.nlist = params->nlist ? params->nlist : GD_nlist(g),
+               .tbbalance = params->tbbalance, .seeded = params->seeded};
 
 #ifdef DEBUG
     check_cycles(g);
 #endif
-    if (Verbose) {
+    if (params->verbose) {
 	int nn, ne;
-	graphSize (g, &nn, &ne);
-	fprintf(stderr, "%s %d nodes %d edges maxiter=%d balance=%d\n", ns,
-	    nn, ne, maxiter, balance);
-	start_timer();
+	graphSize (ns.nlist, &nn, &ne);
+	fprintf(stderr, "%s %d nodes %d edges maxiter=%d balance=%d\n", msg,
+	    nn, ne, maxiter, params->balance);
+	start = clock();
     }
-    feasible = init_graph(g);
+    feasible = init_graph(&ns, g);
     if (!feasible)
-	init_rank();
+	init_rank(&ns);
 
-    if (search_size >= 0)
-	Search_size = search_size;
+    if (params->search_size >= 0)
+	ns.Search_size = params->search_size;
     else
-	Search_size = SEARCHSIZE;
+	ns.Search_size = SEARCHSIZE;
 
-    {
-	int err = feasible_tree();
-	if (err != 0) {
-	    freeTreeList (g);
-	    return err;
-	}
+    err = feasible_tree(&ns);
+    if (err != 0) {
+	freeTreeList (&ns);
+	goto done;
     }
     if (maxiter <= 0) {
-	freeTreeList (g);
-	return 0;
+	freeTreeList (&ns);
+	goto done;
     }
 
-    while ((e = leave_edge())) {
-	int err;
-	f = enter_edge(e);
-	err = update(e, f);
+    while ((e = leave_edge(&ns))) {
+	f = enter_edge(&ns, e);
+	err = update(&ns, e, f);
 	if (err != 0) {
-	    freeTreeList (g);
-	    return err;
+	    freeTreeList (&ns);
+	    goto done;
 	}
 	iter++;
-	if (Verbose && iter % 100 == 0) {
+	if (params->verbose && iter % 100 == 0) {
 	    if (iter % 1000 == 100)
-		fputs(ns, stderr);
+		fputs(msg, stderr);
 	    fprintf(stderr, "%d ", iter);
 	    if (iter % 1000 == 0)
 		fputc('\n', stderr);
@@ -906,25 +932,38 @@ int rank2(graph_t * g, int balance, int maxiter, int search_size)
 	if (iter >= maxiter)
 	    break;
     }
-    switch (balance) {
+    switch (params->balance) {
     case 1:
-	TB_balance();
+	TB_balance(&ns);
 	break;
     case 2:
-	LR_balance();
+	LR_balance(&ns);
 	break;
     default:
-	scan_and_normalize();
-	freeTreeList (G);
+	scan_and_normalize(&ns);
+	freeTreeList (&ns);
 	break;
     }
-    if (Verbose) {
+    if (params->verbose) {
 	if (iter >= 100)
 	    fputc('\n', stderr);
 	fprintf(stderr, "%s%d nodes %d edges %d iter %.2f sec\n",
-		ns, N_nodes, N_edges, iter, elapsed_sec());
+		msg, ns.N_nodes, ns.N_edges, iter,
+		(double)(clock() - start) / CLOCKS_PER_SEC);
     }
-    return 0;
+
+done:
+    free(ns.Tree_node.list);
+    free(ns.Tree_edge.list);
+    return err;
+}
+
+int rank2(graph_t * g, int balance, int maxiter, int search_size)
+{
+    nsparams_t params = {.balance = balance, .maxiter = maxiter,
+                         .search_size = search_size, .verbose = Verbose};
+
+    return rank3(g, &params);
 }
 
 int rank(graph_t * g, int balance, int maxiter)
@@ -1036,7 +1075,7 @@ static int dfs_range(node_t * v, edge_t * par, int low)
 }
 
 #ifdef DEBUG
-void tchk(void)
+void tchk(ns_t *ns)
 {
     int i, n_cnt, e_cnt;
     node_t *n;
@@ -1044,7 +1083,7 @@ void tchk(void)
 
     n_cnt = 0;
     e_cnt = 0;
-    for (n = agfstnode(G); n; n = agnxtnode(G, n)) {
+    for (n = agfstnode(ns->G); n; n = agnxtnode(ns->G, n)) {
 	n_cnt++;
 	for (i = 0; (e = ND_tree_out(n).list[i]); i++) {
 	    e_cnt++;
@@ -1052,17 +1091,17 @@ void tchk(void)
 		fprintf(stderr, "not a tight tree %p", e);
 	}
     }
-    if (n_cnt != Tree_node.size || e_cnt != Tree_edge.size)
+    if (n_cnt != ns->Tree_node.size || e_cnt != ns->Tree_edge.size)
 	fprintf(stderr, "something missing\n");
 }
 
-void check_cutvalues(void)
+void check_cutvalues(ns_t *ns)
 {
     node_t *v;
     edge_t *e;
     int i, save;
 
-    for (v = agfstnode(G); v; v = agnxtnode(G, v)) {
+    for (v = agfstnode(ns->G); v; v = agnxtnode(ns->G, v)) {
 	for (i = 0; (e = ND_tree_out(v).list[i]); i++) {
 	    save = ED_cutvalue(e);
 	    x_cutval(e);
@@ -1072,14 +1111,14 @@ void check_cutvalues(void)
     }
 }
 
-int check_ranks(void)
+int check_ranks(ns_t *ns)
 {
     int cost = 0;
     node_t *n;
     edge_t *e;
 
-    for (n = agfstnode(G); n; n = agnxtnode(G, n)) {
-	for (e = agfstout(G, n); e; e = agnxtout(G, e)) {
+    for (n = agfstnode(ns->G); n; n = agnxtnode(ns->G, n)) {
+	for (e = agfstout(ns->G, n); e; e = agnxtout(ns->G, e)) {
 	    cost += (ED_weight(e)) * abs(LENGTH(e));
 	    if (ND_rank(aghead(e)) - ND_rank(agtail(e)) - ED_minlen(e) < 0)
 		abort();
@@ -1089,13 +1128,13 @@ int check_ranks(void)
     return cost;
 }
 
-void checktree(void)
+void checktree(ns_t *ns)
 {
     int i, n = 0, m = 0;
     node_t *v;
     edge_t *e;
 
-    for (v = agfstnode(G); v; v = agnxtnode(G, v)) {
+    for (v = agfstnode(ns->G); v; v = agnxtnode(ns->G, v)) {
 	for (i = 0; (e = ND_tree_out(v).list[i]); i++)
 	    n++;
 	if (i != ND_tree_out(v).size)
@@ -1105,7 +1144,7 @@ void checktree(void)
 	if (i != ND_tree_in(v).size)
 	    abort();
     }
-    fprintf(stderr, "%d %d %d\n", Tree_edge.size, n, m);
+    fprintf(stderr, "%d %d %d\n", ns->Tree_edge.size, n, m);
 }
 
 void check_fast_node(node_t * n)
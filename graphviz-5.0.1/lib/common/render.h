@@ -45,6 +45,17 @@ extern "C" {
 	point offset;
     } epsf_t;
 
+    /* parameters for one network simplex solve; see rank3() */
+    typedef struct {
+	int balance;		/* 0 = none, 1 = TB balance, 2 = LR balance */
+	int maxiter;
+	int search_size;	/* < 0 => use the default */
+	bool verbose;		/* report progress and timing on stderr */
+	node_t *nlist;		/* nodes to rank; NULL => GD_nlist(g) */
+	const char *tbbalance;	/* TBbalance value; NULL => look it up on g */
+	bool seeded;		/* start from the ranks already in ND_rank */
+    } nsparams_t;
+
 #ifdef GVDLL
 #ifdef GVC_EXPORTS
 #define RENDER_API __declspec(dllexport)
@@ -119,12 +130,14 @@ extern "C" {
     RENDER_API obj_state_t* push_obj_state(GVJ_t *job);
     RENDER_API int rank(graph_t * g, int balance, int maxiter);
     RENDER_API int rank2(graph_t * g, int balance, int maxiter, int search_size);
+    RENDER_API int rank3(graph_t * g, nsparams_t * params);
     RENDER_API port resolvePort(node_t*  n, node_t* other, port* oldport);
     RENDER_API void resolvePorts (edge_t* e);
     RENDER_API void round_corners(GVJ_t * job, pointf * AF, int sides, int style, int filled);
     RENDER_API int routesplinesinit(void);
     RENDER_API pointf *routesplines(path *, int *);
     RENDER_API void routesplinesterm(void);
+    RENDER_API void routesplinesfree(void);
     RENDER_API pointf* simpleSplineRoute (pointf, pointf, Ppoly_t, int*, int);
     RENDER_API pointf *routepolylines(path* pp, int* npoints);
     RENDER_API double selfRightSpace(edge_t *e);
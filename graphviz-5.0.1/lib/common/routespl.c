@@ -10,6 +10,7 @@
 
 #include "config.h"
 
+#include <cgraph/tls.h>
 #include <common/render.h>
 #include <math.h>
 #include <pathplan/pathplan.h>
@@ -17,14 +18,16 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
-static int nedges, nboxes; /* total no. of edges and boxes used in routing */
+/* total no. of edges and boxes routed on this thread */
+static GV_THREAD_LOCAL int nedges, nboxes;
 
 static int routeinit;
-/* static data used across multiple edges */
-static Ppoint_t *polypoints;  /* vertices of polygon defined by boxes */
-static int polypointn;        /* size of polypoints[] */
-static Pedge_t *edges;        /* polygon edges passed to Proutespline */
-static int edgen;             /* size of edges[] */
+/* static data used across multiple edges; each thread has its own, so that
+ * edges can be routed on several threads at once */
+static GV_THREAD_LOCAL Ppoint_t *polypoints;  /* vertices of polygon defined by boxes */
+static GV_THREAD_LOCAL int polypointn;        /* size of polypoints[] */
+static GV_THREAD_LOCAL Pedge_t *edges;        /* polygon edges passed to Proutespline */
+static GV_THREAD_LOCAL int edgen;             /* size of edges[] */
 
 static int checkpath(int, boxf*, path*);
 static void printpath(path * pp);
@@ -289,6 +292,20 @@ void routesplinesterm()
 		nedges, nboxes, elapsed_sec());
 }
 
+/* routesplinesfree:
+ * Free the routing data of the calling thread, as a thread that routed
+ * edges should before it exits.
+ */
+void routesplinesfree(void)
+{
+    free(polypoints);
+    free(edges);
+    polypoints = NULL;
+    edges = NULL;
+    polypointn = edgen = 0;
+    Pfreescratch();
+}
+
 static void
 limitBoxes (boxf* boxes, int boxn, const pointf *pps, int pn, int delta)
 {
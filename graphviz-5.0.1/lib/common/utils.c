@@ -64,35 +64,29 @@ node_t *dequeue(nodequeue * q)
     return n;
 }
 
+/* late_int, late_double:
+ * The parsed value comes from cgraph's typed attribute cache, so
+ * repeated lookups of the same object do not parse the string again.
+ */
 int late_int(void *obj, attrsym_t * attr, int def, int low)
 {
-    char *p;
-    char *endp;
     int rv;
     if (attr == NULL)
 	return def;
-    p = ag_xget(obj, attr);
-    if (!p || p[0] == '\0')
-	return def;
-    rv = strtol (p, &endp, 10);
-    if (p == endp) return def;  /* invalid int format */
+    if (!agxgetint(obj, attr, &rv))
+	return def;  /* empty or invalid int format */
     if (rv < low) return low;
     else return rv;
 }
 
 double late_double(void *obj, attrsym_t * attr, double def, double low)
 {
-    char *p;
-    char *endp;
     double rv;
 
     if (!attr || !obj)
 	return def;
-    p = ag_xget(obj, attr);
-    if (!p || p[0] == '\0')
-	return def;
-    rv = strtod (p, &endp);
-    if (p == endp) return def;  /* invalid double format */
+    if (!agxgetdouble(obj, attr, &rv))
+	return def;  /* empty or invalid double format */
     if (rv < low) return low;
     else return rv;
 }
@@ -519,18 +519,18 @@ static void zapLayers(void)
     }
 }
 
-/* rank3: 
+/* aspect_rank: 
  * ranking function for dealing with wide/narrow graphs,
  * or graphs with varying node widths and heights.
  * This function iteratively calls dot's rank1() function and 
  * applies packing (by calling the applyPacking2 function. 
  * applyPacking2 function calls the reduceMaxWidth2 function
  * for partitioning the widest layer).
- * Initially the iterations argument is -1, for which rank3
+ * Initially the iterations argument is -1, for which aspect_rank
  * callse applyPacking2 function until the combinatorial aspect
  * ratio is <= the desired aspect ratio.
  */
-void rank3(graph_t * g, aspect_t * asp)
+void aspect_rank(graph_t * g, aspect_t * asp)
 {
     Agnode_t *n;
     int i;
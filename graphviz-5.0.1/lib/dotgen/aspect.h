@@ -22,7 +22,7 @@ typedef struct aspect_t {
 } aspect_t;
 
 extern aspect_t* setAspect (Agraph_t * g, aspect_t* adata);
-extern void rank3(graph_t * g, aspect_t * asp);
+extern void aspect_rank(graph_t * g, aspect_t * asp);
 extern void initEdgeTypes(graph_t * g);
 extern void init_UF_size(graph_t * g);
 extern int countDummyNodes(graph_t * g);
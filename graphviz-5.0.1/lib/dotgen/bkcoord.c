@@ -0,0 +1,416 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/// \file
+/// \brief Brandes-Köpf x coordinate assignment
+///
+/// An alternative to solving the auxiliary graph of position.c with network
+/// simplex, for graphs too large for that to be quick. Following Brandes and
+/// Köpf, "Fast and Simple Horizontal Coordinate Assignment" (2001), nodes are
+/// aligned into vertical blocks four times, towards the upper or the lower
+/// neighbors and sweeping from the left or the right. Each node is aligned
+/// with a median neighbor, avoiding segments that cross the inner segments
+/// of long edges.
+///
+/// Instead of only separating neighbors in a rank, as the paper does,
+/// compaction honors every constraint of the auxiliary graph: node
+/// separation, flat edge labels and cluster boxes. The blocks become single
+/// variables and a longest path through the constraints packs them to the
+/// left, or to the right. The four layouts are aligned to the narrowest,
+/// each node is put midway between its two median coordinates, and a last
+/// pass over the constraints restores any separation that this lost.
+///
+/// Nodes are only aligned with neighbors in the same cluster. Should the
+/// alignments still leave constraints that cannot be met, the layout is left
+/// to network simplex.
+
+#include <cgraph/alloc.h>
+#include <dotgen/dot.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct {
+    int n;			///< nodes of the auxiliary graph
+    node_t **node;
+    int nranks;
+    int *first;			///< per rank, offset of its nodes in layer
+    int *layer;			///< ranked nodes, rank after rank, in order
+    int *rank, *pos;		///< per node, or -1 for nodes not in a rank
+    int *up, *upoff;		///< per node, neighbors in the rank above
+    bool *conflict;		///< type 1 conflicts, parallel to up
+    int *down, *downoff;	///< per node, neighbors in the rank below
+    int nc;			///< constraints
+    int *ctail, *chead, *clen;
+} bk_t;
+
+#define INDEX(v) ND_low(v)
+#define RANKSIZE(b,r) ((b)->first[(r) + 1] - (b)->first[r])
+
+/* neighbors:
+ * Neighbor lists of the ranked nodes, from their fast in edges (up) or out
+ * edges, sorted by position.
+ */
+static void neighbors(bk_t * b, bool up, int **adj, int **off)
+{
+    int i, j, v, u, cnt = 0;
+    edge_t *e;
+
+    *off = gv_calloc((size_t)b->n + 1, sizeof(int));
+    for (v = 0; v < b->n; v++) {
+	if (b->rank[v] >= 0) {
+	    elist l = up ? ND_save_in(b->node[v]) : ND_save_out(b->node[v]);
+	    for (i = 0; (e = l.list[i]); i++) {
+		u = INDEX(up ? agtail(e) : aghead(e));
+		if (b->rank[u] == b->rank[v] + (up ? -1 : 1))
+		    cnt++;
+	    }
+	}
+	(*off)[v + 1] = cnt;
+    }
+    *adj = gv_calloc((size_t)cnt + 1, sizeof(int));
+    for (v = 0; v < b->n; v++) {
+	if (b->rank[v] < 0)
+	    continue;
+	elist l = up ? ND_save_in(b->node[v]) : ND_save_out(b->node[v]);
+	cnt = (*off)[v];
+	for (i = 0; (e = l.list[i]); i++) {
+	    u = INDEX(up ? agtail(e) : aghead(e));
+	    if (b->rank[u] != b->rank[v] + (up ? -1 : 1))
+		continue;
+	    /* insertion sort by position, as the lists are short */
+	    for (j = cnt++; j > (*off)[v] && b->pos[(*adj)[j - 1]] > b->pos[u];
+		 j--)
+		(*adj)[j] = (*adj)[j - 1];
+	    (*adj)[j] = u;
+	}
+    }
+}
+
+static bk_t *bk_new(graph_t * g)
+{
+    bk_t *b = gv_alloc(sizeof(bk_t));
+    node_t *v;
+    edge_t *e;
+    int i, r, c;
+
+    for (v = GD_nlist(g); v; v = ND_next(v))
+	INDEX(v) = b->n++;
+    b->node = gv_calloc((size_t)b->n, sizeof(node_t *));
+    b->rank = gv_calloc((size_t)b->n, sizeof(int));
+    b->pos = gv_calloc((size_t)b->n, sizeof(int));
+    for (v = GD_nlist(g); v; v = ND_next(v)) {
+	b->node[INDEX(v)] = v;
+	b->rank[INDEX(v)] = b->pos[INDEX(v)] = -1;
+	for (i = 0; (e = ND_out(v).list[i]); i++)
+	    b->nc++;
+    }
+
+    b->nranks = GD_maxrank(g) - GD_minrank(g) + 1;
+    b->first = gv_calloc((size_t)b->nranks + 1, sizeof(int));
+    for (r = 0; r < b->nranks; r++)
+	b->first[r + 1] = b->first[r] + GD_rank(g)[r + GD_minrank(g)].n;
+    b->layer = gv_calloc((size_t)b->first[b->nranks] + 1, sizeof(int));
+    for (r = 0; r < b->nranks; r++)
+	for (i = 0; i < RANKSIZE(b, r); i++) {
+	    int x = INDEX(GD_rank(g)[r + GD_minrank(g)].v[i]);
+	    b->layer[b->first[r] + i] = x;
+	    b->rank[x] = r;
+	    b->pos[x] = i;
+	}
+
+    /* the auxiliary edges are the constraints */
+    b->ctail = gv_calloc((size_t)b->nc + 1, sizeof(int));
+    b->chead = gv_calloc((size_t)b->nc + 1, sizeof(int));
+    b->clen = gv_calloc((size_t)b->nc + 1, sizeof(int));
+    c = 0;
+    for (v = GD_nlist(g); v; v = ND_next(v))
+	for (i = 0; (e = ND_out(v).list[i]); i++) {
+	    b->ctail[c] = INDEX(v);
+	    b->chead[c] = INDEX(aghead(e));
+	    b->clen[c] = ED_minlen(e);
+	    c++;
+	}
+
+    neighbors(b, true, &b->up, &b->upoff);
+    neighbors(b, false, &b->down, &b->downoff);
+    b->conflict = gv_calloc((size_t)b->upoff[b->n] + 1, sizeof(bool));
+    return b;
+}
+
+static void bk_free(bk_t * b)
+{
+    free(b->node);
+    free(b->first);
+    free(b->layer);
+    free(b->rank);
+    free(b->pos);
+    free(b->up);
+    free(b->upoff);
+    free(b->conflict);
+    free(b->down);
+    free(b->downoff);
+    free(b->ctail);
+    free(b->chead);
+    free(b->clen);
+    free(b);
+}
+
+static bool is_virtual(const bk_t * b, int v)
+{
+    return ND_node_type(b->node[v]) == VIRTUAL;
+}
+
+/* mark_conflicts:
+ * Flag the segments between ranks that cross an inner segment, an edge
+ * between two virtual nodes, so that alignment keeps long edges straight.
+ */
+static void mark_conflicts(bk_t * b)
+{
+    int r, l, l1, k, k0, k1, i, v, w;
+
+    for (r = 1; r < b->nranks; r++) {
+	const int *lower = b->layer + b->first[r];
+	int nlower = RANKSIZE(b, r);
+	k0 = 0;
+	l = 0;
+	for (l1 = 0; l1 < nlower; l1++) {
+	    int inner = -1;
+	    v = lower[l1];
+	    if (is_virtual(b, v))
+		for (i = b->upoff[v]; i < b->upoff[v + 1]; i++)
+		    if (is_virtual(b, b->up[i]))
+			inner = b->up[i];
+	    if (l1 < nlower - 1 && inner < 0)
+		continue;
+	    k1 = inner >= 0 ? b->pos[inner] : RANKSIZE(b, r - 1) - 1;
+	    for (; l <= l1; l++) {
+		w = lower[l];
+		for (i = b->upoff[w]; i < b->upoff[w + 1]; i++) {
+		    k = b->pos[b->up[i]];
+		    if (k < k0 || k > k1)
+			b->conflict[i] = true;
+		}
+	    }
+	    k0 = k1;
+	}
+    }
+}
+
+/* conflicted:
+ * Whether the segment from u down to v is flagged.
+ */
+static bool conflicted(const bk_t * b, int u, int v)
+{
+    int i;
+
+    for (i = b->upoff[v]; i < b->upoff[v + 1]; i++)
+	if (b->up[i] == u)
+	    return b->conflict[i];
+    return false;
+}
+
+/* align:
+ * With down set, align each rank with the one above it, else with the one
+ * below, sweeping each rank from the right if right is set. Sets root to
+ * the first node of each node's block.
+ */
+static void align(const bk_t * b, bool down, bool right, int *root)
+{
+    int v, i, j, r, m, d, u;
+    const int *adj = down ? b->up : b->down;
+    const int *off = down ? b->upoff : b->downoff;
+
+    for (v = 0; v < b->n; v++)
+	root[v] = v;
+
+    for (j = 1; j < b->nranks; j++) {
+	int rank = down ? j : b->nranks - 1 - j;
+	int n = RANKSIZE(b, rank);
+	r = right ? INT_MAX : -1;
+	for (i = 0; i < n; i++) {
+	    v = b->layer[b->first[rank] + (right ? n - 1 - i : i)];
+	    d = off[v + 1] - off[v];
+	    if (d == 0)
+		continue;
+	    /* the lower and upper median, in the order of the sweep */
+	    int med[2] = {(d - 1) / 2, d / 2};
+	    if (right) {
+		med[0] = d / 2;
+		med[1] = (d - 1) / 2;
+	    }
+	    for (m = 0; m < 2 && root[v] == v; m++) {
+		if (m == 1 && med[1] == med[0])
+		    break;
+		u = adj[off[v] + med[m]];
+		if (ND_clust(b->node[u]) != ND_clust(b->node[v]))
+		    continue;
+		if (down ? conflicted(b, u, v) : conflicted(b, v, u))
+		    continue;
+		if (right ? b->pos[u] < r : b->pos[u] > r) {
+		    root[v] = root[u];
+		    r = b->pos[u];
+		}
+	    }
+	}
+    }
+}
+
+/* longest_path:
+ * Satisfy the constraints between the nodes root maps to themselves, by
+ * pushing heads right of their tails or, if right is set, tails left of
+ * their heads, in topological order. x holds the starting coordinates.
+ * Returns false if the constraints are cyclic.
+ */
+static bool longest_path(const bk_t * b, const int *root, bool right, int *x)
+{
+    int n = b->n, v, i, head = 0, tail = 0, done = 0, nodes = 0;
+    int *indeg = gv_calloc((size_t)n, sizeof(int));
+    int *queue = gv_calloc((size_t)n, sizeof(int));
+    int *off = gv_calloc((size_t)n + 1, sizeof(int));
+    int *edges = gv_calloc((size_t)b->nc + 1, sizeof(int));
+
+    /* index the constraints by the end the path arrives from */
+    for (i = 0; i < b->nc; i++) {
+	int t = root[b->ctail[i]], h = root[b->chead[i]];
+	if (t != h)
+	    off[(right ? h : t) + 1]++;
+    }
+    for (v = 0; v < n; v++)
+	off[v + 1] += off[v];
+    for (i = 0; i < b->nc; i++) {
+	int t = root[b->ctail[i]], h = root[b->chead[i]];
+	if (t == h)
+	    continue;
+	edges[off[right ? h : t] + indeg[right ? h : t]++] = i;
+    }
+    for (v = 0; v < n; v++)
+	indeg[v] = 0;
+    for (i = 0; i < b->nc; i++) {
+	int t = root[b->ctail[i]], h = root[b->chead[i]];
+	if (t != h)
+	    indeg[right ? t : h]++;
+    }
+
+    for (v = 0; v < n; v++)
+	if (root[v] == v) {
+	    nodes++;
+	    if (indeg[v] == 0)
+		queue[tail++] = v;
+	}
+    while (head < tail) {
+	v = queue[head++];
+	done++;
+	for (i = off[v]; i < off[v + 1]; i++) {
+	    int e = edges[i];
+	    int to = right ? root[b->ctail[e]] : root[b->chead[e]];
+	    if (right)
+		x[to] = MIN(x[to], x[v] - b->clen[e]);
+	    else
+		x[to] = MAX(x[to], x[v] + b->clen[e]);
+	    if (--indeg[to] == 0)
+		queue[tail++] = to;
+	}
+    }
+
+    free(indeg);
+    free(queue);
+    free(off);
+    free(edges);
+    return done == nodes;
+}
+
+/* compact:
+ * Place the blocks given by root as far left, or right, as the constraints
+ * allow. Returns false if they cannot be met.
+ */
+static bool compact(const bk_t * b, const int *root, bool right, int *x)
+{
+    int v, i;
+
+    /* a constraint within a block can only hold if it asks for nothing */
+    for (i = 0; i < b->nc; i++)
+	if (root[b->ctail[i]] == root[b->chead[i]] && b->clen[i] > 0)
+	    return false;
+    for (v = 0; v < b->n; v++)
+	x[v] = 0;
+    if (!longest_path(b, root, right, x))
+	return false;
+    for (v = 0; v < b->n; v++)
+	x[v] = x[root[v]];
+    return true;
+}
+
+static int intcmpf(const void *x, const void *y)
+{
+    int a = *(const int *) x, b = *(const int *) y;
+    return (a > b) - (a < b);
+}
+
+/* dot_bk_position:
+ * Set ND_rank of every node of g's auxiliary graph to its x coordinate.
+ * Returns false, changing nothing, if the constraints could not be met.
+ */
+bool dot_bk_position(graph_t * g)
+{
+    bk_t *b = bk_new(g);
+    int *root = gv_calloc((size_t)b->n, sizeof(int));
+    int *xs[4], lo[4], hi[4], best = 0, d, v, *x, *self;
+    bool ok = true;
+
+    mark_conflicts(b);
+    for (d = 0; d < 4; d++) {
+	bool right = d & 1;
+	xs[d] = gv_calloc((size_t)b->n, sizeof(int));
+	if (!ok)
+	    continue;
+	align(b, d < 2, right, root);
+	ok = compact(b, root, right, xs[d]);
+	lo[d] = INT_MAX;
+	hi[d] = INT_MIN;
+	for (v = 0; v < b->n; v++) {
+	    lo[d] = MIN(lo[d], xs[d][v]);
+	    hi[d] = MAX(hi[d], xs[d][v]);
+	}
+	if (hi[d] - lo[d] < hi[best] - lo[best])
+	    best = d;
+    }
+
+    if (ok) {
+	/* align to the narrowest layout and take the average median */
+	x = root;
+	for (v = 0; v < b->n; v++) {
+	    int c[4];
+	    for (d = 0; d < 4; d++)
+		c[d] = xs[d][v] + ((d & 1) ? hi[best] - hi[d] : lo[best] - lo[d]);
+	    qsort(c, 4, sizeof(int), intcmpf);
+	    x[v] = (c[1] + c[2]) / 2;
+	}
+	/* averaging can bring nodes too close; push them apart again */
+	self = gv_calloc((size_t)b->n, sizeof(int));
+	for (v = 0; v < b->n; v++)
+	    self[v] = v;
+	ok = longest_path(b, self, false, x);
+	free(self);
+    }
+    if (ok) {
+	int min = INT_MAX;
+	for (v = 0; v < b->n; v++)
+	    min = MIN(min, x[v]);
+	for (v = 0; v < b->n; v++)
+	    ND_rank(b->node[v]) = x[v] - min;
+    }
+
+    for (d = 0; d < 4; d++)
+	free(xs[d]);
+    free(root);
+    bk_free(b);
+    return ok;
+}
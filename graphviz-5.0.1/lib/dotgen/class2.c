@@ -165,9 +165,10 @@ int mergeable(edge_t * e, edge_t * f)
 
 void class2(graph_t * g)
 {
-    int c;
+    int c, i, k;
     node_t *n, *t, *h;
     edge_t *e, *prev, *opp;
+    Agcsr_t *csr;
 
     GD_nlist(g) = NULL;
 
@@ -176,21 +177,28 @@ void class2(graph_t * g)
     mark_clusters(g);
     for (c = 1; c <= GD_n_cluster(g); c++)
 	build_skeleton(g, GD_clust(g)[c]);
-    for (n = agfstnode(g); n; n = agnxtnode(g, n))
-	for (e = agfstout(g, n); e; e = agnxtout(g, e)) {
-	    if (ND_weight_class(aghead(e)) <= 2)
-		ND_weight_class(aghead(e))++;
-	    if (ND_weight_class(agtail(e)) <= 2)
-		ND_weight_class(agtail(e))++;
+
+    /* The loops below only add virtual nodes and edges, which live outside
+     * the cgraph edge sets, so a single snapshot serves both passes.
+     */
+    csr = agcsr(g);
+    for (i = 0; i < csr->nnodes; i++)
+	for (k = csr->out_offset[i]; k < csr->out_offset[i + 1]; k++) {
+	    if (ND_weight_class(csr->node[csr->out_target[k]]) <= 2)
+		ND_weight_class(csr->node[csr->out_target[k]])++;
+	    if (ND_weight_class(csr->node[i]) <= 2)
+		ND_weight_class(csr->node[i])++;
 	}
 
-    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+    for (i = 0; i < csr->nnodes; i++) {
+	n = csr->node[i];
 	if ((ND_clust(n) == NULL) && (n == UF_find(n))) {
 	    fast_node(g, n);
 	    GD_n_nodes(g)++;
 	}
 	prev = NULL;
-	for (e = agfstout(g, n); e; e = agnxtout(g, e)) {
+	for (k = csr->out_offset[i]; k < csr->out_offset[i + 1]; k++) {
+	    e = csr->out_edge[k];
 
 	    /* already processed */
 	    if (ED_to_virt(e)) {
@@ -292,6 +300,7 @@ void class2(graph_t * g)
 	    }
 	}
     }
+    agcsrfree(csr);
     /* since decompose() is not called on subgraphs */
     if (g != dot_root(g)) {
 	GD_comp(g).list = ALLOC(1, GD_comp(g).list, node_t *);
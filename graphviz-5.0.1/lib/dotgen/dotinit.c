@@ -490,7 +490,12 @@ static void doDot (Agraph_t* g)
 
 void dot_layout(Agraph_t * g)
 {
-    if (agnnodes(g)) doDot (g);
+    if (agnnodes(g)) {
+	doDot (g);
+	/* record ranks and orders to seed the next incremental layout */
+	if (mapbool(agget(g, "incremental")))
+	    attach_phase_attrs (g, 2);
+    }
     dotneato_postprocess(g);
 }
 
@@ -69,10 +69,19 @@ extern "C" {
     extern void virtual_weight(Agedge_t *);
     extern void zapinlist(elist *, Agedge_t *);
 
+    typedef struct mcsearch_s mcsearch_t;
+    extern mcsearch_t *mcsearch_new(graph_t *, int);
+    extern void mcsearch_start(mcsearch_t *, graph_t *);
+    extern void mcsearch_run(mcsearch_t **, int, int, int, int, int, double);
+    extern int mcsearch_install(mcsearch_t *, graph_t *, int *);
+    extern void mcsearch_free(mcsearch_t *);
+
     extern Agraph_t* dot_root(void *);
+    extern bool dot_bk_position(Agraph_t *);
     extern void dot_concentrate(Agraph_t *);
     extern void dot_mincross(Agraph_t *, int);
     extern void dot_position(Agraph_t *, aspect_t*);
+    extern bool dot_prior_x(Agnode_t *, double *);
     extern void dot_rank(Agraph_t *, aspect_t*);
     extern void dot_sameports(Agraph_t *);
     extern void dot_splines(Agraph_t *);
@@ -14,6 +14,9 @@
  */
 
 #include <assert.h>
+#include <cgraph/alloc.h>
+#include <cgraph/parallel.h>
+#include <cgraph/stack.h>
 #include <common/memory.h>
 #include <dotgen/dot.h>
 #include <limits.h>
@@ -112,6 +115,26 @@ typedef struct {
     boxf* Rank_box;
 } spline_info_t;
 
+/* a group of equivalent edges, edges[ind] to edges[ind + cnt - 1] of the
+ * sorted edge list, which are routed together */
+typedef struct {
+    int ind, cnt;
+} edge_group_t;
+
+/* The routing of a group of regular edges. The forward copies of the edges
+ * are kept here, since the spline may be installed on them only after the
+ * routing is done.
+ */
+typedef struct {
+    int ind, cnt;
+    edge_t *fe;			/* the edge the spline is installed on */
+    node_t *hn;			/* the node the spline ends at */
+    pointf *ps;			/* the spline */
+    int pn, size;		/* its number of points, and room for them */
+    Agedgeinfo_t fwdedgeai, fwdedgebi;
+    Agedgepair_t fwdedgea, fwdedgeb;
+} regular_route_t;
+
 static void adjustregularpath(path *, int, int);
 static Agedge_t *bot_bound(Agedge_t *, int);
 static bool pathscross(Agnode_t *, Agnode_t *, Agedge_t *, Agedge_t *);
@@ -122,6 +145,8 @@ static void completeregularpath(path *, Agedge_t *, Agedge_t *,
 static int edgecmp(Agedge_t **, Agedge_t **);
 static void make_flat_edge(graph_t*, spline_info_t*, path *, Agedge_t **, int, int, int);
 static void make_regular_edge(graph_t* g, spline_info_t*, path *, Agedge_t **, int, int, int);
+static void make_regular_edges(graph_t *, spline_info_t *, Agedge_t **,
+			       const edge_group_t *, int, int, int, int);
 static boxf makeregularend(boxf, int, double);
 static boxf maximal_bbox(graph_t* g, spline_info_t*, Agnode_t *, Agedge_t *, Agedge_t *);
 static Agnode_t *neighbor(graph_t*, Agnode_t *, Agedge_t *, Agedge_t *, int);
@@ -313,13 +338,15 @@ setEdgeLabelPos (graph_t * g)
  */
 static void _dot_splines(graph_t * g, int normalize)
 {
-    int i, j, k, n_nodes, n_edges, ind, cnt;
+    int i, j, k, n_nodes, n_edges, ind, cnt, nthreads = 1, n_regular = 0;
     node_t *n;
     Agedgeinfo_t fwdedgeai, fwdedgebi;
     Agedgepair_t fwdedgea, fwdedgeb;
     edge_t *e, *e0, *e1, *ea, *eb, *le0, *le1, **edges = NULL;
     path *P = NULL;
     spline_info_t sd;
+    edge_group_t *regular = NULL;
+    char *s;
     int et = EDGE_TYPE(g);
     fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
     fwdedgeb.out.base.data = (Agrec_t*)&fwdedgebi;
@@ -427,6 +454,15 @@ static void _dot_splines(graph_t * g, int normalize)
     P->boxes = N_NEW(n_nodes + 20 * 2 * NSUB, boxf);
     sd.Rank_box = N_NEW(i, boxf);
 
+    /* with more than one thread, regular edges are set aside and routed
+     * together at the end; they sort after all other edges anyway.
+     * Concentrated edges share spline pieces, so they stay serial.
+     */
+    if ((s = agget(g, "threads")) && !Concentrate)
+	nthreads = atoi(s);
+    if (nthreads > 1)
+	regular = gv_calloc((size_t)n_edges, sizeof(edge_group_t));
+
     if (et == EDGETYPE_LINE) {
     /* place regular edge labels */
 	for (n = GD_nlist(g); n; n = ND_next(n)) {
@@ -515,9 +551,15 @@ static void _dot_splines(graph_t * g, int normalize)
 	else if (ND_rank(agtail(e0)) == ND_rank(aghead(e0))) {
 	    make_flat_edge(g, &sd, P, edges, ind, cnt, et);
 	}
+	else if (regular)
+	    regular[n_regular++] = (edge_group_t){.ind = ind, .cnt = cnt};
 	else
 	    make_regular_edge(g, &sd, P, edges, ind, cnt, et);
     }
+    if (n_regular > 0)
+	make_regular_edges(g, &sd, edges, regular, n_regular, et, nthreads,
+			   n_nodes + 20 * 2 * NSUB);
+    free(regular);
 
     /* place regular edge labels */
     for (n = GD_nlist(g); n; n = ND_next(n)) {
@@ -1821,81 +1863,98 @@ makeLineEdge(graph_t* g, edge_t* fe, pointf* points, node_t** hp)
     return pn;
 }
 
-#define NUMPTS 2000
-
-/* make_regular_edge:
+/* regular_first:
+ * Set up the first edge of the path of the group in rt, pointing down.
+ * If the edge spans several ranks, this is a copy standing for its chain
+ * of virtual edges and hackflag is set. The copies live in rt, so that the
+ * spline can be installed on them after the routing is done.
  */
-static void
-make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int ind, int cnt, int et)
+static edge_t *regular_first(edge_t ** edges, regular_route_t * rt,
+			     bool * hackflag)
 {
-    node_t *tn, *hn;
-    Agedgeinfo_t fwdedgeai, fwdedgebi, fwdedgei;
-    Agedgepair_t fwdedgea, fwdedgeb, fwdedge;
-    edge_t *e, *fe, *le, *segfirst;
-    pathend_t tend, hend;
-    boxf b;
-    int sl, si, smode, i, j, dx, hackflag, longedge;
-    static pointf* pointfs;
-    static pointf* pointfs2;
-    static int numpts;
-    static int numpts2;
-    int pointn;
+    edge_t *e, *le;
 
-    fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
-    fwdedgeb.out.base.data = (Agrec_t*)&fwdedgebi;
-    fwdedge.out.base.data = (Agrec_t*)&fwdedgei;
+    rt->fwdedgea.out.base.data = (Agrec_t*)&rt->fwdedgeai;
+    rt->fwdedgeb.out.base.data = (Agrec_t*)&rt->fwdedgebi;
 
-    if (!pointfs) {
-	pointfs = N_GNEW(NUMPTS, pointf);
-   	pointfs2 = N_GNEW(NUMPTS, pointf);
-	numpts = NUMPTS;
-	numpts2 = NUMPTS;
-    }
-    sl = 0;
-    e = edges[ind];
-    hackflag = FALSE;
+    e = edges[rt->ind];
+    *hackflag = false;
     if (abs(ND_rank(agtail(e)) - ND_rank(aghead(e))) > 1) {
-	fwdedgeai = *(Agedgeinfo_t*)e->base.data;
-	fwdedgea.out = *e;
-	fwdedgea.in = *AGOUT2IN(e);
-	fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
+	rt->fwdedgeai = *(Agedgeinfo_t*)e->base.data;
+	rt->fwdedgea.out = *e;
+	rt->fwdedgea.in = *AGOUT2IN(e);
+	rt->fwdedgea.out.base.data = (Agrec_t*)&rt->fwdedgeai;
 	if (ED_tree_index(e) & BWDEDGE) {
-	    MAKEFWDEDGE(&fwdedgeb.out, e);
-	    agtail(&fwdedgea.out) = aghead(e);
-	    ED_tail_port(&fwdedgea.out) = ED_head_port(e);
+	    MAKEFWDEDGE(&rt->fwdedgeb.out, e);
+	    agtail(&rt->fwdedgea.out) = aghead(e);
+	    ED_tail_port(&rt->fwdedgea.out) = ED_head_port(e);
 	} else {
-	    fwdedgebi = *(Agedgeinfo_t*)e->base.data;
-	    fwdedgeb.out = *e;
-	    fwdedgeb.out.base.data = (Agrec_t*)&fwdedgebi;
-	    agtail(&fwdedgea.out) = agtail(e);
-	    fwdedgeb.in = *AGOUT2IN(e);
+	    rt->fwdedgebi = *(Agedgeinfo_t*)e->base.data;
+	    rt->fwdedgeb.out = *e;
+	    rt->fwdedgeb.out.base.data = (Agrec_t*)&rt->fwdedgebi;
+	    agtail(&rt->fwdedgea.out) = agtail(e);
+	    rt->fwdedgeb.in = *AGOUT2IN(e);
 	}
 	le = getmainedge(e);
 	while (ED_to_virt(le))
 	    le = ED_to_virt(le);
-	aghead(&fwdedgea.out) = aghead(le);
-	ED_head_port(&fwdedgea.out).defined = false;
-	ED_edge_type(&fwdedgea.out) = VIRTUAL;
-	ED_head_port(&fwdedgea.out).p.x = ED_head_port(&fwdedgea.out).p.y = 0;
-	ED_to_orig(&fwdedgea.out) = e;
-	e = &fwdedgea.out;
-	hackflag = TRUE;
+	aghead(&rt->fwdedgea.out) = aghead(le);
+	ED_head_port(&rt->fwdedgea.out).defined = false;
+	ED_edge_type(&rt->fwdedgea.out) = VIRTUAL;
+	ED_head_port(&rt->fwdedgea.out).p.x = ED_head_port(&rt->fwdedgea.out).p.y = 0;
+	ED_to_orig(&rt->fwdedgea.out) = e;
+	e = &rt->fwdedgea.out;
+	*hackflag = true;
     } else {
 	if (ED_tree_index(e) & BWDEDGE) {
-	    MAKEFWDEDGE(&fwdedgea.out, e);
-	    e = &fwdedgea.out;
+	    MAKEFWDEDGE(&rt->fwdedgea.out, e);
+	    e = &rt->fwdedgea.out;
 	}
     }
-    fe = e;
+    return e;
+}
+
+/* reserve_points:
+ * Make room for n points in rt.
+ */
+static void reserve_points(regular_route_t * rt, int n)
+{
+    if (n > rt->size) {
+	rt->size = 2 * n;
+	rt->ps = RALLOC(rt->size, rt->ps, pointf);
+    }
+}
+
+/* route_regular_edge:
+ * Compute the spline points of the group of regular edges in rt, leaving
+ * them in rt->ps and the node they end at in rt->hn. Space freed by the
+ * spline is handed back to the virtual nodes along it. Returns false if
+ * routing failed.
+ */
+static bool
+route_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges,
+		   int et, regular_route_t * rt)
+{
+    node_t *tn, *hn;
+    edge_t *e, *segfirst;
+    pathend_t tend, hend;
+    boxf b;
+    int sl, si, smode, i, longedge;
+    bool hackflag;
+
+    sl = 0;
+    e = regular_first(edges, rt, &hackflag);
+    rt->fe = e;
+    rt->pn = 0;
 
     /* compute the spline points for the edge */
 
-    if (et == EDGETYPE_LINE && (pointn = makeLineEdge (g, fe, pointfs, &hn))) {
+    reserve_points(rt, 7);	/* the most makeLineEdge makes */
+    if (et == EDGETYPE_LINE && (rt->pn = makeLineEdge (g, rt->fe, rt->ps, &rt->hn))) {
     }
     else {
 	bool is_spline = et == EDGETYPE_SPLINE;
 	boxes_t boxes = {0};
-	pointn = 0;
 	segfirst = e;
 	tn = agtail(e);
 	hn = aghead(e);
@@ -1950,21 +2009,16 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	    if (pn == 0) {
 	        free(ps);
 	        boxes_free(&boxes);
-	        return;
+	        return false;
 	    }
 	
-	    if (pointn + pn > numpts) {
-                /* This should be enough to include 3 extra points added by
-                 * straight_path below.
-                 */
-		numpts = 2*(pointn+pn); 
-		pointfs = RALLOC(numpts, pointfs, pointf);
-	    }
+	    /* leave room for the 3 points added by straight_path below */
+	    reserve_points(rt, rt->pn + pn + 3);
 	    for (i = 0; i < pn; i++) {
-		pointfs[pointn++] = ps[i];
+		rt->ps[rt->pn++] = ps[i];
 	    }
 	    free(ps);
-	    e = straight_path(ND_out(hn).list[0], sl, pointfs, &pointn);
+	    e = straight_path(ND_out(hn).list[0], sl, rt->ps, &rt->pn);
 	    recover_slack(segfirst, P);
 	    segfirst = e;
 	    tn = agtail(e);
@@ -1981,7 +2035,7 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	}
 	boxes_append(&boxes, rank_box(sp, g, ND_rank(tn)));
 	b = hend.nb = maximal_bbox(g, sp, hn, e, NULL);
-	endpath(P, hackflag ? &fwdedgeb.out : e, REGULAREDGE, &hend,
+	endpath(P, hackflag ? &rt->fwdedgeb.out : e, REGULAREDGE, &hend,
 	        spline_merge(aghead(e)));
 	b.UR.y = hend.boxes[hend.boxn - 1].UR.y;
 	b.LL.y = hend.boxes[hend.boxn - 1].LL.y;
@@ -2008,39 +2062,48 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
         }
 	if (pn == 0) {
 	    free(ps);
-	    return;
-	}
-	if (pointn + pn > numpts) {
-	    numpts = 2*(pointn+pn); 
-	    pointfs = RALLOC(numpts, pointfs, pointf);
+	    return false;
 	}
+	reserve_points(rt, rt->pn + pn);
 	for (i = 0; i < pn; i++) {
-	    pointfs[pointn++] = ps[i];
+	    rt->ps[rt->pn++] = ps[i];
 	}
 	free(ps);
 	recover_slack(segfirst, P);
-	hn = hackflag ? aghead(&fwdedgeb.out) : aghead(e);
+	rt->hn = hackflag ? aghead(&rt->fwdedgeb.out) : aghead(e);
     }
+    return true;
+}
 
-    /* make copies of the spline points, one per multi-edge */
+/* install_regular_edge:
+ * Install the spline routed for the group in rt on its edges, one copy
+ * per multi-edge.
+ */
+static void install_regular_edge(spline_info_t* sp, edge_t ** edges,
+				 regular_route_t * rt)
+{
+    Agedgeinfo_t fwdedgei;
+    Agedgepair_t fwdedge;
+    edge_t *e;
+    pointf *pointfs = rt->ps, *pointfs2;
+    int pointn = rt->pn, cnt = rt->cnt, i, j, dx;
+
+    fwdedge.out.base.data = (Agrec_t*)&fwdedgei;
 
     if (cnt == 1) {
-	clip_and_install(fe, hn, pointfs, pointn, &sinfo);
+	clip_and_install(rt->fe, rt->hn, pointfs, pointn, &sinfo);
 	return;
     }
     dx = sp->Multisep * (cnt - 1) / 2;
     for (i = 1; i < pointn - 1; i++)
 	pointfs[i].x -= dx;
 
-    if (numpts > numpts2) {
-	numpts2 = numpts; 
-	pointfs2 = RALLOC(numpts2, pointfs2, pointf);
-    }
+    pointfs2 = N_GNEW(pointn, pointf);
     for (i = 0; i < pointn; i++)
 	pointfs2[i] = pointfs[i];
-    clip_and_install(fe, hn, pointfs2, pointn, &sinfo);
+    clip_and_install(rt->fe, rt->hn, pointfs2, pointn, &sinfo);
     for (j = 1; j < cnt; j++) {
-	e = edges[ind + j];
+	e = edges[rt->ind + j];
 	if (ED_tree_index(e) & BWDEDGE) {
 	    MAKEFWDEDGE(&fwdedge.out, e);
 	    e = &fwdedge.out;
@@ -2051,6 +2114,247 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	    pointfs2[i] = pointfs[i];
 	clip_and_install(e, aghead(e), pointfs2, pointn, &sinfo);
     }
+    free(pointfs2);
+}
+
+/* make_regular_edge:
+ */
+static void
+make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int ind, int cnt, int et)
+{
+    regular_route_t rt = {.ind = ind, .cnt = cnt};
+
+    if (route_regular_edge(g, sp, P, edges, et, &rt))
+	install_regular_edge(sp, edges, &rt);
+    free(rt.ps);
+}
+
+/* Regular edges can be routed on several threads. Routing a group reads
+ * the positions and sizes of the nodes along its path, of their nearest
+ * neighbors and, at concentrators, of the nodes setting the slope there;
+ * recover_slack then shrinks the virtual nodes of the path. The groups are
+ * put into waves such that no group writes a node that another group of its
+ * wave reads, and each group comes after every earlier group in the edge
+ * list it conflicts with. The groups of a wave are routed at once, and the
+ * splines come out exactly as if the groups had been routed one after
+ * another. Clipping the splines to the node shapes is not reentrant, so
+ * they are installed between waves, on the calling thread.
+ */
+
+/* node_index:
+ * The index of n among all ranked nodes of g.
+ */
+static int node_index(graph_t * g, const int *rankpos, node_t * n)
+{
+    assert(ND_order(n) >= 0 && ND_order(n) < GD_rank(g)[ND_rank(n)].n);
+    return rankpos[ND_rank(n)] + ND_order(n);
+}
+
+/* push_neighbors:
+ * Push the nodes that bound the boxes maximal_bbox makes for vn.
+ */
+static void push_neighbors(graph_t * g, gv_stack_t * nodes, node_t * vn,
+			   edge_t * ie, edge_t * oe)
+{
+    node_t *n;
+
+    if ((n = neighbor(g, vn, ie, oe, -1)))
+	stack_push_or_exit(nodes, n);
+    if ((n = neighbor(g, vn, ie, oe, 1)))
+	stack_push_or_exit(nodes, n);
+}
+
+/* push_slope:
+ * Push the nodes conc_slope looks at for the concentrator n.
+ */
+static void push_slope(gv_stack_t * nodes, node_t * n)
+{
+    edge_t *e;
+    int i;
+
+    for (i = 0; (e = ND_in(n).list[i]); i++)
+	stack_push_or_exit(nodes, agtail(e));
+    for (i = 0; (e = ND_out(n).list[i]); i++)
+	stack_push_or_exit(nodes, aghead(e));
+}
+
+/* regular_nodes:
+ * Push the nodes routing the group in rt depends on onto nodes, starting
+ * with the virtual nodes of its path, which routing resizes. Returns their
+ * number.
+ */
+static size_t regular_nodes(graph_t * g, edge_t ** edges,
+			    regular_route_t * rt, gv_stack_t * nodes)
+{
+    edge_t *e, *ie;
+    node_t *tn, *hn;
+    bool hackflag;
+    size_t nw = 0;
+
+    e = regular_first(edges, rt, &hackflag);
+    tn = agtail(e);
+    for (hn = aghead(e); ND_node_type(hn) == VIRTUAL && !sinfo.splineMerge(hn);
+	 hn = aghead(ND_out(hn).list[0])) {
+	stack_push_or_exit(nodes, hn);
+	nw++;
+    }
+
+    push_neighbors(g, nodes, tn, NULL, e);
+    if (spline_merge(tn))
+	push_slope(nodes, tn);
+    for (ie = e, hn = aghead(e);
+	 ND_node_type(hn) == VIRTUAL && !sinfo.splineMerge(hn);
+	 ie = ND_out(hn).list[0], hn = aghead(ie))
+	push_neighbors(g, nodes, hn, ie, ND_out(hn).list[0]);
+    push_neighbors(g, nodes, hn, ie, NULL);
+    if (spline_merge(hn))
+	push_slope(nodes, hackflag ? aghead(&rt->fwdedgeb.out) : hn);
+    return nw;
+}
+
+/* regular_waves:
+ * Set the wave of each of the n groups of regular edges in groups.
+ * Returns the number of waves.
+ */
+static int regular_waves(graph_t * g, edge_t ** edges,
+			 const edge_group_t * groups, int n, int *wave)
+{
+    int r, i, nranked = 0, nwaves = 0;
+    int *rankpos = gv_calloc((size_t)GD_maxrank(g) + 1, sizeof(int));
+    int *read, *written;
+    gv_stack_t nodes = {0};
+    regular_route_t *rt = gv_alloc(sizeof(regular_route_t));
+
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	rankpos[r] = nranked;
+	nranked += GD_rank(g)[r].n;
+    }
+    /* the last wave each node was read or written in, or -1 */
+    read = gv_calloc((size_t)nranked, sizeof(int));
+    written = gv_calloc((size_t)nranked, sizeof(int));
+    for (i = 0; i < nranked; i++)
+	read[i] = written[i] = -1;
+
+    for (i = 0; i < n; i++) {
+	size_t j, nw;
+	int w = 0;
+
+	nodes.size = 0;
+	rt->ind = groups[i].ind;
+	rt->cnt = groups[i].cnt;
+	nw = regular_nodes(g, edges, rt, &nodes);
+	for (j = 0; j < stack_size(&nodes); j++) {
+	    int v = node_index(g, rankpos, nodes.base[j]);
+	    w = MAX(w, written[v] + 1);
+	    if (j < nw)
+		w = MAX(w, read[v] + 1);
+	}
+	for (j = 0; j < stack_size(&nodes); j++) {
+	    int v = node_index(g, rankpos, nodes.base[j]);
+	    read[v] = MAX(read[v], w);
+	    if (j < nw)
+		written[v] = MAX(written[v], w);
+	}
+	wave[i] = w;
+	nwaves = MAX(nwaves, w + 1);
+    }
+
+    stack_reset(&nodes);
+    free(rt);
+    free(read);
+    free(written);
+    free(rankpos);
+    return nwaves;
+}
+
+typedef struct {
+    graph_t *g;
+    spline_info_t *sp;
+    edge_t **edges;
+    int et;
+    regular_route_t *groups;	/* the groups of the current wave */
+    bool *routed;
+    int n;
+    path *paths;		/* one per job */
+    int njobs;
+} regular_job_t;
+
+static void route_regular_job(void *ctx, size_t job)
+{
+    regular_job_t *rj = ctx;
+    int i;
+
+    for (i = (int)job; i < rj->n; i += rj->njobs)
+	rj->routed[i] = route_regular_edge(rj->g, rj->sp, &rj->paths[job],
+					   rj->edges, rj->et, &rj->groups[i]);
+    /* the thread may exit once the job is done */
+    routesplinesfree();
+}
+
+/* make_regular_edges:
+ * Route the n groups of regular edges in groups, wave by wave, on up to
+ * nthreads threads. The paths need room for nboxes boxes.
+ */
+static void make_regular_edges(graph_t * g, spline_info_t * sp,
+			       edge_t ** edges, const edge_group_t * groups,
+			       int n, int et, int nthreads, int nboxes)
+{
+    int *wave = gv_calloc((size_t)n, sizeof(int));
+    int *order = gv_calloc((size_t)n, sizeof(int));
+    int *first, nwaves, w, i, r, most = 0;
+    regular_job_t rj = {.g = g, .sp = sp, .edges = edges, .et = et};
+
+    /* fill the rank box cache, which routing reads */
+    for (r = GD_minrank(g); r < GD_maxrank(g); r++)
+	rank_box(sp, g, r);
+
+    /* sort the groups by wave, keeping their order within each */
+    nwaves = regular_waves(g, edges, groups, n, wave);
+    first = gv_calloc((size_t)nwaves + 1, sizeof(int));
+    for (i = 0; i < n; i++)
+	first[wave[i] + 1]++;
+    for (w = 0; w < nwaves; w++)
+	first[w + 1] += first[w];
+    for (i = 0; i < n; i++)
+	order[first[wave[i]]++] = i;
+    for (w = nwaves; w > 0; w--)
+	first[w] = first[w - 1];
+    first[0] = 0;
+    for (w = 0; w < nwaves; w++)
+	most = MAX(most, first[w + 1] - first[w]);
+    if (Verbose)
+	fprintf(stderr, "routing %d groups of regular edges in %d waves\n",
+		n, nwaves);
+
+    rj.paths = gv_calloc((size_t)nthreads, sizeof(path));
+    for (i = 0; i < nthreads; i++)
+	rj.paths[i].boxes = N_NEW(nboxes, boxf);
+    rj.groups = gv_calloc((size_t)most, sizeof(regular_route_t));
+    rj.routed = gv_calloc((size_t)most, sizeof(bool));
+    for (w = 0; w < nwaves; w++) {
+	rj.n = first[w + 1] - first[w];
+	for (i = 0; i < rj.n; i++) {
+	    const edge_group_t *eg = &groups[order[first[w] + i]];
+	    rj.groups[i] = (regular_route_t){.ind = eg->ind, .cnt = eg->cnt};
+	}
+	/* small waves are not worth starting threads for */
+	rj.njobs = MAX(1, MIN(nthreads, rj.n / 16));
+	gv_parallel_for((size_t)rj.njobs, nthreads, route_regular_job, &rj);
+	for (i = 0; i < rj.n; i++) {
+	    if (rj.routed[i])
+		install_regular_edge(sp, edges, &rj.groups[i]);
+	    free(rj.groups[i].ps);
+	}
+    }
+
+    for (i = 0; i < nthreads; i++)
+	free(rj.paths[i].boxes);
+    free(rj.paths);
+    free(rj.groups);
+    free(rj.routed);
+    free(first);
+    free(order);
+    free(wave);
 }
 
 /* regular edges */
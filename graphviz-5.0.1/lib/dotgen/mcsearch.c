@@ -0,0 +1,765 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/// \file
+/// \brief independent crossing minimization searches
+///
+/// mincross.c keeps its state in the nodes and rank arrays of the graph, so
+/// only one search can run on a component at a time. For components without
+/// clusters or flat edges, the state a search needs is small: an order for
+/// each rank and the edges between adjacent ranks. This file copies that
+/// into arrays owned by an mcsearch_t and runs the median and transpose
+/// heuristics of mincross.c on private copies of the order, so that several
+/// searches from different initial orders can run at once, on as many
+/// components as there are, and the best result of each is kept.
+///
+/// Start 0 follows the schedule of mincross() exactly, from the two orders
+/// built by build_ranks, so it finds the ordering the serial code would.
+/// Start 1 begins from the second of those orders only. Later starts build
+/// their own order by a breadth first search from shuffled sources, and
+/// break ties in the heuristics at random. Random choices come from a
+/// generator seeded by the component and start, so the result does not
+/// depend on the number of threads.
+
+#include <cgraph/alloc.h>
+#include <cgraph/parallel.h>
+#include <dotgen/dot.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int node;			///< index of the node at the other end
+    int xpenalty;
+    int port;			///< port order at the other end, for medians
+    double near_x;		///< port position at this end
+    double far_x;		///< port position at the other end
+} mcedge_t;
+
+struct mcsearch_s {
+    int nnodes;
+    int nranks;
+    int index;			///< of the component, to seed random starts
+    node_t **node;
+    int *rank;			///< per node, counted from the first rank
+    int *first;			///< per rank, offset of its nodes in an order
+    int *out, *in;		///< per node, offsets into outs and ins
+    mcedge_t *outs, *ins;
+    bool *has_port;
+    int maxdeg;
+    node_t ***slice;		///< per rank, where the graph keeps the nodes
+    int *start[2];		///< node indices from build_ranks passes 0 and 1
+
+    /* results, per start */
+    int starts;
+    int *pos;			///< nnodes positions for each start
+    int *cross;
+    int *passmax;		///< iteration limit of the last pass run
+};
+
+/* mcsearch_new:
+ * Copy the component whose nodes g's rank arrays currently hold, taking
+ * their order as the first start. The component must have no clusters or
+ * flat edges.
+ */
+mcsearch_t *mcsearch_new(graph_t * g, int index)
+{
+    mcsearch_t *s = gv_alloc(sizeof(mcsearch_t));
+    int r, i, j, v, nin, nout;
+    node_t *n;
+    edge_t *e;
+
+    s->index = index;
+    s->nranks = GD_maxrank(g) - GD_minrank(g) + 1;
+    s->first = gv_calloc((size_t)s->nranks + 1, sizeof(int));
+    s->slice = gv_calloc((size_t)s->nranks, sizeof(node_t **));
+    for (r = 0; r < s->nranks; r++) {
+	s->slice[r] = GD_rank(g)[r + GD_minrank(g)].v;
+	s->first[r + 1] = s->first[r] + GD_rank(g)[r + GD_minrank(g)].n;
+    }
+    s->nnodes = s->first[s->nranks];
+
+    s->node = gv_calloc((size_t)s->nnodes, sizeof(node_t *));
+    s->rank = gv_calloc((size_t)s->nnodes, sizeof(int));
+    s->has_port = gv_calloc((size_t)s->nnodes, sizeof(bool));
+    s->start[0] = gv_calloc((size_t)s->nnodes, sizeof(int));
+    s->out = gv_calloc((size_t)s->nnodes + 1, sizeof(int));
+    s->in = gv_calloc((size_t)s->nnodes + 1, sizeof(int));
+    nin = nout = 0;
+    for (r = 0; r < s->nranks; r++) {
+	for (i = 0; i < s->first[r + 1] - s->first[r]; i++) {
+	    v = s->first[r] + i;
+	    n = s->node[v] = s->slice[r][i];
+	    s->rank[v] = r;
+	    s->has_port[v] = ND_has_port(n);
+	    s->start[0][v] = v;
+	    nout += ND_out(n).size;
+	    nin += ND_in(n).size;
+	    s->out[v + 1] = nout;
+	    s->in[v + 1] = nin;
+	    s->maxdeg = MAX(s->maxdeg, MAX(ND_out(n).size, ND_in(n).size));
+	}
+    }
+
+    /* a node's index follows from its place in the first start */
+#define INDEX(n) (s->first[ND_rank(n) - GD_minrank(g)] + ND_order(n))
+    s->outs = gv_calloc((size_t)nout, sizeof(mcedge_t));
+    s->ins = gv_calloc((size_t)nin, sizeof(mcedge_t));
+    for (v = 0; v < s->nnodes; v++) {
+	n = s->node[v];
+	for (j = 0; (e = ND_out(n).list[j]); j++) {
+	    mcedge_t *me = &s->outs[s->out[v] + j];
+	    me->node = INDEX(aghead(e));
+	    me->xpenalty = ED_xpenalty(e);
+	    me->port = ED_head_port(e).order;
+	    me->near_x = ED_tail_port(e).p.x;
+	    me->far_x = ED_head_port(e).p.x;
+	}
+	for (j = 0; (e = ND_in(n).list[j]); j++) {
+	    mcedge_t *me = &s->ins[s->in[v] + j];
+	    me->node = INDEX(agtail(e));
+	    me->xpenalty = ED_xpenalty(e);
+	    me->port = ED_tail_port(e).order;
+	    me->near_x = ED_head_port(e).p.x;
+	    me->far_x = ED_tail_port(e).p.x;
+	}
+    }
+#undef INDEX
+    return s;
+}
+
+/* mcsearch_start:
+ * Take the order in g's rank arrays, holding the same nodes as when s was
+ * made, as the second start.
+ */
+void mcsearch_start(mcsearch_t * s, graph_t * g)
+{
+    int v;
+    node_t *n;
+
+    s->start[1] = gv_calloc((size_t)s->nnodes, sizeof(int));
+    for (v = 0; v < s->nnodes; v++) {
+	n = s->node[v];
+	s->start[1][s->first[ND_rank(n) - GD_minrank(g)] + ND_order(n)] = v;
+    }
+}
+
+void mcsearch_free(mcsearch_t * s)
+{
+    if (!s)
+	return;
+    free(s->node);
+    free(s->rank);
+    free(s->first);
+    free(s->out);
+    free(s->in);
+    free(s->outs);
+    free(s->ins);
+    free(s->has_port);
+    free(s->slice);
+    free(s->start[0]);
+    free(s->start[1]);
+    free(s->pos);
+    free(s->cross);
+    free(s->passmax);
+    free(s);
+}
+
+/* the state of one search */
+typedef struct {
+    const mcsearch_t *s;
+    int minquit, maxiter;
+    double convergence;
+    int *v;			///< node indices, rank after rank
+    int *pos;			///< per node, its place in its rank
+    int *save;			///< per node, its place in the best order
+    double *mval;
+    bool *valid, *candidate;	///< per rank
+    int *cache_nc;		///< per rank
+    int *count;
+    int *list;
+    bool random;		///< break ties at random
+    uint64_t seed;
+} mcwork_t;
+
+/* xorshift64* */
+static uint64_t next_random(mcwork_t * w)
+{
+    w->seed ^= w->seed >> 12;
+    w->seed ^= w->seed << 25;
+    w->seed ^= w->seed >> 27;
+    return w->seed * UINT64_C(2685821657736338717);
+}
+
+/* tie:
+ * Whether a swap between equally good orders should be made.
+ */
+static bool tie(mcwork_t * w, bool reverse)
+{
+    if (w->random)
+	return next_random(w) >> 63;
+    return reverse;
+}
+
+#define RANKSIZE(s,r) ((s)->first[(r) + 1] - (s)->first[r])
+#define RANKV(w,r) ((w)->v + (w)->s->first[r])
+
+static void exchange(mcwork_t * w, int a, int b)
+{
+    int r = w->s->rank[a];
+    int pa = w->pos[a], pb = w->pos[b];
+
+    w->pos[a] = pb;
+    RANKV(w, r)[pb] = a;
+    w->pos[b] = pa;
+    RANKV(w, r)[pa] = b;
+}
+
+/* in_cross, out_cross:
+ * Crossings between the edges of a and b on one side, with a left of b,
+ * as in mincross.c.
+ */
+static int in_cross(const mcwork_t * w, int a, int b)
+{
+    const mcsearch_t *s = w->s;
+    const mcedge_t *e1, *e2;
+    int inv, cross = 0, t;
+
+    for (e2 = s->ins + s->in[b]; e2 < s->ins + s->in[b + 1]; e2++) {
+	inv = w->pos[e2->node];
+	for (e1 = s->ins + s->in[a]; e1 < s->ins + s->in[a + 1]; e1++) {
+	    t = w->pos[e1->node] - inv;
+	    if (t > 0 || (t == 0 && e1->far_x > e2->far_x))
+		cross += e1->xpenalty * e2->xpenalty;
+	}
+    }
+    return cross;
+}
+
+static int out_cross(const mcwork_t * w, int a, int b)
+{
+    const mcsearch_t *s = w->s;
+    const mcedge_t *e1, *e2;
+    int inv, cross = 0, t;
+
+    for (e2 = s->outs + s->out[b]; e2 < s->outs + s->out[b + 1]; e2++) {
+	inv = w->pos[e2->node];
+	for (e1 = s->outs + s->out[a]; e1 < s->outs + s->out[a + 1]; e1++) {
+	    t = w->pos[e1->node] - inv;
+	    if (t > 0 || (t == 0 && e1->far_x > e2->far_x))
+		cross += e1->xpenalty * e2->xpenalty;
+	}
+    }
+    return cross;
+}
+
+static int transpose_step(mcwork_t * w, int r, bool reverse)
+{
+    const mcsearch_t *s = w->s;
+    int i, c0, c1, rv = 0;
+    int *vlist = RANKV(w, r);
+
+    w->candidate[r] = false;
+    for (i = 0; i < RANKSIZE(s, r) - 1; i++) {
+	int a = vlist[i], b = vlist[i + 1];
+	int in0 = in_cross(w, a, b), in1 = in_cross(w, b, a);
+	int out0 = out_cross(w, a, b), out1 = out_cross(w, b, a);
+	c0 = in0 + out0;
+	c1 = in1 + out1;
+	if (c1 < c0 || (c0 > 0 && c1 == c0 && tie(w, reverse))) {
+	    exchange(w, a, b);
+	    rv += c0 - c1;
+	    w->cache_nc[r] += out1 - out0;
+	    w->candidate[r] = true;
+	    if (r > 0) {
+		w->cache_nc[r - 1] += in1 - in0;
+		w->candidate[r - 1] = true;
+	    }
+	    if (r < s->nranks - 1)
+		w->candidate[r + 1] = true;
+	}
+    }
+    return rv;
+}
+
+static void transpose(mcwork_t * w, bool reverse)
+{
+    int r, delta;
+
+    for (r = 0; r < w->s->nranks; r++)
+	w->candidate[r] = true;
+    do {
+	delta = 0;
+	for (r = 0; r < w->s->nranks; r++)
+	    if (w->candidate[r])
+		delta += transpose_step(w, r, reverse);
+    } while (delta >= 1);
+}
+
+static int local_cross(const mcwork_t * w, const mcedge_t * l,
+		       const mcedge_t * end)
+{
+    const mcedge_t *e, *f;
+    int cross = 0;
+
+    for (e = l; e < end; e++)
+	for (f = e + 1; f < end; f++)
+	    if ((w->pos[f->node] - w->pos[e->node]) * (f->near_x - e->near_x)
+		< 0)
+		cross += e->xpenalty * f->xpenalty;
+    return cross;
+}
+
+/* rcross:
+ * As in mincross.c, with a Fenwick tree over the positions in rank r+1.
+ */
+static int rcross(mcwork_t * w, int r)
+{
+    const mcsearch_t *s = w->s;
+    const mcedge_t *e;
+    int top, bot, cross = 0, total = 0, below, i, k, v;
+    int nbot = RANKSIZE(s, r + 1);
+
+    for (i = 0; i <= nbot; i++)
+	w->count[i] = 0;
+
+    for (top = 0; top < RANKSIZE(s, r); top++) {
+	v = RANKV(w, r)[top];
+	for (e = s->outs + s->out[v]; e < s->outs + s->out[v + 1]; e++) {
+	    below = 0;
+	    for (k = w->pos[e->node] + 1; k > 0; k -= k & -k)
+		below += w->count[k];
+	    cross += (total - below) * e->xpenalty;
+	}
+	for (e = s->outs + s->out[v]; e < s->outs + s->out[v + 1]; e++) {
+	    for (k = w->pos[e->node] + 1; k <= nbot; k += k & -k)
+		w->count[k] += e->xpenalty;
+	    total += e->xpenalty;
+	}
+    }
+    for (top = 0; top < RANKSIZE(s, r); top++) {
+	v = RANKV(w, r)[top];
+	if (s->has_port[v])
+	    cross += local_cross(w, s->outs + s->out[v], s->outs + s->out[v + 1]);
+    }
+    for (bot = 0; bot < RANKSIZE(s, r + 1); bot++) {
+	v = RANKV(w, r + 1)[bot];
+	if (s->has_port[v])
+	    cross += local_cross(w, s->ins + s->in[v], s->ins + s->in[v + 1]);
+    }
+    return cross;
+}
+
+static int crossings(mcwork_t * w)
+{
+    int r, count = 0;
+
+    for (r = 0; r < w->s->nranks - 1; r++) {
+	if (!w->valid[r]) {
+	    w->cache_nc[r] = rcross(w, r);
+	    w->valid[r] = true;
+	}
+	count += w->cache_nc[r];
+    }
+    return count;
+}
+
+static int intcmpf(const void *x, const void *y)
+{
+    int a = *(const int *) x, b = *(const int *) y;
+    return (a > b) - (a < b);
+}
+
+/* medians:
+ * As in mincross.c. Nodes with no edges at all are fixed.
+ */
+static bool medians(mcwork_t * w, int r0, int r1)
+{
+    const mcsearch_t *s = w->s;
+    const mcedge_t *e, *l, *end;
+    int i, lspan, rspan, v, *list = w->list;
+    bool hasfixed = false;
+
+    for (i = 0; i < RANKSIZE(s, r0); i++) {
+	size_t j = 0;
+	v = RANKV(w, r0)[i];
+	if (r1 > r0) {
+	    l = s->outs + s->out[v];
+	    end = s->outs + s->out[v + 1];
+	} else {
+	    l = s->ins + s->in[v];
+	    end = s->ins + s->in[v + 1];
+	}
+	for (e = l; e < end; e++)
+	    if (e->xpenalty > 0)
+		list[j++] = MC_SCALE * w->pos[e->node] + e->port;
+	switch (j) {
+	case 0:
+	    w->mval[v] = -1;
+	    break;
+	case 1:
+	    w->mval[v] = list[0];
+	    break;
+	case 2:
+	    w->mval[v] = (list[0] + list[1]) / 2;
+	    break;
+	default:
+	    qsort(list, j, sizeof(int), intcmpf);
+	    if (j % 2)
+		w->mval[v] = list[j / 2];
+	    else {
+		/* weighted median */
+		size_t rm = j / 2;
+		size_t lm = rm - 1;
+		rspan = list[j - 1] - list[rm];
+		lspan = list[lm] - list[0];
+		if (lspan == rspan)
+		    w->mval[v] = (list[lm] + list[rm]) / 2;
+		else {
+		    double wt = list[lm] * (double)rspan + list[rm] * (double)lspan;
+		    w->mval[v] = wt / (lspan + rspan);
+		}
+	    }
+	}
+	if (s->out[v] == s->out[v + 1] && s->in[v] == s->in[v + 1])
+	    hasfixed = true;
+    }
+    return hasfixed;
+}
+
+static void reorder(mcwork_t * w, int r, bool reverse, bool hasfixed)
+{
+    int changed = 0, nelt;
+    int *vlist = RANKV(w, r);
+    int *lp, *rp, *ep = vlist + RANKSIZE(w->s, r);
+
+    for (nelt = RANKSIZE(w->s, r) - 1; nelt >= 0; nelt--) {
+	lp = vlist;
+	while (lp < ep) {
+	    /* find leftmost node that can be compared */
+	    while (lp < ep && w->mval[*lp] < 0)
+		lp++;
+	    if (lp >= ep)
+		break;
+	    /* find the node that can be compared */
+	    for (rp = lp + 1; rp < ep; rp++)
+		if (w->mval[*rp] >= 0)
+		    break;
+	    if (rp >= ep)
+		break;
+	    int p1 = w->mval[*lp];
+	    int p2 = w->mval[*rp];
+	    if (p1 > p2 || (p1 == p2 && tie(w, reverse))) {
+		exchange(w, *lp, *rp);
+		changed++;
+	    }
+	    lp = rp;
+	}
+	if (!hasfixed && !reverse)
+	    ep--;
+    }
+
+    if (changed) {
+	w->valid[r] = false;
+	if (r > 0)
+	    w->valid[r - 1] = false;
+    }
+}
+
+static void mincross_step(mcwork_t * w, int pass)
+{
+    int r, other, first, last, dir;
+    bool reverse = pass % 4 < 2;
+
+    if (pass % 2 == 0) {	/* down pass */
+	first = 1;
+	last = w->s->nranks - 1;
+	dir = 1;
+    } else {			/* up pass */
+	first = w->s->nranks - 2;
+	last = 0;
+	dir = -1;
+    }
+
+    for (r = first; r != last + dir; r += dir) {
+	other = r - dir;
+	bool hasfixed = medians(w, r, other);
+	reorder(w, r, reverse, hasfixed);
+    }
+    transpose(w, !reverse);
+}
+
+/* renumber:
+ * Set the positions of the nodes from the order in w->v.
+ */
+static void renumber(mcwork_t * w)
+{
+    const mcsearch_t *s = w->s;
+    int r, i;
+
+    for (r = 0; r < s->nranks; r++) {
+	for (i = 0; i < RANKSIZE(s, r); i++)
+	    w->pos[RANKV(w, r)[i]] = i;
+	w->valid[r] = false;
+    }
+}
+
+/* install:
+ * Make the order given as node indices, rank after rank, current.
+ */
+static void install(mcwork_t * w, const int *order)
+{
+    memcpy(w->v, order, (size_t)w->s->nnodes * sizeof(int));
+    renumber(w);
+}
+
+static void save_best(mcwork_t * w)
+{
+    memcpy(w->save, w->pos, (size_t)w->s->nnodes * sizeof(int));
+}
+
+static void restore_best(mcwork_t * w)
+{
+    const mcsearch_t *s = w->s;
+    int v, r;
+
+    for (v = 0; v < s->nnodes; v++) {
+	w->pos[v] = w->save[v];
+	RANKV(w, s->rank[v])[w->pos[v]] = v;
+    }
+    for (r = 0; r < s->nranks; r++)
+	w->valid[r] = false;
+}
+
+/* random_start:
+ * Build an order the way build_ranks does, by a breadth first search along
+ * out edges (pass 0) or in edges (pass 1), but taking the sources and the
+ * neighbors of each node in random order.
+ */
+static void random_start(mcwork_t * w, int pass)
+{
+    const mcsearch_t *s = w->s;
+    int n = s->nnodes, *order = gv_calloc((size_t)n, sizeof(int));
+    int *queue = gv_calloc((size_t)n, sizeof(int));
+    int *fill = gv_calloc((size_t)s->nranks, sizeof(int));
+    int *nbr = gv_calloc((size_t)s->maxdeg + 1, sizeof(int));
+    bool *mark = gv_calloc((size_t)n, sizeof(bool));
+    int i, j, k, v, head = 0, tail = 0;
+
+    for (i = 0; i < n; i++)
+	order[i] = i;
+    for (i = n - 1; i > 0; i--) {
+	j = (int)(next_random(w) % (uint64_t)(i + 1));
+	k = order[i];
+	order[i] = order[j];
+	order[j] = k;
+    }
+    for (i = 0; i < n; i++) {
+	const int *other = pass == 0 ? s->in : s->out;
+	v = order[i];
+	if (other[v] != other[v + 1] || mark[v])
+	    continue;
+	mark[v] = true;
+	queue[tail++] = v;
+	while (head < tail) {
+	    const mcedge_t *l, *end;
+	    int m = 0;
+	    v = queue[head++];
+	    RANKV(w, s->rank[v])[fill[s->rank[v]]++] = v;
+	    if (pass == 0) {
+		l = s->outs + s->out[v];
+		end = s->outs + s->out[v + 1];
+	    } else {
+		l = s->ins + s->in[v];
+		end = s->ins + s->in[v + 1];
+	    }
+	    for (; l < end; l++)
+		nbr[m++] = l->node;
+	    for (j = m - 1; j > 0; j--) {
+		k = (int)(next_random(w) % (uint64_t)(j + 1));
+		int t = nbr[j];
+		nbr[j] = nbr[k];
+		nbr[k] = t;
+	    }
+	    for (j = 0; j < m; j++)
+		if (!mark[nbr[j]]) {
+		    mark[nbr[j]] = true;
+		    queue[tail++] = nbr[j];
+		}
+	}
+    }
+    renumber(w);
+    if (crossings(w) > 0)
+	transpose(w, false);
+
+    free(order);
+    free(queue);
+    free(fill);
+    free(nbr);
+    free(mark);
+}
+
+/* iterate:
+ * One pass of mincross(): improve on the current order for up to maxpass
+ * iterations, keeping the best order seen.
+ */
+static int iterate(mcwork_t * w, int maxpass, int *best_cross)
+{
+    int iter, trying = 0, cur_cross = crossings(w);
+
+    for (iter = 0; iter < maxpass; iter++) {
+	if (trying++ >= w->minquit)
+	    break;
+	if (cur_cross == 0)
+	    break;
+	mincross_step(w, iter);
+	if ((cur_cross = crossings(w)) <= *best_cross) {
+	    save_best(w);
+	    if (cur_cross < w->convergence * *best_cross)
+		trying = 0;
+	    *best_cross = cur_cross;
+	}
+    }
+    return cur_cross;
+}
+
+/* search:
+ * Run start k, following the schedule of mincross() from startpass 0 to 2,
+ * with the initial orders of passes 0 and 1 chosen by k.
+ */
+static void search(mcwork_t * w, int k, int *cross, int *passmax)
+{
+    const mcsearch_t *s = w->s;
+    int pass, maxthispass = 0, cur_cross = INT_MAX, best_cross = INT_MAX;
+
+    w->random = k >= 2;
+    for (pass = 0; pass <= 2; pass++) {
+	if (pass <= 1) {
+	    if (k == 0)
+		install(w, s->start[pass]);
+	    else if (pass == 1)
+		continue;
+	    else if (k == 1)
+		install(w, s->start[1]);
+	    else
+		random_start(w, k % 2);
+	    maxthispass = MIN(4, w->maxiter);
+	    if ((cur_cross = crossings(w)) <= best_cross) {
+		save_best(w);
+		best_cross = cur_cross;
+	    }
+	} else {
+	    maxthispass = w->maxiter;
+	    if (cur_cross > best_cross)
+		restore_best(w);
+	    cur_cross = best_cross;
+	}
+	cur_cross = iterate(w, maxthispass, &best_cross);
+	if (cur_cross == 0)
+	    break;
+    }
+    if (cur_cross > best_cross)
+	restore_best(w);
+    *cross = best_cross;
+    *passmax = maxthispass;
+}
+
+typedef struct {
+    mcsearch_t **s;
+    int starts, minquit, maxiter;
+    double convergence;
+} mcjob_t;
+
+static void search_job(void *ctx, size_t index)
+{
+    const mcjob_t *job = ctx;
+    mcsearch_t *s = job->s[index / (size_t)job->starts];
+    int k = (int)(index % (size_t)job->starts);
+    int nranks = s->nranks, maxrank = 1;
+    mcwork_t w = {.s = s, .minquit = job->minquit, .maxiter = job->maxiter,
+	.convergence = job->convergence};
+    int r;
+
+    for (r = 0; r < nranks; r++)
+	maxrank = MAX(maxrank, RANKSIZE(s, r));
+    w.v = gv_calloc((size_t)s->nnodes, sizeof(int));
+    w.pos = s->pos + (size_t)k * (size_t)s->nnodes;
+    w.save = gv_calloc((size_t)s->nnodes, sizeof(int));
+    w.mval = gv_calloc((size_t)s->nnodes, sizeof(double));
+    w.valid = gv_calloc((size_t)nranks, sizeof(bool));
+    w.candidate = gv_calloc((size_t)nranks, sizeof(bool));
+    w.cache_nc = gv_calloc((size_t)nranks, sizeof(int));
+    w.count = gv_calloc((size_t)maxrank + 1, sizeof(int));
+    w.list = gv_calloc((size_t)s->maxdeg + 1, sizeof(int));
+    w.seed = UINT64_C(0x9E3779B97F4A7C15) * (uint64_t)(k + 1)
+	^ (uint64_t)s->index << 32 ^ 1;
+
+    search(&w, k, &s->cross[k], &s->passmax[k]);
+
+    free(w.v);
+    free(w.save);
+    free(w.mval);
+    free(w.valid);
+    free(w.candidate);
+    free(w.cache_nc);
+    free(w.count);
+    free(w.list);
+}
+
+/* mcsearch_run:
+ * Run starts searches on each of the n components in s, on up to nthreads
+ * threads.
+ */
+void mcsearch_run(mcsearch_t ** s, int n, int starts, int nthreads,
+		  int minquit, int maxiter, double convergence)
+{
+    mcjob_t job = {.s = s, .starts = starts, .minquit = minquit,
+	.maxiter = maxiter, .convergence = convergence};
+    int c;
+
+    for (c = 0; c < n; c++) {
+	s[c]->starts = starts;
+	s[c]->pos = gv_calloc((size_t)starts * (size_t)s[c]->nnodes,
+			      sizeof(int));
+	s[c]->cross = gv_calloc((size_t)starts, sizeof(int));
+	s[c]->passmax = gv_calloc((size_t)starts, sizeof(int));
+    }
+    gv_parallel_for((size_t)n * (size_t)starts, nthreads, search_job, &job);
+}
+
+/* mcsearch_install:
+ * Put the best order found for the component back into its part of g's
+ * rank arrays and make those g's current ranks. Returns the number of
+ * crossings, and the iteration limit of the last pass of the winning
+ * search in passmax.
+ */
+int mcsearch_install(mcsearch_t * s, graph_t * g, int *passmax)
+{
+    int k, best = 0, r, v;
+    const int *pos;
+
+    for (k = 1; k < s->starts; k++)
+	if (s->cross[k] < s->cross[best])
+	    best = k;
+    pos = s->pos + (size_t)best * (size_t)s->nnodes;
+    for (v = 0; v < s->nnodes; v++) {
+	s->slice[s->rank[v]][pos[v]] = s->node[v];
+	ND_order(s->node[v]) = pos[v];
+    }
+    for (r = 0; r < s->nranks; r++) {
+	GD_rank(g)[r + GD_minrank(g)].v = s->slice[r];
+	GD_rank(g)[r + GD_minrank(g)].n = RANKSIZE(s, r);
+	GD_rank(g)[r + GD_minrank(g)].valid = false;
+    }
+    *passmax = s->passmax[best];
+    return s->cross[best];
+}
@@ -17,9 +17,11 @@
  */
 
 #include <assert.h>
+#include <cgraph/alloc.h>
 #include <cgraph/cgraph.h>
 #include <cgraph/exit.h>
 #include <dotgen/dot.h>
+#include <float.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -43,6 +45,9 @@ static void init_mccomp(graph_t * g, int c);
 static void cleanup2(graph_t * g, int nc);
 static int mincross_clust(graph_t * g, int);
 static int mincross(graph_t * g, int startpass, int endpass, int);
+static int mincross_finish(graph_t * g, int best_cross, int maxthispass,
+			   int doBalance);
+static int mincross_starts(graph_t * g, int doBalance);
 static void mincross_step(graph_t * g, int pass);
 static void mincross_options(graph_t * g);
 static void save_best(graph_t * g);
@@ -73,6 +78,9 @@ static int GlobalMinRank, GlobalMaxRank;
 static edge_t **TE_list;
 static int *TI_list;
 static bool ReMincross;
+/* set for incremental layout */
+static Agsym_t *N_seedrank, *N_seedorder, *N_seedpos, *E_seedpos;
+static bool SeededOrder;	/* some ranks were ordered by seed_order */
 
 #if defined(DEBUG) && DEBUG > 1
 static void indent(graph_t* g)
@@ -358,9 +366,11 @@ void dot_mincross(graph_t * g, int doBalance)
 
     init_mincross(g);
 
-    for (nc = c = 0; c < GD_comp(g).size; c++) {
-	init_mccomp(g, c);
-	nc += mincross(g, 0, 2, doBalance);
+    if ((nc = mincross_starts(g, doBalance)) < 0) {
+	for (nc = c = 0; c < GD_comp(g).size; c++) {
+	    init_mccomp(g, c);
+	    nc += mincross(g, 0, 2, doBalance);
+	}
     }
 
     merge2(g);
@@ -754,9 +764,15 @@ static int balance(graph_t * g)
     return rv;
 }
 
+/* transpose_step:
+ * Swap adjacent nodes of rank r where that reduces crossings. A swap only
+ * changes the crossings between the edges of the two nodes, so the cached
+ * counts of the rank pairs above and below r are updated by the difference
+ * rather than recounted.
+ */
 static int transpose_step(graph_t * g, int r, bool reverse)
 {
-    int i, c0, c1, rv;
+    int i, c0, c1, in0, in1, out0, out1, rv;
     node_t *v, *w;
 
     rv = 0;
@@ -767,27 +783,35 @@ static int transpose_step(graph_t * g, int r, bool reverse)
 	assert(ND_order(v) < ND_order(w));
 	if (left2right(g, v, w))
 	    continue;
-	c0 = c1 = 0;
+	in0 = in1 = out0 = out1 = 0;
 	if (r > 0) {
-	    c0 += in_cross(v, w);
-	    c1 += in_cross(w, v);
+	    in0 = in_cross(v, w);
+	    in1 = in_cross(w, v);
 	}
 	if (GD_rank(g)[r + 1].n > 0) {
-	    c0 += out_cross(v, w);
-	    c1 += out_cross(w, v);
+	    out0 = out_cross(v, w);
+	    out1 = out_cross(w, v);
 	}
+	c0 = in0 + out0;
+	c1 = in1 + out1;
 	if (c1 < c0 || (c0 > 0 && reverse && c1 == c0)) {
 	    exchange(v, w);
 	    rv += c0 - c1;
-	    GD_rank(Root)[r].valid = false;
 	    GD_rank(g)[r].candidate = true;
+	    /* out_cross is skipped below the last rank of a cluster, but the
+	     * root's count still changes there
+	     */
+	    if (GD_rank(g)[r + 1].n > 0)
+		GD_rank(Root)[r].cache_nc += out1 - out0;
+	    else
+		GD_rank(Root)[r].valid = false;
+	    if (r > GD_minrank(Root))
+		GD_rank(Root)[r - 1].cache_nc += in1 - in0;
 
 	    if (r > GD_minrank(g)) {
-		GD_rank(Root)[r - 1].valid = false;
 		GD_rank(g)[r - 1].candidate = true;
 	    }
 	    if (r < GD_maxrank(g)) {
-		GD_rank(Root)[r + 1].valid = false;
 		GD_rank(g)[r + 1].candidate = true;
 	    }
 	}
@@ -822,10 +846,16 @@ static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
     } else
 	cur_cross = best_cross = INT_MAX;
     for (pass = startpass; pass <= endpass; pass++) {
+	/* a seeded order would only be rebuilt the same way */
+	if (pass == 1 && SeededOrder)
+	    continue;
 	if (pass <= 1) {
-	    maxthispass = MIN(4, MaxIter);
 	    if (g == dot_root(g))
 		build_ranks(g, pass);
+	    /* an order seeded by an earlier layout is only refined by the
+	     * transpose below, so that it keeps its shape
+	     */
+	    maxthispass = SeededOrder ? 0 : MIN(4, MaxIter);
 	    if (pass == 0)
 		flat_breakcycles(g);
 	    flat_reorder(g);
@@ -835,7 +865,7 @@ static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
 		best_cross = cur_cross;
 	    }
 	} else {
-	    maxthispass = MaxIter;
+	    maxthispass = SeededOrder ? 0 : MaxIter;
 	    if (cur_cross > best_cross)
 		restore_best(g);
 	    cur_cross = best_cross;
@@ -863,6 +893,18 @@ static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
     }
     if (cur_cross > best_cross)
 	restore_best(g);
+    return mincross_finish(g, best_cross, maxthispass, doBalance);
+}
+
+/* mincross_finish:
+ * Polish the best order found by a search: a final transpose, and
+ * balancing if asked for.
+ */
+static int mincross_finish(graph_t * g, int best_cross, int maxthispass,
+			   int doBalance)
+{
+    int iter;
+
     if (best_cross > 0) {
 	transpose(g, FALSE);
 	best_cross = ncross(g);
@@ -875,6 +917,54 @@ static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
     return best_cross;
 }
 
+/* mincross_starts:
+ * If the mcstarts attribute asks for more than one search, order every
+ * component of g by running that many independent searches on it, on up
+ * to threads threads, and keeping the best order found for each. See
+ * mcsearch.c. Graphs with clusters, flat edges or a seeded order need the
+ * full machinery of mincross(); for these, and when only one search is
+ * asked for, -1 is returned and nothing is done.
+ */
+static int mincross_starts(graph_t * g, int doBalance)
+{
+    int starts = 1, nthreads = 1, ncomp = GD_comp(g).size;
+    int c, nc, passmax;
+    mcsearch_t **comps;
+    char *s;
+
+    if ((s = agget(g, "mcstarts")))
+	starts = atoi(s);
+    if ((s = agget(g, "threads")))
+	nthreads = atoi(s);
+    if (starts <= 1 || GD_n_cluster(g) > 0 || GD_has_flat_edges(g)
+	|| N_seedrank)
+	return -1;
+
+    /* the initial orders come from the serial code, one component at a
+     * time, since they need the shared rank arrays
+     */
+    comps = gv_calloc((size_t)ncomp, sizeof(mcsearch_t *));
+    for (c = 0; c < ncomp; c++) {
+	init_mccomp(g, c);
+	build_ranks(g, 0);
+	comps[c] = mcsearch_new(g, c);
+	build_ranks(g, 1);
+	mcsearch_start(comps[c], g);
+    }
+
+    mcsearch_run(comps, ncomp, starts, nthreads, MinQuit, MaxIter,
+		 Convergence);
+
+    for (nc = c = 0; c < ncomp; c++) {
+	GD_nlist(g) = GD_comp(g).list[c];
+	int cross = mcsearch_install(comps[c], g, &passmax);
+	nc += mincross_finish(g, cross, passmax, doBalance);
+	mcsearch_free(comps[c]);
+    }
+    free(comps);
+    return nc;
+}
+
 static void restore_best(graph_t * g)
 {
     node_t *n;
@@ -1165,6 +1255,14 @@ static void init_mincross(graph_t * g)
 
     ReMincross = false;
     Root = g;
+    N_seedrank = N_seedorder = N_seedpos = E_seedpos = NULL;
+    SeededOrder = false;
+    if (mapbool(agget(g, "incremental"))
+	&& (N_seedrank = agattr(agroot(g), AGNODE, "rank", NULL))) {
+	N_seedorder = agattr(agroot(g), AGNODE, "order", NULL);
+	N_seedpos = agattr(agroot(g), AGNODE, "pos", NULL);
+	E_seedpos = agattr(agroot(g), AGEDGE, "pos", NULL);
+    }
     /* alloc +1 for the null terminator usage in do_ordering() */
     size = agnedges(dot_root(g)) + 1;
     TE_list = N_NEW(size, edge_t *);
@@ -1349,6 +1447,205 @@ void install_in_rank(graph_t * g, node_t * n)
     }
 }
 
+static int seedcmpf(node_t ** n0, node_t ** n1)
+{
+  if (ND_mval(*n0) < ND_mval(*n1)) {
+    return -1;
+  }
+  if (ND_mval(*n0) > ND_mval(*n1)) {
+    return 1;
+  }
+  return nodeposcmpf(n0, n1);
+}
+
+/* prior_key:
+ * Where an earlier layout put real node v within its rank, if v is still on
+ * the rank it had then. Positions come from pos, undoing the rotation for
+ * rankdir, or failing that, unless xonly, from order.
+ */
+static bool prior_key(node_t * v, bool xonly, double *key)
+{
+    int rk, ord;
+    pointf p;
+
+    if (!N_seedrank || ND_node_type(v) != NORMAL
+	|| !agxgetint(v, N_seedrank, &rk) || rk != ND_rank(v))
+	return false;
+    if (N_seedpos && agxgetpoint(v, N_seedpos, &p.x, &p.y)) {
+	*key = cwrotatepf(p, 90 * GD_rankdir(Root)).x;
+	return true;
+    }
+    if (!xonly && N_seedorder && agxgetint(v, N_seedorder, &ord) && ord >= 0) {
+	*key = ord;
+	return true;
+    }
+    return false;
+}
+
+/* rank_y:
+ * The y coordinate an earlier layout gave rank r, if it placed any real
+ * node that is still on r.
+ */
+static bool rank_y(int r, double *y)
+{
+    rank_t *rk = &GD_rank(Root)[r];
+    node_t *v;
+    pointf p;
+    int i, rnk;
+
+    for (i = 0; i < rk->n; i++) {
+	v = rk->v[i];
+	if (ND_node_type(v) == NORMAL && agxgetint(v, N_seedrank, &rnk)
+	    && rnk == r && agxgetpoint(v, N_seedpos, &p.x, &p.y)) {
+	    *y = cwrotatepf(p, 90 * GD_rankdir(Root)).y;
+	    return true;
+	}
+    }
+    return false;
+}
+
+/* spline_x:
+ * Where the control polygon of the spline an earlier layout drew for e
+ * crosses y. Arrowhead endpoints are skipped.
+ */
+static bool spline_x(edge_t * e, double y, double *x)
+{
+    char *s = agxget(e, E_seedpos);
+    bool arrow, have = false;
+    pointf p, q = {0};
+    int n;
+
+    for (;;) {
+	while (*s == ' ' || *s == ';' || *s == '\n')
+	    s++;
+	if (*s == '\0')
+	    return false;
+	arrow = (*s == 'e' || *s == 's') && s[1] == ',';
+	if (arrow)
+	    s += 2;
+	if (sscanf(s, "%lf,%lf%n", &p.x, &p.y, &n) != 2)
+	    return false;
+	s += n;
+	if (arrow)
+	    continue;
+	p = cwrotatepf(p, 90 * GD_rankdir(Root));
+	if (have && p.y != q.y && (q.y - y) * (p.y - y) <= 0) {
+	    *x = q.x + (p.x - q.x) * (y - q.y) / (p.y - q.y);
+	    return true;
+	}
+	q = p;
+	have = true;
+    }
+}
+
+/* chain_key:
+ * Key for a virtual node v on a chain of virtual nodes. If the edge was
+ * drawn before, this is where its spline crossed the rank of v; otherwise
+ * it is interpolated between the keys of the real nodes at the chain's
+ * ends.
+ */
+static bool chain_key(node_t * v, bool xonly, double *key)
+{
+    node_t *t = v, *h = v;
+    edge_t *e;
+    double kt, kh, y;
+
+    if (E_seedpos && N_seedpos && (e = ND_out(v).list[0])) {
+	while (e && ED_edge_type(e) != NORMAL)
+	    e = ED_to_orig(e);
+	if (e && rank_y(ND_rank(v), &y) && spline_x(e, y, key))
+	    return true;
+    }
+    while (ND_node_type(t) == VIRTUAL && ND_in(t).size == 1)
+	t = agtail(ND_in(t).list[0]);
+    while (ND_node_type(h) == VIRTUAL && ND_out(h).size == 1)
+	h = aghead(ND_out(h).list[0]);
+    if (t == v || h == v || !prior_key(t, xonly, &kt)
+	|| !prior_key(h, xonly, &kh))
+	return false;
+    *key = kt + (kh - kt) * (ND_rank(v) - ND_rank(t))
+	/ (ND_rank(h) - ND_rank(t));
+    return true;
+}
+
+/* dot_prior_x:
+ * For incremental layout, the x coordinate an earlier layout gave v, with
+ * the virtual nodes of an edge spaced evenly between its ends. Only valid
+ * between dot_mincross and the end of the layout.
+ */
+bool dot_prior_x(node_t * v, double *x)
+{
+    if (ND_node_type(v) == NORMAL)
+	return prior_key(v, true, x);
+    return chain_key(v, true, x);
+}
+
+/* above_key:
+ * The mean key of the neighbors of v on the rank above it in g.
+ */
+static bool above_key(graph_t * g, node_t * v, double *key)
+{
+    rank_t *up = &GD_rank(g)[ND_rank(v) - 1];
+    double sum = 0;
+    int i, cnt = 0;
+    node_t *t;
+    edge_t *e;
+
+    for (i = 0; (e = ND_in(v).list[i]); i++) {
+	t = agtail(e);
+	if (ND_order(t) < up->n && up->v[ND_order(t)] == t
+	    && ND_mval(t) > -DBL_MAX) {
+	    sum += ND_mval(t);
+	    cnt++;
+	}
+    }
+    if (cnt == 0)
+	return false;
+    *key = sum / cnt;
+    return true;
+}
+
+/* seed_order:
+ * For incremental layout, reorder the nodes just installed in the ranks of g
+ * to follow an earlier layout. A real node that kept its rank sorts by where
+ * it was, and a virtual node of an edge between two such nodes by
+ * interpolating between them. Any other node goes below its neighbors on
+ * the rank above, or failing that just after the node to its left. Returns
+ * false, leaving the ranks alone, if no node was placed before.
+ */
+static bool seed_order(graph_t * g)
+{
+    int r, i;
+    bool found = false;
+    double key, k;
+    node_t *v;
+
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	key = -DBL_MAX;
+	for (i = 0; i < GD_rank(g)[r].n; i++) {
+	    v = GD_rank(g)[r].v[i];
+	    if (prior_key(v, false, &k)) {
+		key = k;
+		found = true;
+	    } else if (ND_node_type(v) == VIRTUAL && chain_key(v, false, &k))
+		key = k;
+	    else if (r > GD_minrank(g) && above_key(g, v, &k))
+		key = k;
+	    ND_mval(v) = key;
+	}
+    }
+    if (!found)
+	return false;
+
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	qsort(GD_rank(g)[r].v, GD_rank(g)[r].n, sizeof(GD_rank(g)[0].v[0]),
+	      (qsort_cmpf) seedcmpf);
+	for (i = 0; i < GD_rank(g)[r].n; i++)
+	    ND_order(GD_rank(g)[r].v[i]) = i;
+    }
+    return true;
+}
+
 /*	install nodes in ranks. the initial ordering ensure that series-parallel
  *	graphs such as trees are drawn with no crossings.  it tries searching
  *	in- and out-edges and takes the better of the two initial orderings.
@@ -1359,6 +1656,7 @@ void build_ranks(graph_t * g, int pass)
     node_t *n, *n0;
     edge_t **otheredges;
     nodequeue *q;
+    bool seeded;
 
     q = new_queue(GD_n_nodes(g));
     for (n = GD_nlist(g); n; n = ND_next(n))
@@ -1398,9 +1696,12 @@ void build_ranks(graph_t * g, int pass)
     }
     if (dequeue(q))
 	agerr(AGERR, "surprise\n");
+    /* a seeded order already has any flip applied */
+    seeded = N_seedrank && seed_order(g);
+    SeededOrder |= seeded;
     for (i = GD_minrank(g); i <= GD_maxrank(g); i++) {
 	GD_rank(Root)[i].valid = false;
-	if (GD_flip(g) && GD_rank(g)[i].n > 0) {
+	if (GD_flip(g) && !seeded && GD_rank(g)[i].n > 0) {
 	    node_t **vlist = GD_rank(g)[i].v;
 	    int num_nodes_1 = GD_rank(g)[i].n - 1;
 	    int half_num_nodes_1 = num_nodes_1 / 2;
@@ -1655,37 +1956,45 @@ static int local_cross(elist l, int dir)
     return cross;
 }
 
+/* rcross:
+ * Count the crossings between ranks r and r+1, each weighted by the product
+ * of the edges' xpenalty. The edges are visited in the order of their tails,
+ * and a Fenwick tree over the head positions accumulates the weight of the
+ * edges seen so far, so each edge finds the weight of those it crosses in
+ * O(log n).
+ */
 static int rcross(graph_t * g, int r)
 {
     static int *Count, C;
-    int top, bot, cross, max, i, k;
+    int top, bot, cross, total, nbot, i, k, below;
     node_t **rtop, *v;
 
     cross = 0;
-    max = 0;
+    total = 0;
     rtop = GD_rank(g)[r].v;
+    nbot = GD_rank(g)[r + 1].n;
 
     if (C <= GD_rank(Root)[r + 1].n) {
 	C = GD_rank(Root)[r + 1].n + 1;
 	Count = ALLOC(C, Count, int);
     }
 
-    for (i = 0; i < GD_rank(g)[r + 1].n; i++)
+    for (i = 0; i <= nbot; i++)
 	Count[i] = 0;
 
     for (top = 0; top < GD_rank(g)[r].n; top++) {
 	edge_t *e;
-	if (max > 0) {
-	    for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
-		for (k = ND_order(aghead(e)) + 1; k <= max; k++)
-		    cross += Count[k] * ED_xpenalty(e);
-	    }
+	/* edges with a common tail do not cross here; see local_cross */
+	for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
+	    below = 0;
+	    for (k = ND_order(aghead(e)) + 1; k > 0; k -= k & -k)
+		below += Count[k];
+	    cross += (total - below) * ED_xpenalty(e);
 	}
 	for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
-	    int inv = ND_order(aghead(e));
-	    if (inv > max)
-		max = inv;
-	    Count[inv] += ED_xpenalty(e);
+	    for (k = ND_order(aghead(e)) + 1; k <= nbot; k += k & -k)
+		Count[k] += ED_xpenalty(e);
+	    total += ED_xpenalty(e);
 	}
     }
     for (top = 0; top < GD_rank(g)[r].n; top++) {
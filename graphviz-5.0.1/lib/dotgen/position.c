@@ -19,10 +19,14 @@
 
 #include <dotgen/dot.h>
 #include <dotgen/aspect.h>
+#include <float.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 static int nsiter2(graph_t * g);
-static void create_aux_edges(graph_t * g);
+static void create_aux_edges(graph_t * g, double **seed, bool pairs);
+static void free_seed(graph_t * g, double **seed);
+static void make_edge_pairs(graph_t * g);
 static void remove_aux_edges(graph_t * g);
 static void set_xcoords(graph_t * g);
 static void set_ycoords(graph_t * g);
@@ -115,8 +119,55 @@ connectGraph (graph_t* g)
     }
 }
 
+/* seed_xcoords:
+ * For incremental layout, the x coordinates an earlier layout gave the nodes
+ * of g, by rank and order, shifted to start at 0. Nodes it did not place get
+ * -1. Returns NULL if there is no earlier layout to start from.
+ */
+static double **seed_xcoords(graph_t * g)
+{
+    double **seed;
+    double x, minx = DBL_MAX;
+    int r, i;
+
+    if (!mapbool(agget(g, "incremental")))
+	return NULL;
+    seed = N_NEW(GD_maxrank(g) + 1, double *);
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	seed[r] = N_NEW(GD_rank(g)[r].n + 1, double);
+	for (i = 0; i < GD_rank(g)[r].n; i++) {
+	    if (dot_prior_x(GD_rank(g)[r].v[i], &x)) {
+		seed[r][i] = x;
+		minx = MIN(minx, x);
+	    } else
+		seed[r][i] = -DBL_MAX;
+	}
+    }
+    if (minx == DBL_MAX) {
+	free_seed(g, seed);
+	return NULL;
+    }
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
+	for (i = 0; i < GD_rank(g)[r].n; i++)
+	    seed[r][i] = seed[r][i] == -DBL_MAX ? -1 : seed[r][i] - minx;
+    return seed;
+}
+
+static void free_seed(graph_t * g, double **seed)
+{
+    int r;
+
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
+	free(seed[r]);
+    free(seed);
+}
+
 void dot_position(graph_t * g, aspect_t* asp)
 {
+    double **seed;
+    bool bk;
+    char *s;
+
     if (GD_nlist(g) == NULL)
 	return;			/* ignore empty graph */
     mark_lowclusters(g);	/* we could remove from splines.c now */
@@ -126,8 +177,34 @@ void dot_position(graph_t * g, aspect_t* asp)
     expand_leaves(g);
     if (flat_edges(g))
 	set_ycoords(g);
-    create_aux_edges(g);
-    if (rank(g, 2, nsiter2(g))) { /* LR balance == 2 */
+    seed = seed_xcoords(g);
+    /* Brandes-Köpf has no use for the edge pairs, which only steer
+     * network simplex
+     */
+    bk = !seed && (s = agget(g, "xalgo")) && streq(s, "bk");
+    create_aux_edges(g, seed, !bk);
+    if (bk && !dot_bk_position(g)) {
+	if (Verbose)
+	    fprintf(stderr, "xalgo=bk: constraints not met, "
+		    "using network simplex\n");
+	make_edge_pairs(g);
+	bk = false;
+    }
+    if (bk) {
+	/* the coordinates are already set */
+    } else if (seed) {
+	nsparams_t params = {.balance = 2, .maxiter = nsiter2(g),
+			     .search_size = -1, .verbose = Verbose,
+			     .seeded = true};
+	if ((s = agget(g, "searchsize")))
+	    params.search_size = atoi(s);
+	if (rank3(g, &params)) {
+	    connectGraph (g);
+	    const int rank_result = rank3(g, &params);
+	    assert(rank_result == 0);
+	}
+	free_seed(g, seed);
+    } else if (rank(g, 2, nsiter2(g))) { /* LR balance == 2 */
 	connectGraph (g);
 	const int rank_result = rank(g, 2, nsiter2(g));
 	assert(rank_result == 0);
@@ -206,9 +283,12 @@ static void allocate_aux_edges(graph_t * g)
 }
 
 /* make_LR_constraints:
+ * If seed is not NULL, it holds, by rank and order, where an earlier layout
+ * put each node; nodes start there rather than packed to the left when that
+ * leaves room for the nodes before them.
  */
 static void 
-make_LR_constraints(graph_t * g)
+make_LR_constraints(graph_t * g, double **seed)
 {
     int i, j, k;
     int m0, m1;
@@ -231,6 +311,8 @@ make_LR_constraints(graph_t * g)
     for (i = GD_minrank(g); i <= GD_maxrank(g); i++) {
 	double last;
 	last = ND_rank(rank[i].v[0]) = 0;
+	if (seed && seed[i][0] > 0)
+	    last = ND_rank(rank[i].v[0]) = ROUND(seed[i][0]);
 	nodesep = sep[i & 1];
 	for (j = 0; j < rank[i].n; j++) {
 	    u = rank[i].v[j];
@@ -257,6 +339,8 @@ make_LR_constraints(graph_t * g)
 		width = ND_rw(u) + ND_lw(v) + nodesep;
 		e0 = make_aux_edge(u, v, width, 0);
 		last = (ND_rank(v) = last + width);
+		if (seed && seed[i][j + 1] > last)
+		    last = (ND_rank(v) = ROUND(seed[i][j + 1]));
 	    }
 
 	    /* constraints from labels of flat edges on previous rank */
@@ -525,11 +609,12 @@ static void compress_graph(graph_t * g)
     make_aux_edge(GD_ln(g), GD_rn(g), x, 1000);
 }
 
-static void create_aux_edges(graph_t * g)
+static void create_aux_edges(graph_t * g, double **seed, bool pairs)
 {
     allocate_aux_edges(g);
-    make_LR_constraints(g);
-    make_edge_pairs(g);
+    make_LR_constraints(g, seed);
+    if (pairs)
+	make_edge_pairs(g);
     pos_clusters(g);
     compress_graph(g);
 }
@@ -23,6 +23,7 @@
  *  watch out for interactions between leaves and clusters.
  */
 
+#include	<cgraph/parallel.h>
 #include	<dotgen/dot.h>
 #include	<limits.h>
 #include	<stdbool.h>
@@ -366,18 +367,156 @@ minmax_edges2(graph_t * g, point slen)
     return (e != 0);
 }
 
-/* Run the network simplex algorithm on each component. */
+typedef struct {
+    graph_t *g;
+    nsparams_t params;
+} rank1_job_t;
+
+/* rank1_comp:
+ * Rank component c of g. Components share no nodes or edges, so
+ * different components can be ranked concurrently.
+ */
+static void rank1_comp(void *ctx, size_t c)
+{
+    rank1_job_t *job = ctx;
+    nsparams_t params = job->params;
+
+    params.nlist = GD_comp(job->g).list[c];
+    rank3(job->g, &params);
+}
+
+/* seed_ranks:
+ * If g asks for incremental layout, start each node of g being ranked
+ * from the rank recorded by an earlier layout in its rank attribute, and
+ * every other node from rank 0. Returns the rank attribute if g was seeded.
+ */
+static Agsym_t *seed_ranks(graph_t * g)
+{
+    Agsym_t *N_rank;
+    node_t *n;
+    int c, r;
+
+    if (!mapbool(agget(g, "incremental")))
+	return NULL;
+    if (!(N_rank = agattr(agroot(g), AGNODE, "rank", NULL)))
+	return NULL;
+    for (c = 0; c < GD_comp(g).size; c++) {
+	for (n = GD_comp(g).list[c]; n; n = ND_next(n)) {
+	    if (ND_node_type(n) == NORMAL && agxgetint(n, N_rank, &r) && r >= 0)
+		ND_rank(n) = r;
+	    else
+		ND_rank(n) = 0;
+	}
+    }
+    return N_rank;
+}
+
+static int intcmpf(const void *x, const void *y)
+{
+    const int *a = x, *b = y;
+    return (*a > *b) - (*a < *b);
+}
+
+/* keep_seed_ranks:
+ * Nodes whose in- and out-edges weigh the same can sit anywhere between
+ * their neighbors at no cost, so network simplex and balancing may move
+ * them away from their seeds even when nothing near them changed. Put
+ * each such node of the component nlist back on its seed rank, allowing
+ * for the whole component having shifted, when its edges still allow it.
+ */
+static void keep_seed_ranks(node_t * nlist, Agsym_t * N_rank)
+{
+    node_t *n;
+    edge_t *e;
+    int i, cnt = 0, nseed = 0, shift = 0, best = 0, maxrank = 0;
+    int r, low, high, inweight, outweight;
+    int *diff;
+
+    for (n = nlist; n; n = ND_next(n)) {
+	nseed++;
+	maxrank = MAX(maxrank, ND_rank(n));
+    }
+    diff = N_NEW(nseed, int);
+    nseed = 0;
+    for (n = nlist; n; n = ND_next(n))
+	if (ND_node_type(n) == NORMAL && agxgetint(n, N_rank, &r) && r >= 0)
+	    diff[nseed++] = ND_rank(n) - r;
+    /* the shift is the most common difference from the seeds */
+    qsort(diff, nseed, sizeof(diff[0]), intcmpf);
+    for (i = 0; i < nseed; i++) {
+	cnt = i > 0 && diff[i] == diff[i - 1] ? cnt + 1 : 1;
+	if (cnt > best) {
+	    best = cnt;
+	    shift = diff[i];
+	}
+    }
+    free(diff);
+
+    for (n = nlist; n; n = ND_next(n)) {
+	if (ND_node_type(n) != NORMAL || !agxgetint(n, N_rank, &r) || r < 0)
+	    continue;
+	inweight = outweight = 0;
+	low = 0;
+	high = maxrank;
+	for (i = 0; (e = ND_in(n).list[i]); i++) {
+	    inweight += ED_weight(e);
+	    low = MAX(low, ND_rank(agtail(e)) + ED_minlen(e));
+	}
+	for (i = 0; (e = ND_out(n).list[i]); i++) {
+	    outweight += ED_weight(e);
+	    high = MIN(high, ND_rank(aghead(e)) - ED_minlen(e));
+	}
+	if (inweight == outweight && low <= r + shift && r + shift <= high)
+	    ND_rank(n) = r + shift;
+    }
+}
+
+/* Run the network simplex algorithm on each component.
+ * If the threads attribute asks for more than one thread, the
+ * components are ranked in parallel.
+ */
 void rank1(graph_t * g)
 {
     int maxiter = INT_MAX;
+    int nthreads = 1;
+    Agsym_t *N_rank = seed_ranks(g);
     int c;
     char *s;
 
     if ((s = agget(g, "nslimit1")))
 	maxiter = atof(s) * agnnodes(g);
+    if ((s = agget(g, "threads")))
+	nthreads = atoi(s);
+    if (nthreads > 1 && GD_comp(g).size > 1) {
+	/* attribute lookups are not safe to make concurrently, so
+	 * resolve everything the solver would look up here
+	 */
+	rank1_job_t job = {.g = g};
+	job.params.balance = GD_n_cluster(g) == 0 ? 1 : 0;	/* TB balance */
+	job.params.maxiter = maxiter;
+	job.params.search_size = (s = agget(g, "searchsize")) ? atoi(s) : -1;
+	job.params.tbbalance = (s = agget(g, "TBbalance")) ? s : "";
+	job.params.seeded = N_rank != NULL;
+	gv_parallel_for((size_t)GD_comp(g).size, nthreads, rank1_comp, &job);
+	if (N_rank)
+	    for (c = 0; c < GD_comp(g).size; c++)
+		keep_seed_ranks(GD_comp(g).list[c], N_rank);
+	/* leave the node list where the serial loop would */
+	GD_nlist(g) = GD_comp(g).list[GD_comp(g).size - 1];
+	return;
+    }
     for (c = 0; c < GD_comp(g).size; c++) {
 	GD_nlist(g) = GD_comp(g).list[c];
-	rank(g, (GD_n_cluster(g) == 0 ? 1 : 0), maxiter);	/* TB balance */
+	if (N_rank) {
+	    nsparams_t params = {.balance = GD_n_cluster(g) == 0 ? 1 : 0,
+				 .maxiter = maxiter, .search_size = -1,
+				 .verbose = Verbose, .seeded = true};
+	    if ((s = agget(g, "searchsize")))
+		params.search_size = atoi(s);
+	    rank3(g, &params);
+	    keep_seed_ranks(GD_nlist(g), N_rank);
+	} else
+	    rank(g, (GD_n_cluster(g) == 0 ? 1 : 0), maxiter);	/* TB balance */
     }
 }
 
@@ -479,7 +618,7 @@ static void dot1_rank(graph_t * g, aspect_t* asp)
 #endif
 
     if (asp)
-	rank3(g, asp);
+	aspect_rank(g, asp);
     else
 	rank1(g);
 
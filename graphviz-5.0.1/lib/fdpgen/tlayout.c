@@ -32,6 +32,7 @@
 #endif
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #ifndef _WIN32
 #include <unistd.h>
@@ -47,6 +48,8 @@
 
 #include <fdpgen/tlayout.h>
 #include <common/globals.h>
+#include <sparse/force_kernels.h>
+#include <stdbool.h>
 
 #define D_useGrid   (fdp_parms->useGrid)
 #define D_useNew    (fdp_parms->useNew)
@@ -214,8 +217,14 @@ void fdp_initParams(graph_t * g)
 #endif
 }
 
+/* doRep:
+ * Apply the repulsion between nodes p and q, with displacements
+ * (*pdx,*pdy) and (*qdx,*qdy), q being at (xdelta,ydelta) from p.
+ * ports is true if both are ports.
+ */
 static void
-doRep(node_t * p, node_t * q, double xdelta, double ydelta, double dist2)
+doRep(double *pdx, double *pdy, double *qdx, double *qdy, bool ports,
+      double xdelta, double ydelta, double dist2)
 {
     double force;
     double dist;
@@ -230,12 +239,12 @@ doRep(node_t * p, node_t * q, double xdelta, double ydelta, double dist2)
 	force = T_K2 / (dist * dist2);
     } else
 	force = T_K2 / dist2;
-    if (IS_PORT(p) && IS_PORT(q))
+    if (ports)
 	force *= 10.0;
-    DISP(q)[0] += xdelta * force;
-    DISP(q)[1] += ydelta * force;
-    DISP(p)[0] -= xdelta * force;
-    DISP(p)[1] -= ydelta * force;
+    *qdx += xdelta * force;
+    *qdy += ydelta * force;
+    *pdx -= xdelta * force;
+    *pdy -= ydelta * force;
 }
 
 /* applyRep:
@@ -248,17 +257,106 @@ static void applyRep(Agnode_t * p, Agnode_t * q)
 
     xdelta = ND_pos(q)[0] - ND_pos(p)[0];
     ydelta = ND_pos(q)[1] - ND_pos(p)[1];
-    doRep(p, q, xdelta, ydelta, xdelta * xdelta + ydelta * ydelta);
+    doRep(&DISP(p)[0], &DISP(p)[1], &DISP(q)[0], &DISP(q)[1],
+	  IS_PORT(p) && IS_PORT(q), xdelta, ydelta,
+	  xdelta * xdelta + ydelta * ydelta);
 }
 
-static void doNeighbor(Grid * grid, int i, int j, node_list * nodes)
+/* The nodes of grid cells, with their positions, displacements and
+ * port flags in the arrays force_fdp_repulse works on.
+ */
+typedef struct {
+    force_block b;
+    Agnode_t **nodes;
+    int size;
+} cellblock;
+
+/* The cell whose repulsions are applied, and the nodes of its neighbors,
+ * one cell after the other. Each node of the cell meets those of all its
+ * neighbors in a single pass, as it does those of each neighbor in turn
+ * in the plain loops. Coincident nodes are always in the same cell, so
+ * the random moves apart happen in the same order too.
+ */
+static cellblock cellA, cellB;
+
+static void freeBlock(cellblock * cb)
+{
+    free(cb->nodes);
+    free(cb->b.x);
+    free(cb->b.y);
+    free(cb->b.dx);
+    free(cb->b.dy);
+    free(cb->b.port);
+    memset(cb, 0, sizeof(cellblock));
+}
+
+/* addBlock:
+ * Append the nodes of a cell to cb.
+ */
+static void addBlock(cellblock * cb, node_list * nodes)
+{
+    node_list *l;
+    Agnode_t *n;
+    int i = cb->b.n;
+
+    for (l = nodes; l; l = l->next)
+	i++;
+    if (i > cb->size) {
+	cb->size = MAX(i, 2 * cb->size);
+	cb->nodes = RALLOC(cb->size, cb->nodes, Agnode_t *);
+	cb->b.x = RALLOC(cb->size, cb->b.x, double);
+	cb->b.y = RALLOC(cb->size, cb->b.y, double);
+	cb->b.dx = RALLOC(cb->size, cb->b.dx, double);
+	cb->b.dy = RALLOC(cb->size, cb->b.dy, double);
+	cb->b.port = RALLOC(cb->size, cb->b.port, unsigned char);
+    }
+    for (i = cb->b.n, l = nodes; l; l = l->next, i++) {
+	n = l->node;
+	cb->nodes[i] = n;
+	cb->b.x[i] = ND_pos(n)[0];
+	cb->b.y[i] = ND_pos(n)[1];
+	cb->b.dx[i] = DISP(n)[0];
+	cb->b.dy[i] = DISP(n)[1];
+	cb->b.port[i] = IS_PORT(n);
+    }
+    cb->b.n = i;
+}
+
+/* storeBlock:
+ * Copy the displacements in cb back to its nodes.
+ */
+static void storeBlock(cellblock * cb)
+{
+    int i;
+
+    for (i = 0; i < cb->b.n; i++) {
+	DISP(cb->nodes[i])[0] = cb->b.dx[i];
+	DISP(cb->nodes[i])[1] = cb->b.dy[i];
+    }
+}
+
+/* blockRep:
+ * Apply the repulsion between node i of a and the nodes of b, other than
+ * i if a == b, closer than sqrt(cutoff2), in order. The kernel leaves
+ * coincident nodes to doRep, which moves them apart at random.
+ */
+static void blockRep(force_block * a, int i, force_block * b, double cutoff2)
+{
+    int j = 0;
+
+    while ((j = force_fdp_repulse(a, i, b, j, T_K2, cutoff2, T_useNew)) < b->n) {
+	doRep(&a->dx[i], &a->dy[i], &b->dx[j], &b->dy[j],
+	      a->port[i] && b->port[j], 0, 0, 0);
+	j++;
+    }
+}
+
+/* doNeighbor:
+ * Add the nodes of cell (i,j), if any, to the neighbors in cellB.
+ */
+static void doNeighbor(Grid * grid, int i, int j)
 {
     cell *cellp = findGrid(grid, i, j);
-    node_list *qs;
-    Agnode_t *p;
-    Agnode_t *q;
-    double xdelta, ydelta;
-    double dist2;
 
     if (cellp) {
 #ifdef DEBUG
@@ -268,27 +366,15 @@ static void doNeighbor(Grid * grid, int i, int j, node_list * nodes)
 		    gLength(cellp));
 	}
 #endif
-	for (; nodes != 0; nodes = nodes->next) {
-	    p = nodes->node;
-	    for (qs = cellp->nodes; qs != 0; qs = qs->next) {
-		q = qs->node;
-		xdelta = (ND_pos(q))[0] - (ND_pos(p))[0];
-		ydelta = (ND_pos(q))[1] - (ND_pos(p))[1];
-		dist2 = xdelta * xdelta + ydelta * ydelta;
-		if (dist2 < T_Cell2)
-		    doRep(p, q, xdelta, ydelta, dist2);
-	    }
-	}
+	addBlock(&cellB, cellp->nodes);
     }
 }
 
 static int gridRepulse(Dt_t * dt, cell * cellp, Grid * grid)
 {
-    node_list *nodes = cellp->nodes;
     int i = cellp->p.i;
     int j = cellp->p.j;
-    node_list *p;
-    node_list *q;
+    int k;
 
     (void)dt;
 #ifdef DEBUG
@@ -298,21 +384,25 @@ static int gridRepulse(Dt_t * dt, cell * cellp, Grid * grid)
 		gLength(cellp));
     }
 #endif
-    for (p = nodes; p != 0; p = p->next) {
-	for (q = nodes; q != 0; q = q->next)
-	    if (p != q)
-		applyRep(p->node, q->node);
-    }
-
-    doNeighbor(grid, i - 1, j - 1, nodes);
-    doNeighbor(grid, i - 1, j, nodes);
-    doNeighbor(grid, i - 1, j + 1, nodes);
-    doNeighbor(grid, i, j - 1, nodes);
-    doNeighbor(grid, i, j + 1, nodes);
-    doNeighbor(grid, i + 1, j - 1, nodes);
-    doNeighbor(grid, i + 1, j, nodes);
-    doNeighbor(grid, i + 1, j + 1, nodes);
-
+    cellA.b.n = 0;
+    addBlock(&cellA, cellp->nodes);
+    for (k = 0; k < cellA.b.n; k++)
+	blockRep(&cellA.b, k, &cellA.b, HUGE_VAL);
+
+    cellB.b.n = 0;
+    doNeighbor(grid, i - 1, j - 1);
+    doNeighbor(grid, i - 1, j);
+    doNeighbor(grid, i - 1, j + 1);
+    doNeighbor(grid, i, j - 1);
+    doNeighbor(grid, i, j + 1);
+    doNeighbor(grid, i + 1, j - 1);
+    doNeighbor(grid, i + 1, j);
+    doNeighbor(grid, i + 1, j + 1);
+    for (k = 0; k < cellA.b.n; k++)
+	blockRep(&cellA.b, k, &cellB.b, T_Cell2);
+
+    storeBlock(&cellB);
+    storeBlock(&cellA);
     return 0;
 }
 
@@ -346,6 +436,87 @@ static void applyAttr(Agnode_t * p, Agnode_t * q, Agedge_t * e)
     DISP(p)[1] += ydelta * force;
 }
 
+/* The edges of the graph, with the vectors between their ends and the
+ * parameters force_fdp_attract works on.
+ */
+typedef struct {
+    int n, size;
+    Agnode_t **tail, **head;
+    double *dx, *dy;
+    double *factor, *len;
+    double *force;
+} edgeblock;
+
+static edgeblock edgeA;
+
+static void freeEdges(edgeblock * eb)
+{
+    free(eb->tail);
+    free(eb->head);
+    free(eb->dx);
+    free(eb->dy);
+    free(eb->factor);
+    free(eb->len);
+    free(eb->force);
+    memset(eb, 0, sizeof(edgeblock));
+}
+
+/* gridAttr:
+ * Apply the attractive forces of all edges of g, as applyAttr does
+ * edge by edge. Coincident ends are moved apart at random while the
+ * edges are collected, and the displacements are added in edge order,
+ * so the results are the same.
+ */
+static void gridAttr(Agraph_t * g)
+{
+    Agnode_t *n, *q;
+    Agedge_t *e;
+    double xdelta, ydelta;
+    int i;
+
+    edgeA.n = 0;
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	for (e = agfstout(g, n); e; e = agnxtout(g, e)) {
+	    q = aghead(e);
+	    if (n == q)
+		continue;
+	    if (edgeA.n == edgeA.size) {
+		edgeA.size = MAX(64, 2 * edgeA.size);
+		edgeA.tail = RALLOC(edgeA.size, edgeA.tail, Agnode_t *);
+		edgeA.head = RALLOC(edgeA.size, edgeA.head, Agnode_t *);
+		edgeA.dx = RALLOC(edgeA.size, edgeA.dx, double);
+		edgeA.dy = RALLOC(edgeA.size, edgeA.dy, double);
+		edgeA.factor = RALLOC(edgeA.size, edgeA.factor, double);
+		edgeA.len = RALLOC(edgeA.size, edgeA.len, double);
+		edgeA.force = RALLOC(edgeA.size, edgeA.force, double);
+	    }
+	    xdelta = ND_pos(q)[0] - ND_pos(n)[0];
+	    ydelta = ND_pos(q)[1] - ND_pos(n)[1];
+	    while (xdelta * xdelta + ydelta * ydelta == 0.0) {
+		xdelta = 5 - rand() % 10;
+		ydelta = 5 - rand() % 10;
+	    }
+	    i = edgeA.n++;
+	    edgeA.tail[i] = n;
+	    edgeA.head[i] = q;
+	    edgeA.dx[i] = xdelta;
+	    edgeA.dy[i] = ydelta;
+	    edgeA.factor[i] = ED_factor(e);
+	    edgeA.len[i] = ED_dist(e);
+	}
+    }
+
+    force_fdp_attract(edgeA.n, edgeA.dx, edgeA.dy, edgeA.factor, edgeA.len,
+		      edgeA.force, T_useNew);
+
+    for (i = 0; i < edgeA.n; i++) {
+	DISP(edgeA.head[i])[0] -= edgeA.dx[i] * edgeA.force[i];
+	DISP(edgeA.head[i])[1] -= edgeA.dy[i] * edgeA.force[i];
+	DISP(edgeA.tail[i])[0] += edgeA.dx[i] * edgeA.force[i];
+	DISP(edgeA.tail[i])[1] += edgeA.dy[i] * edgeA.force[i];
+    }
+}
+
 static void updatePos(Agraph_t * g, double temp, bport_t * pp)
 {
     Agnode_t *n;
@@ -399,7 +570,6 @@ static void updatePos(Agraph_t * g, double temp, bport_t * pp)
 static void gAdjust(Agraph_t * g, double temp, bport_t * pp, Grid * grid)
 {
     Agnode_t *n;
-    Agedge_t *e;
 
     if (temp <= 0.0)
 	return;
@@ -412,11 +582,7 @@ static void gAdjust(Agraph_t * g, double temp, bport_t * pp, Grid * grid)
 		n);
     }
 
-    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
-	for (e = agfstout(g, n); e; e = agnxtout(g, e))
-	    if (n != aghead(e))
-		applyAttr(n, aghead(e), e);
-    }
+    gridAttr(g);
     walkGrid(grid, gridRepulse);
 
 
@@ -679,6 +845,9 @@ void fdp_tLayout(graph_t * g, xparams * xpms)
 	    gAdjust(g, temp, pp, grid);
 	}
 	delGrid(grid);
+	freeBlock(&cellA);
+	freeBlock(&cellB);
+	freeEdges(&edgeA);
     } else {
 	for (i = 0; i < T_loopcnt; i++) {
 	    temp = cool(i);
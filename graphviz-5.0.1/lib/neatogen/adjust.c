@@ -661,12 +661,12 @@ double *getSizes(Agraph_t * g, pointf pad, int* n_elabels, int** elabels)
 SparseMatrix makeMatrix(Agraph_t* g, SparseMatrix *D)
 {
     SparseMatrix A = 0;
-    Agnode_t *n;
+    Agcsr_t *csr;
     Agedge_t *e;
     Agsym_t *sym;
     int nnodes;
     int nedges;
-    int i, row;
+    int i, k, row;
     int *I;
     int *J;
     double *val;
@@ -677,13 +677,13 @@ SparseMatrix makeMatrix(Agraph_t* g, SparseMatrix *D)
 
     if (!g)
 	return NULL;
-    nnodes = agnnodes(g);
-    nedges = agnedges(g);
+    csr = agcsr(g);
+    nnodes = csr->nnodes;
+    nedges = csr->nedges;
 
     /* Assign node ids */
-    i = 0;
-    for (n = agfstnode(g); n; n = agnxtnode(g, n))
-	ND_id(n) = i++;
+    for (i = 0; i < nnodes; i++)
+	ND_id(csr->node[i]) = i;
 
     I = N_GNEW(nedges, int);
     J = N_GNEW(nedges, int);
@@ -696,11 +696,11 @@ SparseMatrix makeMatrix(Agraph_t* g, SparseMatrix *D)
     }
 
     i = 0;
-    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
-	row = ND_id(n);
-	for (e = agfstout(g, n); e; e = agnxtout(g, e)) {
+    for (row = 0; row < nnodes; row++) {
+	for (k = csr->out_offset[row]; k < csr->out_offset[row + 1]; k++) {
+	    e = csr->out_edge[k];
 	    I[i] = row;
-	    J[i] = ND_id(aghead(e));
+	    J[i] = csr->out_target[k];
 	    if (!sym || sscanf(agxget(e, sym), "%lf", &v) != 1)
 		v = 1;
 	    val[i] = v;
@@ -722,6 +722,7 @@ SparseMatrix makeMatrix(Agraph_t* g, SparseMatrix *D)
     free(J);
     free(val);
     free (valD);
+    agcsrfree(csr);
 
     return A;
 }
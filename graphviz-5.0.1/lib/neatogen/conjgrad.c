@@ -161,6 +161,17 @@ cleanup1:
     return rv;
 }
 
+typedef struct {
+    float *A;
+    int n;
+} packed_matrix;
+
+static void mult_packed(void *ctx, float *vector, float *result)
+{
+    packed_matrix *m = ctx;
+    right_mult_with_vector_ff(m->A, m->n, vector, result);
+}
+
 int
 conjugate_gradient_mkernel(float *A, float *x, float *b, int n,
 			   double tol, int max_iterations)
@@ -169,6 +180,18 @@ conjugate_gradient_mkernel(float *A, float *x, float *b, int n,
     /* A is a packed symmetric matrix */
     /* matrux A is "packed" (only upper triangular portion exists, row-major); */
 
+    packed_matrix m = {A, n};
+    return conjugate_gradient_op(mult_packed, &m, x, b, n, tol,
+				 max_iterations);
+}
+
+int
+conjugate_gradient_op(cg_mult_fn mult, void *ctx, float *x, float *b, int n,
+		      double tol, int max_iterations)
+{
+    /* Solves Ax=b using Conjugate-Gradients method */
+    /* A is symmetric and given by mult, which sets result := A*vector */
+
     int i, rv = 0;
 
     double alpha, beta, r_r, r_r_new, p_Ap;
@@ -181,7 +204,7 @@ conjugate_gradient_mkernel(float *A, float *x, float *b, int n,
     orthog1f(n, x);
     orthog1f(n, b);
 
-    right_mult_with_vector_ff(A, n, x, Ax);
+    mult(ctx, x, Ax);
     /* centering Ax */
     orthog1f(n, Ax);
 
@@ -196,7 +219,7 @@ conjugate_gradient_mkernel(float *A, float *x, float *b, int n,
 	orthog1f(n, x);
 	orthog1f(n, r);
 
-	right_mult_with_vector_ff(A, n, p, Ap);
+	mult(ctx, p, Ap);
 	/* centering Ap */
 	orthog1f(n, Ap);
 
@@ -34,6 +34,14 @@ extern "C" {
     extern int conjugate_gradient_mkernel(float *, float *, float *, int,
 					   double, int);
 
+/* C.G. method with a symmetric matrix given by a function setting
+ * result := A*vector, for matrices too large to store
+ */
+    typedef void (*cg_mult_fn)(void *ctx, float *vector, float *result);
+
+    extern int conjugate_gradient_op(cg_mult_fn, void *, float *, float *,
+				     int, double, int);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,15 +9,50 @@
  *************************************************************************/
 
 
+#include <cgraph/parallel.h>
 #include <neatogen/matrix_ops.h>
 #include <common/memory.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
+/* The packed matrix-vector product and the float vector operations have
+ * AVX2 versions on x86 processors that have it, chosen when called. They
+ * are compiled with target attributes, so the library still runs on any
+ * processor. Their sums are taken in another order than in the plain loops,
+ * which changes the results by rounding.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_X86
+#include <immintrin.h>
+#define MATRIX_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
 static double p_iteration_threshold = 1e-3;
 
+/* threads for right_mult_with_vector_ff */
+static int num_threads = 1;
+
+/* smallest packed matrix worth splitting between threads */
+#define PARALLEL_MIN_ENTRIES ((size_t)1 << 20)
+
+void matrix_ops_set_num_threads(int nthreads)
+{
+    num_threads = nthreads < 1 ? 1 : nthreads;
+}
+
+static bool use_avx2(void)
+{
+#ifdef MATRIX_X86
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
 bool power_iteration(double **square_mat, int n, int neigs, double **eigs,
 		double *evals, int initialize)
 {
@@ -469,12 +504,54 @@ right_mult_with_vector_d(double **matrix,
 ** version                  **
 *****************************/
 
+#ifdef MATRIX_X86
+MATRIX_AVX2 static float hsum_avx2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehdup_ps(s)));
+}
+
+MATRIX_AVX2 static float sum_avx2(int n, const float *vec)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    float sum;
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+	s0 = _mm256_add_ps(s0, _mm256_loadu_ps(vec + i));
+	s1 = _mm256_add_ps(s1, _mm256_loadu_ps(vec + i + 8));
+    }
+    sum = hsum_avx2(_mm256_add_ps(s0, s1));
+    for (; i < n; i++)
+	sum += vec[i];
+    return sum;
+}
+
+MATRIX_AVX2 static void add_avx2(int n, float *vec, float val)
+{
+    __m256 v = _mm256_set1_ps(val);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(vec + i, _mm256_add_ps(_mm256_loadu_ps(vec + i), v));
+    for (; i < n; i++)
+	vec[i] += val;
+}
+#endif
+
 void orthog1f(int n, float *vec)
 {
     int i;
     float *pntr;
     float sum;
 
+#ifdef MATRIX_X86
+    if (use_avx2()) {
+	add_avx2(n, vec, -sum_avx2(n, vec) / n);
+	return;
+    }
+#endif
     sum = 0.0;
     pntr = vec;
     for (i = n; i; i--) {
@@ -487,34 +564,258 @@ void orthog1f(int n, float *vec)
     }
 }
 
+/* packed_row:
+ * For the off-diagonal part row[0..len-1] of a row of a packed matrix,
+ * whose diagonal entry multiplies vector_i: add row[j] * vector_i to
+ * result[j], and return res plus the sum of row[j] * vector[j].
+ */
+static float packed_row(const float *row, int len, const float *vector,
+			float vector_i, float *result, float res)
+{
+    int j;
+
+    for (j = 0; j < len; j++) {
+	res += row[j] * vector[j];
+	result[j] += row[j] * vector_i;
+    }
+    return res;
+}
+
+#ifdef MATRIX_X86
+MATRIX_AVX2 static float packed_row_avx2(const float *row, int len,
+					 const float *vector, float vector_i,
+					 float *result, float res)
+{
+    __m256 xi = _mm256_set1_ps(vector_i);
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 a0, a1;
+    int j = 0;
+
+    for (; j + 16 <= len; j += 16) {
+	a0 = _mm256_loadu_ps(row + j);
+	a1 = _mm256_loadu_ps(row + j + 8);
+	s0 = _mm256_fmadd_ps(a0, _mm256_loadu_ps(vector + j), s0);
+	s1 = _mm256_fmadd_ps(a1, _mm256_loadu_ps(vector + j + 8), s1);
+	_mm256_storeu_ps(result + j,
+			 _mm256_fmadd_ps(a0, xi, _mm256_loadu_ps(result + j)));
+	_mm256_storeu_ps(result + j + 8,
+			 _mm256_fmadd_ps(a1, xi,
+					 _mm256_loadu_ps(result + j + 8)));
+    }
+    for (; j + 8 <= len; j += 8) {
+	a0 = _mm256_loadu_ps(row + j);
+	s0 = _mm256_fmadd_ps(a0, _mm256_loadu_ps(vector + j), s0);
+	_mm256_storeu_ps(result + j,
+			 _mm256_fmadd_ps(a0, xi, _mm256_loadu_ps(result + j)));
+    }
+    res += hsum_avx2(_mm256_add_ps(s0, s1));
+    return packed_row(row + j, len - j, vector + j, vector_i, result + j,
+		      res);
+}
+#endif
+
+/* packed_rows:
+ * Rows i0 to i1-1 of right_mult_with_vector_ff, added to result. Their
+ * entries below the diagonal go to rows i1 and after as well.
+ */
+static void packed_rows(float *packed_matrix, int n, float *vector, int i0,
+			int i1, float *result, bool avx2)
+{
+    size_t index = (size_t)i0 * (size_t)n - (size_t)i0 * (size_t)(i0 - 1) / 2;
+    int i, len;
+    float vector_i;
+    float res;
+
+    for (i = i0; i < i1; i++) {
+	vector_i = vector[i];
+	len = n - i - 1;
+	/* deal with main diag */
+	res = packed_matrix[index] * vector_i;
+	/* deal with off diag */
+#ifdef MATRIX_X86
+	if (avx2)
+	    res = packed_row_avx2(packed_matrix + index + 1, len,
+				  vector + i + 1, vector_i, result + i + 1,
+				  res);
+	else
+#endif
+	    res = packed_row(packed_matrix + index + 1, len, vector + i + 1,
+			     vector_i, result + i + 1, res);
+	result[i] += res;
+	index += (size_t)len + 1;
+    }
+}
+
+typedef struct {
+    float *packed_matrix;
+    int n;
+    float *vector;
+    int *rows;			/* chunk c has rows rows[c] to rows[c+1]-1 */
+    float **results;		/* what each chunk adds to the result */
+    bool avx2;
+} packed_mult_job;
+
+static void packed_mult_run(void *ctx, size_t c)
+{
+    packed_mult_job *job = ctx;
+
+    packed_rows(job->packed_matrix, job->n, job->vector, job->rows[c],
+		job->rows[c + 1], job->results[c], job->avx2);
+}
+
 void right_mult_with_vector_ff
     (float *packed_matrix, int n, float *vector, float *result) {
     /* packed matrix is the upper-triangular part of a symmetric matrix arranged in a vector row-wise */
-    int i, j, index;
-    float vector_i;
+    /* With several threads, each takes a range of rows of about the same
+     * number of entries, adding them into a result of its own. These are
+     * summed in order, so the result only depends on the number of threads.
+     */
+    size_t entries = (size_t)n * (size_t)(n + 1) / 2;
+    packed_mult_job job;
+    int nchunks, c, i, j;
+    size_t count;
 
-    float res;
     for (i = 0; i < n; i++) {
 	result[i] = 0;
     }
-    for (index = 0, i = 0; i < n; i++) {
-	res = 0;
-	vector_i = vector[i];
-	/* deal with main diag */
-	res += packed_matrix[index++] * vector_i;
-	/* deal with off diag */
-	for (j = i + 1; j < n; j++, index++) {
-	    res += packed_matrix[index] * vector[j];
-	    result[j] += packed_matrix[index] * vector_i;
-	}
-	result[i] += res;
+    nchunks = num_threads > 1 && entries >= PARALLEL_MIN_ENTRIES
+	? (num_threads < n ? num_threads : n) : 1;
+    if (nchunks == 1) {
+	packed_rows(packed_matrix, n, vector, 0, n, result, use_avx2());
+	return;
     }
+
+    job.packed_matrix = packed_matrix;
+    job.n = n;
+    job.vector = vector;
+    job.avx2 = use_avx2();
+    job.rows = N_NEW(nchunks + 1, int);
+    for (c = 1, count = 0, i = 0; c < nchunks; c++) {
+	while (i < n && count < entries * (size_t)c / (size_t)nchunks)
+	    count += (size_t)(n - i++);
+	job.rows[c] = i;
+    }
+    job.rows[nchunks] = n;
+    job.results = N_NEW(nchunks, float *);
+    job.results[0] = result;
+    for (c = 1; c < nchunks; c++)
+	job.results[c] = N_NEW(n, float);
+
+    gv_parallel_for((size_t)nchunks, num_threads, packed_mult_run, &job);
+
+    for (c = 1; c < nchunks; c++) {
+	for (j = job.rows[c]; j < n; j++)
+	    result[j] += job.results[c][j];
+	free(job.results[c]);
+    }
+    free(job.results);
+    free(job.rows);
+}
+
+#ifdef MATRIX_X86
+MATRIX_AVX2 static void substraction_avx2(int n, const float *vector1,
+					  const float *vector2, float *result)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(result + i, _mm256_sub_ps(_mm256_loadu_ps(vector1 + i),
+						   _mm256_loadu_ps(vector2 + i)));
+    for (; i < n; i++)
+	result[i] = vector1[i] - vector2[i];
+}
+
+MATRIX_AVX2 static void addition_avx2(int n, const float *vector1,
+				      const float *vector2, float *result)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_loadu_ps(vector1 + i),
+						   _mm256_loadu_ps(vector2 + i)));
+    for (; i < n; i++)
+	result[i] = vector1[i] + vector2[i];
+}
+
+MATRIX_AVX2 static void mult_addition_avx2(int n, float *vector1,
+					   float alpha, const float *vector2)
+{
+    __m256 a = _mm256_set1_ps(alpha);
+    int i = 0;
+
+    /* no FMA, so the results are those of the plain loop */
+    for (; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(vector1 + i,
+			 _mm256_add_ps(_mm256_loadu_ps(vector1 + i),
+				       _mm256_mul_ps(a, _mm256_loadu_ps(vector2 + i))));
+    for (; i < n; i++)
+	vector1[i] = vector1[i] + alpha * vector2[i];
 }
 
+MATRIX_AVX2 static void scalar_mult_avx2(int n, const float *vector,
+					 float alpha, float *result)
+{
+    __m256 a = _mm256_set1_ps(alpha);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(result + i, _mm256_mul_ps(_mm256_loadu_ps(vector + i), a));
+    for (; i < n; i++)
+	result[i] = vector[i] * alpha;
+}
+
+MATRIX_AVX2 static double inner_product_avx2(int n, const float *vector1,
+					     const float *vector2)
+{
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256 p;
+    __m128d s;
+    double result;
+    int i = 0;
+
+    /* the products are rounded to float, as in the plain loop */
+    for (; i + 8 <= n; i += 8) {
+	p = _mm256_mul_ps(_mm256_loadu_ps(vector1 + i), _mm256_loadu_ps(vector2 + i));
+	s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm256_castps256_ps128(p)));
+	s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm256_extractf128_ps(p, 1)));
+    }
+    s0 = _mm256_add_pd(s0, s1);
+    s = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+    result = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    for (; i < n; i++)
+	result += vector1[i] * vector2[i];
+    return result;
+}
+
+MATRIX_AVX2 static float max_abs_avx2(int n, const float *vector)
+{
+    __m256 m = _mm256_set1_ps(-1e30f);
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m128 h;
+    float max_val;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+	m = _mm256_max_ps(m, _mm256_andnot_ps(sign, _mm256_loadu_ps(vector + i)));
+    h = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    max_val = _mm_cvtss_f32(_mm_max_ss(h, _mm_movehdup_ps(h)));
+    for (; i < n; i++)
+	max_val = fmaxf(max_val, fabsf(vector[i]));
+    return max_val;
+}
+#endif
+
 void
 vectors_substractionf(int n, float *vector1, float *vector2, float *result)
 {
     int i;
+#ifdef MATRIX_X86
+    if (use_avx2()) {
+	substraction_avx2(n, vector1, vector2, result);
+	return;
+    }
+#endif
     for (i = 0; i < n; i++) {
 	result[i] = vector1[i] - vector2[i];
     }
@@ -524,6 +825,12 @@ void
 vectors_additionf(int n, float *vector1, float *vector2, float *result)
 {
     int i;
+#ifdef MATRIX_X86
+    if (use_avx2()) {
+	addition_avx2(n, vector1, vector2, result);
+	return;
+    }
+#endif
     for (i = 0; i < n; i++) {
 	result[i] = vector1[i] + vector2[i];
     }
@@ -533,6 +840,12 @@ void
 vectors_mult_additionf(int n, float *vector1, float alpha, float *vector2)
 {
     int i;
+#ifdef MATRIX_X86
+    if (use_avx2()) {
+	mult_addition_avx2(n, vector1, alpha, vector2);
+	return;
+    }
+#endif
     for (i = 0; i < n; i++) {
 	vector1[i] = vector1[i] + alpha * vector2[i];
     }
@@ -541,6 +854,12 @@ vectors_mult_additionf(int n, float *vector1, float alpha, float *vector2)
 void vectors_scalar_multf(int n, float *vector, float alpha, float *result)
 {
     int i;
+#ifdef MATRIX_X86
+    if (use_avx2()) {
+	scalar_mult_avx2(n, vector, alpha, result);
+	return;
+    }
+#endif
     for (i = 0; i < n; i++) {
 	result[i] = vector[i] * alpha;
     }
@@ -548,15 +867,17 @@ void vectors_scalar_multf(int n, float *vector, float alpha, float *result)
 
 void copy_vectorf(int n, float *source, float *dest)
 {
-    int i;
-    for (i = 0; i < n; i++)
-	dest[i] = source[i];
+    memcpy(dest, source, sizeof(float) * (size_t)n);
 }
 
 double vectors_inner_productf(int n, float *vector1, float *vector2)
 {
     int i;
     double result = 0;
+#ifdef MATRIX_X86
+    if (use_avx2())
+	return inner_product_avx2(n, vector1, vector2);
+#endif
     for (i = 0; i < n; i++) {
 	result += vector1[i] * vector2[i];
     }
@@ -582,6 +903,10 @@ double max_absf(int n, float *vector)
 {
     int i;
     float max_val = -1e30f;
+#ifdef MATRIX_X86
+    if (use_avx2())
+	return max_abs_avx2(n, vector);
+#endif
     for (i = 0; i < n; i++)
 	max_val = fmaxf(max_val, fabsf(vector[i]));
 
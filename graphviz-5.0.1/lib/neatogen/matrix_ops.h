@@ -60,6 +60,11 @@ extern "C" {
 
     extern void orthog1f(int n, float *vec);
     extern void right_mult_with_vector_ff(float *, int, float *, float *);
+    /* Threads right_mult_with_vector_ff may use on large matrices. With
+     * more than one, its sums are taken in another order, so the result
+     * depends on the number of threads by rounding.
+     */
+    extern void matrix_ops_set_num_threads(int nthreads);
     extern void vectors_substractionf(int, float *, float *, float *);
     extern void vectors_additionf(int n, float *vector1, float *vector2,
 				  float *result);
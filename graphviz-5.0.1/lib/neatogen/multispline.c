@@ -419,6 +419,7 @@ struct router_s {
     Dt_t *trimap; /* map from obstacle side (a,b) to index of adj. triangle */
     int tn;	  /* no. of nodes in tg */
     tgraph *tg;	  /* graph of triangles */
+    Pworkspace_t *ws; /* scratch space for routing in the router */
 };
 
 /* triCenter:
@@ -633,6 +634,7 @@ void freeRouter(router_t * rtr)
     free(rtr->tris);
     dtclose(rtr->trimap);
     freeTriGraph(rtr->tg);
+    Pworkspace_free(rtr->ws);
     free(rtr);
 }
 
@@ -709,6 +711,7 @@ router_t *mkRouter(Ppoly_t** obsp, int npoly)
     rtr->trimap = mapSegToTri(sf);
     rtr->tn = sf->nfaces;
     rtr->tg = mkTriGraph(sf, maxv, pts);
+    rtr->ws = Pworkspace_new();
 
     freeSurface(sf);
     return rtr;
@@ -787,10 +790,11 @@ tweakPath (Ppoly_t poly, int s, int t, Ppolyline_t pl)
 
 /* genroute:
  * Generate splines for e and cohorts.
- * Edges go from s to t.
+ * Edges go from s to t. Routing uses the scratch space in ws.
  * Return 0 on success.
  */
-static int genroute(tripoly_t * trip, int s, int t, edge_t * e, int doPolyline)
+static int genroute(Pworkspace_t *ws, tripoly_t * trip, int s, int t,
+		    edge_t * e, int doPolyline)
 {
     pointf eps[2];
     Pvector_t evs[2];
@@ -809,7 +813,7 @@ static int genroute(tripoly_t * trip, int s, int t, edge_t * e, int doPolyline)
     pl.pn = 0;
     eps[0].x = trip->poly.ps[s].x, eps[0].y = trip->poly.ps[s].y;
     eps[1].x = trip->poly.ps[t].x, eps[1].y = trip->poly.ps[t].y;
-    if (Pshortestpath(&(trip->poly), eps, &pl) < 0) {
+    if (Pshortestpath_ws(ws, &(trip->poly), eps, &pl) < 0) {
 	agerr(AGWARN, "Could not create control points for multiple spline for edge (%s,%s)\n", agnameof(agtail(e)), agnameof(aghead(e)));
 	rv = 1;
 	goto finish;
@@ -830,7 +834,7 @@ static int genroute(tripoly_t * trip, int s, int t, edge_t * e, int doPolyline)
 	    medges[j].b = poly.ps[(j + 1) % poly.pn];
 	}
 	tweakPath (poly, s, t, pl);
-	if (Proutespline(medges, poly.pn, pl, evs, &spl) < 0) {
+	if (Proutespline_ws(ws, medges, poly.pn, pl, evs, &spl) < 0) {
 	    agerr(AGWARN, "Could not create control points for multiple spline for edge (%s,%s)\n", agnameof(agtail(e)), agnameof(aghead(e)));
 	    rv = 1;
 	    goto finish;
@@ -866,14 +870,14 @@ static int genroute(tripoly_t * trip, int s, int t, edge_t * e, int doPolyline)
 	for (j = 1; j < pl.pn - 1; j++) {
 	    poly.ps[pn - j] = cpts[j - 1][i + 1];
 	}
-	if (Pshortestpath(&poly, eps, &mmpl) < 0) {
+	if (Pshortestpath_ws(ws, &poly, eps, &mmpl) < 0) {
 	    agerr(AGWARN, "Could not create control points for multiple spline for edge (%s,%s)\n", agnameof(agtail(e)), agnameof(aghead(e)));
 	    rv = 1;
 	    goto finish;
 	}
 
 	if (doPolyline) {
-	    make_polyline (mmpl, &spl);
+	    make_polyline_ws(ws, mmpl, &spl);
 	}
 	else {
 	    for (j = 0; j < poly.pn; j++) {
@@ -881,7 +885,7 @@ static int genroute(tripoly_t * trip, int s, int t, edge_t * e, int doPolyline)
 		medges[j].b = poly.ps[(j + 1) % poly.pn];
 	    }
 	    tweakPath (poly, 0, pl.pn-1, mmpl);
-	    if (Proutespline(medges, poly.pn, mmpl, evs, &spl) < 0) {
+	    if (Proutespline_ws(ws, medges, poly.pn, mmpl, evs, &spl) < 0) {
 		agerr(AGWARN, "Could not create control points for multiple spline for edge (%s,%s)\n", 
 		    agnameof(agtail(e)), agnameof(aghead(e)));
 		rv = 1;
@@ -1313,7 +1317,7 @@ int makeMultiSpline(edge_t* e, router_t * rtr, int doPolyline) {
 	free(sp);
 
 	/* Generate multiple splines using polygon */
-	ret = genroute(poly, 0, idx, e, doPolyline);
+	ret = genroute(rtr->ws, poly, 0, idx, e, doPolyline);
 	freeTripoly (poly);
     }
     else ret = -1;
@@ -24,6 +24,7 @@
 #include <neatogen/digcola.h>
 #endif
 #include <neatogen/kkutils.h>
+#include <neatogen/matrix_ops.h>
 #include <common/pointset.h>
 #include <neatogen/sgd.h>
 #include <cgraph/bitarray.h>
@@ -488,12 +489,10 @@ static void
 nop_init_graphs(Agraph_t * g, attrsym_t * G_lp, attrsym_t * G_bb)
 {
     graph_t *subg;
-    char *s;
     double x, y;
 
     if (GD_label(g) && G_lp) {
-	s = agxget(g, G_lp);
-	if (sscanf(s, "%lf,%lf", &x, &y) == 2) {
+	if (agxgetpoint(g, G_lp, &x, &y)) {
 	    GD_label(g)->pos = pointfof(x, y);
 	    GD_label(g)->set = true;
 	}
@@ -657,6 +656,8 @@ static int neatoMode(graph_t * g)
 	    mode = MODE_MAJOR;
 	else if (streq(str, "sgd"))
 		mode = MODE_SGD;
+	else if (streq(str, "multilevel"))
+	    mode = MODE_MULTILEVEL;
 #ifdef DIGCOLA
 	else if (streq(str, "hier"))
 	    mode = MODE_HIER;
@@ -1115,7 +1116,7 @@ void dumpOpts (ipsep_options* opp, int nv)
  * Solve stress using majorization.
  * Old neato attributes to incorporate:
  *  weight
- * mode will be MODE_MAJOR, MODE_HIER or MODE_IPSEP
+ * mode will be MODE_MAJOR, MODE_MULTILEVEL, MODE_HIER or MODE_IPSEP
  */
 static void
 majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, adjust_data* am)
@@ -1136,6 +1137,7 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, adj
 
     if (init == INIT_SELF)
 	opts |= opt_smart_init;
+    matrix_ops_set_num_threads(late_int(g, agfindgraphattr(g, "threads"), 1, 1));
 
     coords = N_GNEW(dim, double *);
     coords[0] = N_GNEW(nv * dim, double);
@@ -1156,7 +1158,7 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, adj
     }
 
 #ifdef DIGCOLA
-    if (mode != MODE_MAJOR) {
+    if (mode == MODE_HIER || mode == MODE_IPSEP) {
         double lgap = late_double(g, agfindgraphattr(g, "levelsgap"), 0.0, -MAXDOUBLE);
         if (mode == MODE_HIER) {
             rv = stress_majorization_with_hierarchy(gp, nv, coords, nodes, Ndim,
@@ -1240,6 +1242,9 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, adj
     }
     else
 #endif
+    if (mode == MODE_MULTILEVEL)
+	rv = stress_majorization_multilevel(gp, nv, coords, nodes, Ndim, opts, model, MaxIter);
+    else
 	rv = stress_majorization_kD_mkernel(gp, nv, coords, nodes, Ndim, opts, model, MaxIter);
 
     if (rv < 0) {
@@ -1251,6 +1256,7 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, adj
 	    ND_pos(v)[i] = coords[i][idx];
 	}
     }
+    matrix_ops_set_num_threads(1);
     freeGraphData(gp);
     free(coords[0]);
     free(coords);
@@ -1342,7 +1348,7 @@ neatoLayout(Agraph_t * mg, Agraph_t * g, int layoutMode, int layoutModel,
 
     if ((str = agget(g, "maxiter")))
 	MaxIter = atoi(str);
-    else if (layoutMode == MODE_MAJOR)
+    else if (layoutMode == MODE_MAJOR || layoutMode == MODE_MULTILEVEL)
 	MaxIter = DFLT_ITERATIONS;
     else if (layoutMode == MODE_SGD)
 	MaxIter = 30;
@@ -17,6 +17,7 @@
 #include <pathplan/pathplan.h>
 #include <pathplan/vispath.h>
 #include <neatogen/multispline.h>
+#include <neatogen/obsindex.h>
 #include <stdbool.h>
 
 #ifdef ORTHO
@@ -524,9 +525,38 @@ void makeSpline(edge_t *e, Ppoly_t **obs, int npoly, bool chkPts) {
     addEdgeLabels(e);
 }
 
+/* makeIndexedSpline:
+ * As makeSpline with chkPts true, finding the obstacles near e through ox.
+ */
+static void makeIndexedSpline(edge_t *e, obsindex_t *ox) {
+    Ppolyline_t line, spline;
+    Pvector_t slopes[2];
+    int pp, qp;
+
+    line = ED_path(e);
+    pp = obsHit(ox, line.ps[0]);
+    qp = obsHit(ox, line.ps[line.pn - 1]);
+    slopes[0].x = slopes[0].y = 0.0;
+    slopes[1].x = slopes[1].y = 0.0;
+    if (obsSpline(ox, line, pp, qp, slopes, &spline) < 0) {
+	agerr (AGERR, "makeSpline: failed to make spline edge (%s,%s)\n", agnameof(agtail(e)), agnameof(aghead(e)));
+	return;
+    }
+
+    if (Verbose > 1)
+	fprintf(stderr, "spline %s %s\n", agnameof(agtail(e)), agnameof(aghead(e)));
+    clip_and_install(e, aghead(e), spline.ps, spline.pn, &sinfo);
+    addEdgeLabels(e);
+}
+
   /* True if either head or tail has a port on its boundary */
 #define BOUNDARY_PORT(e) ((ED_tail_port(e).side)||(ED_head_port(e).side))
 
+/* With at least this many obstacles, edges are routed with an R-tree of
+ * the obstacles rather than the visibility graph of all of them.
+ */
+#define OBSINDEX_MIN 64
+
 /* _spline_edges:
  * Basic default routine for creating edges.
  * If splines are requested, we construct the obstacles.
@@ -535,6 +565,9 @@ void makeSpline(edge_t *e, Ppoly_t **obs, int npoly, bool chkPts) {
  * remain in the cluster's bounding box and, conversely, a cluster's box
  * is not altered to reflect intra-cluster edges.
  * If Nop > 1 and the spline exists, it is just copied.
+ * Building the visibility graph of all obstacles takes time cubic in
+ * their number of vertices, so large graphs index the obstacles and
+ * route each edge among those near it instead.
  * NOTE: if edgetype = EDGETYPE_NONE, we shouldn't be here.
  */
 static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
@@ -546,6 +579,7 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
     Ppoly_t *obp;
     int cnt, i = 0, npoly;
     vconfig_t *vconfig = 0;
+    obsindex_t *ox = NULL;
     path *P = NULL;
     int useEdges = Nop > 1;
     int legal = 0;
@@ -572,7 +606,12 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
     npoly = i;
     if (obs) {
 	if ((legal = Plegal_arrangement(obs, npoly))) {
-	    if (edgetype != EDGETYPE_ORTHO) vconfig = Pobsopen(obs, npoly);
+	    if (edgetype != EDGETYPE_ORTHO) {
+		if (npoly >= OBSINDEX_MIN)
+		    ox = mkObsIndex(obs, npoly);
+		else
+		    vconfig = Pobsopen(obs, npoly);
+	    }
 	}
 	else {
 	    if (edgetype == EDGETYPE_ORTHO)
@@ -586,7 +625,7 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
     if (Verbose)
 	fprintf(stderr, "Creating edges using %s\n",
 	    (legal && edgetype == EDGETYPE_ORTHO) ? "orthogonal lines" :
-	    (vconfig ? (edgetype == EDGETYPE_SPLINE ? "splines" : "polylines") :
+	    (vconfig || ox ? (edgetype == EDGETYPE_SPLINE ? "splines" : "polylines") :
 		"line segments"));
     if (vconfig) {
 	/* path-finding pass */
@@ -596,6 +635,15 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
 	    }
 	}
     }
+    else if (ox) {
+	for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	    for (e = agfstout(g, n); e; e = agnxtout(g, e)) {
+		Ppoint_t p = add_pointf(ND_coord(n), ED_tail_port(e).p);
+		Ppoint_t q = add_pointf(ND_coord(aghead(e)), ED_head_port(e).p);
+		obsPath(ox, p, ND_lim(n), q, ND_lim(aghead(e)), &ED_path(e));
+	    }
+	}
+    }
 #ifdef ORTHO
     else if (legal && edgetype == EDGETYPE_ORTHO) {
 	orthoEdges (g, 0);
@@ -620,7 +668,7 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
 		    P->boxes = N_NEW(agnnodes(g) + 20 * 2 * 9, boxf);
 		}
 		makeSelfArcs(e, GD_nodesep(g->root));
-	    } else if (vconfig) { /* EDGETYPE_SPLINE or EDGETYPE_PLINE */
+	    } else if (vconfig || ox) { /* EDGETYPE_SPLINE or EDGETYPE_PLINE */
 #ifdef HAVE_GTS
 		if (ED_count(e) > 1 || BOUNDARY_PORT(e)) {
 		    int fail = 0;
@@ -642,7 +690,9 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
 		if (Concentrate) cnt = 1; /* only do representative */
 		e0 = e;
 		for (i = 0; i < cnt; i++) {
-		    if (edgetype == EDGETYPE_SPLINE)
+		    if (edgetype == EDGETYPE_SPLINE && ox)
+			makeIndexedSpline(e0, ox);
+		    else if (edgetype == EDGETYPE_SPLINE)
 			makeSpline(e0, obs, npoly, true);
 		    else
 			makePolyline(e0);
@@ -661,6 +711,7 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
 
     if (vconfig)
 	Pobsclose (vconfig);
+    freeObsIndex(ox);
     if (P) {
 	free(P->boxes);
 	free(P);
@@ -0,0 +1,343 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+/* Routing around obstacles found through an R-tree.
+ *
+ * A route is first computed among the obstacles it would cross as a
+ * straight line. If the result runs into another obstacle, that obstacle
+ * is added and the route is computed again. A shortest path avoiding all
+ * obstacles among a subset of them is also a shortest path among all of
+ * them. Similarly, Proutespline rejects a candidate spline piece against
+ * a subset of the barriers only if it would against all of them, and
+ * every piece it accepts is checked against the index. The routes are
+ * thus those of the full obstacle set, up to ties between paths of equal
+ * length, while each edge only looks at the obstacles near it.
+ */
+
+#include <cgraph/alloc.h>
+#include <label/index.h>
+#include <math.h>
+#include <neatogen/obsindex.h>
+#include <pathplan/pathplan.h>
+#include <pathplan/vispath.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Obstacle boxes are enlarged by this much, so that routes passing
+ * within rounding distance of an obstacle see it.
+ */
+#define FUZZ 1.0
+
+struct obsindex_s {
+    Ppoly_t **obs;
+    int npoly;
+    boxf *bb;			/* enlarged bounding box of each obstacle */
+    RTree_t *rtree;
+    bool *in;			/* is obstacle i in the subset? */
+    int *sub;			/* the subset of obstacles in use */
+    int nsub;
+    Ppoly_t **sobs;		/* obstacles of the subset, in index order */
+    Pedge_t *bars;		/* barriers of the subset */
+    int nbars;
+    int szbars;
+    vconfig_t *all;		/* configuration of all obstacles, made on demand */
+};
+
+static Rect_t mkRect(boxf b)
+{
+    Rect_t r;
+
+    r.boundary[0] = (int)floor(b.LL.x);
+    r.boundary[1] = (int)floor(b.LL.y);
+    r.boundary[2] = (int)ceil(b.UR.x);
+    r.boundary[3] = (int)ceil(b.UR.y);
+    return r;
+}
+
+/* ptsBox:
+ * Bounding box of the n points ps.
+ */
+static boxf ptsBox(Ppoint_t * ps, int n)
+{
+    boxf bb;
+    int i;
+
+    bb.LL = bb.UR = ps[0];
+    for (i = 1; i < n; i++) {
+	bb.LL.x = fmin(bb.LL.x, ps[i].x);
+	bb.LL.y = fmin(bb.LL.y, ps[i].y);
+	bb.UR.x = fmax(bb.UR.x, ps[i].x);
+	bb.UR.y = fmax(bb.UR.y, ps[i].y);
+    }
+    return bb;
+}
+
+/* segHit:
+ * Return true if the segment ab touches an edge of the polygon, with
+ * the same allowance for rounding errors as the visibility computation.
+ * A segment of a route cannot lie inside an obstacle without touching
+ * its boundary, as its ends are endpoints of the route or vertices of
+ * other, disjoint obstacles.
+ */
+static bool segHit(Ppoint_t a, Ppoint_t b, Ppoly_t * poly)
+{
+    int i;
+    Ppoint_t c, d;
+
+    for (i = 0; i < poly->pn; i++) {
+	c = poly->ps[i];
+	d = poly->ps[(i + 1) % poly->pn];
+	if (wind(a, b, c) * wind(a, b, d) <= 0 &&
+	    wind(c, d, a) * wind(c, d, b) <= 0)
+	    return true;
+    }
+    return false;
+}
+
+static void addObs(obsindex_t * ox, int i)
+{
+    if (i >= 0 && !ox->in[i]) {
+	ox->in[i] = true;
+	ox->sub[ox->nsub++] = i;
+    }
+}
+
+static void clearObs(obsindex_t * ox)
+{
+    int i;
+
+    for (i = 0; i < ox->nsub; i++)
+	ox->in[ox->sub[i]] = false;
+    ox->nsub = 0;
+}
+
+/* addHits:
+ * Add to the subset the obstacles whose boxes overlap bb and, if seg is
+ * not NULL, that the segment seg[0] seg[1] touches.
+ * Return the number of obstacles added.
+ */
+static int addHits(obsindex_t * ox, boxf bb, Ppoint_t * seg)
+{
+    Rect_t r = mkRect(bb);
+    LeafList_t *llp = RTreeSearch(ox->rtree, ox->rtree->root, &r);
+    LeafList_t *lp;
+    int i, cnt = 0;
+
+    for (lp = llp; lp; lp = lp->next) {
+	i = (int)((boxf *) lp->leaf->data - ox->bb);
+	if (ox->in[i] || !OVERLAP(bb, ox->bb[i]))
+	    continue;
+	if (seg && !segHit(seg[0], seg[1], ox->obs[i]))
+	    continue;
+	addObs(ox, i);
+	cnt++;
+    }
+    RTreeLeafListFree(llp);
+    return cnt;
+}
+
+/* addAll:
+ * Add every obstacle to the subset. Used once the subset covers half
+ * of the obstacles, as checking the others one at a time no longer pays.
+ */
+static void addAll(obsindex_t * ox)
+{
+    int i;
+
+    for (i = 0; i < ox->npoly; i++)
+	addObs(ox, i);
+}
+
+static int cmpint(const void *x, const void *y)
+{
+    const int *a = x;
+    const int *b = y;
+
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+/* sortObs:
+ * Put the subset in index order, so the routing sees its obstacles in the
+ * same order as it would the full set, and collect them in sobs.
+ */
+static void sortObs(obsindex_t * ox)
+{
+    int i;
+
+    qsort(ox->sub, ox->nsub, sizeof(int), cmpint);
+    for (i = 0; i < ox->nsub; i++)
+	ox->sobs[i] = ox->obs[ox->sub[i]];
+}
+
+/* subPos:
+ * Position of obstacle i in the sorted subset. Polygon ids that are
+ * not obstacles are returned unchanged.
+ */
+static int subPos(obsindex_t * ox, int i)
+{
+    int *ip;
+
+    if (i < 0)
+	return i;
+    ip = bsearch(&i, ox->sub, ox->nsub, sizeof(int), cmpint);
+    return ip ? (int)(ip - ox->sub) : POLYID_NONE;
+}
+
+/* mkBarriers:
+ * Collect the edges of the obstacles in the subset, other than pp and qp.
+ */
+static void mkBarriers(obsindex_t * ox, int pp, int qp)
+{
+    int i, j, n = 0;
+    Ppoly_t *poly;
+
+    for (i = 0; i < ox->nsub; i++)
+	if (ox->sub[i] != pp && ox->sub[i] != qp)
+	    n += ox->obs[ox->sub[i]]->pn;
+    if (n > ox->szbars) {
+	ox->bars = gv_recalloc(ox->bars, ox->szbars, n, sizeof(Pedge_t));
+	ox->szbars = n;
+    }
+    n = 0;
+    for (i = 0; i < ox->nsub; i++) {
+	if (ox->sub[i] == pp || ox->sub[i] == qp)
+	    continue;
+	poly = ox->obs[ox->sub[i]];
+	for (j = 0; j < poly->pn; j++) {
+	    ox->bars[n].a = poly->ps[j];
+	    ox->bars[n].b = poly->ps[(j + 1) % poly->pn];
+	    n++;
+	}
+    }
+    ox->nbars = n;
+}
+
+obsindex_t *mkObsIndex(Ppoly_t ** obs, int npoly)
+{
+    obsindex_t *ox = gv_alloc(sizeof(obsindex_t));
+    Rect_t r;
+    int i;
+
+    ox->obs = obs;
+    ox->npoly = npoly;
+    ox->bb = gv_calloc(npoly, sizeof(boxf));
+    ox->in = gv_calloc(npoly, sizeof(bool));
+    ox->sub = gv_calloc(npoly, sizeof(int));
+    ox->sobs = gv_calloc(npoly, sizeof(Ppoly_t *));
+    ox->rtree = RTreeOpen();
+    for (i = 0; i < npoly; i++) {
+	ox->bb[i] = ptsBox(obs[i]->ps, obs[i]->pn);
+	ox->bb[i].LL.x -= FUZZ;
+	ox->bb[i].LL.y -= FUZZ;
+	ox->bb[i].UR.x += FUZZ;
+	ox->bb[i].UR.y += FUZZ;
+	r = mkRect(ox->bb[i]);
+	RTreeInsert(ox->rtree, &r, &ox->bb[i], &ox->rtree->root, 0);
+    }
+    return ox;
+}
+
+void freeObsIndex(obsindex_t * ox)
+{
+    if (!ox)
+	return;
+    RTreeClose(ox->rtree);
+    if (ox->all)
+	Pobsclose(ox->all);
+    free(ox->bb);
+    free(ox->in);
+    free(ox->sub);
+    free(ox->sobs);
+    free(ox->bars);
+    free(ox);
+}
+
+/* obsHit:
+ * Return the index of the first obstacle containing p, or POLYID_NONE.
+ */
+int obsHit(obsindex_t * ox, Ppoint_t p)
+{
+    boxf bb = {p, p};
+    Rect_t r = mkRect(bb);
+    LeafList_t *llp = RTreeSearch(ox->rtree, ox->rtree->root, &r);
+    LeafList_t *lp;
+    int i, hit = POLYID_NONE;
+
+    for (lp = llp; lp; lp = lp->next) {
+	i = (int)((boxf *) lp->leaf->data - ox->bb);
+	if ((hit == POLYID_NONE || i < hit) && in_poly(*ox->obs[i], p))
+	    hit = i;
+    }
+    RTreeLeafListFree(llp);
+    return hit;
+}
+
+/* obsPath:
+ * As Pobspath, for the obstacles in ox.
+ */
+void obsPath(obsindex_t * ox, Ppoint_t p, int pp, Ppoint_t q, int qp,
+	     Ppolyline_t * line)
+{
+    Ppoint_t seg[2] = {p, q};
+    vconfig_t *conf;
+    int i, cnt;
+
+    clearObs(ox);
+    addObs(ox, pp);
+    addObs(ox, qp);
+    addHits(ox, ptsBox(seg, 2), seg);
+    for (;;) {
+	if (2 * ox->nsub > ox->npoly) {
+	    if (!ox->all)
+		ox->all = Pobsopen(ox->obs, ox->npoly);
+	    Pobspath(ox->all, p, pp, q, qp, line);
+	    return;
+	}
+	sortObs(ox);
+	conf = Pobsopen(ox->sobs, ox->nsub);
+	Pobspath(conf, p, subPos(ox, pp), q, subPos(ox, qp), line);
+	Pobsclose(conf);
+	for (cnt = 0, i = 0; i + 1 < line->pn; i++)
+	    cnt += addHits(ox, ptsBox(line->ps + i, 2), line->ps + i);
+	if (cnt == 0)
+	    return;
+	free(line->ps);
+    }
+}
+
+/* obsSpline:
+ * As Proutespline, with the edges of the obstacles in ox, other than pp
+ * and qp, as barriers.
+ * Return 0 on success and -1 on failure.
+ */
+int obsSpline(obsindex_t * ox, Ppolyline_t line, int pp, int qp,
+	      Ppoint_t slopes[2], Ppolyline_t * spline)
+{
+    int i, cnt;
+
+    clearObs(ox);
+    addObs(ox, pp);
+    addObs(ox, qp);
+    for (i = 0; i + 1 < line.pn; i++)
+	addHits(ox, ptsBox(line.ps + i, 2), line.ps + i);
+    for (;;) {
+	if (2 * ox->nsub > ox->npoly)
+	    addAll(ox);
+	sortObs(ox);
+	mkBarriers(ox, pp, qp);
+	if (Proutespline(ox->bars, ox->nbars, line, slopes, spline) < 0)
+	    return -1;
+	/* each piece lies in the hull of its control points */
+	for (cnt = 0, i = 0; i + 3 < spline->pn; i += 3)
+	    cnt += addHits(ox, ptsBox(spline->ps + i, 4), NULL);
+	if (cnt == 0)
+	    return 0;
+    }
+}
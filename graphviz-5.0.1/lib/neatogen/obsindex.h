@@ -0,0 +1,28 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+#pragma once
+
+#include <render.h>
+#include <pathutil.h>
+
+/* Obstacles indexed in an R-tree. Paths and splines are routed around
+ * the obstacles near them only, adding others as the route runs into
+ * them, rather than around a visibility graph of all obstacles.
+ */
+typedef struct obsindex_s obsindex_t;
+
+extern obsindex_t *mkObsIndex(Ppoly_t **obs, int npoly);
+extern void freeObsIndex(obsindex_t *ox);
+extern int obsHit(obsindex_t *ox, Ppoint_t p);
+extern void obsPath(obsindex_t *ox, Ppoint_t p, int pp, Ppoint_t q, int qp,
+                    Ppolyline_t *line);
+extern int obsSpline(obsindex_t *ox, Ppolyline_t line, int pp, int qp,
+                     Ppoint_t slopes[2], Ppolyline_t *spline);
@@ -1,5 +1,8 @@
 #include <assert.h>
+#include <cgraph/alloc.h>
 #include <cgraph/bitarray.h>
+#include <cgraph/parallel.h>
+#include <float.h>
 #include <limits.h>
 #include <neatogen/neato.h>
 #include <neatogen/sgd.h>
@@ -8,27 +11,32 @@
 #include <neatogen/neatoprocs.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
+// the node at the other end of a term, which is a pivot if terms[ij].j < 0
+static int term_j(const term_sgd *term) {
+    return term->j < 0 ? -term->j - 1 : term->j;
+}
 
 static float calculate_stress(float *pos, term_sgd *terms, int n_terms) {
     float stress = 0;
     int ij;
     for (ij=0; ij<n_terms; ij++) {
-        float dx = pos[2*terms[ij].i] - pos[2*terms[ij].j];
-        float dy = pos[2*terms[ij].i+1] - pos[2*terms[ij].j+1];
+        int j = term_j(&terms[ij]);
+        float dx = pos[2*terms[ij].i] - pos[2*j];
+        float dy = pos[2*terms[ij].i+1] - pos[2*j+1];
         float r = hypotf(dx, dy) - terms[ij].d;
         stress += terms[ij].w * (r * r);
     }
     return stress;
 }
 // it is much faster to shuffle term rather than pointers to term, even though the swap is more expensive
-static rk_state rstate;
-static void fisheryates_shuffle(term_sgd *terms, int n_terms) {
+static void fisheryates_shuffle(term_sgd *terms, int n_terms, rk_state *rstate) {
     int i;
     for (i=n_terms-1; i>=1; i--) {
         // srand48() is called in neatoinit.c, so no need to seed here
         //int j = (int)(drand48() * (i+1));
-        int j = rk_interval(i, &rstate);
+        int j = rk_interval(i, rstate);
 
         term_sgd temp = terms[i];
         terms[i] = terms[j];
@@ -143,6 +151,505 @@ static void free_adjacency(graph_sgd *graph) {
 }
 
 
+// the number of hops within which the sparse model keeps the exact terms
+enum { SPARSE_HOPS = 2 };
+
+typedef struct {
+    float d;
+    int node;
+} search_entry;
+
+// scratch space for the shortest path searches of the sparse model, left
+// as it was found after each search so that it costs only what is reached
+typedef struct {
+    float *dists; // FLT_MAX for the nodes not reached
+    int *hops; // the number of edges on the path to each node reached
+    int *reached; // the nodes reached, in the order they were
+    int n_reached;
+    // a binary heap of nodes, pushed again rather than moved when their
+    // distance goes down
+    search_entry *heap;
+    size_t heap_size, heap_cap;
+} search_sgd;
+
+static void search_push(search_sgd *s, float d, int node) {
+    if (s->heap_size == s->heap_cap) {
+        size_t cap = s->heap_cap == 0 ? 64 : 2 * s->heap_cap;
+        s->heap = gv_recalloc(s->heap, s->heap_cap, cap, sizeof(search_entry));
+        s->heap_cap = cap;
+    }
+    size_t i = s->heap_size++;
+    while (i > 0 && s->heap[(i - 1) / 2].d > d) {
+        s->heap[i] = s->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->heap[i].d = d;
+    s->heap[i].node = node;
+}
+
+static search_entry search_pop(search_sgd *s) {
+    search_entry top = s->heap[0], last = s->heap[--s->heap_size];
+    size_t i = 0, child;
+    while ((child = 2 * i + 1) < s->heap_size) {
+        if (child + 1 < s->heap_size && s->heap[child + 1].d < s->heap[child].d)
+            child++;
+        if (s->heap[child].d >= last.d)
+            break;
+        s->heap[i] = s->heap[child];
+        i = child;
+    }
+    s->heap[i] = last;
+    return top;
+}
+
+// shortest paths from source to the nodes within max_hops edges of it,
+// found among the paths of at most max_hops edges
+static void search(graph_sgd *graph, int source, int max_hops, search_sgd *s) {
+    s->dists[source] = 0;
+    s->hops[source] = 0;
+    s->reached[s->n_reached++] = source;
+    search_push(s, 0, source);
+    while (s->heap_size > 0) {
+        search_entry e = search_pop(s);
+        if (e.d > s->dists[e.node] || s->hops[e.node] == max_hops) {
+            continue;
+        }
+        for (size_t x = graph->sources[e.node]; x < graph->sources[e.node + 1]; x++) {
+            int target = (int)graph->targets[x];
+            float d = e.d + graph->weights[x];
+            if (d < s->dists[target]) {
+                if (s->dists[target] == FLT_MAX) {
+                    s->reached[s->n_reached++] = target;
+                }
+                s->dists[target] = d;
+                s->hops[target] = s->hops[e.node] + 1;
+                search_push(s, d, target);
+            }
+        }
+    }
+}
+
+static void search_reset(search_sgd *s) {
+    for (int x = 0; x < s->n_reached; x++) {
+        s->dists[s->reached[x]] = FLT_MAX;
+    }
+    s->n_reached = 0;
+}
+
+static int cmp_float(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return x < y ? -1 : x > y;
+}
+
+// the pivots and the distances from them, for the sparse model
+typedef struct {
+    int n_pivots;
+    int *pivots;
+    float *dists; // dists[q*n + i] is the distance from pivot q to node i
+    // the distances from each pivot to the nodes closer to it than to the
+    // others, in increasing order from region[start[q]]
+    int *start;
+    float *region;
+} pivots_sgd;
+
+// pick up to n_pivots pivots, each the node farthest from those before
+static void choose_pivots(graph_sgd *graph, int n_pivots, search_sgd *s, pivots_sgd *p) {
+    int n = (int)graph->n;
+    float *mind = N_NEW(n, float);
+    int *closest = N_NEW(n, int);
+    int i, q, next = 0;
+
+    p->pivots = N_NEW(n_pivots, int);
+    p->dists = N_NEW((size_t)n_pivots * (size_t)n, float);
+    for (i = 0; i < n; i++) {
+        mind[i] = FLT_MAX;
+        closest[i] = -1;
+    }
+    for (q = 0; q < n_pivots; q++) {
+        float *dists = p->dists + (size_t)q * (size_t)n;
+        p->pivots[q] = next;
+        search(graph, next, INT_MAX, s);
+        for (i = 0; i < n; i++) {
+            dists[i] = s->dists[i];
+            if (dists[i] < mind[i]) {
+                mind[i] = dists[i];
+                closest[i] = q;
+            }
+        }
+        search_reset(s);
+        for (next = 0, i = 1; i < n; i++) {
+            if (mind[i] > mind[next])
+                next = i;
+        }
+        if (mind[next] == 0) { // every node is a pivot
+            q++;
+            break;
+        }
+    }
+    p->n_pivots = q;
+
+    p->start = N_NEW(p->n_pivots + 1, int);
+    p->region = N_NEW(n, float);
+    for (i = 0; i < n; i++) {
+        if (closest[i] >= 0)
+            p->start[closest[i] + 1]++;
+    }
+    for (q = 0; q < p->n_pivots; q++) {
+        p->start[q + 1] += p->start[q];
+    }
+    int *fill = N_NEW(p->n_pivots, int);
+    for (i = 0; i < n; i++) {
+        if (closest[i] >= 0)
+            p->region[p->start[closest[i]] + fill[closest[i]]++] = mind[i];
+    }
+    for (q = 0; q < p->n_pivots; q++) {
+        qsort(p->region + p->start[q], (size_t)(p->start[q + 1] - p->start[q]),
+              sizeof(float), cmp_float);
+    }
+    free(fill);
+    free(mind);
+    free(closest);
+}
+
+static void free_pivots(pivots_sgd *p) {
+    free(p->pivots);
+    free(p->dists);
+    free(p->start);
+    free(p->region);
+}
+
+// the number of nodes in the region of pivot q at most d from it
+static int region_count(const pivots_sgd *p, int q, float d) {
+    int lo = p->start[q], hi = p->start[q + 1];
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (p->region[mid] <= d)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - p->start[q];
+}
+
+static void add_term(term_sgd **terms, int *n_terms, int *cap, int i, int j,
+                     float d, float w) {
+    if (*n_terms == *cap) {
+        int c = *cap == 0 ? 1024 : 2 * *cap;
+        *terms = gv_recalloc(*terms, (size_t)*cap, (size_t)c, sizeof(term_sgd));
+        *cap = c;
+    }
+    (*terms)[*n_terms].i = i;
+    (*terms)[*n_terms].j = j;
+    (*terms)[*n_terms].d = d;
+    (*terms)[*n_terms].w = w;
+    (*n_terms)++;
+}
+
+// the terms of a range of nodes of the sparse model, worked out on one thread
+typedef struct {
+    graph_sgd *graph;
+    pivots_sgd *pivots;
+    int n_chunks;
+    term_sgd **terms; // per range
+    int *n_terms;
+} sparse_job;
+
+static void sparse_run(void *ctx, size_t c) {
+    sparse_job *job = ctx;
+    graph_sgd *graph = job->graph;
+    pivots_sgd *p = job->pivots;
+    int n = (int)graph->n;
+    search_sgd s = {0};
+    int cap = 0, i, q;
+
+    s.dists = N_NEW(n, float);
+    s.hops = N_NEW(n, int);
+    s.reached = N_NEW(n, int);
+    for (i = 0; i < n; i++) {
+        s.dists[i] = FLT_MAX;
+    }
+
+    int first = (int)((long long)n * (long long)c / job->n_chunks);
+    int last = (int)((long long)n * (long long)(c + 1) / job->n_chunks);
+    for (i = first; i < last; i++) {
+        if (bitarray_get(graph->pinneds, (size_t)i)) {
+            continue;
+        }
+        search(graph, i, SPARSE_HOPS, &s);
+        for (int x = 1; x < s.n_reached; x++) {
+            int j = s.reached[x];
+            // as in dijkstra_sgd, each pair once unless the other end is fixed
+            if (bitarray_get(graph->pinneds, j) || j < i) {
+                float d = s.dists[j];
+                add_term(&job->terms[c], &job->n_terms[c], &cap, i, j, d, 1 / (d * d));
+            }
+        }
+        for (q = 0; q < p->n_pivots; q++) {
+            float d = p->dists[(size_t)q * (size_t)n + (size_t)i];
+            if (s.dists[p->pivots[q]] != FLT_MAX || d == FLT_MAX) {
+                continue; // near i, so in an exact term, or not connected
+            }
+            int count = region_count(p, q, d / 2);
+            add_term(&job->terms[c], &job->n_terms[c], &cap, i, -p->pivots[q] - 1, d,
+                     (float)count / (d * d));
+        }
+        search_reset(&s);
+    }
+
+    free(s.dists);
+    free(s.hops);
+    free(s.reached);
+    free(s.heap);
+}
+
+/* The terms of the sparse stress model: exact ones between the nodes at
+ * most SPARSE_HOPS edges apart, and between each node and the pivots
+ * further away, weighted by the number of nodes the pivot stands for, in
+ * which only the node moves. Each takes time and space in proportion to
+ * the number of nodes times that of pivots and near nodes. The pivots are
+ * chosen one after the other, and the terms of ranges of nodes found on up
+ * to n_threads threads, then put in the order of the nodes.
+ */
+static term_sgd *sparse_terms(graph_sgd *graph, int n_pivots, int n_threads, int *n_terms) {
+    int n = (int)graph->n;
+    search_sgd s = {0};
+    pivots_sgd p = {0};
+    sparse_job job = {.graph = graph, .pivots = &p};
+    int i, c;
+
+    s.dists = N_NEW(n, float);
+    s.hops = N_NEW(n, int);
+    s.reached = N_NEW(n, int);
+    for (i = 0; i < n; i++) {
+        s.dists[i] = FLT_MAX;
+    }
+    choose_pivots(graph, n_pivots, &s, &p);
+    free(s.dists);
+    free(s.hops);
+    free(s.reached);
+    free(s.heap);
+
+    // one range per thread, as each needs scratch space for all nodes
+    job.n_chunks = n_threads < n ? n_threads : n;
+    job.terms = N_NEW(job.n_chunks, term_sgd *);
+    job.n_terms = N_NEW(job.n_chunks, int);
+    gv_parallel_for((size_t)job.n_chunks, n_threads, sparse_run, &job);
+
+    term_sgd *terms = job.terms[0];
+    *n_terms = 0;
+    for (c = 0; c < job.n_chunks; c++) {
+        *n_terms += job.n_terms[c];
+    }
+    if (job.n_chunks > 1) {
+        terms = N_NEW(*n_terms, term_sgd);
+        for (i = 0, c = 0; c < job.n_chunks; c++) {
+            if (job.n_terms[c] > 0)
+                memcpy(terms + i, job.terms[c], sizeof(term_sgd) * (size_t)job.n_terms[c]);
+            i += job.n_terms[c];
+            free(job.terms[c]);
+        }
+    }
+    free(job.terms);
+    free(job.n_terms);
+    free_pivots(&p);
+    return terms;
+}
+
+// the shortest paths from ranges of sources, for the full model
+typedef struct {
+    graph_sgd *graph;
+    term_sgd *terms;
+    int *offsets; // the first term of each source, leaving room for all it could make
+    int *counts; // the terms each source made
+} paths_job;
+
+enum { PATHS_CHUNK = 32 };
+
+static void paths_run(void *ctx, size_t c) {
+    paths_job *job = ctx;
+    int n = (int)job->graph->n;
+    for (int i = (int)c * PATHS_CHUNK; i < n && i < ((int)c + 1) * PATHS_CHUNK; i++) {
+        if (!bitarray_get(job->graph->pinneds, (size_t)i)) {
+            job->counts[i] = dijkstra_sgd(job->graph, i, job->terms + job->offsets[i]);
+        }
+    }
+}
+
+/* The terms of the full model, from a shortest path search from each node
+ * that is not fixed, on up to n_threads threads. Source i makes terms with
+ * the nodes before it and the fixed ones after it it can reach, so each
+ * gets room for that many, and the terms are then moved together.
+ */
+static term_sgd *full_terms(graph_sgd *graph, int n_threads, int *n_terms) {
+    int n = (int)graph->n, i, pinned_after = 0;
+    paths_job job = {.graph = graph};
+    size_t room = 0;
+
+    job.offsets = N_NEW(n, int);
+    job.counts = N_NEW(n, int);
+    for (i = n - 1; i >= 0; i--) {
+        if (bitarray_get(graph->pinneds, (size_t)i)) {
+            pinned_after++;
+        } else {
+            room += (size_t)(i + pinned_after);
+        }
+    }
+    assert(room <= INT_MAX);
+    for (room = 0, i = 0; i < n; i++) {
+        job.offsets[i] = (int)room;
+        if (bitarray_get(graph->pinneds, (size_t)i)) {
+            pinned_after--;
+        } else {
+            room += (size_t)(i + pinned_after);
+        }
+    }
+    job.terms = N_NEW(room, term_sgd);
+
+    gv_parallel_for(((size_t)n + PATHS_CHUNK - 1) / PATHS_CHUNK, n_threads, paths_run, &job);
+
+    *n_terms = 0;
+    for (i = 0; i < n; i++) {
+        if (job.counts[i] > 0 && *n_terms != job.offsets[i])
+            memmove(job.terms + *n_terms, job.terms + job.offsets[i],
+                    sizeof(term_sgd) * (size_t)job.counts[i]);
+        *n_terms += job.counts[i];
+    }
+    free(job.offsets);
+    free(job.counts);
+    return job.terms;
+}
+
+// one step of the gradient descent, on the ends of a term
+static void update_term(float *pos, const bool *unfixed, const term_sgd *term, float eta) {
+    // cap step size
+    float mu = eta * term->w;
+    if (mu > 1)
+        mu = 1;
+
+    int j = term_j(term);
+    float dx = pos[2*term->i] - pos[2*j];
+    float dy = pos[2*term->i+1] - pos[2*j+1];
+    float mag = hypotf(dx, dy);
+
+    if (term->j < 0) {
+        // a pivot, which stays, so i goes all the way
+        float r = (mu * (mag-term->d)) / mag;
+        if (unfixed[term->i]) {
+            pos[2*term->i] -= r * dx;
+            pos[2*term->i+1] -= r * dy;
+        }
+        return;
+    }
+
+    float r = (mu * (mag-term->d)) / (2*mag);
+    float r_x = r * dx;
+    float r_y = r * dy;
+
+    if (unfixed[term->i]) {
+        pos[2*term->i] -= r_x;
+        pos[2*term->i+1] -= r_y;
+    }
+    if (unfixed[term->j]) {
+        pos[2*term->j] += r_x;
+        pos[2*term->j+1] += r_y;
+    }
+}
+
+/* The terms split for the solve on several threads. The nodes are split
+ * into n_parts ranges, and the terms into blocks by the ranges of their
+ * ends. An epoch goes through rounds in which the blocks taken on at the
+ * same time have no range in common: first each range on its own, then
+ * the pairs of ranges of a round-robin tournament. The updates need no
+ * locks, and as each block is shuffled with a random state of its own,
+ * the layout only depends on the number of threads.
+ */
+typedef struct {
+    int n_parts;
+    int *start; // the terms of block b are start[b], ..., start[b+1] - 1
+    rk_state *rstates; // per block
+    term_sgd *terms;
+    float *pos;
+    const bool *unfixed;
+    float eta;
+    int *round; // the blocks of the current round
+} blocks_sgd;
+
+enum { BLOCK_MIN_NODES = 64 };
+
+static int node_part(int i, int n, int n_parts) {
+    return (int)((long long)i * n_parts / n);
+}
+
+static int block_of(int a, int b, int n_parts) {
+    return a < b ? a * n_parts + b : b * n_parts + a;
+}
+
+static void blocks_init(blocks_sgd *bl, term_sgd **terms, int n_terms, int n, int n_parts) {
+    int n_blocks = n_parts * n_parts, b, ij;
+    int *fill = N_NEW(n_blocks, int);
+    term_sgd *sorted = N_NEW(n_terms, term_sgd);
+
+    bl->n_parts = n_parts;
+    bl->start = N_NEW(n_blocks + 1, int);
+    bl->rstates = N_NEW(n_blocks, rk_state);
+    bl->round = N_NEW(n_parts, int);
+    for (ij = 0; ij < n_terms; ij++) {
+        const term_sgd *term = &(*terms)[ij];
+        bl->start[block_of(node_part(term->i, n, n_parts), node_part(term_j(term), n, n_parts),
+                           n_parts) + 1]++;
+    }
+    for (b = 0; b < n_blocks; b++) {
+        bl->start[b + 1] += bl->start[b];
+        rk_seed((unsigned long)b, &bl->rstates[b]);
+    }
+    for (ij = 0; ij < n_terms; ij++) {
+        const term_sgd *term = &(*terms)[ij];
+        b = block_of(node_part(term->i, n, n_parts), node_part(term_j(term), n, n_parts), n_parts);
+        sorted[bl->start[b] + fill[b]++] = *term;
+    }
+    free(*terms);
+    *terms = sorted;
+    bl->terms = sorted;
+    free(fill);
+}
+
+static void blocks_free(blocks_sgd *bl) {
+    free(bl->start);
+    free(bl->rstates);
+    free(bl->round);
+}
+
+static void block_run(void *ctx, size_t k) {
+    blocks_sgd *bl = ctx;
+    int b = bl->round[k];
+    term_sgd *terms = bl->terms + bl->start[b];
+    int n_terms = bl->start[b + 1] - bl->start[b];
+
+    fisheryates_shuffle(terms, n_terms, &bl->rstates[b]);
+    for (int ij = 0; ij < n_terms; ij++) {
+        update_term(bl->pos, bl->unfixed, &terms[ij], bl->eta);
+    }
+}
+
+// one epoch: the rounds of blocks, each on up to n_threads threads
+static void blocks_epoch(blocks_sgd *bl, int n_threads) {
+    int n_parts = bl->n_parts, m = n_parts - 1, a, k, q;
+
+    for (a = 0; a < n_parts; a++) {
+        bl->round[a] = block_of(a, a, n_parts);
+    }
+    gv_parallel_for((size_t)n_parts, n_threads, block_run, bl);
+
+    // the circle method: range m stays put while the others turn around it
+    for (q = 0; q < m; q++) {
+        bl->round[0] = block_of(q, m, n_parts);
+        for (k = 1; k < n_parts / 2; k++) {
+            bl->round[k] = block_of((q + k) % m, (q - k + m) % m, n_parts);
+        }
+        gv_parallel_for((size_t)(n_parts / 2), n_threads, block_run, bl);
+    }
+}
+
 void sgd(graph_t *G, /* input graph */
         int model /* distance model */)
 {
@@ -155,32 +662,29 @@ void sgd(graph_t *G, /* input graph */
         model = MODEL_SHORTPATH;
     }
     int n = agnnodes(G);
+    int n_pivots = late_int(G, agfindgraphattr(G, "pivots"), 0, 0);
+    int n_threads = late_int(G, agfindgraphattr(G, "threads"), 1, 1);
 
     if (Verbose) {
         fprintf(stderr, "calculating shortest paths and setting up stress terms:");
         start_timer();
     }
-    // calculate how many terms will be needed as fixed nodes can be ignored
-    int i, n_fixed = 0, n_terms = 0;
-    for (i=0; i<n; i++) {
-        if (!isFixed(GD_neato_nlist(G)[i])) {
-            n_fixed++;
-            n_terms += n-n_fixed;
-        }
-    }
-    term_sgd *terms = N_NEW(n_terms, term_sgd);
-    // calculate term values through shortest paths
-    int offset = 0;
+    int i, n_terms = 0;
+    term_sgd *terms;
     graph_sgd *graph = extract_adjacency(G, model);
-    for (i=0; i<n; i++) {
-        if (!isFixed(GD_neato_nlist(G)[i])) {
-            offset += dijkstra_sgd(graph, i, terms+offset);
-        }
+    if (n_pivots > 0 && n_pivots < n) {
+        terms = sparse_terms(graph, n_pivots, n_threads, &n_terms);
+    } else {
+        terms = full_terms(graph, n_threads, &n_terms);
     }
-    assert(offset == n_terms);
     free_adjacency(graph);
     if (Verbose) {
-        fprintf(stderr, " %.2f sec\n", elapsed_sec());
+        fprintf(stderr, " %d terms %.2f sec\n", n_terms, elapsed_sec());
+    }
+    if (n_terms == 0) { // every node is fixed
+        initial_positions(G, n);
+        free(terms);
+        return;
     }
 
     // initialise annealing schedule
@@ -216,31 +720,24 @@ void sgd(graph_t *G, /* input graph */
         start_timer();
     }
     int t;
+    rk_state rstate;
     rk_seed(0, &rstate); // TODO: get seed from graph
+    // several threads only pay with a few ranges of nodes for each
+    blocks_sgd blocks = {0};
+    if (n_threads > 1 && n >= 2 * n_threads * BLOCK_MIN_NODES) {
+        blocks_init(&blocks, &terms, n_terms, n, 2 * n_threads);
+        blocks.pos = pos;
+        blocks.unfixed = unfixed;
+    }
     for (t=0; t<MaxIter; t++) {
-        fisheryates_shuffle(terms, n_terms);
         float eta = eta_max * exp(-lambda * t);
-        for (ij=0; ij<n_terms; ij++) {
-            // cap step size
-            float mu = eta * terms[ij].w;
-            if (mu > 1)
-                mu = 1;
-
-            float dx = pos[2*terms[ij].i] - pos[2*terms[ij].j];
-            float dy = pos[2*terms[ij].i+1] - pos[2*terms[ij].j+1];
-            float mag = hypotf(dx, dy);
-
-            float r = (mu * (mag-terms[ij].d)) / (2*mag);
-            float r_x = r * dx;
-            float r_y = r * dy;
-
-            if (unfixed[terms[ij].i]) {
-                pos[2*terms[ij].i] -= r_x;
-                pos[2*terms[ij].i+1] -= r_y;
-            }
-            if (unfixed[terms[ij].j]) {
-                pos[2*terms[ij].j] += r_x;
-                pos[2*terms[ij].j+1] += r_y;
+        if (blocks.n_parts > 0) {
+            blocks.eta = eta;
+            blocks_epoch(&blocks, n_threads);
+        } else {
+            fisheryates_shuffle(terms, n_terms, &rstate);
+            for (ij=0; ij<n_terms; ij++) {
+                update_term(pos, unfixed, &terms[ij], eta);
             }
         }
         if (Verbose) {
@@ -251,6 +748,7 @@ void sgd(graph_t *G, /* input graph */
         fprintf(stderr, "\nfinished in %.2f sec\n", elapsed_sec());
     }
     free(terms);
+    blocks_free(&blocks);
 
     // copy temporary positions back into graph_t
     for (i=0; i<n; i++) {
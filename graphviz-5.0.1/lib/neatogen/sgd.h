@@ -8,7 +8,7 @@ extern "C" {
 #endif
 
 typedef struct term_sgd {
-    int i, j;
+    int i, j; // j < 0 for a pivot -j-1 of the sparse model, which only moves i
     float d, w;
 } term_sgd;
 
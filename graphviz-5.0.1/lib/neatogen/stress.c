@@ -18,6 +18,11 @@
 #include <neatogen/embed_graph.h>
 #include <neatogen/kkutils.h>
 #include <neatogen/stress.h>
+#ifdef SFDP
+#include <sparse/SparseMatrix.h>
+#include <sfdpgen/Multilevel.h>
+#include <sfdpgen/spring_electrical.h>
+#endif
 #include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -767,12 +772,12 @@ float *compute_apsp_packed(vtx_data * graph, int n)
     return Dij;
 }
 
-float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n)
+/* set_artificial_weights:
+ * Weight the graph so high-degree nodes are distantly located, returning
+ * the original weights for restore_weights.
+ */
+static float *set_artificial_weights(vtx_data * graph, int n)
 {
-    /* compute all-pairs-shortest-path-length while weighting the graph */
-    /* so high-degree nodes are distantly located */
-
-    float *Dij;
     int i, j;
     float *old_weights = graph[0].ewgts;
     int nedges = 0;
@@ -804,7 +809,6 @@ float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n)
 	    graph[i].ewgts = weights;
 	    weights += graph[i].nedges;
 	}
-	Dij = compute_weighted_apsp_packed(graph, n);
     } else {
 	for (i = 0; i < n; i++) {
 	    graph[i].ewgts = weights;
@@ -820,10 +824,16 @@ float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n)
 	    empty_neighbors_vec(graph, i, vtx_vec);
 	    weights += graph[i].nedges;
 	}
-	Dij = compute_apsp_packed(graph, n);
     }
 
     free(vtx_vec);
+    return old_weights;
+}
+
+static void restore_weights(vtx_data * graph, int n, float *old_weights)
+{
+    int i;
+
     free(graph[0].ewgts);
     graph[0].ewgts = NULL;
     if (old_weights != NULL) {
@@ -832,6 +842,23 @@ float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n)
 	    old_weights += graph[i].nedges;
 	}
     }
+}
+
+float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n)
+{
+    /* compute all-pairs-shortest-path-length while weighting the graph */
+    /* so high-degree nodes are distantly located */
+
+    float *Dij;
+    bool weighted = graph->ewgts != NULL;
+    float *old_weights = set_artificial_weights(graph, n);
+
+    if (weighted)
+	Dij = compute_weighted_apsp_packed(graph, n);
+    else
+	Dij = compute_apsp_packed(graph, n);
+
+    restore_weights(graph, n, old_weights);
     return Dij;
 }
 
@@ -853,62 +880,416 @@ static void dumpMatrix(float *Dij, int n)
  */
 #define DegType long double
 
-/* stress_majorization_kD_mkernel:
- * At present, if any nodes have pos set, smart_ini is false.
+/* Beyond this many entries in a packed n(n+1)/2 matrix, the two dense
+ * matrices of stress_majorization_kD_mkernel are not allocated, and the
+ * low-memory model below is used instead.
  */
-int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse representation */
-				   int n,	/* Number of nodes */
-				   double **d_coords,	/* coordinates of nodes (output layout) */
-				   node_t ** nodes,	/* original nodes */
-				   int dim,	/* dimemsionality of layout */
-				   int opts,    /* options */
-				   int model,	/* model */
-				   int maxi	/* max iterations */
-    )
+#ifndef STRESS_DENSE_MAX
+#define STRESS_DENSE_MAX ((size_t)1 << 27)
+#endif
+
+/* Most entries of the Laplacian kept by the low-memory model. Tiles beyond
+ * this are recomputed from shortest paths whenever they are needed.
+ */
+#ifndef STRESS_CACHE_MAX
+#define STRESS_CACHE_MAX ((size_t)1 << 28)
+#endif
+
+/* entries in a tile of the low-memory model */
+#define STRESS_TILE_SIZE ((size_t)1 << 20)
+
+/* lap_tiles:
+ * The weighted Laplacian of the low-memory model. Its off-diagonal entries
+ * are held as the packed upper triangle, without the diagonal, in tiles of
+ * consecutive rows. A tile is filled from the shortest paths of its rows,
+ * and kept if it fits within STRESS_CACHE_MAX entries.
+ */
+typedef struct {
+    vtx_data *graph;
+    int n;
+    int exp;
+    bool weighted;		/* shortest paths by Dijkstra, not BFS */
+    bool mds;			/* edges have their user-supplied length */
+    int n_tiles;
+    int *start;			/* tile t holds rows start[t] to start[t+1]-1 */
+    float **cache;		/* kept tiles, NULL for those recomputed */
+    float *scratch;		/* storage of a recomputed tile */
+    float *diag;		/* diagonal of the Laplacian */
+    DistType *Di;
+    float *Df;
+    Queue Q;
+} lap_tiles;
+
+static size_t tile_size(lap_tiles * lt, int t)
 {
-    int iterations;		/* output: number of iteration of the process */
+    size_t size = 0;
+    int i;
 
-    double conj_tol = tolerance_cg;	/* tolerance of Conjugate Gradient */
-    float *Dij = NULL;
-    int i, j, k;
-    float **coords = NULL;
-    float *f_storage = NULL;
-    float constant_term;
-    int count;
+    for (i = lt->start[t]; i < lt->start[t + 1]; i++)
+	size += (size_t)(lt->n - 1 - i);
+    return size;
+}
+
+/* fill_tile:
+ * Compute the entries of tile t into tile, as the dense model computes
+ * lap2, and return the sum of their distances.
+ */
+static double fill_tile(lap_tiles * lt, int t, float *tile)
+{
+    vtx_data *graph = lt->graph;
+    int n = lt->n;
+    int i, j, e;
+    size_t count = 0;
+    float d;
+    double sum = 0;
+
+    for (i = lt->start[t]; i < lt->start[t + 1]; i++) {
+	if (lt->weighted) {
+	    dijkstra_f(i, graph, n, lt->Df);
+	    if (lt->mds) {
+		for (e = 1; e < graph[i].nedges; e++)
+		    lt->Df[graph[i].edges[e]] = graph[i].ewgts[e];
+	    }
+	} else {
+	    bfs(i, graph, n, lt->Di, &lt->Q);
+	}
+	for (j = i + 1; j < n; j++) {
+	    d = lt->weighted ? lt->Df[j] : (float)lt->Di[j];
+	    sum += d;
+	    if (lt->exp == 2)
+		d *= d;
+	    tile[count++] = d != 0 ? 1.0f / d : 0;
+	}
+    }
+    return sum;
+}
+
+static float *get_tile(lap_tiles * lt, int t)
+{
+    if (lt->cache[t])
+	return lt->cache[t];
+    fill_tile(lt, t, lt->scratch);
+    return lt->scratch;
+}
+
+/* init_lap_tiles:
+ * Compute the Laplacian of the low-memory model a tile at a time, keeping
+ * the tiles that fit and the diagonal. The sum of all the distances is
+ * stored in dist_sum.
+ */
+static void init_lap_tiles(lap_tiles * lt, vtx_data * graph, int n,
+			   int exp, bool weighted, bool mds,
+			   double *dist_sum)
+{
+    int i, j, t;
+    size_t size, max_size = 0, cached = 0, count;
     DegType degree;
-    int lap_length;
-    float *lap2 = NULL;
-    DegType *degrees = NULL;
-    int step;
-    float val;
+    DegType *degrees;
+    float *tile;
+
+    lt->graph = graph;
+    lt->n = n;
+    lt->exp = exp;
+    lt->weighted = weighted;
+    lt->mds = mds;
+    lt->start = N_NEW(n + 1, int);
+    lt->n_tiles = 0;
+    for (i = 0; i < n;) {
+	lt->start[lt->n_tiles++] = i;
+	for (size = 0; i < n && size < STRESS_TILE_SIZE; i++)
+	    size += (size_t)(n - 1 - i);
+	max_size = MAX(max_size, size);
+    }
+    lt->start[lt->n_tiles] = n;
+    lt->cache = N_NEW(lt->n_tiles, float *);
+    lt->scratch = NULL;
+    lt->Di = NULL;
+    lt->Df = NULL;
+    if (weighted) {
+	lt->Df = N_NEW(n, float);
+    } else {
+	lt->Di = N_NEW(n, DistType);
+	mkQueue(&lt->Q, n);
+    }
+
+    degrees = N_NEW(n, DegType);
+    *dist_sum = 0;
+    for (t = 0; t < lt->n_tiles; t++) {
+	size = tile_size(lt, t);
+	if (cached + size <= STRESS_CACHE_MAX) {
+	    tile = lt->cache[t] = N_NEW(size, float);
+	    cached += size;
+	} else {
+	    if (!lt->scratch)
+		lt->scratch = N_NEW(max_size, float);
+	    tile = lt->scratch;
+	}
+	*dist_sum += fill_tile(lt, t, tile);
+	for (count = 0, i = lt->start[t]; i < lt->start[t + 1]; i++) {
+	    degree = 0;
+	    for (j = i + 1; j < n; j++, count++) {
+		degree += tile[count];
+		degrees[j] -= tile[count];
+	    }
+	    degrees[i] -= degree;
+	}
+    }
+    lt->diag = N_NEW(n, float);
+    for (i = 0; i < n; i++)
+	lt->diag[i] = (float)degrees[i];
+    free(degrees);
+
+    if (Verbose)
+	fprintf(stderr, ": %zu of %zu entries kept", cached,
+		(size_t)n * (size_t)(n - 1) / 2);
+}
+
+static void free_lap_tiles(lap_tiles * lt)
+{
+    int t;
+
+    for (t = 0; t < lt->n_tiles; t++)
+	free(lt->cache[t]);
+    free(lt->cache);
+    free(lt->start);
+    free(lt->scratch);
+    free(lt->diag);
+    free(lt->Df);
+    if (lt->Di) {
+	free(lt->Di);
+	freeQueue(&lt->Q);
+    }
+}
+
+/* mult_lap_tiles:
+ * result := L*vector for the Laplacian L of the low-memory model, as
+ * right_mult_with_vector_ff does for the dense one
+ */
+static void mult_lap_tiles(void *ctx, float *vector, float *result)
+{
+    lap_tiles *lt = ctx;
+    int n = lt->n;
+    int i, j, t;
+    size_t count;
+    float *tile;
+    float vector_i, res;
+
+    for (i = 0; i < n; i++)
+	result[i] = lt->diag[i] * vector[i];
+    for (t = 0; t < lt->n_tiles; t++) {
+	tile = get_tile(lt, t);
+	for (count = 0, i = lt->start[t]; i < lt->start[t + 1]; i++) {
+	    res = 0;
+	    vector_i = vector[i];
+	    for (j = i + 1; j < n; j++, count++) {
+		res += tile[count] * vector[j];
+		result[j] += tile[count] * vector_i;
+	    }
+	    result[i] += res;
+	}
+    }
+}
+
+/* lap_tiles_b:
+ * Set b[k] := L_Z*coords[k] for the Laplacian L_Z of the current layout,
+ * built as the dense model builds lap1, one pair of nodes at a time. Return
+ * the sum over k of coords[k]*L*coords[k] for the Laplacian L of the model.
+ */
+static double lap_tiles_b(lap_tiles * lt, float **coords, int dim,
+			  float **b)
+{
+    int n = lt->n;
+    int i, j, k, t;
+    size_t count;
+    float *tile;
+    float dist, val, delta;
+    double sum = 0;
+
+    for (k = 0; k < dim; k++)
+	set_vector_valf(n, 0, b[k]);
+    for (t = 0; t < lt->n_tiles; t++) {
+	tile = get_tile(lt, t);
+	for (count = 0, i = lt->start[t]; i < lt->start[t + 1]; i++) {
+	    for (j = i + 1; j < n; j++, count++) {
+		dist = 0;
+		for (k = 0; k < dim; k++) {
+		    delta = coords[k][i] - coords[k][j];
+		    dist += delta * delta;
+		}
+		sum -= tile[count] * dist;
+
+		/* convert to 1/d_{ij}, detecting overflows */
+		if (dist > 0)
+		    dist = 1.0f / sqrtf(dist);
+		if (dist >= FLT_MAX || dist < 0)
+		    dist = 0;
+		val = lt->exp == 2 ? sqrtf(tile[count]) * dist : dist;
+
+		for (k = 0; k < dim; k++) {
+		    delta = val * (coords[k][j] - coords[k][i]);
+		    b[k][i] += delta;
+		    b[k][j] -= delta;
+		}
+	    }
+	}
+    }
+    return sum;
+}
+
+/* lap_tiles_stress:
+ * The stress of the layout, as compute_stressf gives for the dense model
+ */
+static double lap_tiles_stress(lap_tiles * lt, float **coords, int dim)
+{
+    int n = lt->n;
+    int i, j, k, t;
+    size_t count;
+    float *tile;
+    double sum = 0, dist, delta, Dij;
+
+    for (t = 0; t < lt->n_tiles; t++) {
+	tile = get_tile(lt, t);
+	for (count = 0, i = lt->start[t]; i < lt->start[t + 1]; i++) {
+	    for (j = i + 1; j < n; j++, count++) {
+		dist = 0;
+		for (k = 0; k < dim; k++) {
+		    delta = coords[k][i] - coords[k][j];
+		    dist += delta * delta;
+		}
+		dist = sqrt(dist);
+		if (lt->exp == 2)
+		    Dij = 1.0 / sqrt(tile[count]);
+		else
+		    Dij = 1.0 / tile[count];
+		sum += (Dij - dist) * (Dij - dist) * tile[count];
+	    }
+	}
+    }
+    return sum;
+}
+
+/* majorization_lowmem:
+ * The optimization of stress_majorization_kD_mkernel for the low-memory
+ * model. Neither the Laplacian of the distances nor that of the layout is
+ * stored: the former is kept in tiles, recomputing those that do not fit,
+ * and the latter is applied a pair of nodes at a time.
+ */
+static int majorization_lowmem(vtx_data * graph, int n, double **d_coords,
+			       float **coords, node_t ** nodes, int dim,
+			       int exp, int model, int maxi, int havePinned)
+{
+    int iterations;
+    double conj_tol = tolerance_cg;
+    bool weighted = graph->ewgts != NULL;
+    bool subset = model == MODEL_SUBSET;
+    float *old_weights = NULL;
+    lap_tiles tiles;
+    double dist_sum, constant_term;
     double old_stress, new_stress;
     bool converged;
-    float **b = NULL;
-    float *tmp_coords = NULL;
-    float *dist_accumulator = NULL;
-    float *lap1 = NULL;
-    int smart_ini = opts & opt_smart_init;
-    int exp = opts & opt_exp_flag;
-    int len;
-    int havePinned;		/* some node is pinned */
-#ifdef ALTERNATIVE_STRESS_CALC
-    double mat_stress;
-#endif
+    float **b;
+    float *tmp_coords;
+    int i, j, k;
 
-	/*************************************************
-	** Computation of full, dense, unrestricted k-D ** 
-	** stress minimization by majorization          **    
-	*************************************************/
+    /* weight graph to separate high-degree nodes */
+    if (subset)
+	old_weights = set_artificial_weights(graph, n);
+    init_lap_tiles(&tiles, graph, n, exp, weighted,
+		   model == MODEL_MDS && weighted, &dist_sum);
 
-	/****************************************************
-	** Compute the all-pairs-shortest-distances matrix **
-	****************************************************/
+    /* compute constant term in stress sum, as the dense model does */
+    if (exp)
+	constant_term = (double)n * (n - 1) / 2;
+    else
+	constant_term = dist_sum;
 
-    if (maxi < 0)
-	return 0;
+    b = N_NEW(dim, float *);
+    b[0] = N_NEW(dim * n, float);
+    for (k = 1; k < dim; k++) {
+	b[k] = b[0] + k * n;
+    }
+    tmp_coords = N_NEW(n, float);
 
-    if (Verbose)
+    old_stress = MAXDOUBLE;	/* at least one iteration */
+    if (Verbose) {
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+	fprintf(stderr, "Solving model: ");
 	start_timer();
+    }
+
+    for (converged = false, iterations = 0;
+	 iterations < maxi && !converged; iterations++) {
+	double lap_term = lap_tiles_b(&tiles, coords, dim, b);
+
+	/* compute new stress  */
+	/* remember that the Laplacians are negated, so we subtract instead of add and vice versa */
+	new_stress = 0;
+	for (k = 0; k < dim; k++) {
+	    new_stress += vectors_inner_productf(n, coords[k], b[k]);
+	}
+	new_stress *= 2;
+	new_stress += constant_term;	/* only after mult by 2 */
+	new_stress -= lap_term;
+
+	{
+	    double diff = old_stress - new_stress;
+	    double change = fabs(diff);
+	    converged = change / old_stress < Epsilon || new_stress < Epsilon;
+	}
+	old_stress = new_stress;
+
+	for (k = 0; k < dim; k++) {
+	    if (havePinned) {
+		copy_vectorf(n, coords[k], tmp_coords);
+		if (conjugate_gradient_op(mult_lap_tiles, &tiles, tmp_coords,
+					  b[k], n, conj_tol, n) < 0) {
+		    iterations = -1;
+		    goto finish;
+		}
+		for (i = 0; i < n; i++) {
+		    if (!isFixed(nodes[i]))
+			coords[k][i] = tmp_coords[i];
+		}
+	    } else if (conjugate_gradient_op(mult_lap_tiles, &tiles,
+					     coords[k], b[k], n, conj_tol,
+					     n) < 0) {
+		iterations = -1;
+		goto finish;
+	    }
+	}
+	if (Verbose && iterations % 5 == 0) {
+	    fprintf(stderr, "%.3f ", new_stress);
+	    if ((iterations + 5) % 50 == 0)
+		fprintf(stderr, "\n");
+	}
+    }
+    if (Verbose) {
+	fprintf(stderr, "\nfinal e = %f %d iterations %.2f sec\n",
+		lap_tiles_stress(&tiles, coords, dim), iterations,
+		elapsed_sec());
+    }
+
+    for (i = 0; i < dim; i++) {
+	for (j = 0; j < n; j++) {
+	    d_coords[i][j] = coords[i][j];
+	}
+    }
+finish:
+    free(b[0]);
+    free(b);
+    free(tmp_coords);
+    free_lap_tiles(&tiles);
+    if (subset)
+	restore_weights(graph, n, old_weights);
+    return iterations;
+}
+
+/* model_distances:
+ * The packed matrix of the target distances of the given model.
+ */
+static float *model_distances(vtx_data * graph, int n, int model)
+{
+    float *Dij = NULL;
 
     if (model == MODEL_SUBSET) {
 	/* weight graph to separate high-degree nodes */
@@ -937,69 +1318,39 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 	else
 	    Dij = compute_apsp_packed(graph, n);
     }
+    return Dij;
+}
 
-    if (Verbose) {
-	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
-	fprintf(stderr, "Setting initial positions");
-	start_timer();
-    }
-
-	/**************************
-	** Layout initialization **
-	**************************/
-
-    if (smart_ini && n > 1) {
-	havePinned = 0;
-	/* optimize layout quickly within subspace */
-	/* perform at most 50 iterations within 30-D subspace to 
-	   get an estimate */
-	if (sparse_stress_subspace_majorization_kD(graph, n,
-					       d_coords, dim, smart_ini, exp,
-					       model == MODEL_SUBSET, 50,
-					       neighborhood_radius_subspace,
-					       num_pivots_stress) < 0) {
-	    iterations = -1;
-	    goto finish1;
-	}
-
-	for (i = 0; i < dim; i++) {
-	    /* for numerical stability, scale down layout */
-	    double max = 1;
-	    for (j = 0; j < n; j++) {
-		if (fabs(d_coords[i][j]) > max) {
-		    max = fabs(d_coords[i][j]);
-		}
-	    }
-	    for (j = 0; j < n; j++) {
-		d_coords[i][j] /= max;
-	    }
-	    /* add small random noise */
-	    for (j = 0; j < n; j++) {
-		d_coords[i][j] += 1e-6 * (drand48() - 0.5);
-	    }
-	    orthog1(n, d_coords[i]);
-	}
-    } else {
-	havePinned = initLayout(n, dim, d_coords, nodes);
-    }
-    if (Verbose)
-	fprintf(stderr, ": %.2f sec", elapsed_sec());
-    if (n == 1 || maxi == 0)
-	return 0;
-
-    if (Verbose) {
-	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
-	fprintf(stderr, "Setting up stress function");
-	start_timer();
-    }
-    coords = N_NEW(dim, float *);
-    f_storage = N_NEW(dim * n, float);
-    for (i = 0; i < dim; i++) {
-	coords[i] = f_storage + i * n;
-	for (j = 0; j < n; j++) {
-	    coords[i][j] = (float)d_coords[i][j];
-	}
-    }
+/* majorization_dense:
+ * The optimization of stress_majorization_kD_mkernel for the dense model,
+ * starting from coords. The packed distances Dij are overwritten with
+ * the Laplacian of their weights.
+ */
+static int majorization_dense(float *Dij, int n, double **d_coords,
+			      float **coords, node_t ** nodes, int dim,
+			      int exp, int maxi, int havePinned)
+{
+    int iterations;
+    double conj_tol = tolerance_cg;	/* tolerance of Conjugate Gradient */
+    int i, j, k;
+    float constant_term;
+    int count;
+    DegType degree;
+    int lap_length;
+    float *lap2 = NULL;
+    DegType *degrees = NULL;
+    int step;
+    float val;
+    double old_stress, new_stress;
+    bool converged;
+    float **b = NULL;
+    float *tmp_coords = NULL;
+    float *dist_accumulator = NULL;
+    float *lap1 = NULL;
+    int len;
+#ifdef ALTERNATIVE_STRESS_CALC
+    double mat_stress;
+#endif
 
     /* compute constant term in stress sum */
     /* which is \sum_{i<j} w_{ij}d_{ij}^2 */
@@ -1184,7 +1535,7 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 		if (conjugate_gradient_mkernel(lap2, tmp_coords, b[k], n,
 					   conj_tol, n) < 0) {
 		    iterations = -1;
-		    goto finish1;
+		    goto finish;
 		}
 		for (i = 0; i < n; i++) {
 		    np = nodes[i];
@@ -1195,7 +1546,7 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 		if (conjugate_gradient_mkernel(lap2, coords[k], b[k], n,
 					   conj_tol, n) < 0) {
 		    iterations = -1;
-		    goto finish1;
+		    goto finish;
 		}
 	    }
 	}
@@ -1216,11 +1567,7 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 	    d_coords[i][j] = coords[i][j];
 	}
     }
-finish1:
-    free(f_storage);
-    free(coords);
-
-    free(lap2);
+finish:
     if (b) {
 	free(b[0]);
 	free(b);
@@ -1231,3 +1578,367 @@ finish1:
     free(lap1);
     return iterations;
 }
+
+/* majorize:
+ * Minimize the stress of the layout d_coords, with the dense model if the
+ * packed distances Dij are given and the low-memory one otherwise.
+ */
+static int majorize(vtx_data * graph, float *Dij, int n, double **d_coords,
+		    node_t ** nodes, int dim, int exp, int model, int maxi,
+		    int havePinned)
+{
+    int iterations;
+    float **coords = N_NEW(dim, float *);
+    float *f_storage = N_NEW(dim * n, float);
+    int i, j;
+
+    for (i = 0; i < dim; i++) {
+	coords[i] = f_storage + i * n;
+	for (j = 0; j < n; j++) {
+	    coords[i][j] = (float)d_coords[i][j];
+	}
+    }
+
+    if (Dij)
+	iterations = majorization_dense(Dij, n, d_coords, coords, nodes,
+					dim, exp, maxi, havePinned);
+    else
+	iterations = majorization_lowmem(graph, n, d_coords, coords, nodes,
+					 dim, exp, model, maxi, havePinned);
+
+    free(f_storage);
+    free(coords);
+    return iterations;
+}
+
+/* stress_majorization_kD_mkernel:
+ * At present, if any nodes have pos set, smart_ini is false.
+ */
+int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse representation */
+				   int n,	/* Number of nodes */
+				   double **d_coords,	/* coordinates of nodes (output layout) */
+				   node_t ** nodes,	/* original nodes */
+				   int dim,	/* dimemsionality of layout */
+				   int opts,    /* options */
+				   int model,	/* model */
+				   int maxi	/* max iterations */
+    )
+{
+    int iterations;		/* output: number of iteration of the process */
+
+    float *Dij = NULL;
+    int i, j;
+    int smart_ini = opts & opt_smart_init;
+    int exp = opts & opt_exp_flag;
+    int havePinned;		/* some node is pinned */
+    /* the circuit model needs its dense matrices to be computed */
+    bool lowmem = model != MODEL_CIRCUIT
+	&& (size_t)n * (size_t)(n + 1) / 2 > STRESS_DENSE_MAX;
+
+	/*************************************************
+	** Computation of full, dense, unrestricted k-D ** 
+	** stress minimization by majorization          **    
+	*************************************************/
+
+	/****************************************************
+	** Compute the all-pairs-shortest-distances matrix **
+	****************************************************/
+
+    if (maxi < 0)
+	return 0;
+
+    if (Verbose)
+	start_timer();
+
+    if (lowmem) {
+	/* distances are computed as the model is set up */
+	if (Verbose)
+	    fprintf(stderr, "Using low-memory model");
+    } else
+	Dij = model_distances(graph, n, model);
+
+    if (Verbose) {
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+	fprintf(stderr, "Setting initial positions");
+	start_timer();
+    }
+
+	/**************************
+	** Layout initialization **
+	**************************/
+
+    if (smart_ini && n > 1) {
+	havePinned = 0;
+	/* optimize layout quickly within subspace */
+	/* perform at most 50 iterations within 30-D subspace to 
+	   get an estimate */
+	if (sparse_stress_subspace_majorization_kD(graph, n,
+					       d_coords, dim, smart_ini, exp,
+					       model == MODEL_SUBSET, 50,
+					       neighborhood_radius_subspace,
+					       num_pivots_stress) < 0) {
+	    iterations = -1;
+	    goto finish1;
+	}
+
+	for (i = 0; i < dim; i++) {
+	    /* for numerical stability, scale down layout */
+	    double max = 1;
+	    for (j = 0; j < n; j++) {
+		if (fabs(d_coords[i][j]) > max) {
+		    max = fabs(d_coords[i][j]);
+		}
+	    }
+	    for (j = 0; j < n; j++) {
+		d_coords[i][j] /= max;
+	    }
+	    /* add small random noise */
+	    for (j = 0; j < n; j++) {
+		d_coords[i][j] += 1e-6 * (drand48() - 0.5);
+	    }
+	    orthog1(n, d_coords[i]);
+	}
+    } else {
+	havePinned = initLayout(n, dim, d_coords, nodes);
+    }
+    if (Verbose)
+	fprintf(stderr, ": %.2f sec", elapsed_sec());
+    if (n == 1 || maxi == 0)
+	return 0;
+
+    if (Verbose) {
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+	fprintf(stderr, "Setting up stress function");
+	start_timer();
+    }
+    iterations = majorize(graph, Dij, n, d_coords, nodes, dim, exp, model,
+			  maxi, havePinned);
+
+finish1:
+    free(Dij);
+    return iterations;
+}
+
+#ifdef SFDP
+/* smallest graph stress_majorization_multilevel coarsens to */
+#define ML_COARSEST_SIZE 50
+
+/* rep_distances:
+ * The packed matrix of the distances in the graph between the nodes reps,
+ * which represent the nc nodes of a coarser graph.
+ */
+static float *rep_distances(vtx_data * graph, int n, int *reps, int nc)
+{
+    float *Dij = N_NEW((size_t)nc * (size_t)(nc + 1) / 2, float);
+    DistType *Di = NULL;
+    float *Df = NULL;
+    Queue Q;
+    size_t count = 0;
+    int i, j;
+
+    if (graph->ewgts)
+	Df = N_NEW(n, float);
+    else {
+	Di = N_NEW(n, DistType);
+	mkQueue(&Q, n);
+    }
+    for (i = 0; i < nc; i++) {
+	if (Df) {
+	    dijkstra_f(reps[i], graph, n, Df);
+	    for (j = i; j < nc; j++)
+		Dij[count++] = Df[reps[j]];
+	} else {
+	    bfs(reps[i], graph, n, Di, &Q);
+	    for (j = i; j < nc; j++)
+		Dij[count++] = (float)Di[reps[j]];
+	}
+    }
+    if (Di)
+	freeQueue(&Q);
+    free(Di);
+    free(Df);
+    return Dij;
+}
+
+/* prolongate:
+ * Map the layout xc of a coarse graph, row by row, to the finer graph
+ * grid, as sfdp does: each node starts from its coarse node, and is moved
+ * halfway to its neighbors. The nodes other than the first of a coarse
+ * node are perturbed a little, so that none stay on top of each other.
+ */
+static double *prolongate(Multilevel grid, double *xc, int dim)
+{
+    SparseMatrix R = grid->R;
+    double *xf = NULL;
+    int i, j, k;
+
+    SparseMatrix_multiply_dense(grid->next->P, xc, &xf, dim);
+    interpolate_coord(dim, grid->A, xf);
+    for (i = 0; i < R->m; i++) {
+	for (j = R->ia[i] + 1; j < R->ia[i + 1]; j++) {
+	    for (k = 0; k < dim; k++)
+		xf[R->ja[j] * dim + k] += 0.01 * (drand48() - 0.5);
+	}
+    }
+    return xf;
+}
+#endif
+
+/* stress_majorization_multilevel:
+ * Stress majorization on the multilevel coarsening of sfdp. The coarsest
+ * graph is laid out first. Each of its nodes represents a node of the
+ * original graph, and the target distances are those between the
+ * representatives in the original graph. The layout is prolongated to each
+ * finer graph in turn, where it is close to optimal, so few iterations are
+ * needed to refine it. The original graph gets the model's distances.
+ * Without sfdp, for small graphs, or if nodes have initial positions, this
+ * is stress_majorization_kD_mkernel.
+ */
+int stress_majorization_multilevel(vtx_data * graph, int n, double **d_coords,
+				   node_t ** nodes, int dim, int opts,
+				   int model, int maxi)
+{
+#ifdef SFDP
+    int exp = opts & opt_exp_flag;
+    bool lowmem = model != MODEL_CIRCUIT
+	&& (size_t)n * (size_t)(n + 1) / 2 > STRESS_DENSE_MAX;
+    Multilevel_control ctrl;
+    Multilevel grid0, grid;
+    SparseMatrix A;
+    int *irn, *jcn;
+    double *val;
+    int **reps;
+    double *x, *xf;
+    double **lcoords;
+    float *Dij;
+    int nz, nc, iterations = 0;
+    int i, j, k;
+
+    if (maxi <= 0 || n <= ML_COARSEST_SIZE)
+	return stress_majorization_kD_mkernel(graph, n, d_coords, nodes, dim,
+					      opts, model, maxi);
+    for (i = 0; i < n; i++) {
+	if (hasPos(nodes[i]))
+	    return stress_majorization_kD_mkernel(graph, n, d_coords, nodes,
+						  dim, opts, model, maxi);
+    }
+
+    if (Verbose) {
+	fprintf(stderr, "Coarsening graph");
+	start_timer();
+    }
+    for (nz = 0, i = 0; i < n; i++)
+	nz += graph[i].nedges - 1;
+    irn = N_NEW(nz, int);
+    jcn = N_NEW(nz, int);
+    val = N_NEW(nz, double);
+    for (nz = 0, i = 0; i < n; i++) {
+	for (j = 1; j < graph[i].nedges; j++, nz++) {
+	    irn[nz] = i;
+	    jcn[nz] = graph[i].edges[j];
+	    val[nz] = 1;
+	}
+    }
+    A = SparseMatrix_from_coordinate_arrays(nz, n, n, irn, jcn, val,
+					    MATRIX_TYPE_REAL, sizeof(double));
+    free(irn);
+    free(jcn);
+    free(val);
+    ctrl = Multilevel_control_new(COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_SUPERNODES_FIRST,
+				  COARSEN_MODE_FORCEFUL);
+    ctrl->minsize = ML_COARSEST_SIZE;
+    grid0 = Multilevel_new(A, NULL, ctrl);
+    grid = Multilevel_get_coarsest(grid0);
+    if (Verbose)
+	fprintf(stderr, ": %d levels, %.2f sec\n", grid->level + 1,
+		elapsed_sec());
+
+    /* the representative of a coarse node is that of its first fine node */
+    reps = N_NEW(grid->level + 1, int *);
+    reps[0] = N_NEW(n, int);
+    for (i = 0; i < n; i++)
+	reps[0][i] = i;
+    for (grid = grid0->next; grid; grid = grid->next) {
+	SparseMatrix P = grid->P;
+	int *rep = reps[grid->level] = N_NEW(grid->n, int);
+	for (i = 0; i < grid->n; i++)
+	    rep[i] = -1;
+	for (i = 0; i < P->m; i++) {
+	    k = P->ja[P->ia[i]];
+	    if (rep[k] < 0)
+		rep[k] = reps[grid->level - 1][i];
+	}
+    }
+
+    /* start the coarsest graph from a random layout, as initLayout does */
+    grid = Multilevel_get_coarsest(grid0);
+    x = N_NEW(grid->n * dim, double);
+    for (i = 0; i < grid->n * dim; i++)
+	x[i] = drand48();
+    lcoords = N_NEW(dim, double *);
+    lcoords[0] = N_NEW(n * dim, double);
+    for (; grid; grid = grid->prev) {
+	nc = grid->n;
+	if (grid->next) {
+	    xf = prolongate(grid, x, dim);
+	    free(x);
+	    x = xf;
+	}
+	if (Multilevel_is_finest(grid)) {
+	    for (k = 0; k < dim; k++) {
+		for (i = 0; i < n; i++)
+		    d_coords[k][i] = x[i * dim + k];
+		orthog1(n, d_coords[k]);
+	    }
+	    if (Verbose) {
+		fprintf(stderr, "Level 0, %d nodes\n", nc);
+		start_timer();
+	    }
+	    Dij = lowmem ? NULL : model_distances(graph, n, model);
+	    iterations = majorize(graph, Dij, n, d_coords, nodes, dim, exp,
+				  model, maxi, 0);
+	    free(Dij);
+	    break;
+	}
+	/* too large for the dense model; leave it to the finer graphs */
+	if ((size_t)nc * (size_t)(nc + 1) / 2 > STRESS_DENSE_MAX)
+	    continue;
+
+	if (Verbose) {
+	    fprintf(stderr, "Level %d, %d nodes", grid->level, nc);
+	    start_timer();
+	}
+	Dij = rep_distances(graph, n, reps[grid->level], nc);
+	for (k = 0; k < dim; k++) {
+	    lcoords[k] = lcoords[0] + k * nc;
+	    for (i = 0; i < nc; i++)
+		lcoords[k][i] = x[i * dim + k];
+	    orthog1(nc, lcoords[k]);
+	}
+	iterations = majorize(NULL, Dij, nc, lcoords, NULL, dim, exp,
+			      model, maxi, 0);
+	free(Dij);
+	if (iterations < 0)
+	    break;
+	for (k = 0; k < dim; k++) {
+	    for (i = 0; i < nc; i++)
+		x[i * dim + k] = lcoords[k][i];
+	}
+    }
+
+    free(x);
+    free(lcoords[0]);
+    free(lcoords);
+    grid = Multilevel_get_coarsest(grid0);
+    for (i = 0; i <= grid->level; i++)
+	free(reps[i]);
+    free(reps);
+    Multilevel_delete(grid0);
+    Multilevel_control_delete(ctrl);
+    SparseMatrix_delete(A);
+    return iterations;
+#else
+    return stress_majorization_kD_mkernel(graph, n, d_coords, nodes, dim,
+					  opts, model, maxi);
+#endif
+}
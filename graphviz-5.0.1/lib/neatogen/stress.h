@@ -50,6 +50,14 @@ extern "C" {
 					      int maxi	/* max iterations */
 	);
 
+    /* Stress majorization refined from the coarsest graph of sfdp's
+     * multilevel coarsening to the original one
+     */
+    extern int stress_majorization_multilevel(vtx_data * graph, int n,
+					      double **coords, node_t **nodes,
+					      int dim, int opts, int model,
+					      int maxi);
+
 extern float *compute_apsp_packed(vtx_data * graph, int n);
 extern float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n);
 extern float* circuitModel(vtx_data * graph, int nG);
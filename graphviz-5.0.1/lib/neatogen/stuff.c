@@ -578,6 +578,7 @@ void move_node(graph_t * G, int nG, node_t * n)
 static node_t **Heap;
 static int Heapsize;
 static node_t *Src;
+static Agcsr_t *Csr;
 
 static void heapup(node_t * v)
 {
@@ -650,6 +651,23 @@ node_t *neato_dequeue(void)
     return rv;
 }
 
+/* relax:
+ * Shorten the path to u through its neighbor v to f if that is an
+ * improvement.
+ */
+static void relax(node_t * v, node_t * u, double f)
+{
+    if (ND_dist(u) > f) {
+	ND_dist(u) = f;
+	if (ND_heapindex(u) >= 0)
+	    heapup(u);
+	else {
+	    ND_hops(u) = ND_hops(v) + 1;
+	    neato_enqueue(u);
+	}
+    }
+}
+
 void shortest_path(graph_t * G, int nG)
 {
     node_t *v;
@@ -659,20 +677,30 @@ void shortest_path(graph_t * G, int nG)
 	fprintf(stderr, "Calculating shortest paths: ");
 	start_timer();
     }
+    /* Every source walks the whole graph, so take a flat copy of the
+     * adjacency once rather than chasing the edge sets nG times.
+     */
+    Csr = agcsr(G);
     for (v = agfstnode(G); v; v = agnxtnode(G, v))
 	s1(G, v);
+    agcsrfree(Csr);
+    Csr = NULL;
     if (Verbose) {
 	fprintf(stderr, "%.2f sec\n", elapsed_sec());
     }
     free(Heap);
 }
 
+/* s1:
+ * Single source shortest paths from node, using the snapshot of G taken
+ * by shortest_path. Edges are visited in agfstedge/agnxtedge order.
+ */
 void s1(graph_t * G, node_t * node)
 {
     node_t *v, *u;
-    edge_t *e;
-    int t;
-    double f;
+    int t, i, k;
+
+    assert(Csr != NULL);
 
     for (t = 0; (v = GD_neato_nlist(G)[t]); t++)
 	ND_dist(v) = Initial_dist;
@@ -684,19 +712,16 @@ void s1(graph_t * G, node_t * node)
     while ((v = neato_dequeue())) {
 	if (v != Src)
 	    make_spring(G, Src, v, ND_dist(v));
-	for (e = agfstedge(G, v); e; e = agnxtedge(G, e, v)) {
-	    if ((u = agtail(e)) == v)
-		u = aghead(e);
-	    f = ND_dist(v) + ED_dist(e);
-	    if (ND_dist(u) > f) {
-		ND_dist(u) = f;
-		if (ND_heapindex(u) >= 0)
-		    heapup(u);
-		else {
-		    ND_hops(u) = ND_hops(v) + 1;
-		    neato_enqueue(u);
-		}
-	    }
+	i = agcsrindex(Csr, v);
+	for (k = Csr->out_offset[i]; k < Csr->out_offset[i + 1]; k++) {
+	    u = Csr->node[Csr->out_target[k]];
+	    relax(v, u, ND_dist(v) + ED_dist(Csr->out_edge[k]));
+	}
+	for (k = Csr->in_offset[i]; k < Csr->in_offset[i + 1]; k++) {
+	    if (Csr->in_source[k] == i)
+		continue;	/* loops were seen as out-edges */
+	    u = Csr->node[Csr->in_source[k]];
+	    relax(v, u, ND_dist(v) + ED_dist(Csr->in_edge[k]));
 	}
     }
 }
@@ -50,6 +50,33 @@ extern "C" {
 /* function to convert a polyline into a spline representation */
     PATHPLAN_API void make_polyline(Ppolyline_t line, Ppolyline_t* sline);
 
+/* Scratch space for routing. A workspace keeps the buffers used by the
+ * functions below, and the routes they return, until its next use, and
+ * only grows them, so routing with one does not allocate once it has seen
+ * the largest input. A workspace may only be used by one thread at a time;
+ * to route on several threads, give each its own. */
+    typedef struct Pworkspace_s Pworkspace_t;
+
+    PATHPLAN_API Pworkspace_t *Pworkspace_new(void);
+    PATHPLAN_API void Pworkspace_free(Pworkspace_t * ws);
+
+/* as Pshortestpath, Proutespline and make_polyline, using the scratch
+ * space in ws */
+    PATHPLAN_API int Pshortestpath_ws(Pworkspace_t * ws, Ppoly_t * boundary,
+				      Ppoint_t endpoints[2],
+				      Ppolyline_t * output_route);
+    PATHPLAN_API int Proutespline_ws(Pworkspace_t * ws, Pedge_t * barriers,
+				     int n_barriers, Ppolyline_t input_route,
+				     Pvector_t endpoint_slopes[2],
+				     Ppolyline_t * output_route);
+    PATHPLAN_API void make_polyline_ws(Pworkspace_t * ws, Ppolyline_t line,
+				       Ppolyline_t * sline);
+
+/* Pshortestpath, Proutespline and make_polyline use a workspace of the
+ * calling thread, so they can run on several threads at once. Free that
+ * workspace, which invalidates the routes they returned. */
+    PATHPLAN_API void Pfreescratch(void);
+
 #undef PATHPLAN_API
 
 #ifdef __cplusplus
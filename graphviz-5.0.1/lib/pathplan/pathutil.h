@@ -39,6 +39,22 @@ extern "C" {
 
     PATHUTIL_API int in_poly(Ppoly_t argpoly, Ppoint_t q);
 
+    /* the scratch space behind a Pworkspace_t; shortest.c and route.c keep
+     * the layout of their parts to themselves */
+    struct Pworkspace_s {
+	struct Pshortest_s *shortest;	/* Pshortestpath_ws */
+	struct Proute_s *route;	/* Proutespline_ws */
+	Ppoint_t *ispline;	/* make_polyline_ws */
+	int isz;
+    };
+
+    void Pshortestpath_free(struct Pshortest_s *);
+    void Proutespline_free(struct Proute_s *);
+
+    /* the workspace of the calling thread, used by the functions without
+     * a workspace argument */
+    Pworkspace_t *Pworkspace_default(void);
+
 #undef PATHUTIL_API
 #ifdef __cplusplus
 }
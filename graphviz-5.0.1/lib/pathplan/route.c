@@ -30,15 +30,22 @@ typedef struct tna_t {
 
 #define POINTSIZE sizeof (Ppoint_t)
 
-static Ppoint_t *ops;
-static int opn, opl;
+/* scratch space of Proutespline_ws, kept in a Pworkspace_t */
+struct Proute_s {
+    Ppoint_t *ops;		/* the output */
+    int opn, opl;
+    tna_t *tnas;		/* for reallyroutespline */
+    int tnan;
+};
 
-static int reallyroutespline(Pedge_t *, int,
+typedef struct Proute_s route_t;
+
+static int reallyroutespline(route_t *, Pedge_t *, int,
 			     Ppoint_t *, int, Ppoint_t, Ppoint_t);
 static int mkspline(Ppoint_t *, int, tna_t *, Ppoint_t, Ppoint_t,
 		    Ppoint_t *, Ppoint_t *, Ppoint_t *, Ppoint_t *);
-static int splinefits(Pedge_t *, int, Ppoint_t, Pvector_t, Ppoint_t,
-		      Pvector_t, Ppoint_t *, int);
+static int splinefits(route_t *, Pedge_t *, int, Ppoint_t, Pvector_t,
+		      Ppoint_t, Pvector_t, Ppoint_t *, int);
 static int splineisinside(Pedge_t *, int, Ppoint_t *);
 static int splineintersectsline(Ppoint_t *, Ppoint_t *, double *);
 static void points2coeff(double, double, double, double, double *);
@@ -46,7 +53,7 @@ static void addroot(double, double *, int *);
 
 static Pvector_t normv(Pvector_t);
 
-static int growops(int);
+static int growops(route_t *, int);
 
 static Ppoint_t add(Ppoint_t, Ppoint_t);
 static Ppoint_t sub(Ppoint_t, Ppoint_t);
@@ -68,9 +75,26 @@ static double B23(double t);
  */
 int Proutespline(Pedge_t * edges, int edgen, Ppolyline_t input,
 		 Ppoint_t evs[2], Ppolyline_t * output)
+{
+    return Proutespline_ws(Pworkspace_default(), edges, edgen, input, evs,
+			   output);
+}
+
+/* Proutespline_ws:
+ * As Proutespline, using the scratch space in ws.
+ */
+int Proutespline_ws(Pworkspace_t * ws, Pedge_t * edges, int edgen,
+		    Ppolyline_t input, Ppoint_t evs[2], Ppolyline_t * output)
 {
     Ppoint_t *inps;
     int inpn;
+    route_t *rt;
+
+    if (!ws)
+	return -1;
+    if (!ws->route && !(ws->route = calloc(1, sizeof(route_t))))
+	return -1;
+    rt = ws->route;
 
     /* unpack into previous format rather than modify legacy code */
     inps = input.ps;
@@ -79,20 +103,20 @@ int Proutespline(Pedge_t * edges, int edgen, Ppolyline_t input,
     /* generate the splines */
     evs[0] = normv(evs[0]);
     evs[1] = normv(evs[1]);
-    opl = 0;
-    if (growops(4) < 0) {
+    rt->opl = 0;
+    if (growops(rt, 4) < 0) {
 	return -1;
     }
-    ops[opl++] = inps[0];
-    if (reallyroutespline(edges, edgen, inps, inpn, evs[0], evs[1]) == -1)
+    rt->ops[rt->opl++] = inps[0];
+    if (reallyroutespline(rt, edges, edgen, inps, inpn, evs[0], evs[1]) == -1)
 	return -1;
-    output->pn = opl;
-    output->ps = ops;
+    output->pn = rt->opl;
+    output->ps = rt->ops;
 
     return 0;
 }
 
-static int reallyroutespline(Pedge_t * edges, int edgen,
+static int reallyroutespline(route_t * rt, Pedge_t * edges, int edgen,
 			     Ppoint_t * inps, int inpn, Ppoint_t ev0,
 			     Ppoint_t ev1)
 {
@@ -101,14 +125,14 @@ static int reallyroutespline(Pedge_t * edges, int edgen,
     double maxd, d, t;
     int maxi, i, spliti;
 
-    static tna_t *tnas;
-    static int tnan;
-
-    if (tnan < inpn) {
-	if (!(tnas = realloc(tnas, sizeof(tna_t) * (size_t)inpn)))
+    if (rt->tnan < inpn) {
+	tna_t *tnas = realloc(rt->tnas, sizeof(tna_t) * (size_t)inpn);
+	if (!tnas)
 	    return -1;
-	tnan = inpn;
+	rt->tnas = tnas;
+	rt->tnan = inpn;
     }
+    tna_t *tnas = rt->tnas;
     tnas[0].t = 0;
     for (i = 1; i < inpn; i++)
 	tnas[i].t = tnas[i - 1].t + dist(inps[i], inps[i - 1]);
@@ -120,7 +144,7 @@ static int reallyroutespline(Pedge_t * edges, int edgen,
     }
     if (mkspline(inps, inpn, tnas, ev0, ev1, &p1, &v1, &p2, &v2) == -1)
 	return -1;
-    int fit = splinefits(edges, edgen, p1, v1, p2, v2, inps, inpn);
+    int fit = splinefits(rt, edges, edgen, p1, v1, p2, v2, inps, inpn);
     if (fit > 0) {
 	return 0;
     }
@@ -140,10 +164,10 @@ static int reallyroutespline(Pedge_t * edges, int edgen,
     splitv1 = normv(sub(inps[spliti], inps[spliti - 1]));
     splitv2 = normv(sub(inps[spliti + 1], inps[spliti]));
     splitv = normv(add(splitv1, splitv2));
-    if (reallyroutespline(edges, edgen, inps, spliti + 1, ev0, splitv) < 0) {
+    if (reallyroutespline(rt, edges, edgen, inps, spliti + 1, ev0, splitv) < 0) {
 	return -1;
     }
-    if (reallyroutespline(edges, edgen, &inps[spliti], inpn - spliti, splitv,
+    if (reallyroutespline(rt, edges, edgen, &inps[spliti], inpn - spliti, splitv,
                           ev1) < 0) {
 	return -1;
     }
@@ -203,8 +227,8 @@ static double dist_n(Ppoint_t * p, int n)
     return rv;
 }
 
-static int splinefits(Pedge_t * edges, int edgen, Ppoint_t pa,
-		      Pvector_t va, Ppoint_t pb, Pvector_t vb,
+static int splinefits(route_t * rt, Pedge_t * edges, int edgen,
+		      Ppoint_t pa, Pvector_t va, Ppoint_t pb, Pvector_t vb,
 		      Ppoint_t * inps, int inpn)
 {
     Ppoint_t sps[4];
@@ -239,11 +263,11 @@ static int splinefits(Pedge_t * edges, int edgen, Ppoint_t pa,
 	first = 0;
 
 	if (splineisinside(edges, edgen, &sps[0])) {
-	    if (growops(opl + 4) < 0) {
+	    if (growops(rt, rt->opl + 4) < 0) {
 		return -1;
 	    }
 	    for (pi = 1; pi < 4; pi++)
-		ops[opl].x = sps[pi].x, ops[opl++].y = sps[pi].y;
+		rt->ops[rt->opl].x = sps[pi].x, rt->ops[rt->opl++].y = sps[pi].y;
 #if defined(DEBUG) && DEBUG >= 1
 	    fprintf(stderr, "success: %f %f\n", a, b);
 #endif
@@ -251,11 +275,11 @@ static int splinefits(Pedge_t * edges, int edgen, Ppoint_t pa,
 	}
 	if (a == 0 && b == 0) {
 	    if (forceflag) {
-		if (growops(opl + 4) < 0) {
+		if (growops(rt, rt->opl + 4) < 0) {
 		    return -1;
 		}
 		for (pi = 1; pi < 4; pi++)
-		    ops[opl].x = sps[pi].x, ops[opl++].y = sps[pi].y;
+		    rt->ops[rt->opl].x = sps[pi].x, rt->ops[rt->opl++].y = sps[pi].y;
 #if defined(DEBUG) && DEBUG >= 1
 		fprintf(stderr, "forced straight line: %f %f\n", a, b);
 #endif
@@ -414,14 +438,26 @@ static Pvector_t normv(Pvector_t v)
     return v;
 }
 
-static int growops(int newopn)
+void Proutespline_free(route_t * rt)
+{
+    if (!rt)
+	return;
+    free(rt->ops);
+    free(rt->tnas);
+    free(rt);
+}
+
+static int growops(route_t * rt, int newopn)
 {
-    if (newopn <= opn)
+    Ppoint_t *ops;
+
+    if (newopn <= rt->opn)
 	return 0;
-    if (!(ops = realloc(ops, POINTSIZE * (size_t)newopn))) {
+    if (!(ops = realloc(rt->ops, POINTSIZE * (size_t)newopn))) {
 	return -1;
     }
-    opn = newopn;
+    rt->ops = ops;
+    rt->opn = newopn;
     return 0;
 }
 
@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <math.h>
 #include <pathplan/pathutil.h>
@@ -54,36 +55,66 @@ typedef struct deque_t {
     int pnlpn, fpnlpi, lpnlpi, apex;
 } deque_t;
 
-static pointnlink_t *pnls, **pnlps;
-static int pnln, pnll;
-
-static triangle_t *tris;
-static int trin, tril;
-
-static deque_t dq;
-
-static Ppoint_t *ops;
-static int opn;
-
-static int triangulate(pointnlink_t **, int);
+/* kinds of polygon vertices in the sweep of monotone() */
+enum { V_START, V_END, V_SPLIT, V_MERGE, V_REGULAR };
+
+/* a side of a triangle, by the indices of the polygon vertices it joins */
+typedef struct {
+    int lo, hi;
+    int trii, ei;
+} triside_t;
+
+/* scratch space of Pshortestpath_ws, kept in a Pworkspace_t */
+struct Pshortest_s {
+    pointnlink_t *pnls, **pnlps;
+    int pnln, pnll;
+
+    triangle_t *tris;
+    int trin, tril;
+
+    deque_t dq;
+
+    Ppoint_t *ops;
+    int opn;
+
+    /* triangulate, for polygons of up to trn points */
+    int trn;
+    int *sweep;		/* vertices from top to bottom */
+    int *vtype;		/* V_START etc. of each vertex */
+    int *status, nstatus;	/* left boundary edges on the sweep line */
+    int *helper;	/* helper vertex of each edge */
+    int *diags, ndiags;	/* pairs of vertices joined by diagonals */
+    int *adjs, *adj;	/* neighbors of each vertex, counterclockwise */
+    bool *done;		/* entries of adj already walked */
+    int *face, *chain, *stack;
+    bool *right;	/* vertex is on the right chain of its face */
+    triside_t *sides;
+};
+
+typedef struct Pshortest_s shortest_t;
+
+static int triangulate(shortest_t *, int);
+static int earclip(shortest_t *, pointnlink_t **, int);
 static bool isdiagonal(int, int, pointnlink_t **, int);
-static int loadtriangle(pointnlink_t *, pointnlink_t *, pointnlink_t *);
-static void connecttris(int, int);
-static bool marktripath(int, int);
+static int loadtriangle(shortest_t *, pointnlink_t *, pointnlink_t *,
+			pointnlink_t *);
+static void connecttris(shortest_t *);
+static bool marktripath(shortest_t *, int, int);
 
-static void add2dq(int, pointnlink_t *);
-static void splitdq(int, int);
-static int finddqsplit(pointnlink_t *);
+static void add2dq(shortest_t *, int, pointnlink_t *);
+static void splitdq(shortest_t *, int, int);
+static int finddqsplit(shortest_t *, pointnlink_t *);
 
 static int ccw(Ppoint_t *, Ppoint_t *, Ppoint_t *);
 static bool intersects(Ppoint_t *, Ppoint_t *, Ppoint_t *, Ppoint_t *);
 static bool between(Ppoint_t *, Ppoint_t *, Ppoint_t *);
-static int pointintri(int, Ppoint_t *);
+static int pointintri(shortest_t *, int, Ppoint_t *);
 
-static int growpnls(int);
-static int growtris(int);
-static int growdq(int);
-static int growops(int);
+static int growpnls(shortest_t *, int);
+static int growtris(shortest_t *, int);
+static int growtrn(shortest_t *, int);
+static int growdq(shortest_t *, int);
+static int growops(shortest_t *, int);
 
 /* Pshortestpath:
  * Find a shortest path contained in the polygon polyp going between the
@@ -91,27 +122,45 @@ static int growops(int);
  * Return 0 on success, -1 on bad input, -2 on memory allocation problem. 
  */
 int Pshortestpath(Ppoly_t * polyp, Ppoint_t eps[2], Ppolyline_t * output)
+{
+    return Pshortestpath_ws(Pworkspace_default(), polyp, eps, output);
+}
+
+/* Pshortestpath_ws:
+ * As Pshortestpath, using the scratch space in ws.
+ */
+int Pshortestpath_ws(Pworkspace_t * ws, Ppoly_t * polyp, Ppoint_t eps[2],
+		     Ppolyline_t * output)
 {
     int pi, minpi;
     double minx;
     Ppoint_t p1, p2, p3;
-    int trii, trij, ftrii, ltrii;
+    int trii, ftrii, ltrii;
     int ei;
     pointnlink_t epnls[2], *lpnlp, *rpnlp, *pnlp;
     triangle_t *trip;
     int splitindex;
+    shortest_t *sp;
 #ifdef DEBUG
     int pnli;
 #endif
 
+    if (!ws)
+	return -2;
+    if (!ws->shortest && !(ws->shortest = calloc(1, sizeof(shortest_t)))) {
+	prerror("cannot allocate workspace");
+	return -2;
+    }
+    sp = ws->shortest;
+
     /* make space */
-    if (growpnls(polyp->pn) != 0)
+    if (growpnls(sp, polyp->pn) != 0)
 	return -2;
-    pnll = 0;
-    tril = 0;
-    if (growdq(polyp->pn * 2) != 0)
+    sp->pnll = 0;
+    sp->tril = 0;
+    if (growdq(sp, polyp->pn * 2) != 0)
 	return -2;
-    dq.fpnlpi = dq.pnlpn / 2, dq.lpnlpi = dq.fpnlpi - 1;
+    sp->dq.fpnlpi = sp->dq.pnlpn / 2, sp->dq.lpnlpi = sp->dq.fpnlpi - 1;
 
     /* make sure polygon is CCW and load pnls array */
     for (pi = 0, minx = HUGE_VAL, minpi = -1; pi < polyp->pn; pi++) {
@@ -128,94 +177,92 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t eps[2], Ppolyline_t * output)
 		&& polyp->ps[pi].x == polyp->ps[pi + 1].x
 		&& polyp->ps[pi].y == polyp->ps[pi + 1].y)
 		continue;
-	    pnls[pnll].pp = &polyp->ps[pi];
-	    pnls[pnll].link = &pnls[pnll % polyp->pn];
-	    pnlps[pnll] = &pnls[pnll];
-	    pnll++;
+	    sp->pnls[sp->pnll].pp = &polyp->ps[pi];
+	    sp->pnls[sp->pnll].link = &sp->pnls[sp->pnll % polyp->pn];
+	    sp->pnlps[sp->pnll] = &sp->pnls[sp->pnll];
+	    sp->pnll++;
 	}
     } else {
 	for (pi = 0; pi < polyp->pn; pi++) {
 	    if (pi > 0 && polyp->ps[pi].x == polyp->ps[pi - 1].x &&
 		polyp->ps[pi].y == polyp->ps[pi - 1].y)
 		continue;
-	    pnls[pnll].pp = &polyp->ps[pi];
-	    pnls[pnll].link = &pnls[pnll % polyp->pn];
-	    pnlps[pnll] = &pnls[pnll];
-	    pnll++;
+	    sp->pnls[sp->pnll].pp = &polyp->ps[pi];
+	    sp->pnls[sp->pnll].link = &sp->pnls[sp->pnll % polyp->pn];
+	    sp->pnlps[sp->pnll] = &sp->pnls[sp->pnll];
+	    sp->pnll++;
 	}
     }
 
 #if defined(DEBUG) && DEBUG >= 1
-    fprintf(stderr, "points\n%d\n", pnll);
-    for (pnli = 0; pnli < pnll; pnli++)
-	fprintf(stderr, "%f %f\n", pnls[pnli].pp->x, pnls[pnli].pp->y);
+    fprintf(stderr, "points\n%d\n", sp->pnll);
+    for (pnli = 0; pnli < sp->pnll; pnli++)
+	fprintf(stderr, "%f %f\n", sp->pnls[pnli].pp->x, sp->pnls[pnli].pp->y);
 #endif
 
     /* generate list of triangles */
-    if (triangulate(pnlps, pnll))
+    if (triangulate(sp, sp->pnll))
 	return -2;
 
 #if defined(DEBUG) && DEBUG >= 2
-    fprintf(stderr, "triangles\n%d\n", tril);
-    for (trii = 0; trii < tril; trii++)
+    fprintf(stderr, "triangles\n%d\n", sp->tril);
+    for (trii = 0; trii < sp->tril; trii++)
 	for (ei = 0; ei < 3; ei++)
-	    fprintf(stderr, "%f %f\n", tris[trii].e[ei].pnl0p->pp->x,
-		    tris[trii].e[ei].pnl0p->pp->y);
+	    fprintf(stderr, "%f %f\n", sp->tris[trii].e[ei].pnl0p->pp->x,
+		    sp->tris[trii].e[ei].pnl0p->pp->y);
 #endif
 
     /* connect all pairs of triangles that share an edge */
-    for (trii = 0; trii < tril; trii++)
-	for (trij = trii + 1; trij < tril; trij++)
-	    connecttris(trii, trij);
+    connecttris(sp);
 
     /* find first and last triangles */
-    for (trii = 0; trii < tril; trii++)
-	if (pointintri(trii, &eps[0]))
+    for (trii = 0; trii < sp->tril; trii++)
+	if (pointintri(sp, trii, &eps[0]))
 	    break;
-    if (trii == tril) {
+    if (trii == sp->tril) {
 	prerror("source point not in any triangle");
 	return -1;
     }
     ftrii = trii;
-    for (trii = 0; trii < tril; trii++)
-	if (pointintri(trii, &eps[1]))
+    for (trii = 0; trii < sp->tril; trii++)
+	if (pointintri(sp, trii, &eps[1]))
 	    break;
-    if (trii == tril) {
+    if (trii == sp->tril) {
 	prerror("destination point not in any triangle");
 	return -1;
     }
     ltrii = trii;
 
     /* mark the strip of triangles from eps[0] to eps[1] */
-    if (!marktripath(ftrii, ltrii)) {
+    if (!marktripath(sp, ftrii, ltrii)) {
 	prerror("cannot find triangle path");
 	/* a straight line is better than failing */
-	if (growops(2) != 0)
+	if (growops(sp, 2) != 0)
 		return -2;
 	output->pn = 2;
-	ops[0] = eps[0], ops[1] = eps[1];
-	output->ps = ops;
+	sp->ops[0] = eps[0], sp->ops[1] = eps[1];
+	output->ps = sp->ops;
 	return 0;
     }
 
     /* if endpoints in same triangle, use a single line */
     if (ftrii == ltrii) {
-	if (growops(2) != 0)
+	if (growops(sp, 2) != 0)
 		return -2;
 	output->pn = 2;
-	ops[0] = eps[0], ops[1] = eps[1];
-	output->ps = ops;
+	sp->ops[0] = eps[0], sp->ops[1] = eps[1];
+	output->ps = sp->ops;
 	return 0;
     }
 
     /* build funnel and shortest path linked list (in add2dq) */
     epnls[0].pp = &eps[0], epnls[0].link = NULL;
     epnls[1].pp = &eps[1], epnls[1].link = NULL;
-    add2dq(DQ_FRONT, &epnls[0]);
-    dq.apex = dq.fpnlpi;
+    add2dq(sp, DQ_FRONT, &epnls[0]);
+    sp->dq.apex = sp->dq.fpnlpi;
     trii = ftrii;
     while (trii != -1) {
-	trip = &tris[trii];
+	trip = &sp->tris[trii];
 	trip->mark = 2;
 
 	/* find the left and right points of the exiting edge */
@@ -223,11 +270,11 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t eps[2], Ppolyline_t * output)
 	    if (trip->e[ei].rtp && trip->e[ei].rtp->mark == 1)
 		break;
 	if (ei == 3) {		/* in last triangle */
-	    if (ccw(&eps[1], dq.pnlps[dq.fpnlpi]->pp,
-		    dq.pnlps[dq.lpnlpi]->pp) == ISCCW)
-		lpnlp = dq.pnlps[dq.lpnlpi], rpnlp = &epnls[1];
+	    if (ccw(&eps[1], sp->dq.pnlps[sp->dq.fpnlpi]->pp,
+		    sp->dq.pnlps[sp->dq.lpnlpi]->pp) == ISCCW)
+		lpnlp = sp->dq.pnlps[sp->dq.lpnlpi], rpnlp = &epnls[1];
 	    else
-		lpnlp = &epnls[1], rpnlp = dq.pnlps[dq.lpnlpi];
+		lpnlp = &epnls[1], rpnlp = sp->dq.pnlps[sp->dq.lpnlpi];
 	} else {
 	    pnlp = trip->e[(ei + 1) % 3].pnl1p;
 	    if (ccw(trip->e[ei].pnl0p->pp, pnlp->pp,
@@ -239,32 +286,32 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t eps[2], Ppolyline_t * output)
 
 	/* update deque */
 	if (trii == ftrii) {
-	    add2dq(DQ_BACK, lpnlp);
-	    add2dq(DQ_FRONT, rpnlp);
+	    add2dq(sp, DQ_BACK, lpnlp);
+	    add2dq(sp, DQ_FRONT, rpnlp);
 	} else {
-	    if (dq.pnlps[dq.fpnlpi] != rpnlp
-		&& dq.pnlps[dq.lpnlpi] != rpnlp) {
+	    if (sp->dq.pnlps[sp->dq.fpnlpi] != rpnlp
+		&& sp->dq.pnlps[sp->dq.lpnlpi] != rpnlp) {
 		/* add right point to deque */
-		splitindex = finddqsplit(rpnlp);
-		splitdq(DQ_BACK, splitindex);
-		add2dq(DQ_FRONT, rpnlp);
+		splitindex = finddqsplit(sp, rpnlp);
+		splitdq(sp, DQ_BACK, splitindex);
+		add2dq(sp, DQ_FRONT, rpnlp);
 		/* if the split is behind the apex, then reset apex */
-		if (splitindex > dq.apex)
-		    dq.apex = splitindex;
+		if (splitindex > sp->dq.apex)
+		    sp->dq.apex = splitindex;
 	    } else {
 		/* add left point to deque */
-		splitindex = finddqsplit(lpnlp);
-		splitdq(DQ_FRONT, splitindex);
-		add2dq(DQ_BACK, lpnlp);
+		splitindex = finddqsplit(sp, lpnlp);
+		splitdq(sp, DQ_FRONT, splitindex);
+		add2dq(sp, DQ_BACK, lpnlp);
 		/* if the split is in front of the apex, then reset apex */
-		if (splitindex < dq.apex)
-		    dq.apex = splitindex;
+		if (splitindex < sp->dq.apex)
+		    sp->dq.apex = splitindex;
 	    }
 	}
 	trii = -1;
 	for (ei = 0; ei < 3; ei++)
 	    if (trip->e[ei].rtp && trip->e[ei].rtp->mark == 1) {
-		trii = trip->e[ei].rtp - tris;
+		trii = trip->e[ei].rtp - sp->tris;
 		break;
 	    }
     }
@@ -278,40 +325,449 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t eps[2], Ppolyline_t * output)
 
     for (pi = 0, pnlp = &epnls[1]; pnlp; pnlp = pnlp->link)
 	pi++;
-    if (growops(pi) != 0)
+    if (growops(sp, pi) != 0)
 	return -2;
     output->pn = pi;
     for (pi = pi - 1, pnlp = &epnls[1]; pnlp; pi--, pnlp = pnlp->link)
-	ops[pi] = *pnlp->pp;
-    output->ps = ops;
+	sp->ops[pi] = *pnlp->pp;
+    output->ps = sp->ops;
 
     return 0;
 }
 
-/* triangulate polygon */
-static int triangulate(pointnlink_t ** pnlps, int pnln)
+#define PT(sp, i) ((sp)->pnlps[i]->pp)
+
+/* turn:
+ * Positive if a, b, c make a left (counterclockwise) turn at b.
+ */
+static double turn(const Ppoint_t * a, const Ppoint_t * b,
+		   const Ppoint_t * c)
+{
+    return (b->x - a->x) * (c->y - b->y) - (b->y - a->y) * (c->x - b->x);
+}
+
+/* above:
+ * Is vertex i met before vertex j when sweeping the polygon from top to
+ * bottom? Ties in y are broken left to right, then by index, so that the
+ * order is strict and horizontal edges need no special case.
+ */
+static bool above(shortest_t * sp, int i, int j)
+{
+    const Ppoint_t *a = PT(sp, i), *b = PT(sp, j);
+
+    if (a->y != b->y)
+	return a->y > b->y;
+    if (a->x != b->x)
+	return a->x < b->x;
+    return i < j;
+}
+
+/* sortsweep:
+ * Sort the n vertices v into sweep order, using tmp as scratch space.
+ */
+static void sortsweep(shortest_t * sp, int *v, int *tmp, int n)
+{
+    int i, j, k, h;
+
+    if (n < 2)
+	return;
+    h = n / 2;
+    sortsweep(sp, v, tmp, h);
+    sortsweep(sp, v + h, tmp, n - h);
+    for (i = 0, j = h, k = 0; i < h && j < n;)
+	tmp[k++] = above(sp, v[j], v[i]) ? v[j++] : v[i++];
+    while (i < h)
+	tmp[k++] = v[i++];
+    while (j < n)
+	tmp[k++] = v[j++];
+    memcpy(v, tmp, (size_t) n * sizeof(int));
+}
+
+/* edgex:
+ * x coordinate where edge e, from vertex e down to vertex e+1, crosses
+ * the sweep line through v.
+ */
+static double edgex(shortest_t * sp, int n, int e, const Ppoint_t * v)
+{
+    const Ppoint_t *a = PT(sp, e), *b = PT(sp, (e + 1) % n);
+
+    if (a->y == b->y)
+	return fmin(fmax(a->x, b->x), v->x);
+    return a->x + (v->y - a->y) * (b->x - a->x) / (b->y - a->y);
+}
+
+/* statuspos:
+ * Index of the first edge on the sweep line that lies to the right of
+ * vertex v, found by binary search.
+ */
+static int statuspos(shortest_t * sp, int n, int v)
+{
+    const Ppoint_t *p = PT(sp, v);
+    int lo = 0, hi = sp->nstatus, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (edgex(sp, n, sp->status[mid], p) <= p->x)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+static void insertedge(shortest_t * sp, int n, int e)
+{
+    int pos = statuspos(sp, n, e);
+
+    memmove(sp->status + pos + 1, sp->status + pos,
+	    (size_t) (sp->nstatus - pos) * sizeof(int));
+    sp->status[pos] = e;
+    sp->nstatus++;
+    sp->helper[e] = e;
+}
+
+/* removeedge:
+ * Take edge e off the sweep line at its lower end v. Return -1 if it is
+ * not there, which only happens if the polygon is not simple.
+ */
+static int removeedge(shortest_t * sp, int n, int e, int v)
+{
+    int pos = statuspos(sp, n, v), k;
+
+    /* e ends at v, so it is normally just left of it */
+    if (pos > 0 && sp->status[pos - 1] == e)
+	k = pos - 1;
+    else {
+	for (k = 0; k < sp->nstatus && sp->status[k] != e; k++);
+	if (k == sp->nstatus)
+	    return -1;
+    }
+    memmove(sp->status + k, sp->status + k + 1,
+	    (size_t) (sp->nstatus - k - 1) * sizeof(int));
+    sp->nstatus--;
+    return 0;
+}
+
+/* leftedge:
+ * The edge on the sweep line directly left of vertex v, or -1.
+ */
+static int leftedge(shortest_t * sp, int n, int v)
+{
+    int pos = statuspos(sp, n, v);
+    return pos > 0 ? sp->status[pos - 1] : -1;
+}
+
+static int adddiag(shortest_t * sp, int n, int a, int b)
+{
+    if (a == b || (a + 1) % n == b || (b + 1) % n == a)
+	return 0;
+    if (sp->ndiags >= 2 * n)
+	return -1;
+    sp->diags[2 * sp->ndiags] = a;
+    sp->diags[2 * sp->ndiags + 1] = b;
+    sp->ndiags++;
+    return 0;
+}
+
+/* fixup:
+ * If the helper of edge e is a merge vertex, join it to v.
+ */
+static int fixup(shortest_t * sp, int n, int e, int v)
+{
+    if (sp->vtype[sp->helper[e]] == V_MERGE)
+	return adddiag(sp, n, v, sp->helper[e]);
+    return 0;
+}
+
+/* monotone:
+ * Add the diagonals that split the CCW polygon with n vertices into
+ * y-monotone pieces, sweeping a line from top to bottom and keeping the
+ * edges it crosses that have the interior on their right. Return -1 if
+ * the polygon turns out not to be simple.
+ */
+static int monotone(shortest_t * sp, int n)
+{
+    int i, k, v, p, q, e;
+
+    for (v = 0; v < n; v++) {
+	p = (v + n - 1) % n;
+	q = (v + 1) % n;
+	bool pbelow = above(sp, v, p), qbelow = above(sp, v, q);
+	double t = turn(PT(sp, p), PT(sp, v), PT(sp, q));
+	if (pbelow && qbelow)
+	    sp->vtype[v] = t >= 0 ? V_START : V_SPLIT;
+	else if (!pbelow && !qbelow)
+	    sp->vtype[v] = t >= 0 ? V_END : V_MERGE;
+	else
+	    sp->vtype[v] = V_REGULAR;
+	sp->sweep[v] = v;
+    }
+    sortsweep(sp, sp->sweep, sp->stack, n);
+
+    sp->nstatus = 0;
+    sp->ndiags = 0;
+    for (i = 0; i < n; i++) {
+	v = sp->sweep[i];
+	p = (v + n - 1) % n;	/* edge p runs from vertex p to v */
+	switch (sp->vtype[v]) {
+	case V_START:
+	    insertedge(sp, n, v);
+	    break;
+	case V_END:
+	    if (fixup(sp, n, p, v) || removeedge(sp, n, p, v))
+		return -1;
+	    break;
+	case V_SPLIT:
+	    if ((e = leftedge(sp, n, v)) < 0
+		|| adddiag(sp, n, v, sp->helper[e]))
+		return -1;
+	    sp->helper[e] = v;
+	    insertedge(sp, n, v);
+	    break;
+	case V_MERGE:
+	    if (fixup(sp, n, p, v) || removeedge(sp, n, p, v))
+		return -1;
+	    if ((e = leftedge(sp, n, v)) < 0 || fixup(sp, n, e, v))
+		return -1;
+	    sp->helper[e] = v;
+	    break;
+	default:
+	    if (above(sp, p, v)) {
+		/* on a left chain: the interior is to the right */
+		if (fixup(sp, n, p, v) || removeedge(sp, n, p, v))
+		    return -1;
+		insertedge(sp, n, v);
+	    } else {
+		if ((e = leftedge(sp, n, v)) < 0 || fixup(sp, n, e, v))
+		    return -1;
+		sp->helper[e] = v;
+	    }
+	    break;
+	}
+    }
+    for (k = 0; k < 2 * sp->ndiags; k++)
+	if (sp->diags[k] < 0 || sp->diags[k] >= n)
+	    return -1;
+    return 0;
+}
+
+static double angle(shortest_t * sp, int v, int w)
+{
+    const Ppoint_t *a = PT(sp, v), *b = PT(sp, w);
+    return atan2(b->y - a->y, b->x - a->x);
+}
+
+/* mkadj:
+ * List the neighbors of each vertex, along the boundary and the
+ * diagonals, in counterclockwise order around it.
+ */
+static void mkadj(shortest_t * sp, int n)
+{
+    int v, k, j, w, *cur = sp->stack;
+
+    for (v = 0; v < n; v++)
+	cur[v] = 2;
+    for (k = 0; k < 2 * sp->ndiags; k++)
+	cur[sp->diags[k]]++;
+    sp->adjs[0] = 0;
+    for (v = 0; v < n; v++) {
+	sp->adjs[v + 1] = sp->adjs[v] + cur[v];
+	cur[v] = sp->adjs[v];
+	sp->adj[cur[v]++] = (v + n - 1) % n;
+	sp->adj[cur[v]++] = (v + 1) % n;
+    }
+    for (k = 0; k < sp->ndiags; k++) {
+	int a = sp->diags[2 * k], b = sp->diags[2 * k + 1];
+	sp->adj[cur[a]++] = b;
+	sp->adj[cur[b]++] = a;
+    }
+    for (v = 0; v < n; v++) {
+	int *a = sp->adj + sp->adjs[v], deg = sp->adjs[v + 1] - sp->adjs[v];
+	for (k = 1; k < deg; k++) {
+	    w = a[k];
+	    double t = angle(sp, v, w);
+	    for (j = k; j > 0 && angle(sp, v, a[j - 1]) > t; j--)
+		a[j] = a[j - 1];
+	    a[j] = w;
+	}
+	/* the boundary back to the previous vertex is outside */
+	for (k = 0; k < deg; k++)
+	    sp->done[sp->adjs[v] + k] = a[k] == (v + n - 1) % n;
+    }
+}
+
+static int emit(shortest_t * sp, int a, int b, int c)
+{
+    /* keep the orientation of the ears cut by earclip; pointintri relies
+     * on it for points lying on a diagonal */
+    if (ccw(sp->pnlps[a]->pp, sp->pnlps[b]->pp, sp->pnlps[c]->pp) != ISCCW)
+	return loadtriangle(sp, sp->pnlps[a], sp->pnlps[c], sp->pnlps[b]);
+    return loadtriangle(sp, sp->pnlps[a], sp->pnlps[b], sp->pnlps[c]);
+}
+
+/* facetris:
+ * Triangulate the y-monotone face with the m vertices f, in CCW order,
+ * with the stack based linear time method. Return -1 if the face is not
+ * monotone after all.
+ */
+static int facetris(shortest_t * sp, const int *f, int m)
+{
+    int i, top = 0, bot = 0, k = 0, ns, li, ri, lend, v, last;
+    int lastl, lastr, *u = sp->chain, *s = sp->stack;
+
+    if (m < 3)
+	return -1;
+    for (i = 1; i < m; i++) {
+	if (above(sp, f[i], f[top]))
+	    top = i;
+	if (above(sp, f[bot], f[i]))
+	    bot = i;
+    }
+
+    /* merge the left chain, top to bottom forwards, and the right chain,
+     * top to bottom backwards, into sweep order */
+    u[k++] = lastl = lastr = f[top];
+    sp->right[f[top]] = false;
+    li = (top + 1) % m, lend = (bot + 1) % m;
+    ri = (top + m - 1) % m;
+    while (li != lend || ri != bot) {
+	if (ri == bot || (li != lend && above(sp, f[li], f[ri]))) {
+	    v = f[li], li = (li + 1) % m;
+	    if (!above(sp, lastl, v))
+		return -1;
+	    lastl = v;
+	    sp->right[v] = false;
+	} else {
+	    v = f[ri], ri = (ri + m - 1) % m;
+	    if (!above(sp, lastr, v))
+		return -1;
+	    lastr = v;
+	    sp->right[v] = true;
+	}
+	u[k++] = v;
+    }
+    if (k != m)
+	return -1;
+
+    s[0] = u[0], s[1] = u[1], ns = 2;
+    for (i = 2; i < m - 1; i++) {
+	v = u[i];
+	if (sp->right[v] != sp->right[s[ns - 1]]) {
+	    /* fan out to the whole other chain */
+	    for (k = 0; k < ns - 1; k++)
+		if (emit(sp, v, s[k], s[k + 1]))
+		    return -1;
+	    s[0] = u[i - 1], s[1] = v, ns = 2;
+	} else {
+	    /* cut off the convex corners of this chain */
+	    last = s[--ns];
+	    while (ns > 0) {
+		int w = s[ns - 1];
+		if (sp->right[v] ? turn(PT(sp, v), PT(sp, last), PT(sp, w)) <= 0
+		    : turn(PT(sp, w), PT(sp, last), PT(sp, v)) <= 0)
+		    break;
+		if (emit(sp, v, last, w))
+		    return -1;
+		last = s[--ns];
+	    }
+	    s[ns++] = last;
+	    s[ns++] = v;
+	}
+    }
+    v = u[m - 1];
+    for (k = 0; k < ns - 1; k++)
+	if (emit(sp, v, s[k], s[k + 1]))
+	    return -1;
+    return 0;
+}
+
+/* sweeptris:
+ * Triangulate the CCW polygon with n vertices in O(n log n) time, by
+ * splitting it into y-monotone faces and triangulating each of those.
+ * Return -1 if the polygon is degenerate or not simple.
+ */
+static int sweeptris(shortest_t * sp, int n)
+{
+    int v, k, slot, m;
+
+    for (v = 0; v < n; v++) {
+	const Ppoint_t *a = PT(sp, v), *b = PT(sp, (v + 1) % n);
+	if (a->x == b->x && a->y == b->y)
+	    return -1;
+    }
+    if (monotone(sp, n))
+	return -1;
+    mkadj(sp, n);
+
+    /* walk the faces, turning as far clockwise as possible at each vertex
+     * so that the face stays on the left */
+    for (v = 0; v < n; v++) {
+	for (k = sp->adjs[v]; k < sp->adjs[v + 1]; k++) {
+	    if (sp->done[k])
+		continue;
+	    int from = v;
+	    m = 0;
+	    slot = k;
+	    do {
+		int w = sp->adj[slot], j;
+		if (sp->done[slot] || m >= n)
+		    return -1;
+		sp->done[slot] = true;
+		sp->face[m++] = from;
+		for (j = sp->adjs[w]; j < sp->adjs[w + 1]; j++)
+		    if (sp->adj[j] == from)
+			break;
+		if (j == sp->adjs[w + 1])
+		    return -1;
+		slot = j == sp->adjs[w] ? sp->adjs[w + 1] - 1 : j - 1;
+		from = w;
+	    } while (slot != k);
+	    if (facetris(sp, sp->face, m))
+		return -1;
+	}
+    }
+    return sp->tril == n - 2 ? 0 : -1;
+}
+
+/* triangulate:
+ * Triangulate the polygon in sp->pnlps. Polygons the sweep cannot handle,
+ * such as ones that touch themselves, are left to ear clipping, which is
+ * quadratic but more forgiving.
+ */
+static int triangulate(shortest_t * sp, int pnln)
+{
+    if (growtris(sp, pnln) != 0 || growtrn(sp, pnln) != 0)
+	return -1;
+    if (pnln > 3 && sweeptris(sp, pnln) == 0)
+	return 0;
+    sp->tril = 0;
+    return earclip(sp, sp->pnlps, pnln);
+}
+
+/* triangulate polygon by ear clipping */
+static int earclip(shortest_t * sp, pointnlink_t ** pnlps, int pnln)
 {
     int pnli, pnlip1, pnlip2;
 
-	if (pnln > 3) 
+	if (pnln > 3)
 	{
-		for (pnli = 0; pnli < pnln; pnli++) 
+		for (pnli = 0; pnli < pnln; pnli++)
 		{
 			pnlip1 = (pnli + 1) % pnln;
 			pnlip2 = (pnli + 2) % pnln;
-			if (isdiagonal(pnli, pnlip2, pnlps, pnln)) 
+			if (isdiagonal(pnli, pnlip2, pnlps, pnln))
 			{
-				if (loadtriangle(pnlps[pnli], pnlps[pnlip1], pnlps[pnlip2]) != 0)
+				if (loadtriangle(sp, pnlps[pnli], pnlps[pnlip1], pnlps[pnlip2]) != 0)
 					return -1;
 				for (pnli = pnlip1; pnli < pnln - 1; pnli++)
 					pnlps[pnli] = pnlps[pnli + 1];
-				return triangulate(pnlps, pnln - 1);
+				return earclip(sp, pnlps, pnln - 1);
 			}
 		}
 		prerror("triangulation failed");
-    } 
+    }
 	else {
-		if (loadtriangle(pnlps[0], pnlps[1], pnlps[2]) != 0)
+		if (loadtriangle(sp, pnlps[0], pnlps[1], pnlps[2]) != 0)
 			return -1;
 	}
 
@@ -348,18 +804,18 @@ static bool isdiagonal(int pnli, int pnlip2, pointnlink_t ** pnlps,
     return true;
 }
 
-static int loadtriangle(pointnlink_t * pnlap, pointnlink_t * pnlbp,
-			 pointnlink_t * pnlcp)
+static int loadtriangle(shortest_t * sp, pointnlink_t * pnlap,
+			pointnlink_t * pnlbp, pointnlink_t * pnlcp)
 {
     triangle_t *trip;
     int ei;
 
     /* make space */
-    if (tril >= trin) {
-	if (growtris(trin + 20) != 0)
+    if (sp->tril >= sp->trin) {
+	if (growtris(sp, sp->trin + 20) != 0)
 		return -1;
     }
-    trip = &tris[tril++];
+    trip = &sp->tris[sp->tril++];
     trip->mark = 0;
     trip->e[0].pnl0p = pnlap, trip->e[0].pnl1p = pnlbp, trip->e[0].rtp = NULL;
     trip->e[1].pnl0p = pnlbp, trip->e[1].pnl1p = pnlcp, trip->e[1].rtp = NULL;
@@ -370,78 +826,104 @@ static int loadtriangle(pointnlink_t * pnlap, pointnlink_t * pnlbp,
     return 0;
 }
 
-/* connect a pair of triangles at their common edge (if any) */
-static void connecttris(int tri1, int tri2)
+static int cmpsides(const void *a, const void *b)
 {
-    triangle_t *tri1p, *tri2p;
-    int ei, ej;
+    const triside_t *s = a, *t = b;
 
-    for (ei = 0; ei < 3; ei++) {
-	for (ej = 0; ej < 3; ej++) {
-	    tri1p = &tris[tri1];
-	    tri2p = &tris[tri2];
-	    if ((tri1p->e[ei].pnl0p->pp == tri2p->e[ej].pnl0p->pp &&
-		 tri1p->e[ei].pnl1p->pp == tri2p->e[ej].pnl1p->pp) ||
-		(tri1p->e[ei].pnl0p->pp == tri2p->e[ej].pnl1p->pp &&
-		 tri1p->e[ei].pnl1p->pp == tri2p->e[ej].pnl0p->pp))
-		tri1p->e[ei].rtp = tri2p, tri2p->e[ej].rtp = tri1p;
+    if (s->lo != t->lo)
+	return s->lo < t->lo ? -1 : 1;
+    if (s->hi != t->hi)
+	return s->hi < t->hi ? -1 : 1;
+    return 0;
+}
+
+/* connecttris:
+ * Connect all pairs of triangles at their common edges. The sides are
+ * sorted by the vertices they join, so that shared ones come together.
+ */
+static void connecttris(shortest_t * sp)
+{
+    int trii, ei, k, n = 0;
+    triside_t *sides = sp->sides;
+
+    for (trii = 0; trii < sp->tril; trii++)
+	for (ei = 0; ei < 3; ei++) {
+	    int a = (int) (sp->tris[trii].e[ei].pnl0p - sp->pnls);
+	    int b = (int) (sp->tris[trii].e[ei].pnl1p - sp->pnls);
+	    sides[n].lo = a < b ? a : b;
+	    sides[n].hi = a < b ? b : a;
+	    sides[n].trii = trii;
+	    sides[n].ei = ei;
+	    n++;
 	}
+    qsort(sides, (size_t) n, sizeof(sides[0]), cmpsides);
+    for (k = 0; k + 1 < n; k++) {
+	if (cmpsides(&sides[k], &sides[k + 1]) != 0)
+	    continue;
+	triangle_t *tri1p = &sp->tris[sides[k].trii];
+	triangle_t *tri2p = &sp->tris[sides[k + 1].trii];
+	tri1p->e[sides[k].ei].rtp = tri2p;
+	tri2p->e[sides[k + 1].ei].rtp = tri1p;
+	k++;
     }
 }
 
 /* find and mark path from trii, to trij */
-static bool marktripath(int trii, int trij)
+static bool marktripath(shortest_t * sp, int trii, int trij)
 {
     int ei;
 
-    if (tris[trii].mark)
+    if (sp->tris[trii].mark)
 	return false;
-    tris[trii].mark = 1;
+    sp->tris[trii].mark = 1;
     if (trii == trij)
 	return true;
     for (ei = 0; ei < 3; ei++)
-	if (tris[trii].e[ei].rtp &&
-	    marktripath(tris[trii].e[ei].rtp - tris, trij))
+	if (sp->tris[trii].e[ei].rtp &&
+	    marktripath(sp, sp->tris[trii].e[ei].rtp - sp->tris, trij))
 	    return true;
-    tris[trii].mark = 0;
+    sp->tris[trii].mark = 0;
     return false;
 }
 
 /* add a new point to the deque, either front or back */
-static void add2dq(int side, pointnlink_t * pnlp)
+static void add2dq(shortest_t * sp, int side, pointnlink_t * pnlp)
 {
+    deque_t *dq = &sp->dq;
+
     if (side == DQ_FRONT) {
-	if (dq.lpnlpi - dq.fpnlpi >= 0)
-	    pnlp->link = dq.pnlps[dq.fpnlpi];	/* shortest path links */
-	dq.fpnlpi--;
-	dq.pnlps[dq.fpnlpi] = pnlp;
+	if (dq->lpnlpi - dq->fpnlpi >= 0)
+	    pnlp->link = dq->pnlps[dq->fpnlpi];	/* shortest path links */
+	dq->fpnlpi--;
+	dq->pnlps[dq->fpnlpi] = pnlp;
     } else {
-	if (dq.lpnlpi - dq.fpnlpi >= 0)
-	    pnlp->link = dq.pnlps[dq.lpnlpi];	/* shortest path links */
-	dq.lpnlpi++;
-	dq.pnlps[dq.lpnlpi] = pnlp;
+	if (dq->lpnlpi - dq->fpnlpi >= 0)
+	    pnlp->link = dq->pnlps[dq->lpnlpi];	/* shortest path links */
+	dq->lpnlpi++;
+	dq->pnlps[dq->lpnlpi] = pnlp;
     }
 }
 
-static void splitdq(int side, int index)
+static void splitdq(shortest_t * sp, int side, int index)
 {
     if (side == DQ_FRONT)
-	dq.lpnlpi = index;
+	sp->dq.lpnlpi = index;
     else
-	dq.fpnlpi = index;
+	sp->dq.fpnlpi = index;
 }
 
-static int finddqsplit(pointnlink_t * pnlp)
+static int finddqsplit(shortest_t * sp, pointnlink_t * pnlp)
 {
+    deque_t *dq = &sp->dq;
     int index;
 
-    for (index = dq.fpnlpi; index < dq.apex; index++)
-	if (ccw(dq.pnlps[index + 1]->pp, dq.pnlps[index]->pp, pnlp->pp) == ISCCW)
+    for (index = dq->fpnlpi; index < dq->apex; index++)
+	if (ccw(dq->pnlps[index + 1]->pp, dq->pnlps[index]->pp, pnlp->pp) == ISCCW)
 	    return index;
-    for (index = dq.lpnlpi; index > dq.apex; index--)
-	if (ccw(dq.pnlps[index - 1]->pp, dq.pnlps[index]->pp, pnlp->pp) == ISCW)
+    for (index = dq->lpnlpi; index > dq->apex; index--)
+	if (ccw(dq->pnlps[index - 1]->pp, dq->pnlps[index]->pp, pnlp->pp) == ISCW)
 	    return index;
-    return dq.apex;
+    return dq->apex;
 }
 
 /* ccw test: CCW, CW, or co-linear */
@@ -488,71 +970,135 @@ static bool between(Ppoint_t * pap, Ppoint_t * pbp, Ppoint_t * pcp)
 	p2.x * p2.x + p2.y * p2.y <= p1.x * p1.x + p1.y * p1.y;
 }
 
-static int pointintri(int trii, Ppoint_t * pp)
+static int pointintri(shortest_t * sp, int trii, Ppoint_t * pp)
 {
     int ei, sum;
 
     for (ei = 0, sum = 0; ei < 3; ei++)
-	if (ccw(tris[trii].e[ei].pnl0p->pp, tris[trii].e[ei].pnl1p->pp, pp) != ISCW)
+	if (ccw(sp->tris[trii].e[ei].pnl0p->pp, sp->tris[trii].e[ei].pnl1p->pp, pp) != ISCW)
 	    sum++;
     return sum == 3 || sum == 0;
 }
 
-static int growpnls(int newpnln)
+static int growpnls(shortest_t * sp, int newpnln)
 {
-    if (newpnln <= pnln)
+    pointnlink_t *pnls, **pnlps;
+
+    if (newpnln <= sp->pnln)
 	return 0;
-    pnls = realloc(pnls, POINTNLINKSIZE * newpnln);
+    pnls = realloc(sp->pnls, POINTNLINKSIZE * newpnln);
     if (pnls == NULL) {
 	prerror("cannot realloc pnls");
 	return -1;
     }
-    pnlps = realloc(pnlps, POINTNLINKPSIZE * newpnln);
+    sp->pnls = pnls;
+    pnlps = realloc(sp->pnlps, POINTNLINKPSIZE * newpnln);
     if (pnlps == NULL) {
 	prerror("cannot realloc pnlps");
 	return -1;
     }
-    pnln = newpnln;
+    sp->pnlps = pnlps;
+    sp->pnln = newpnln;
     return 0;
 }
 
-static int growtris(int newtrin)
+static int growtris(shortest_t * sp, int newtrin)
 {
-    if (newtrin <= trin)
+    triangle_t *tris;
+
+    if (newtrin <= sp->trin)
 	return 0;
-    tris = realloc(tris, TRIANGLESIZE * newtrin);
+    tris = realloc(sp->tris, TRIANGLESIZE * newtrin);
     if (tris == NULL) {
 	prerror("cannot realloc tris");
 	return -1;
     }
-    trin = newtrin;
+    sp->tris = tris;
+    sp->trin = newtrin;
 
     return 0;
 }
 
-static int growdq(int newdqn)
+#define GROW(p, n) \
+    (((p) = realloc((p), (size_t)(n) * sizeof(*(p)))) == NULL)
+
+/* growtrn:
+ * Make room in the scratch space of triangulate for polygons with up to
+ * newtrn points. There are at most 2n diagonals and 3n triangle sides.
+ */
+static int growtrn(shortest_t * sp, int newtrn)
 {
-    if (newdqn <= dq.pnlpn)
+    if (newtrn <= sp->trn)
 	return 0;
-    dq.pnlps = realloc(dq.pnlps, POINTNLINKPSIZE * newdqn);
-    if (dq.pnlps == NULL) {
+    sp->trn = 0;
+    if (GROW(sp->sweep, newtrn) || GROW(sp->vtype, newtrn)
+	|| GROW(sp->status, newtrn) || GROW(sp->helper, newtrn)
+	|| GROW(sp->diags, 4 * newtrn) || GROW(sp->adjs, newtrn + 1)
+	|| GROW(sp->adj, 6 * newtrn) || GROW(sp->done, 6 * newtrn)
+	|| GROW(sp->face, newtrn) || GROW(sp->chain, newtrn)
+	|| GROW(sp->stack, newtrn) || GROW(sp->right, newtrn)
+	|| GROW(sp->sides, 3 * newtrn)) {
+	prerror("cannot realloc triangulation space");
+	return -1;
+    }
+    sp->trn = newtrn;
+    return 0;
+}
+
+static int growdq(shortest_t * sp, int newdqn)
+{
+    pointnlink_t **pnlps;
+
+    if (newdqn <= sp->dq.pnlpn)
+	return 0;
+    pnlps = realloc(sp->dq.pnlps, POINTNLINKPSIZE * newdqn);
+    if (pnlps == NULL) {
 	prerror("cannot realloc dq.pnls");
 	return -1;
     }
-    dq.pnlpn = newdqn;
+    sp->dq.pnlps = pnlps;
+    sp->dq.pnlpn = newdqn;
     return 0;
 }
 
-static int growops(int newopn)
+static int growops(shortest_t * sp, int newopn)
 {
-    if (newopn <= opn)
+    Ppoint_t *ops;
+
+    if (newopn <= sp->opn)
 	return 0;
-    ops = realloc(ops, POINTSIZE * newopn);
+    ops = realloc(sp->ops, POINTSIZE * newopn);
     if (ops == NULL) {
 	prerror("cannot realloc ops");
 	return -1;
     }
-    opn = newopn;
+    sp->ops = ops;
+    sp->opn = newopn;
 
     return 0;
 }
+
+void Pshortestpath_free(shortest_t * sp)
+{
+    if (!sp)
+	return;
+    free(sp->pnls);
+    free(sp->pnlps);
+    free(sp->tris);
+    free(sp->dq.pnlps);
+    free(sp->ops);
+    free(sp->sweep);
+    free(sp->vtype);
+    free(sp->status);
+    free(sp->helper);
+    free(sp->diags);
+    free(sp->adjs);
+    free(sp->adj);
+    free(sp->done);
+    free(sp->face);
+    free(sp->chain);
+    free(sp->stack);
+    free(sp->right);
+    free(sp->sides);
+    free(sp);
+}
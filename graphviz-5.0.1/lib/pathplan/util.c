@@ -11,6 +11,7 @@
 
 #include <assert.h>
 #include <cgraph/alloc.h>
+#include <cgraph/tls.h>
 #include <stdlib.h>
 #include <pathplan/pathutil.h>
 
@@ -56,15 +57,21 @@ int Ppolybarriers(Ppoly_t ** polys, int npolys, Pedge_t ** barriers,
 void
 make_polyline(Ppolyline_t line, Ppolyline_t* sline)
 {
-    static int isz = 0;
-    static Ppoint_t* ispline = 0;
+    make_polyline_ws(Pworkspace_default(), line, sline);
+}
+
+void
+make_polyline_ws(Pworkspace_t* ws, Ppolyline_t line, Ppolyline_t* sline)
+{
     int i, j;
     int npts = 4 + 3*(line.pn-2);
+    Ppoint_t* ispline;
 
-    if (npts > isz) {
-	ispline = gv_recalloc(ispline, (size_t)isz, (size_t)npts, sizeof(Ppoint_t));
-	isz = npts;
+    if (npts > ws->isz) {
+	ws->ispline = gv_recalloc(ws->ispline, (size_t)ws->isz, (size_t)npts, sizeof(Ppoint_t));
+	ws->isz = npts;
     }
+    ispline = ws->ispline;
 
     j = i = 0;
     ispline[j+1] = ispline[j] = line.ps[i];
@@ -80,7 +87,38 @@ make_polyline(Ppolyline_t line, Ppolyline_t* sline)
     sline->ps = ispline;
 }
 
+Pworkspace_t *Pworkspace_new(void)
+{
+    return gv_alloc(sizeof(Pworkspace_t));
+}
+
+void Pworkspace_free(Pworkspace_t *ws)
+{
+    if (!ws)
+	return;
+    Pshortestpath_free(ws->shortest);
+    Proutespline_free(ws->route);
+    free(ws->ispline);
+    free(ws);
+}
+
+/* the workspace of the functions without one; each thread has its own */
+static GV_THREAD_LOCAL Pworkspace_t *default_ws;
+
+Pworkspace_t *Pworkspace_default(void)
+{
+    if (!default_ws)
+	default_ws = Pworkspace_new();
+    return default_ws;
+}
+
 /**
  * @dir lib/pathplan
  * @brief finds and smooths shortest paths, API pathplan.h
  */
+
+void Pfreescratch(void)
+{
+    Pworkspace_free(default_ws);
+    default_ws = NULL;
+}
@@ -223,6 +223,8 @@ late_quadtree_scheme (graph_t* g, Agsym_t* sym, int dflt)
 	rv = QUAD_TREE_NORMAL;
       } else if (!strcasecmp(s, "fast")){
 	rv = QUAD_TREE_FAST;
+      } else if (!strcasecmp(s, "linear")){
+	rv = QUAD_TREE_LINEAR;
       }	else {
 	rv = dflt;
       }
@@ -233,6 +235,20 @@ late_quadtree_scheme (graph_t* g, Agsym_t* sym, int dflt)
 }
 
 
+static int
+late_repulsion (graph_t* g, Agsym_t* sym, int dflt)
+{
+    char* s;
+
+    if (!sym) return dflt;
+    s = agxget (g, sym);
+    if (!strcasecmp(s, "bh"))
+	return REPULSION_BH;
+    if (!strcasecmp(s, "fmm"))
+	return REPULSION_FMM;
+    return dflt;
+}
+
 /* tuneControl:
  * Use user values to reset control
  */
@@ -263,6 +279,8 @@ tuneControl (graph_t* g, spring_electrical_control ctrl)
 	agerr (AGWARN, "label_scheme = %d > 4 : ignoring\n", ctrl->edge_labeling_scheme);
 	ctrl->edge_labeling_scheme = 0;
     }
+    ctrl->threads = late_int(g, agfindgraphattr(g, "threads"), 1, 1);
+    ctrl->repulsion = late_repulsion(g, agfindgraphattr(g, "repulsion"), REPULSION_BH);
 }
 
 void sfdp_layout(graph_t * g)
@@ -310,6 +328,7 @@ void sfdp_layout(graph_t * g)
 	if (Verbose)
 	    spring_electrical_control_print(ctrl);
 
+	SparseMatrix_set_num_threads(ctrl->threads);
 	ccs = ccomps(g, &ncc, 0);
 	if (ncc == 1) {
 	    sfdpLayout(g, ctrl, hops, pad);
@@ -334,6 +353,7 @@ void sfdp_layout(graph_t * g)
 	    agdelete(g, ccs[i]);
 	}
 	free(ccs);
+	SparseMatrix_set_num_threads(1);
 	spring_electrical_control_delete(ctrl);
     }
 
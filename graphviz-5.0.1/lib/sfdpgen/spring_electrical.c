@@ -13,9 +13,12 @@
 #include <sparse/SparseMatrix.h>
 #include <sfdpgen/spring_electrical.h>
 #include <sparse/QuadTree.h>
+#include <sparse/LinearQuadTree.h>
+#include <sparse/force_kernels.h>
 #include <sfdpgen/Multilevel.h>
 #include <sfdpgen/post_process.h>
 #include <neatogen/overlap.h>
+#include <cgraph/parallel.h>
 #include <common/types.h>
 #include <common/memory.h>
 #include <common/arith.h>
@@ -64,6 +67,9 @@ spring_electrical_control spring_electrical_control_new(){
   ctrl->initial_scaling = -4;
   ctrl->rotation = 0.;
   ctrl->edge_labeling_scheme = 0;
+  ctrl->threads = 1;
+  ctrl->repulsion = REPULSION_BH;
+  ctrl->fmm_order = 4;
   return ctrl;
 }
 
@@ -76,7 +82,11 @@ static char* smoothings[] = {
 };
 
 static char* tschemes[] = {
-  "NONE", "NORMAL", "FAST", "HYBRID"
+  "NONE", "NORMAL", "FAST", "HYBRID", "LINEAR"
+};
+
+static char* repulsions[] = {
+  "BH", "FMM"
 };
 
 static char* methods[] = {
@@ -99,6 +109,8 @@ void spring_electrical_control_print(spring_electrical_control ctrl){
     smoothings[ctrl->smoothing], ctrl->overlap, ctrl->initial_scaling, ctrl->do_shrinking);
   fprintf (stderr, "  octree scheme %s method %s\n", tschemes[ctrl->tscheme], methods[ctrl->method]);
   fprintf (stderr, "  edge_labeling_scheme %d\n", ctrl->edge_labeling_scheme);
+  fprintf (stderr, "  threads %d\n", ctrl->threads);
+  fprintf (stderr, "  repulsion %s fmm_order %d\n", repulsions[ctrl->repulsion], ctrl->fmm_order);
 }
 
 void oned_optimizer_delete(oned_optimizer opt){
@@ -480,19 +492,174 @@ void force_print(FILE *fp, int n, int dim, double *x, double *force){
 }
 
 
+/* Repulsive forces on a block of nodes, worked out on several threads ahead of
+   the sweep that moves them. A node's repulsion only depends on the quadtree
+   built at the start of the iteration and on its own position, which the sweep
+   has not changed yet when it reaches the block. The sweep adds up the stored
+   terms in the order QuadTree_get_supernodes found them, so the forces do not
+   depend on the number of threads, and only differ from those of the serial
+   code by how the compiler rounds the inline expression there. */
+enum {REPULSE_CHUNK = 256, REPULSE_NCHUNKS = 32};
+
+typedef struct {
+  double *terms;/* dim values per supernode, for the nodes of the chunk in turn */
+  int *start;/* node first+i of the chunk has supernodes start[i], ..., start[i+1]-1 */
+  int size;/* capacity of terms, in supernodes */
+  int nsupermax;
+  double *center, *supernode_wgts, *distances;
+  double counts, nsuper;/* totals over the nodes of the chunk */
+  int flag;
+} repulse_chunk;
+
+typedef struct {
+  QuadTree qt;
+  int dim;
+  double *x, bh, p, KP;
+  int first, last;/* the nodes of the current block */
+  repulse_chunk chunks[REPULSE_NCHUNKS];
+} repulse_block;
+
+static void repulse_chunk_run(void *ctx, size_t index){
+  repulse_block *b = ctx;
+  repulse_chunk *c = &b->chunks[index];
+  int dim = b->dim, first = b->first + (int) index*REPULSE_CHUNK;
+  int last = MIN(first + REPULSE_CHUNK, b->last);
+  int i, j, k, nsuper, nterms = 0;
+  double *x = b->x, counts, dist;
+
+  c->counts = c->nsuper = 0;
+  c->flag = 0;
+  for (i = first; i < last; i++){
+    QuadTree_get_supernodes(b->qt, b->bh, &(x[dim*i]), i, &nsuper, &c->nsupermax,
+			    &c->center, &c->supernode_wgts, &c->distances, &counts, &c->flag);
+    if (c->flag) return;
+    c->counts += counts;
+    c->nsuper += nsuper;
+    c->start[i - first] = nterms;
+    if (nterms + nsuper > c->size){
+      c->size = MAX(2*c->size, nterms + nsuper);
+      c->terms = REALLOC(c->terms, sizeof(double)*dim*c->size);
+    }
+    for (j = 0; j < nsuper; j++){
+      dist = MAX(c->distances[j], MINDIST);
+      for (k = 0; k < dim; k++){
+	c->terms[(nterms + j)*dim + k] = c->supernode_wgts[j]*b->KP*(x[i*dim+k] - c->center[j*dim+k])/pow(dist, 1.- b->p);
+      }
+    }
+    nterms += nsuper;
+  }
+  c->start[last - first] = nterms;
+}
+
+static repulse_block *repulse_block_new(int dim, double *x, double bh, double p, double KP){
+  repulse_block *b = MALLOC(sizeof(repulse_block));
+  int i;
+
+  b->dim = dim;
+  b->x = x;
+  b->bh = bh;
+  b->p = p;
+  b->KP = KP;
+  for (i = 0; i < REPULSE_NCHUNKS; i++){
+    b->chunks[i].start = MALLOC(sizeof(int)*(REPULSE_CHUNK + 1));
+    b->chunks[i].size = 0;
+    b->chunks[i].terms = NULL;
+    b->chunks[i].nsupermax = 10;
+    b->chunks[i].center = NULL;
+    b->chunks[i].supernode_wgts = NULL;
+    b->chunks[i].distances = NULL;
+  }
+  return b;
+}
+
+static void repulse_block_delete(repulse_block *b){
+  int i;
+
+  if (!b) return;
+  for (i = 0; i < REPULSE_NCHUNKS; i++){
+    free(b->chunks[i].start);
+    free(b->chunks[i].terms);
+    free(b->chunks[i].center);
+    free(b->chunks[i].supernode_wgts);
+    free(b->chunks[i].distances);
+  }
+  free(b);
+}
+
+static int repulse_block_run(repulse_block *b, QuadTree qt, int first, int n, int nthreads,
+			     double *counts_avg, double *nsuper_avg){
+  /* compute the repulsion on the block of nodes starting at first. Return the flag of QuadTree_get_supernodes */
+  int c, nchunks;
+
+  b->qt = qt;
+  b->first = first;
+  b->last = MIN(first + REPULSE_CHUNK*REPULSE_NCHUNKS, n);
+  nchunks = (b->last - first + REPULSE_CHUNK - 1)/REPULSE_CHUNK;
+  gv_parallel_for((size_t)nchunks, nthreads, repulse_chunk_run, b);
+  for (c = 0; c < nchunks; c++){
+    if (b->chunks[c].flag) return b->chunks[c].flag;
+    *counts_avg += b->chunks[c].counts;
+    *nsuper_avg += b->chunks[c].nsuper;
+  }
+  return 0;
+}
+
+static void repulse_block_add(repulse_block *b, int i, double *f){
+  /* add the repulsion on node i, in the order QuadTree_get_supernodes found the supernodes */
+  repulse_chunk *c = &b->chunks[(i - b->first)/REPULSE_CHUNK];
+  int dim = b->dim, j, k, l = (i - b->first)%REPULSE_CHUNK;
+
+  for (j = c->start[l]; j < c->start[l+1]; j++){
+    for (k = 0; k < dim; k++) f[k] += c->terms[j*dim+k];
+  }
+}
+
+/* attractive forces of the fast scheme, on a range of nodes */
+typedef struct {
+  int dim, n, *ia, *ja;
+  double *x, *force, CRK;
+} attract_job;
+
+enum {ATTRACT_CHUNK = 4096};
+
+static void attract_run(void *ctx, size_t index){
+  attract_job *a = ctx;
+  int dim = a->dim, i, j, k, first = (int) index*ATTRACT_CHUNK;
+  int last = MIN(first + ATTRACT_CHUNK, a->n);
+  double *x = a->x, *f, dist;
+
+  /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
+  if (dim == 2){
+    force_attract(x, a->force, a->ia, a->ja, first, last, a->CRK);
+    return;
+  }
+  for (i = first; i < last; i++){
+    f = &(a->force[i*dim]);
+    for (j = a->ia[i]; j < a->ia[i+1]; j++){
+      if (a->ja[j] == i) continue;
+      dist = distance(x, dim, i, a->ja[j]);
+      for (k = 0; k < dim; k++){
+	f[k] -= a->CRK*(x[i*dim+k] - x[a->ja[j]*dim+k])*dist;
+      }
+    }
+  }
+}
+
 void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrical_control ctrl, double *x, int *flag){
   /* x is a point to a 1D array, x[i*dim+j] gives the coordinate of the i-th node at dimension j.  */
   SparseMatrix A = A0;
   int m, n;
-  int i, j, k;
+  int i, k;
   double p = ctrl->p, K = ctrl->K, C = ctrl->C, CRK, tol = ctrl->tol, maxiter = ctrl->maxiter, cool = ctrl->cool, step = ctrl->step, KP;
   int *ia = NULL, *ja = NULL;
   double *xold = NULL;
-  double *f = NULL, dist, F, Fnorm = 0, Fnorm0;
+  double *f = NULL, F, Fnorm = 0, Fnorm0;
   int iter = 0;
   int adaptive_cooling = ctrl->adaptive_cooling;
   QuadTree qt = NULL;
+  LinearQuadTree lqt = NULL;
   double counts[4], *force = NULL;
+  attract_job attract;
 #ifdef TIME
   clock_t start, end, start0;
   double qtree_cpu = 0, qtree_cpu0 = 0, qtree_new_cpu = 0, qtree_new_cpu0 = 0;
@@ -533,6 +700,12 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
 
   xold = MALLOC(sizeof(double)*dim*n);
   force = MALLOC(sizeof(double)*dim*n);
+  attract.dim = dim;
+  attract.n = n;
+  attract.ia = ia;
+  attract.ja = ja;
+  attract.force = force;
+  attract.CRK = CRK;
 
   do {
 #ifdef TIME
@@ -549,7 +722,11 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
 #ifdef TIME
     start = clock();
 #endif
-    qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x);
+    if (ctrl->tscheme == QUAD_TREE_LINEAR || ctrl->repulsion == REPULSION_FMM) {
+      lqt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x);
+    } else {
+      qt = QuadTree_new_from_point_list_threads(dim, n, max_qtree_level, x, ctrl->threads);
+    }
 
 #ifdef TIME
     qtree_new_cpu += ((double) (clock() - start))/CLOCKS_PER_SEC;
@@ -560,7 +737,13 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
     start = clock();
 #endif
 
-    QuadTree_get_repulsive_force(qt, force, x, ctrl->bh, p, KP, counts, flag);
+    if (ctrl->repulsion == REPULSION_FMM) {
+      LinearQuadTree_get_repulsive_force_fmm(lqt, force, ctrl->bh, p, KP, ctrl->fmm_order, counts);
+    } else if (lqt) {
+      LinearQuadTree_get_repulsive_force(lqt, force, ctrl->bh, p, KP, counts, ctrl->threads);
+    } else {
+      QuadTree_get_repulsive_force_threads(qt, force, x, ctrl->bh, p, KP, counts, flag, ctrl->threads);
+    }
 
     assert(!(*flag));
 
@@ -570,16 +753,8 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
 #endif
 
     /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
-    for (i = 0; i < n; i++){
-      f = &(force[i*dim]);
-      for (j = ia[i]; j < ia[i+1]; j++){
-	if (ja[j] == i) continue;
-	dist = distance(x, dim, i, ja[j]);
-	for (k = 0; k < dim; k++){
-	  f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*dist;
-	}
-      }
-    }
+    attract.x = x;
+    gv_parallel_for((size_t)((n + ATTRACT_CHUNK - 1)/ATTRACT_CHUNK), ctrl->threads, attract_run, &attract);
 
 
     /* move */
@@ -595,11 +770,14 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
 
 
 
-    if (qt) {
+    if (qt || lqt) {
 #ifdef TIME
       start = clock();
 #endif
       QuadTree_delete(qt);
+      LinearQuadTree_delete(lqt);
+      qt = NULL;
+      lqt = NULL;
 #ifdef TIME
       end = clock();
       qtree_new_cpu += ((double) (end - start)) / CLOCKS_PER_SEC;
@@ -908,6 +1086,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   int USE_QT = FALSE;
   int nsuper = 0, nsupermax = 10;
   double *center = NULL, *supernode_wgts = NULL, *distances = NULL, nsuper_avg, counts = 0, counts_avg = 0;
+  repulse_block *rb = NULL;
 #ifdef TIME
   clock_t start, end, start0, start2;
   double qtree_cpu = 0, qtree_cpu0 = 0;
@@ -965,6 +1144,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
 
   f = MALLOC(sizeof(double)*dim);
   xold = MALLOC(sizeof(double)*dim*n);
+  if (USE_QT && ctrl->threads > 1) rb = repulse_block_new(dim, x, ctrl->bh, p, KP);
   do {
 
     //#define VIS_MULTILEVEL
@@ -990,7 +1170,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
     if (USE_QT) {
 
       max_qtree_level = oned_optimizer_get(qtree_level_optimizer);
-      qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x);
+      qt = QuadTree_new_from_point_list_threads(dim, n, max_qtree_level, x, ctrl->threads);
 
 	
     }
@@ -999,6 +1179,10 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
 #endif
 
     for (i = 0; i < n; i++){
+      if (rb && i%(REPULSE_CHUNK*REPULSE_NCHUNKS) == 0){
+	*flag = repulse_block_run(rb, qt, i, n, ctrl->threads, &counts_avg, &nsuper_avg);
+	if (*flag) goto RETURN;
+      }
       for (k = 0; k < dim; k++) f[k] = 0.;
       /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
       for (j = ia[i]; j < ia[i+1]; j++){
@@ -1010,7 +1194,9 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
       }
 
       /* repulsive force K^(1 - p)/||x_i-x_j||^(1 - p) (x_i - x_j) */
-      if (USE_QT){
+      if (rb){
+	repulse_block_add(rb, i, f);
+      } else if (USE_QT){
 #ifdef TIME
 	start = clock();
 #endif
@@ -1121,6 +1307,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   free(center);
   free(supernode_wgts);
   free(distances);
+  repulse_block_delete(rb);
 }
 
 static void scale_coord(int n, int dim, double *x, int *id, int *jd, double *d, double dj){
@@ -1947,7 +2134,8 @@ static void multilevel_spring_electrical_embedding_core(int dim, SparseMatrix A0
     if (ctrl->method == METHOD_SPRING_ELECTRICAL){
       if (ctrl->tscheme == QUAD_TREE_NONE){
 	spring_electrical_embedding_slow(dim, grid->A, ctrl, xc, flag);
-      } else if (ctrl->tscheme == QUAD_TREE_FAST || (ctrl->tscheme == QUAD_TREE_HYBRID && grid->A->m > QUAD_TREE_HYBRID_SIZE)){
+      } else if (ctrl->tscheme == QUAD_TREE_FAST || ctrl->tscheme == QUAD_TREE_LINEAR || ctrl->repulsion == REPULSION_FMM
+		 || (ctrl->tscheme == QUAD_TREE_HYBRID && grid->A->m > QUAD_TREE_HYBRID_SIZE)){
 	if (ctrl->tscheme == QUAD_TREE_HYBRID && grid->A->m > 10 && Verbose){
 	  fprintf(stderr, "QUAD_TREE_HYBRID, size larger than %d, switch to fast quadtree", QUAD_TREE_HYBRID_SIZE);
 	}
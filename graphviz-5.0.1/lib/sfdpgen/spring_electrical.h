@@ -21,7 +21,9 @@ enum {SMOOTHING_NONE, SMOOTHING_STRESS_MAJORIZATION_GRAPH_DIST, SMOOTHING_STRESS
 
 enum {QUAD_TREE_HYBRID_SIZE = 10000};
 
-enum {QUAD_TREE_NONE = 0, QUAD_TREE_NORMAL, QUAD_TREE_FAST, QUAD_TREE_HYBRID};
+enum {QUAD_TREE_NONE = 0, QUAD_TREE_NORMAL, QUAD_TREE_FAST, QUAD_TREE_HYBRID, QUAD_TREE_LINEAR};
+
+enum {REPULSION_BH = 0, REPULSION_FMM};
 
 enum {METHOD_STA = -1, METHOD_SPRING_ELECTRICAL, METHOD_SPRING_MAXENT, METHOD_STRESS_MAXENT, METHOD_STRESS_APPROX, METHOD_STRESS, METHOD_UNIFORM_STRESS, METHOD_FULL_STRESS, METHOD_NONE, METHOD_STO};
 
@@ -47,7 +49,7 @@ struct spring_electrical_control_struct {
   int smoothing;
   int overlap;
   int do_shrinking;
-  int tscheme; /* octree scheme. 0 (no octree), 1 (normal), 2 (fast) */
+  int tscheme; /* octree scheme. 0 (no octree), 1 (normal), 2 (fast), 4 (fast, on a LinearQuadTree) */
   int method;/* spring_electical, spring_maxent */
   double initial_scaling;/* how to scale the layout of the graph before passing to overlap removal algorithm.
 			  positive values are absolute in points, negative values are relative
@@ -58,6 +60,10 @@ struct spring_electrical_control_struct {
 			       0 (no action, default), 1 (penalty based method to make that kind of node close to the center of its neighbor), 
 			       1 (penalty based method to make that kind of node close to the old center of its neighbor),
 			       3 (two step process of overlap removal and straightening) */
+  int threads;/* number of threads to compute the repulsive forces with. default 1 */
+  int repulsion;/* how the quadtree approximates repulsive forces: REPULSION_BH (Barnes-Hut, default) or REPULSION_FMM
+		   (fast multipole method, in 2D, used with any scheme but QUAD_TREE_NONE) */
+  int fmm_order;/* order of the expansions with REPULSION_FMM. default 4 */
 };
 
 typedef struct  spring_electrical_control_struct  *spring_electrical_control; 
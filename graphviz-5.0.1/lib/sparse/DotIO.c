@@ -133,7 +133,7 @@ SparseMatrix SparseMatrix_import_dot(Agraph_t *g, int dim, double **label_sizes,
 
       /* edge weight */
       if (sym) {
-        if (sscanf (agxget(e,sym), "%lf", &v) != 1) v = 1;
+        if (!agxgetdouble(e, sym, &v)) v = 1;
       } else {
         v = 1;
       }
@@ -408,7 +408,7 @@ SparseMatrix Import_coord_clusters_from_dot(Agraph_t* g, int maxcluster, int dim
       I[i] = row;
       J[i] = ND_id(aghead(e));
       if (sym) {
-        if (sscanf (agxget(e,sym), "%lf", &v) != 1)
+        if (!agxgetdouble(e, sym, &v))
           v = 1;
       }
       else
@@ -646,7 +646,7 @@ void attached_clustering(Agraph_t* g, int maxcluster, int clustering_scheme){
       I[i] = row;
       J[i] = ND_id(aghead(e));
       if (sym) {
-        if (sscanf (agxget(e,sym), "%lf", &v) != 1)
+        if (!agxgetdouble(e, sym, &v))
           v = 1;
       }
       else
@@ -0,0 +1,798 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+#include <cgraph/parallel.h>
+#include <sparse/general.h>
+#include <common/arith.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sparse/LinearQuadTree.h>
+#include <sparse/force_kernels.h>
+
+static void radix_sort(int n, int nbits, uint64_t *keys, int *perm){
+  /* sort perm[0..n-1] by keys, of which only the low nbits bits are set. The sort is stable. */
+  uint64_t *keys2 = MALLOC(sizeof(uint64_t)*MAX(n, 1));
+  int *perm2 = MALLOC(sizeof(int)*MAX(n, 1));
+  uint64_t *tk;
+  int *tp, i, shift, cnt[257];
+
+  for (shift = 0; shift < nbits; shift += 8){
+    for (i = 0; i <= 256; i++) cnt[i] = 0;
+    for (i = 0; i < n; i++) cnt[((keys[i] >> shift) & 0xff) + 1]++;
+    for (i = 0; i < 256; i++) cnt[i+1] += cnt[i];
+    for (i = 0; i < n; i++){
+      int j = cnt[(keys[i] >> shift) & 0xff]++;
+      keys2[j] = keys[i];
+      perm2[j] = perm[i];
+    }
+    tk = keys; keys = keys2; keys2 = tk;
+    tp = perm; perm = perm2; perm2 = tp;
+  }
+  if (((nbits + 7)/8)%2){/* an odd number of passes left the result in the scratch arrays */
+    memcpy(keys2, keys, sizeof(uint64_t)*n);
+    memcpy(perm2, perm, sizeof(int)*n);
+    free(keys);
+    free(perm);
+  } else {
+    free(keys2);
+    free(perm2);
+  }
+}
+
+typedef struct {
+  LinearQuadTree qt;
+  uint64_t *keys;
+  int levels;
+  int size;/* capacity of the cell arrays */
+} lqt_build;
+
+static void lqt_build_cells(lqt_build *b, int lo, int hi, int level, double width){
+  /* add the cell holding the sorted points lo, ..., hi-1, at the given level, and its subtree */
+  LinearQuadTree qt = b->qt;
+  int c = qt->ncells++, dim = qt->dim, shift, d, j;
+
+  if (qt->ncells > b->size){
+    b->size = MAX(2*b->size, 64);
+    qt->first = REALLOC(qt->first, sizeof(int)*b->size);
+    qt->count = REALLOC(qt->count, sizeof(int)*b->size);
+    qt->next = REALLOC(qt->next, sizeof(int)*b->size);
+    qt->width = REALLOC(qt->width, sizeof(double)*b->size);
+  }
+  qt->first[c] = lo;
+  qt->count[c] = hi - lo;
+  qt->width[c] = width;
+
+  /* as in QuadTree, a cell is split once it has two points, unless it is at the last level */
+  if (hi - lo >= 2 && level < b->levels){
+    shift = dim*(b->levels - 1 - level);
+    while (lo < hi){
+      d = (int) ((b->keys[lo] >> shift) & ((1u << dim) - 1));
+      for (j = lo + 1; j < hi && (int) ((b->keys[j] >> shift) & ((1u << dim) - 1)) == d; j++);
+      lqt_build_cells(b, lo, j, level + 1, width/2);
+      lo = j;
+    }
+  }
+  qt->next[c] = qt->ncells;
+}
+
+LinearQuadTree LinearQuadTree_new_from_point_list(int dim, int n, int max_level, double *coord){
+  LinearQuadTree qt;
+  lqt_build b = {0};
+  double *xmin, *xmax, *center, *c, width, w;
+  uint64_t code;
+  int i, j, k, l, ch;
+
+  if (n <= 0 || dim <= 0 || dim > 16) return NULL;
+
+  qt = MALLOC(sizeof(struct LinearQuadTree_struct));
+  qt->dim = dim;
+  qt->n = n;
+  qt->max_level = MAX(0, MIN(max_level, 64/dim));
+  qt->ncells = 0;
+  qt->first = qt->count = qt->next = NULL;
+  qt->width = NULL;
+
+  /* the top cell, as QuadTree_new_from_point_list sets it up */
+  xmin = MALLOC(sizeof(double)*dim);
+  xmax = MALLOC(sizeof(double)*dim);
+  center = MALLOC(sizeof(double)*dim);
+  c = MALLOC(sizeof(double)*dim);
+  for (k = 0; k < dim; k++) xmin[k] = xmax[k] = coord[k];
+  for (i = 1; i < n; i++){
+    for (k = 0; k < dim; k++){
+      xmin[k] = MIN(xmin[k], coord[i*dim+k]);
+      xmax[k] = MAX(xmax[k], coord[i*dim+k]);
+    }
+  }
+  width = xmax[0] - xmin[0];
+  for (k = 0; k < dim; k++) {
+    center[k] = (xmin[k] + xmax[k])*0.5;
+    width = MAX(width, xmax[k] - xmin[k]);
+  }
+  if (width == 0) width = 0.00001;
+  width *= 0.52;
+
+  /* the Morton code of each point, one quadrant per level, found by the same comparisons with
+     the same cell centers as QuadTree_add makes, so that the points fall in the same cells */
+  b.keys = MALLOC(sizeof(uint64_t)*n);
+  qt->perm = MALLOC(sizeof(int)*n);
+  for (i = 0; i < n; i++){
+    for (k = 0; k < dim; k++) c[k] = center[k];
+    w = width;
+    code = 0;
+    for (l = 0; l < qt->max_level; l++){
+      w /= 2;
+      code <<= dim;
+      for (k = 0; k < dim; k++){
+	if (coord[i*dim+k] - c[k] < 0){
+	  c[k] -= w;
+	} else {
+	  c[k] += w;
+	  code |= (uint64_t) 1 << k;
+	}
+      }
+    }
+    b.keys[i] = code;
+    qt->perm[i] = i;
+  }
+  radix_sort(n, dim*qt->max_level, b.keys, qt->perm);
+
+  qt->coord = MALLOC(sizeof(double)*dim*n);
+  for (j = 0; j < n; j++){
+    for (k = 0; k < dim; k++) qt->coord[k*n + j] = coord[qt->perm[j]*dim+k];
+  }
+
+  b.qt = qt;
+  b.levels = qt->max_level;
+  lqt_build_cells(&b, 0, n, 0, width);
+
+  /* centers of mass, children before parents */
+  qt->average = MALLOC(sizeof(double)*dim*qt->ncells);
+  for (i = qt->ncells - 1; i >= 0; i--){
+    for (k = 0; k < dim; k++) qt->average[k*qt->ncells + i] = 0;
+    if (qt->next[i] == i + 1){
+      for (j = qt->first[i]; j < qt->first[i] + qt->count[i]; j++){
+	for (k = 0; k < dim; k++) qt->average[k*qt->ncells + i] += qt->coord[k*n + j];
+      }
+    } else {
+      for (ch = i + 1; ch < qt->next[i]; ch = qt->next[ch]){
+	for (k = 0; k < dim; k++) qt->average[k*qt->ncells + i] += qt->average[k*qt->ncells + ch];
+      }
+    }
+  }
+  for (k = 0; k < dim; k++){
+    for (i = 0; i < qt->ncells; i++) qt->average[k*qt->ncells + i] /= qt->count[i];
+  }
+
+  free(b.keys);
+  free(xmin);
+  free(xmax);
+  free(center);
+  free(c);
+  return qt;
+}
+
+void LinearQuadTree_delete(LinearQuadTree qt){
+  if (!qt) return;
+  free(qt->perm);
+  free(qt->coord);
+  free(qt->first);
+  free(qt->count);
+  free(qt->next);
+  free(qt->width);
+  free(qt->average);
+  free(qt);
+}
+
+/* forces of a traversal: on the points in Morton order, and on the cells, laid out as average */
+typedef struct {
+  LinearQuadTree qt;
+  double bh, p, KP;
+  double *nforce, *cforce;
+  double counts[2];
+} lqt_forces;
+
+static double cell_distance(LinearQuadTree qt, int c1, int c2){
+  double dist = 0, d;
+  int k;
+
+  for (k = 0; k < qt->dim; k++){
+    d = qt->average[k*qt->ncells + c1] - qt->average[k*qt->ncells + c2];
+    dist += d*d;
+  }
+  return sqrt(dist);
+}
+
+static void lqt_interact(lqt_forces *fs, int c1, int c2){
+  /* the repulsive forces between the points of cells c1 and c2, as QuadTree_repulsive_force_interact
+     computes them */
+  LinearQuadTree qt = fs->qt;
+  int dim = qt->dim, n = qt->n, nc = qt->ncells, i, j, k, ch1, ch2;
+  double dist, d, f, w;
+  bool leaf1, leaf2;
+
+  /* far enough, calculate repulsive force */
+  dist = cell_distance(qt, c1, c2);
+  if (qt->width[c1] + qt->width[c2] < fs->bh*dist){
+    fs->counts[0]++;
+    w = (double) qt->count[c1]*qt->count[c2];
+    for (k = 0; k < dim; k++){
+      if (fs->p == -1){
+	f = w*fs->KP*(qt->average[k*nc + c1] - qt->average[k*nc + c2])/(dist*dist);
+      } else {
+	f = w*fs->KP*(qt->average[k*nc + c1] - qt->average[k*nc + c2])/pow(dist, 1.- fs->p);
+      }
+      fs->cforce[k*nc + c1] += f;
+      fs->cforce[k*nc + c2] -= f;
+    }
+    return;
+  }
+
+  leaf1 = qt->next[c1] == c1 + 1;
+  leaf2 = qt->next[c2] == c2 + 1;
+
+  /* both at leaves, calculate repulsive force */
+  if (leaf1 && leaf2){
+    if (c1 == c2){
+      fs->counts[1] += (double) qt->count[c1]*(qt->count[c1] - 1)/2;
+    } else {
+      fs->counts[1] += (double) qt->count[c1]*qt->count[c2];
+    }
+    if (dim == 2 && fs->p == -1){
+      force_repulse(qt->coord, qt->coord + n, fs->nforce, fs->nforce + n, qt->first[c1],
+		    qt->first[c1] + qt->count[c1], qt->first[c2], qt->first[c2] + qt->count[c2], fs->KP);
+      return;
+    }
+    for (i = qt->first[c1]; i < qt->first[c1] + qt->count[c1]; i++){
+      for (j = c1 == c2 ? i + 1 : qt->first[c2]; j < qt->first[c2] + qt->count[c2]; j++){
+	for (dist = 0, k = 0; k < dim; k++){
+	  d = qt->coord[k*n + i] - qt->coord[k*n + j];
+	  dist += d*d;
+	}
+	dist = MAX(sqrt(dist), MINDIST);
+	for (k = 0; k < dim; k++){
+	  d = qt->coord[k*n + i] - qt->coord[k*n + j];
+	  if (fs->p == -1){
+	    f = fs->KP*d/(dist*dist);
+	  } else {
+	    f = fs->KP*d/pow(dist, 1.- fs->p);
+	  }
+	  fs->nforce[k*n + i] += f;
+	  fs->nforce[k*n + j] -= f;
+	}
+      }
+    }
+    return;
+  }
+
+  if (c1 == c2){
+    /* identical, split one */
+    for (ch1 = c1 + 1; ch1 < qt->next[c1]; ch1 = qt->next[ch1]){
+      for (ch2 = ch1; ch2 < qt->next[c1]; ch2 = qt->next[ch2]) lqt_interact(fs, ch1, ch2);
+    }
+  } else if ((qt->width[c1] > qt->width[c2] && !leaf1) || (!(qt->width[c2] > qt->width[c1] && !leaf2) && !leaf1)){
+    /* split the one with bigger box, or one not at the last level */
+    for (ch1 = c1 + 1; ch1 < qt->next[c1]; ch1 = qt->next[ch1]) lqt_interact(fs, ch1, c2);
+  } else {
+    for (ch2 = c2 + 1; ch2 < qt->next[c2]; ch2 = qt->next[ch2]) lqt_interact(fs, ch2, c1);
+  }
+}
+
+/* a pair of cells whose interaction is left to one thread */
+typedef struct {
+  int c1, c2;
+  double cost;
+  int thread;
+} lqt_pair;
+
+typedef struct {
+  lqt_pair *pairs;
+  int npairs, size;
+  lqt_forces *fs;/* one per thread */
+} lqt_pairs;
+
+static void lqt_add_pair(lqt_pairs *ps, int c1, int c2, double cost){
+  if (ps->npairs >= ps->size){
+    ps->size = MAX(64, 2*ps->size);
+    ps->pairs = REALLOC(ps->pairs, sizeof(lqt_pair)*ps->size);
+  }
+  ps->pairs[ps->npairs].c1 = c1;
+  ps->pairs[ps->npairs].c2 = c2;
+  ps->pairs[ps->npairs].cost = cost;
+  ps->pairs[ps->npairs].thread = 0;
+  ps->npairs++;
+}
+
+static void lqt_collect_pairs(LinearQuadTree qt, int c1, int c2, double bh, int depth, lqt_pairs *ps){
+  /* split the interaction of c1 and c2 as lqt_interact does, down to the given depth */
+  int ch1, ch2, m;
+  bool leaf1 = qt->next[c1] == c1 + 1, leaf2 = qt->next[c2] == c2 + 1;
+
+  if (qt->width[c1] + qt->width[c2] < bh*cell_distance(qt, c1, c2)){
+    lqt_add_pair(ps, c1, c2, 1);
+  } else if (leaf1 && leaf2){
+    lqt_add_pair(ps, c1, c2, (double) qt->count[c1]*qt->count[c2]);
+  } else if (depth == 0){
+    m = c1 == c2 ? qt->count[c1] : qt->count[c1] + qt->count[c2];
+    lqt_add_pair(ps, c1, c2, m*log2(m + 1.));
+  } else if (c1 == c2){
+    for (ch1 = c1 + 1; ch1 < qt->next[c1]; ch1 = qt->next[ch1]){
+      for (ch2 = ch1; ch2 < qt->next[c1]; ch2 = qt->next[ch2]) lqt_collect_pairs(qt, ch1, ch2, bh, depth - 1, ps);
+    }
+  } else if ((qt->width[c1] > qt->width[c2] && !leaf1) || (!(qt->width[c2] > qt->width[c1] && !leaf2) && !leaf1)){
+    for (ch1 = c1 + 1; ch1 < qt->next[c1]; ch1 = qt->next[ch1]) lqt_collect_pairs(qt, ch1, c2, bh, depth - 1, ps);
+  } else {
+    for (ch2 = c2 + 1; ch2 < qt->next[c2]; ch2 = qt->next[ch2]) lqt_collect_pairs(qt, ch2, c1, bh, depth - 1, ps);
+  }
+}
+
+static int lqt_pair_cmp(const void *a, const void *b){
+  const lqt_pair *x = *(lqt_pair *const *) a, *y = *(lqt_pair *const *) b;
+  if (x->cost != y->cost) return x->cost > y->cost ? -1 : 1;
+  return x < y ? -1 : (x > y);
+}
+
+static void lqt_assign_pairs(lqt_pairs *ps, int nthreads){
+  /* largest first, each to the least loaded thread, so the split only depends on nthreads */
+  lqt_pair **order = MALLOC(sizeof(lqt_pair*)*MAX(ps->npairs, 1));
+  double *load = MALLOC(sizeof(double)*nthreads);
+  int i, t, tmin;
+
+  for (i = 0; i < ps->npairs; i++) order[i] = &ps->pairs[i];
+  qsort(order, ps->npairs, sizeof(lqt_pair*), lqt_pair_cmp);
+  for (t = 0; t < nthreads; t++) load[t] = 0;
+  for (i = 0; i < ps->npairs; i++){
+    for (tmin = 0, t = 1; t < nthreads; t++){
+      if (load[t] < load[tmin]) tmin = t;
+    }
+    order[i]->thread = tmin;
+    load[tmin] += order[i]->cost;
+  }
+  free(order);
+  free(load);
+}
+
+static void lqt_run_pairs(void *ctx, size_t index){
+  lqt_pairs *ps = ctx;
+  int i, t = (int) index;
+
+  for (i = 0; i < ps->npairs; i++){
+    if (ps->pairs[i].thread == t) lqt_interact(&ps->fs[t], ps->pairs[i].c1, ps->pairs[i].c2);
+  }
+}
+
+void LinearQuadTree_get_repulsive_force(LinearQuadTree qt, double *force, double bh, double p, double KP,
+					double *counts, int nthreads){
+  /* force: the repulsive force, an array of length dim*n, the force on point i is at force[i*dim+j], j = 0, ..., dim - 1.
+     The other arguments are those of QuadTree_get_repulsive_force. With several threads, each accumulates
+     into forces of its own, which are then summed in thread order. */
+  lqt_pairs ps = {0};
+  int n = qt->n, dim = qt->dim, nc = qt->ncells, i, j, k, t, ch, depth, npairs;
+  double *nf, *cf, w;
+
+  if (nthreads < 1 || n < 1000) nthreads = 1;
+
+  ps.fs = MALLOC(sizeof(lqt_forces)*nthreads);
+  for (t = 0; t < nthreads; t++){
+    ps.fs[t].qt = qt;
+    ps.fs[t].bh = bh;
+    ps.fs[t].p = p;
+    ps.fs[t].KP = KP;
+    ps.fs[t].nforce = MALLOC(sizeof(double)*dim*n);
+    ps.fs[t].cforce = MALLOC(sizeof(double)*dim*nc);
+    for (i = 0; i < dim*n; i++) ps.fs[t].nforce[i] = 0;
+    for (i = 0; i < dim*nc; i++) ps.fs[t].cforce[i] = 0;
+    ps.fs[t].counts[0] = ps.fs[t].counts[1] = 0;
+  }
+
+  if (nthreads == 1){
+    lqt_interact(&ps.fs[0], 0, 0);
+  } else {
+    for (depth = 1, npairs = 0; ; depth++){
+      ps.npairs = 0;
+      lqt_collect_pairs(qt, 0, 0, bh, depth, &ps);
+      if (ps.npairs >= 16*nthreads || ps.npairs == npairs || depth >= 8) break;
+      npairs = ps.npairs;
+    }
+    lqt_assign_pairs(&ps, nthreads);
+    gv_parallel_for((size_t)nthreads, nthreads, lqt_run_pairs, &ps);
+  }
+
+  nf = ps.fs[0].nforce;
+  cf = ps.fs[0].cforce;
+  counts[0] = counts[1] = 0;
+  for (t = 0; t < nthreads; t++){
+    counts[0] += ps.fs[t].counts[0];
+    counts[1] += ps.fs[t].counts[1];
+    if (t == 0) continue;
+    for (i = 0; i < dim*n; i++) nf[i] += ps.fs[t].nforce[i];
+    for (i = 0; i < dim*nc; i++) cf[i] += ps.fs[t].cforce[i];
+  }
+
+  /* push the forces on the cells down to the points, parents before children */
+  for (i = 0; i < nc; i++){
+    if (qt->next[i] == i + 1){
+      w = 1./qt->count[i];
+      for (j = qt->first[i]; j < qt->first[i] + qt->count[i]; j++){
+	for (k = 0; k < dim; k++) nf[k*n + j] += w*cf[k*nc + i];
+      }
+    } else {
+      for (ch = i + 1; ch < qt->next[i]; ch = qt->next[ch]){
+	w = (double) qt->count[ch]/qt->count[i];
+	for (k = 0; k < dim; k++) cf[k*nc + ch] += w*cf[k*nc + i];
+      }
+    }
+  }
+  counts[2] = nc;
+  counts[3] = 0;
+  for (i = 0; i < 4; i++) counts[i] /= n;
+
+  for (j = 0; j < n; j++){
+    for (k = 0; k < dim; k++) force[qt->perm[j]*dim+k] = nf[k*n + j];
+  }
+
+  for (t = 0; t < nthreads; t++){
+    free(ps.fs[t].nforce);
+    free(ps.fs[t].cforce);
+  }
+  free(ps.fs);
+  free(ps.pairs);
+}
+
+/* The fast multipole method, in the plane. A point is a complex number z = x + iy, and the force
+   z|z|^(p-1) on a point at z from one at 0 is z^a conj(z)^b with a = (p+1)/2 and b = (p-1)/2, which
+   is well defined as a - b = 1. Writing z = Z + u for the centers Z of two cells, the binomial series
+   in u/Z and conj(u/Z) give the multipole expansion of a cell about its center,
+     M[k][l] = sum over its points of (-d)^k conj(-d)^l, d the offset of the point from the center,
+   the local expansion of the force within a cell,
+     F(e) = sum of L[m][n] e^m conj(e)^n, e the offset from the center,
+   and the translation from one to the other,
+     L[m][n] += sum of A[m+k] B[n+l] C(m+k,m) C(n+l,n) Z^(a-m-k) conj(Z)^(b-n-l) M[k][l],
+   with A and B the binomial coefficients of a and b, truncated to terms with m + n + k + l <= order.
+   Shifting expansions between a cell and its children is exact. If a is a natural number, as it is
+   for p = -1, A[j] = 0 for j > a, and only the coefficients with k, m <= a are needed. */
+
+enum {FMM_MAX_ORDER = 16, FMM_LEAF = 16};/* cells of up to FMM_LEAF points are leaves */
+#define FMM_MAX_THETA 0.75
+
+typedef struct {
+  double re, im;
+} fmm_complex;
+
+static fmm_complex fmm_mul(fmm_complex x, fmm_complex y){
+  fmm_complex z = {x.re*y.re - x.im*y.im, x.re*y.im + x.im*y.re};
+  return z;
+}
+
+static fmm_complex fmm_conj(fmm_complex x){
+  fmm_complex z = {x.re, -x.im};
+  return z;
+}
+
+static void fmm_powers(fmm_complex x, int order, fmm_complex *pw){
+  /* pw[j] = x^j, j = 0, ..., order */
+  int j;
+
+  pw[0].re = 1;
+  pw[0].im = 0;
+  for (j = 1; j <= order; j++) pw[j] = fmm_mul(pw[j-1], x);
+}
+
+typedef struct {
+  LinearQuadTree qt;
+  int order, ncoef;
+  int rows;/* only the coefficients M[k][l] and L[m][n] with k, m < rows are needed */
+  double theta, p, KP;
+  int *index;/* index[c]*ncoef is where the expansions of cell c start, -1 if c lies below a leaf */
+  double *radius;/* the points of cell c are within radius[c] of its center of mass */
+  fmm_complex *mpole, *local;
+  double *nforce;/* the forces on the points in Morton order */
+  int ix[FMM_MAX_ORDER+1][FMM_MAX_ORDER+1];/* ix[k][l] is the position of coefficient k, l */
+  double A[FMM_MAX_ORDER+1], B[FMM_MAX_ORDER+1];
+  double C[FMM_MAX_ORDER+1][FMM_MAX_ORDER+1];
+  double counts[2];
+} fmm;
+
+static bool fmm_leaf(fmm *f, int c){
+  return f->qt->next[c] == c + 1 || f->qt->count[c] <= FMM_LEAF;
+}
+
+static fmm_complex fmm_center(fmm *f, int c){
+  fmm_complex z = {f->qt->average[c], f->qt->average[f->qt->ncells + c]};
+  return z;
+}
+
+static int fmm_setup(fmm *f, int c, int next){
+  /* number the expansions of c and the cells below it, down to the leaves, and find their radii */
+  LinearQuadTree qt = f->qt;
+  fmm_complex z = fmm_center(f, c), w;
+  double r = 0;
+  int ch, j;
+
+  f->index[c] = next++;
+  if (fmm_leaf(f, c)){
+    for (j = qt->first[c]; j < qt->first[c] + qt->count[c]; j++){
+      r = MAX(r, hypot(qt->coord[j] - z.re, qt->coord[qt->n + j] - z.im));
+    }
+  } else {
+    for (ch = c + 1; ch < qt->next[c]; ch = qt->next[ch]){
+      next = fmm_setup(f, ch, next);
+      w = fmm_center(f, ch);
+      r = MAX(r, hypot(w.re - z.re, w.im - z.im) + f->radius[ch]);
+    }
+  }
+  f->radius[c] = r;
+  return next;
+}
+
+static void fmm_upward(fmm *f, int c){
+  /* the multipole expansion of c, from its points or from those of its children */
+  LinearQuadTree qt = f->qt;
+  fmm_complex *M = &f->mpole[f->index[c]*f->ncoef], *Mc, pw[FMM_MAX_ORDER+1], x, t;
+  fmm_complex z = fmm_center(f, c);
+  int P = f->order, ch, j, k, l, r, s;
+
+  if (fmm_leaf(f, c)){
+    for (j = qt->first[c]; j < qt->first[c] + qt->count[c]; j++){
+      x.re = z.re - qt->coord[j];
+      x.im = z.im - qt->coord[qt->n + j];
+      fmm_powers(x, P, pw);
+      for (k = 0; k < f->rows; k++){
+	for (l = 0; k + l <= P; l++){
+	  t = fmm_mul(pw[k], fmm_conj(pw[l]));
+	  M[f->ix[k][l]].re += t.re;
+	  M[f->ix[k][l]].im += t.im;
+	}
+      }
+    }
+    return;
+  }
+
+  for (ch = c + 1; ch < qt->next[c]; ch = qt->next[ch]){
+    fmm_upward(f, ch);
+    Mc = &f->mpole[f->index[ch]*f->ncoef];
+    x = fmm_center(f, ch);
+    x.re = z.re - x.re;
+    x.im = z.im - x.im;
+    fmm_powers(x, P, pw);
+    for (k = 0; k < f->rows; k++){
+      for (l = 0; k + l <= P; l++){
+	for (r = 0; r <= k; r++){
+	  for (s = 0; s <= l; s++){
+	    t = fmm_mul(fmm_mul(pw[k-r], fmm_conj(pw[l-s])), Mc[f->ix[r][s]]);
+	    M[f->ix[k][l]].re += f->C[k][r]*f->C[l][s]*t.re;
+	    M[f->ix[k][l]].im += f->C[k][r]*f->C[l][s]*t.im;
+	  }
+	}
+      }
+    }
+  }
+}
+
+static void fmm_m2l(fmm *f, int c1, int c2, fmm_complex Z, double dist){
+  /* translate the multipole expansion of each of c1 and c2 into the local expansion of the other,
+     Z being the center of c2 less that of c1 */
+  fmm_complex *M1 = &f->mpole[f->index[c1]*f->ncoef], *M2 = &f->mpole[f->index[c2]*f->ncoef];
+  fmm_complex *L1 = &f->local[f->index[c1]*f->ncoef], *L2 = &f->local[f->index[c2]*f->ncoef];
+  fmm_complex T[FMM_MAX_ORDER+1][FMM_MAX_ORDER+1], e[FMM_MAX_ORDER+2], t, u;
+  double rp[FMM_MAX_ORDER+1], w, sgn;
+  int P = f->order, a, b, k, l, m, n;
+
+  /* T[a][b] = A[a] B[b] Z^((p+1)/2-a) conj(Z)^((p-1)/2-b) = A[a] B[b] |Z|^(p-a-b) (Z/|Z|)^(1-a+b) */
+  rp[0] = f->p == -1 ? 1/dist : pow(dist, f->p);
+  for (a = 1; a <= P; a++) rp[a] = rp[a-1]/dist;
+  e[0].re = Z.re/dist;
+  e[0].im = Z.im/dist;
+  fmm_powers(e[0], P + 1, e);
+  for (a = 0; a < f->rows; a++){
+    for (b = 0; a + b <= P; b++){
+      w = f->A[a]*f->B[b];
+      t = 1 - a + b >= 0 ? e[1 - a + b] : fmm_conj(e[a - b - 1]);
+      T[a][b].re = w*rp[a+b]*t.re;
+      T[a][b].im = w*rp[a+b]*t.im;
+    }
+  }
+
+  /* from c1 to c2, and with Z and so T[a][b] negated in part, from c2 to c1 */
+  for (m = 0; m < f->rows; m++){
+    for (k = 0; m + k < f->rows; k++){
+      for (n = 0; m + k + n <= P; n++){
+	for (l = 0; m + k + n + l <= P; l++){
+	  w = f->C[m+k][m]*f->C[n+l][n];
+	  sgn = (m + k + n + l)%2 ? w : -w;
+	  t = fmm_mul(T[m+k][n+l], M1[f->ix[k][l]]);
+	  u = fmm_mul(T[m+k][n+l], M2[f->ix[k][l]]);
+	  L2[f->ix[m][n]].re += w*t.re;
+	  L2[f->ix[m][n]].im += w*t.im;
+	  L1[f->ix[m][n]].re += sgn*u.re;
+	  L1[f->ix[m][n]].im += sgn*u.im;
+	}
+      }
+    }
+  }
+}
+
+static void fmm_p2p(fmm *f, int c1, int c2){
+  /* the forces between the points of leaves c1 and c2, directly */
+  LinearQuadTree qt = f->qt;
+  double *x = qt->coord, *y = qt->coord + qt->n, *fx = f->nforce, *fy = f->nforce + qt->n, dx, dy, d;
+  int i, j;
+
+  if (c1 == c2){
+    f->counts[1] += (double) qt->count[c1]*(qt->count[c1] - 1)/2;
+  } else {
+    f->counts[1] += (double) qt->count[c1]*qt->count[c2];
+  }
+  if (f->p == -1){
+    force_repulse(x, y, fx, fy, qt->first[c1], qt->first[c1] + qt->count[c1], qt->first[c2],
+		  qt->first[c2] + qt->count[c2], f->KP);
+    return;
+  }
+  for (i = qt->first[c1]; i < qt->first[c1] + qt->count[c1]; i++){
+    for (j = c1 == c2 ? i + 1 : qt->first[c2]; j < qt->first[c2] + qt->count[c2]; j++){
+      dx = x[i] - x[j];
+      dy = y[i] - y[j];
+      /* the square of the distance, at least MINDIST */
+      d = pow(MAX(dx*dx + dy*dy, MINDIST*MINDIST), (1.- f->p)/2);
+      fx[i] += f->KP*dx/d;
+      fy[i] += f->KP*dy/d;
+      fx[j] -= f->KP*dx/d;
+      fy[j] -= f->KP*dy/d;
+    }
+  }
+}
+
+static void fmm_interact(fmm *f, int c1, int c2){
+  /* the forces between the points of c1 and c2, through their expansions if they are far enough
+     apart for these to converge well, else between their children or points */
+  LinearQuadTree qt = f->qt;
+  fmm_complex Z;
+  double dist;
+  bool leaf1, leaf2;
+  int ch1, ch2;
+
+  if (c1 != c2){
+    Z = fmm_center(f, c2);
+    Z.re -= qt->average[c1];
+    Z.im -= qt->average[qt->ncells + c1];
+    dist = hypot(Z.re, Z.im);
+    if (f->radius[c1] + f->radius[c2] < f->theta*dist){
+      f->counts[0]++;
+      fmm_m2l(f, c1, c2, Z, dist);
+      return;
+    }
+  }
+
+  leaf1 = fmm_leaf(f, c1);
+  leaf2 = fmm_leaf(f, c2);
+  if (leaf1 && leaf2){
+    fmm_p2p(f, c1, c2);
+  } else if (c1 == c2){
+    for (ch1 = c1 + 1; ch1 < qt->next[c1]; ch1 = qt->next[ch1]){
+      for (ch2 = ch1; ch2 < qt->next[c1]; ch2 = qt->next[ch2]) fmm_interact(f, ch1, ch2);
+    }
+  } else if (!leaf1 && (leaf2 || f->radius[c1] >= f->radius[c2])){
+    for (ch1 = c1 + 1; ch1 < qt->next[c1]; ch1 = qt->next[ch1]) fmm_interact(f, ch1, c2);
+  } else {
+    for (ch2 = c2 + 1; ch2 < qt->next[c2]; ch2 = qt->next[ch2]) fmm_interact(f, c1, ch2);
+  }
+}
+
+static void fmm_downward(fmm *f, int c){
+  /* pass the local expansion of c on to its children, or evaluate it at its points */
+  LinearQuadTree qt = f->qt;
+  fmm_complex *L = &f->local[f->index[c]*f->ncoef], *Lc, pw[FMM_MAX_ORDER+1], x, t, F;
+  fmm_complex z = fmm_center(f, c);
+  int P = f->order, ch, j, m, n, r, s;
+
+  if (fmm_leaf(f, c)){
+    for (j = qt->first[c]; j < qt->first[c] + qt->count[c]; j++){
+      x.re = qt->coord[j] - z.re;
+      x.im = qt->coord[qt->n + j] - z.im;
+      fmm_powers(x, P, pw);
+      F.re = F.im = 0;
+      for (m = 0; m < f->rows; m++){
+	for (n = 0; m + n <= P; n++){
+	  t = fmm_mul(L[f->ix[m][n]], fmm_mul(pw[m], fmm_conj(pw[n])));
+	  F.re += t.re;
+	  F.im += t.im;
+	}
+      }
+      f->nforce[j] += f->KP*F.re;
+      f->nforce[qt->n + j] += f->KP*F.im;
+    }
+    return;
+  }
+
+  for (ch = c + 1; ch < qt->next[c]; ch = qt->next[ch]){
+    Lc = &f->local[f->index[ch]*f->ncoef];
+    x = fmm_center(f, ch);
+    x.re -= z.re;
+    x.im -= z.im;
+    fmm_powers(x, P, pw);
+    for (r = 0; r < f->rows; r++){
+      for (s = 0; r + s <= P; s++){
+	for (m = r; m < f->rows; m++){
+	  for (n = s; m + n <= P; n++){
+	    t = fmm_mul(fmm_mul(pw[m-r], fmm_conj(pw[n-s])), L[f->ix[m][n]]);
+	    Lc[f->ix[r][s]].re += f->C[m][r]*f->C[n][s]*t.re;
+	    Lc[f->ix[r][s]].im += f->C[m][r]*f->C[n][s]*t.im;
+	  }
+	}
+      }
+    }
+    fmm_downward(f, ch);
+  }
+}
+
+void LinearQuadTree_get_repulsive_force_fmm(LinearQuadTree qt, double *force, double bh, double p, double KP,
+					    int order, double *counts){
+  /* as LinearQuadTree_get_repulsive_force, with the fast multipole method in place of Barnes-Hut:
+     cells c1 and c2 interact through expansions of the given order if radius[c1] + radius[c2] < bh*dist,
+     bh being capped for these to converge. Only in two dimensions; in others, Barnes-Hut is used. */
+  fmm f = {0};
+  int n = qt->n, nc = qt->ncells, nexp, i, j, k, l;
+
+  if (qt->dim != 2){
+    LinearQuadTree_get_repulsive_force(qt, force, bh, p, KP, counts, 1);
+    return;
+  }
+
+  f.qt = qt;
+  f.order = MAX(0, MIN(order, FMM_MAX_ORDER));
+  f.theta = MIN(bh, FMM_MAX_THETA);
+  f.p = p;
+  f.KP = KP;
+  for (f.ncoef = 0, k = 0; k <= f.order; k++){
+    for (l = 0; k + l <= f.order; l++) f.ix[k][l] = f.ncoef++;
+  }
+  f.A[0] = f.B[0] = 1;
+  for (k = 1; k <= f.order; k++){
+    f.A[k] = f.A[k-1]*((p + 1)/2 - (k - 1))/k;
+    f.B[k] = f.B[k-1]*((p - 1)/2 - (k - 1))/k;
+  }
+  for (f.rows = f.order + 1, k = 1; k <= f.order; k++){
+    if (f.A[k] == 0) f.rows = MIN(f.rows, k);
+  }
+  for (k = 0; k <= f.order; k++){
+    f.C[k][0] = f.C[k][k] = 1;
+    for (l = 1; l < k; l++) f.C[k][l] = f.C[k-1][l-1] + f.C[k-1][l];
+  }
+
+  f.index = MALLOC(sizeof(int)*nc);
+  f.radius = MALLOC(sizeof(double)*nc);
+  for (i = 0; i < nc; i++) f.index[i] = -1;
+  nexp = fmm_setup(&f, 0, 0);
+  f.mpole = CALLOC(nexp*f.ncoef, sizeof(fmm_complex));
+  f.local = CALLOC(nexp*f.ncoef, sizeof(fmm_complex));
+  f.nforce = CALLOC(2*n, sizeof(double));
+
+  fmm_upward(&f, 0);
+  fmm_interact(&f, 0, 0);
+  fmm_downward(&f, 0);
+
+  counts[0] = f.counts[0];
+  counts[1] = f.counts[1];
+  counts[2] = nexp;
+  counts[3] = 0;
+  for (i = 0; i < 4; i++) counts[i] /= n;
+
+  for (j = 0; j < n; j++){
+    force[2*qt->perm[j]] = f.nforce[j];
+    force[2*qt->perm[j]+1] = f.nforce[n + j];
+  }
+
+  free(f.index);
+  free(f.radius);
+  free(f.mpole);
+  free(f.local);
+  free(f.nforce);
+}
@@ -0,0 +1,58 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property 
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct LinearQuadTree_struct *LinearQuadTree;
+
+struct LinearQuadTree_struct {
+  /* A quadtree (an octree if dim = 3) kept in flat arrays rather than in separately allocated cells.
+     The points are sorted by the Morton code of the deepest cell they fall in, so that every cell
+     holds a contiguous range of them. Cells are numbered in the order they are built, each before
+     its children, and next[c] is the first cell after the subtree of c: the children of c are
+     c+1, next[c+1], ... up to next[c], and c is a leaf if next[c] == c+1.
+     The cells are those of the QuadTree built from the same points with the same max_level, except
+     that max_level is capped so that a Morton code fits in 64 bits. */
+  int dim;
+  int n;/* number of points */
+  int max_level;
+  int *perm;/* perm[j] is the id of the j-th point in Morton order */
+  double *coord;/* coordinates of the points in Morton order, one array per dimension:
+		   coord[k*n + j] is coordinate k of the j-th point */
+  int ncells;
+  int *first;/* cell c holds the points first[c], ..., first[c] + count[c] - 1 in Morton order */
+  int *count;
+  int *next;
+  double *width;/* center +/- width bounds the cell, as in QuadTree */
+  double *average;/* center of mass of the points of each cell, one array per dimension:
+		     average[k*ncells + c] is coordinate k of that of cell c */
+};
+
+/* coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1] */
+LinearQuadTree LinearQuadTree_new_from_point_list(int dim, int n, int max_level, double *coord);
+
+void LinearQuadTree_delete(LinearQuadTree qt);
+
+/* as QuadTree_get_repulsive_force, on up to nthreads threads */
+void LinearQuadTree_get_repulsive_force(LinearQuadTree qt, double *force, double bh, double p, double KP,
+					double *counts, int nthreads);
+
+/* as LinearQuadTree_get_repulsive_force, on one thread, with the fast multipole method using expansions
+   of the given order. In two dimensions only; Barnes-Hut is used in others. */
+void LinearQuadTree_get_repulsive_force_fmm(LinearQuadTree qt, double *force, double bh, double p, double KP,
+					    int order, double *counts);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,7 @@
  * Contributors: Details at https://graphviz.org
  *************************************************************************/
 
+#include <cgraph/parallel.h>
 #include <sparse/general.h>
 #include <common/geom.h>
 #include <common/arith.h>
@@ -159,9 +160,10 @@ static double *get_or_alloc_force_qt(QuadTree qt, int dim){
   return force;
 }
 
-static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, double *x, double *force, double bh, double p, double KP, double *counts){
+static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, double *x, double *force, double bh, double p, double KP, double *counts, int slot){
   /* calculate the all to all reopulsive force and accumulate on each node of the quadtree if an interaction is possible.
      force[i*dim+j], j=1,...,dim is the force on node i 
+     slot: which of the per-thread force vectors of a cell to accumulate into, 0 when single threaded
    */
   SingleLinkedList l1, l2;
   double *x1, *x2, dist, wgt1, wgt2, f, *f1, *f2, w1, w2;
@@ -181,10 +183,10 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, double
     counts[0]++;
     x1 = qt1->average;
     w1 = qt1->total_weight;
-    f1 = get_or_alloc_force_qt(qt1, dim);
+    f1 = get_or_alloc_force_qt(qt1, dim) + slot*dim;
     x2 = qt2->average;
     w2 = qt2->total_weight;
-    f2 = get_or_alloc_force_qt(qt2, dim);
+    f2 = get_or_alloc_force_qt(qt2, dim) + slot*dim;
     assert(dist > 0);
     for (k = 0; k < dim; k++){
       if (p == -1){
@@ -205,13 +207,13 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, double
       x1 = node_data_get_coord(SingleLinkedList_get_data(l1));
       wgt1 = node_data_get_weight(SingleLinkedList_get_data(l1));
       i1 = node_data_get_id(SingleLinkedList_get_data(l1));
-      f1 = get_or_assign_node_force(force, i1, l1, dim);
+      f1 = &force[i1*dim];
       l2 = qt2->l;
       while (l2){
 	x2 = node_data_get_coord(SingleLinkedList_get_data(l2));
 	wgt2 = node_data_get_weight(SingleLinkedList_get_data(l2));
 	i2 = node_data_get_id(SingleLinkedList_get_data(l2));
-	f2 = get_or_assign_node_force(force, i2, l2, dim);
+	f2 = &force[i2*dim];
 	if ((qt1 == qt2 && i2 < i1) || i1 == i2) {
 	  l2 = SingleLinkedList_get_next(l2);
 	  continue;
@@ -241,7 +243,7 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, double
 	qt11 = qt1->qts[i];
 	for (j = i; j < 1<<dim; j++){
 	  qt12 = qt1->qts[j];
-	  QuadTree_repulsive_force_interact(qt11, qt12, x, force, bh, p, KP, counts);
+	  QuadTree_repulsive_force_interact(qt11, qt12, x, force, bh, p, KP, counts, slot);
 	}
       }
   } else {
@@ -249,22 +251,22 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, double
     if (qt1->width > qt2->width && !l1){
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt1->qts[i];
-	QuadTree_repulsive_force_interact(qt11, qt2, x, force, bh, p, KP, counts);
+	QuadTree_repulsive_force_interact(qt11, qt2, x, force, bh, p, KP, counts, slot);
       }
     } else if (qt2->width > qt1->width && !l2){
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt2->qts[i];
-	QuadTree_repulsive_force_interact(qt11, qt1, x, force, bh, p, KP, counts);
+	QuadTree_repulsive_force_interact(qt11, qt1, x, force, bh, p, KP, counts, slot);
       }
     } else if (!l1){/* pick one that is not at the last level */
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt1->qts[i];
-	QuadTree_repulsive_force_interact(qt11, qt2, x, force, bh, p, KP, counts);
+	QuadTree_repulsive_force_interact(qt11, qt2, x, force, bh, p, KP, counts, slot);
       }
     } else if (!l2){
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt2->qts[i];
-	QuadTree_repulsive_force_interact(qt11, qt1, x, force, bh, p, KP, counts);
+	QuadTree_repulsive_force_interact(qt11, qt1, x, force, bh, p, KP, counts, slot);
       }
     } else {
       assert(0); /* can be both at the leaf level since that should be catched at the beginning of this func. */
@@ -336,15 +338,13 @@ void QuadTree_get_repulsive_force(QuadTree qt, double *force, double *x, double
 
   for (i = 0; i < dim*n; i++) force[i] = 0;
 
-  QuadTree_repulsive_force_interact(qt, qt, x, force, bh, p, KP, counts);
+  QuadTree_repulsive_force_interact(qt, qt, x, force, bh, p, KP, counts, 0);
   QuadTree_repulsive_force_accumulate(qt, force, counts);
   for (i = 0; i < 4; i++) counts[i] /= n;
 
 }
-QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, double *coord){
-  /* form a new QuadTree data structure from a list of coordinates of n points
-     coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1]
-   */
+static QuadTree QuadTree_new_bounding(int dim, int n, int max_level, double *coord){
+  /* an empty QuadTree whose top cell encloses the n points in coord */
   double *xmin, *xmax, *center, width;
   QuadTree qt = NULL;
   int i, k;
@@ -378,17 +378,26 @@ QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, double *coo
   width *= 0.52;
   qt = QuadTree_new(dim, center, width, max_level);
 
-  for (i = 0; i < n; i++){
-    qt = QuadTree_add(qt, &(coord[i*dim]), 1, i);
-  }
-
-
   free(xmin);
   free(xmax);
   free(center);
   return qt;
 }
 
+QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, double *coord){
+  /* form a new QuadTree data structure from a list of coordinates of n points
+     coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1]
+   */
+  QuadTree qt;
+  int i;
+
+  qt = QuadTree_new_bounding(dim, n, max_level, coord);
+  for (i = 0; i < n; i++){
+    qt = QuadTree_add(qt, &(coord[i*dim]), 1, i);
+  }
+  return qt;
+}
+
 QuadTree QuadTree_new(int dim, double *center, double width, int max_level){
   QuadTree q;
   int i;
@@ -464,7 +473,45 @@ QuadTree QuadTree_new_in_quadrant(int dim, double *center, double width, int max
   return qt;
 
 }
-static QuadTree QuadTree_add_internal(QuadTree q, double *coord, double weight, int id, int level){
+/* points of a threaded build that reached a cell at the depth where the build is split, in the order
+   they arrived. The cell points to it through its data field until the build is done. */
+typedef struct {
+  QuadTree q;
+  int *ids;
+  int n, size;
+} qt_build_job;
+
+typedef struct {
+  int depth;
+  double *coord;
+  qt_build_job **jobs;
+  int njobs, size;
+} qt_build;
+
+static void qt_build_defer(qt_build *b, QuadTree q, int id){
+  qt_build_job *job = q->data;
+
+  if (!job){
+    job = MALLOC(sizeof(qt_build_job));
+    job->q = q;
+    job->ids = NULL;
+    job->n = job->size = 0;
+    q->data = job;
+    if (b->njobs >= b->size){
+      b->size = MAX(16, 2*b->size);
+      b->jobs = REALLOC(b->jobs, sizeof(qt_build_job*)*b->size);
+    }
+    b->jobs[b->njobs++] = job;
+  }
+  if (job->n >= job->size){
+    job->size = MAX(16, 2*job->size);
+    job->ids = REALLOC(job->ids, sizeof(int)*job->size);
+  }
+  job->ids[job->n++] = id;
+}
+
+static QuadTree QuadTree_add_internal(QuadTree q, double *coord, double weight, int id, int level, qt_build *b){
+  /* b: if not NULL, points reaching level b->depth are queued there rather than added */
   int i, dim = q->dim, ii;
   node_data nd = NULL;
 
@@ -505,7 +552,11 @@ static QuadTree QuadTree_add_internal(QuadTree q, double *coord, double weight,
     assert(ii < 1<<dim && ii >= 0);
     if (q->qts[ii] == NULL) q->qts[ii] = QuadTree_new_in_quadrant(q->dim, q->center, (q->width)/2, max_level, ii);
     
-    q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, weight, id, level + 1);
+    if (b && level + 1 == b->depth){
+      qt_build_defer(b, q->qts[ii], id);
+    } else {
+      q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, weight, id, level + 1, b);
+    }
     assert(q->qts[ii]);
 
     if (q->l){
@@ -518,7 +569,11 @@ static QuadTree QuadTree_add_internal(QuadTree q, double *coord, double weight,
 
       if (q->qts[ii] == NULL) q->qts[ii] = QuadTree_new_in_quadrant(q->dim, q->center, (q->width)/2, max_level, ii);
 
-      q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, weight, idd, level + 1);
+      if (b && level + 1 == b->depth){
+	qt_build_defer(b, q->qts[ii], idd);
+      } else {
+	q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, weight, idd, level + 1, b);
+      }
       assert(q->qts[ii]);
       
       /* delete the old node data on parent */
@@ -543,10 +598,244 @@ static QuadTree QuadTree_add_internal(QuadTree q, double *coord, double weight,
 
 QuadTree QuadTree_add(QuadTree q, double *coord, double weight, int id){
   if (!q) return q;
-  return QuadTree_add_internal(q, coord, weight, id, 0);
+  return QuadTree_add_internal(q, coord, weight, id, 0, NULL);
   
 }
 
+static void qt_build_run(void *ctx, size_t index){
+  qt_build *b = ctx;
+  qt_build_job *job = b->jobs[index];
+  int i, dim = job->q->dim;
+
+  for (i = 0; i < job->n; i++){
+    QuadTree_add_internal(job->q, &(b->coord[job->ids[i]*dim]), 1, job->ids[i], b->depth, NULL);
+  }
+}
+
+QuadTree QuadTree_new_from_point_list_threads(int dim, int n, int max_level, double *coord, int nthreads){
+  /* as QuadTree_new_from_point_list, building the subtrees on up to nthreads threads. The points are
+     first added down to a few levels, where they are queued in the order they arrive, and the cells
+     there are then filled in in parallel. The tree is the same as the one built serially. */
+  qt_build b = {0};
+  QuadTree qt;
+  int i;
+
+  if (nthreads <= 1 || n < 1000) return QuadTree_new_from_point_list(dim, n, max_level, coord);
+
+  qt = QuadTree_new_bounding(dim, n, max_level, coord);
+  if (!qt) return qt;
+
+  /* enough cells for the threads to balance */
+  for (b.depth = 1; b.depth < max_level && 1<<(dim*b.depth) < 8*nthreads; b.depth++);
+  b.coord = coord;
+  for (i = 0; i < n; i++){
+    QuadTree_add_internal(qt, &(coord[i*dim]), 1, i, 0, &b);
+  }
+  gv_parallel_for((size_t)b.njobs, nthreads, qt_build_run, &b);
+
+  for (i = 0; i < b.njobs; i++){
+    b.jobs[i]->q->data = NULL;
+    free(b.jobs[i]->ids);
+    free(b.jobs[i]);
+  }
+  free(b.jobs);
+  return qt;
+}
+
+/* a pair of cells whose interaction is left to one thread */
+typedef struct {
+  QuadTree qt1, qt2;
+  double cost;/* rough estimate of the work */
+  int thread;
+} cell_pair;
+
+typedef struct {
+  cell_pair *pairs;
+  int npairs, size;
+  double *x, bh, p, KP;
+  double **forces;/* force on each node, per thread */
+  double *counts;/* counts[4*t], ..., counts[4*t+3] are those of thread t */
+} cell_pairs;
+
+static void cell_pairs_add(cell_pairs *ps, QuadTree qt1, QuadTree qt2, double cost){
+  if (ps->npairs >= ps->size){
+    ps->size = MAX(64, 2*ps->size);
+    ps->pairs = REALLOC(ps->pairs, sizeof(cell_pair)*ps->size);
+  }
+  ps->pairs[ps->npairs].qt1 = qt1;
+  ps->pairs[ps->npairs].qt2 = qt2;
+  ps->pairs[ps->npairs].cost = cost;
+  ps->pairs[ps->npairs].thread = 0;
+  ps->npairs++;
+}
+
+static void QuadTree_collect_pairs(QuadTree qt1, QuadTree qt2, double bh, int depth, cell_pairs *ps){
+  /* split the interaction of qt1 and qt2 as QuadTree_repulsive_force_interact does, down to the given depth,
+     and collect the pairs of cells left over */
+  int dim, i, j;
+
+  if (!qt1 || !qt2) return;
+  dim = qt1->dim;
+
+  if (qt1->width + qt2->width < bh*point_distance(qt1->average, qt2->average, dim)){
+    cell_pairs_add(ps, qt1, qt2, 1);
+    return;
+  }
+  if (qt1->l && qt2->l){
+    cell_pairs_add(ps, qt1, qt2, (double) qt1->n*qt2->n);
+    return;
+  }
+  if (depth == 0){
+    i = qt1 == qt2 ? qt1->n : qt1->n + qt2->n;
+    cell_pairs_add(ps, qt1, qt2, i*log2(i + 1.));
+    return;
+  }
+
+  if (qt1 == qt2){
+    for (i = 0; i < 1<<dim; i++){
+      for (j = i; j < 1<<dim; j++){
+	QuadTree_collect_pairs(qt1->qts[i], qt1->qts[j], bh, depth - 1, ps);
+      }
+    }
+  } else if ((qt1->width > qt2->width && !qt1->l) || (!(qt2->width > qt1->width && !qt2->l) && !qt1->l)){
+    for (i = 0; i < 1<<dim; i++) QuadTree_collect_pairs(qt1->qts[i], qt2, bh, depth - 1, ps);
+  } else {
+    for (i = 0; i < 1<<dim; i++) QuadTree_collect_pairs(qt2->qts[i], qt1, bh, depth - 1, ps);
+  }
+}
+
+typedef struct {
+  double cost;
+  int i;
+} pair_cost;
+
+static int pair_cost_cmp(const void *a, const void *b){
+  const pair_cost *x = a, *y = b;
+  if (x->cost != y->cost) return x->cost > y->cost ? -1 : 1;
+  return x->i < y->i ? -1 : (x->i > y->i);
+}
+
+static void cell_pairs_assign(cell_pairs *ps, int nthreads){
+  /* hand the pairs out to the threads, largest first to the least loaded, so the
+     split of the work, and with it the rounding of the sums, only depends on nthreads */
+  pair_cost *order = MALLOC(sizeof(pair_cost)*MAX(ps->npairs, 1));
+  double *load = MALLOC(sizeof(double)*nthreads);
+  int i, t, tmin;
+
+  for (i = 0; i < ps->npairs; i++){
+    order[i].cost = ps->pairs[i].cost;
+    order[i].i = i;
+  }
+  qsort(order, ps->npairs, sizeof(pair_cost), pair_cost_cmp);
+  for (t = 0; t < nthreads; t++) load[t] = 0;
+  for (i = 0; i < ps->npairs; i++){
+    tmin = 0;
+    for (t = 1; t < nthreads; t++){
+      if (load[t] < load[tmin]) tmin = t;
+    }
+    ps->pairs[order[i].i].thread = tmin;
+    load[tmin] += order[i].cost;
+  }
+  free(order);
+  free(load);
+}
+
+static void cell_pairs_run(void *ctx, size_t index){
+  cell_pairs *ps = ctx;
+  int i, t = (int) index;
+
+  for (i = 0; i < ps->npairs; i++){
+    if (ps->pairs[i].thread != t) continue;
+    QuadTree_repulsive_force_interact(ps->pairs[i].qt1, ps->pairs[i].qt2, ps->x, ps->forces[t], ps->bh, ps->p, ps->KP,
+				      &ps->counts[4*t], t);
+  }
+}
+
+static void QuadTree_alloc_forces(QuadTree qt, int nslots){
+  /* give every cell nslots zeroed force vectors */
+  int i;
+
+  if (!qt) return;
+  free(qt->data);
+  qt->data = MALLOC(sizeof(double)*nslots*qt->dim);
+  for (i = 0; i < nslots*qt->dim; i++) ((double*) qt->data)[i] = 0.;
+  if (qt->qts){
+    for (i = 0; i < 1<<qt->dim; i++) QuadTree_alloc_forces(qt->qts[i], nslots);
+  }
+}
+
+static void QuadTree_reduce_forces(QuadTree qt, int nslots){
+  /* sum the per-thread force vectors of every cell into the first */
+  double *f;
+  int i, k, dim;
+
+  if (!qt) return;
+  dim = qt->dim;
+  f = qt->data;
+  for (i = 1; i < nslots; i++){
+    for (k = 0; k < dim; k++) f[k] += f[i*dim+k];
+  }
+  if (qt->qts){
+    for (i = 0; i < 1<<dim; i++) QuadTree_reduce_forces(qt->qts[i], nslots);
+  }
+}
+
+void QuadTree_get_repulsive_force_threads(QuadTree qt, double *force, double *x, double bh, double p, double KP, double *counts, int *flag, int nthreads){
+  /* as QuadTree_get_repulsive_force, with the cell interactions split over up to nthreads threads. Each thread
+     accumulates into forces of its own, which are then summed in thread order. The result differs from the
+     serial one by rounding only, and is the same from run to run for a given nthreads.
+   */
+  cell_pairs ps = {0};
+  int n = qt->n, dim = qt->dim, i, t, depth, npairs;
+
+  if (nthreads <= 1 || n < 1000){
+    QuadTree_get_repulsive_force(qt, force, x, bh, p, KP, counts, flag);
+    return;
+  }
+
+  /* split the traversal until there are enough pairs for the threads to balance */
+  for (depth = 1, npairs = 0; ; depth++){
+    ps.npairs = 0;
+    QuadTree_collect_pairs(qt, qt, bh, depth, &ps);
+    if (ps.npairs >= 16*nthreads || ps.npairs == npairs || depth >= 8) break;
+    npairs = ps.npairs;
+  }
+  cell_pairs_assign(&ps, nthreads);
+
+  *flag = 0;
+  ps.x = x;
+  ps.bh = bh;
+  ps.p = p;
+  ps.KP = KP;
+  ps.forces = MALLOC(sizeof(double*)*nthreads);
+  ps.forces[0] = force;
+  for (t = 1; t < nthreads; t++) ps.forces[t] = MALLOC(sizeof(double)*dim*n);
+  for (t = 0; t < nthreads; t++){
+    for (i = 0; i < dim*n; i++) ps.forces[t][i] = 0;
+  }
+  ps.counts = MALLOC(sizeof(double)*4*nthreads);
+  for (i = 0; i < 4*nthreads; i++) ps.counts[i] = 0;
+  QuadTree_alloc_forces(qt, nthreads);
+
+  gv_parallel_for((size_t)nthreads, nthreads, cell_pairs_run, &ps);
+
+  for (i = 0; i < 4; i++) counts[i] = 0;
+  for (t = 0; t < nthreads; t++){
+    for (i = 0; i < 4; i++) counts[i] += ps.counts[4*t+i];
+  }
+  for (t = 1; t < nthreads; t++){
+    for (i = 0; i < dim*n; i++) force[i] += ps.forces[t][i];
+    free(ps.forces[t]);
+  }
+  QuadTree_reduce_forces(qt, nthreads);
+  QuadTree_repulsive_force_accumulate(qt, force, counts);
+  for (i = 0; i < 4; i++) counts[i] /= n;
+
+  free(ps.forces);
+  free(ps.counts);
+  free(ps.pairs);
+}
+
 static void draw_polygon(FILE *fp, int dim, double *center, double width){
   /* pliot the enclosing square */
   if (dim < 2 || dim > 3) return;
@@ -48,6 +48,9 @@ void QuadTree_print(FILE *fp, QuadTree q);
 
 QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, double *coord);
 
+/* the same tree as QuadTree_new_from_point_list, built on up to nthreads threads */
+QuadTree QuadTree_new_from_point_list_threads(int dim, int n, int max_level, double *coord, int nthreads);
+
 double point_distance(double *p1, double *p2, int dim);
 
 void QuadTree_get_supernodes(QuadTree qt, double bh, double *point, int nodeid, int *nsuper, 
@@ -55,6 +58,9 @@ void QuadTree_get_supernodes(QuadTree qt, double bh, double *point, int nodeid,
 
 void QuadTree_get_repulsive_force(QuadTree qt, double *force, double *x, double bh, double p, double KP, double *counts, int *flag);
 
+/* QuadTree_get_repulsive_force on up to nthreads threads, equal to it up to rounding */
+void QuadTree_get_repulsive_force_threads(QuadTree qt, double *force, double *x, double bh, double p, double KP, double *counts, int *flag, int nthreads);
+
 /* find the nearest point and put in ymin, index in imin and distance in min */
 void QuadTree_get_nearest(QuadTree qt, double *x, double *ymin, int *imin, double *min);
 
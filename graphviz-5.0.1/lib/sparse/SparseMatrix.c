@@ -12,6 +12,7 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <cgraph/parallel.h>
 #include <common/memory.h>
 #include <common/arith.h>
 #include <limits.h>
@@ -46,6 +47,114 @@ static size_t size_of_matrix_type(int type){
   return size;
 }
 
+/* the number of threads the products and the transpose use */
+static int num_threads = 1;
+
+/* below this many nonzeros a kernel runs on the calling thread, as starting threads would cost more */
+enum {PARALLEL_MIN_NZ = 20000};
+
+void SparseMatrix_set_num_threads(int nthreads){
+  num_threads = MAX(nthreads, 1);
+}
+
+int SparseMatrix_get_num_threads(void){
+  return num_threads;
+}
+
+/* the number of row ranges to split a kernel over m rows and nz nonzeros into, per thread */
+static int row_chunks(int m, int nz, int per_thread){
+  if (num_threads <= 1 || nz < PARALLEL_MIN_NZ) return 1;
+  return MAX(1, MIN(num_threads*per_thread, m));
+}
+
+/* Split the rows 0, ..., m - 1 into nchunks ranges start[c], ..., start[c+1] - 1 of about the
+   same number of nonzeros. Every row is worked out as it is on one thread, so the results do not
+   depend on the ranges. */
+static int *row_ranges(const int *ia, int m, int nchunks){
+  int *start = MALLOC(sizeof(int)*((size_t)nchunks + 1));
+  int c, i = 0;
+
+  start[0] = 0;
+  for (c = 1; c < nchunks; c++){
+    long long target = (long long) ia[m]*c/nchunks;
+    while (i < m && ia[i] < target) i++;
+    start[c] = i;
+  }
+  start[nchunks] = m;
+  return start;
+}
+
+/* Transpose on several threads: each range of rows counts its entries per column, so that it
+   can place them after those of the ranges before it, which gives the order of the serial loop. */
+typedef struct {
+  SparseMatrix A, B;
+  int *start;
+  int **pos;/* per range, the next entry of B for each column */
+} transpose_job;
+
+static void transpose_count(void *ctx, size_t c){
+  transpose_job *job = ctx;
+  int *ia = job->A->ia, *ja = job->A->ja, *pos = job->pos[c];
+  int i, j;
+
+  for (i = 0; i < job->B->m; i++) pos[i] = 0;
+  for (i = job->start[c]; i < job->start[c+1]; i++){
+    for (j = ia[i]; j < ia[i+1]; j++) pos[ja[j]]++;
+  }
+}
+
+static void transpose_fill(void *ctx, size_t c){
+  transpose_job *job = ctx;
+  int *ia = job->A->ia, *ja = job->A->ja, *jb = job->B->ja, *pos = job->pos[c];
+  size_t sz = job->A->size;
+  char *a = job->A->a, *b = job->B->a;
+  int i, j;
+
+  for (i = job->start[c]; i < job->start[c+1]; i++){
+    for (j = ia[i]; j < ia[i+1]; j++){
+      jb[pos[ja[j]]] = i;
+      if (job->A->type == MATRIX_TYPE_REAL)
+	((double*) b)[pos[ja[j]]] = ((double*) a)[j];
+      else if (sz > 0)
+	memcpy(b + sz*(size_t)pos[ja[j]], a + sz*(size_t)j, sz);
+      pos[ja[j]]++;
+    }
+  }
+}
+
+static SparseMatrix transpose_threads(SparseMatrix A, int nchunks){
+  transpose_job job;
+  int *ib, c, i, next, count;
+
+  job.A = A;
+  job.B = SparseMatrix_new(A->n, A->m, A->nz, A->type, A->format);
+  job.B->nz = A->nz;
+  job.start = row_ranges(A->ia, A->m, nchunks);
+  job.pos = MALLOC(sizeof(int*)*(size_t)nchunks);
+  for (c = 0; c < nchunks; c++) job.pos[c] = MALLOC(sizeof(int)*(size_t)A->n);
+
+  gv_parallel_for((size_t)nchunks, num_threads, transpose_count, &job);
+
+  /* turn the counts into the first entry of each range in each column */
+  ib = job.B->ia;
+  for (next = 0, i = 0; i < A->n; i++){
+    ib[i] = next;
+    for (c = 0; c < nchunks; c++){
+      count = job.pos[c][i];
+      job.pos[c][i] = next;
+      next += count;
+    }
+  }
+  ib[A->n] = next;
+
+  gv_parallel_for((size_t)nchunks, num_threads, transpose_fill, &job);
+
+  for (c = 0; c < nchunks; c++) free(job.pos[c]);
+  free(job.pos);
+  free(job.start);
+  return job.B;
+}
+
 SparseMatrix SparseMatrix_sort(SparseMatrix A){
   SparseMatrix B;
   B = SparseMatrix_transpose(A);
@@ -70,6 +179,10 @@ SparseMatrix SparseMatrix_transpose(SparseMatrix A){
 
   assert(A->format == FORMAT_CSR);/* only implemented for CSR right now */
 
+  if ((type & (MATRIX_TYPE_REAL | MATRIX_TYPE_COMPLEX | MATRIX_TYPE_INTEGER | MATRIX_TYPE_PATTERN))
+      && row_chunks(m, nz, 1) > 1)
+    return transpose_threads(A, row_chunks(m, nz, 1));
+
   B = SparseMatrix_new(n, m, nz, type, format);
   B->nz = nz;
   ib = B->ia;
@@ -998,57 +1111,38 @@ SparseMatrix SparseMatrix_add(SparseMatrix A, SparseMatrix B){
   return C;
 }
 
-static void SparseMatrix_multiply_dense1(SparseMatrix A, double *v, double **res, int dim){
-  /* A v where v a dense matrix of second dimension dim. Real only for now. */
-  int i, j, k, *ia, *ja, m;
-  double *a, *u;
+/* a product of a matrix and a vector or dense matrix, worked out a range of rows at a time */
+typedef struct {
+  SparseMatrix A;
+  double *v, *u;
+  int dim;
+  int *start;
+} multiply_job;
 
-  assert(A->format == FORMAT_CSR);
-  assert(A->type == MATRIX_TYPE_REAL);
+static void multiply_dense_rows(void *ctx, size_t c){
+  multiply_job *job = ctx;
+  int i, j, k, *ia = job->A->ia, *ja = job->A->ja, dim = job->dim;
+  double *a = (double*) job->A->a, *u = job->u, *v = job->v;
 
-  a = (double*) A->a;
-  ia = A->ia;
-  ja = A->ja;
-  m = A->m;
-  u = *res;
-
-  if (!u) u = MALLOC(sizeof(double)*((size_t) m)*((size_t) dim));
-  for (i = 0; i < m; i++){
+  for (i = job->start[c]; i < job->start[c+1]; i++){
     for (k = 0; k < dim; k++) u[i*dim+k] = 0.;
     for (j = ia[i]; j < ia[i+1]; j++){
       for (k = 0; k < dim; k++) u[i*dim+k] += a[j]*v[ja[j]*dim+k];
     }
   }
-
-  *res = u;
-}
-
-void SparseMatrix_multiply_dense(SparseMatrix A, double *v, double **res, int dim){
-  /* A * V, with A dimension m x n, with V of dimension n x dim. v[i*dim+j] gives V[i,j]. Result of dimension m x dim
- */
-
-  SparseMatrix_multiply_dense1(A, v, res, dim);
 }
 
-void SparseMatrix_multiply_vector(SparseMatrix A, double *v, double **res) {
-  /* A v or A^T v. Real only for now. */
-  int i, j, *ia, *ja, m;
-  double *a, *u = NULL;
+static void multiply_vector_rows(void *ctx, size_t c){
+  multiply_job *job = ctx;
+  int i, j, *ia = job->A->ia, *ja = job->A->ja;
+  double *a, *u = job->u, *v = job->v;
   int *ai;
-  assert(A->format == FORMAT_CSR);
-  assert(A->type == MATRIX_TYPE_REAL || A->type == MATRIX_TYPE_INTEGER);
 
-  ia = A->ia;
-  ja = A->ja;
-  m = A->m;
-  u = *res;
-
-  switch (A->type){
+  switch (job->A->type){
   case MATRIX_TYPE_REAL:
-    a = (double*) A->a;
+    a = (double*) job->A->a;
     if (v){
-      if (!u) u = MALLOC(sizeof(double)*((size_t)m));
-      for (i = 0; i < m; i++){
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	u[i] = 0.;
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  u[i] += a[j]*v[ja[j]];
@@ -1056,8 +1150,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, double *v, double **res) {
       }
     } else {
       /* v is assumed to be all 1's */
-      if (!u) u = MALLOC(sizeof(double)*((size_t)m));
-      for (i = 0; i < m; i++){
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	u[i] = 0.;
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  u[i] += a[j];
@@ -1066,10 +1159,9 @@ void SparseMatrix_multiply_vector(SparseMatrix A, double *v, double **res) {
     }
     break;
   case MATRIX_TYPE_INTEGER:
-    ai = (int*) A->a;
+    ai = (int*) job->A->a;
     if (v){
-      if (!u) u = MALLOC(sizeof(double)*((size_t)m));
-      for (i = 0; i < m; i++){
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	u[i] = 0.;
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  u[i] += ai[j]*v[ja[j]];
@@ -1077,8 +1169,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, double *v, double **res) {
       }
     } else {
       /* v is assumed to be all 1's */
-      if (!u) u = MALLOC(sizeof(double)*((size_t)m));
-      for (i = 0; i < m; i++){
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	u[i] = 0.;
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  u[i] += ai[j];
@@ -1088,85 +1179,159 @@ void SparseMatrix_multiply_vector(SparseMatrix A, double *v, double **res) {
     break;
   default:
     assert(0);
-    u = NULL;
   }
-  *res = u;
+}
+
+/* run one of the above over all rows of job->A, on several threads if A is large enough */
+static void multiply_run(multiply_job *job, gv_job_fn rows){
+  int whole[2] = {0, job->A->m};
+  int nchunks = row_chunks(job->A->m, job->A->nz, 4);
 
+  if (nchunks == 1){
+    job->start = whole;
+    rows(job, 0);
+    return;
+  }
+  job->start = row_ranges(job->A->ia, job->A->m, nchunks);
+  gv_parallel_for((size_t)nchunks, num_threads, rows, job);
+  free(job->start);
 }
 
-SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B){
-  int m;
-  SparseMatrix C = NULL;
-  int *mask = NULL;
-  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja, *ic, *jc;
-  int i, j, k, jj, type, nz;
+void SparseMatrix_multiply_dense(SparseMatrix A, double *v, double **res, int dim){
+  /* A * V, with A dimension m x n, with V of dimension n x dim. v[i*dim+j] gives V[i,j]. Result of dimension m x dim
+ */
+  multiply_job job = {.A = A, .v = v, .u = *res, .dim = dim};
 
-  assert(A->format == B->format && A->format == FORMAT_CSR);/* other format not yet supported */
+  assert(A->format == FORMAT_CSR);
+  assert(A->type == MATRIX_TYPE_REAL);
 
-  m = A->m;
-  if (A->n != B->m) return NULL;
-  if (A->type != B->type){
-#ifdef DEBUG
-    printf("in SparseMatrix_multiply, the matrix types do not match, right now only multiplication of matrices of the same type is supported\n");
-#endif
-    return NULL;
-  }
-  type = A->type;
-  
-  mask = MALLOC(sizeof(int)*((size_t)(B->n)));
-  if (!mask) return NULL;
+  if (!job.u) job.u = MALLOC(sizeof(double)*((size_t) A->m)*((size_t) dim));
+  multiply_run(&job, multiply_dense_rows);
+  *res = job.u;
+}
 
-  for (i = 0; i < B->n; i++) mask[i] = -1;
+void SparseMatrix_multiply_vector(SparseMatrix A, double *v, double **res) {
+  /* A v or A^T v. Real only for now. */
+  multiply_job job = {.A = A, .v = v, .u = *res, .dim = 1};
 
-  nz = 0;
-  for (i = 0; i < m; i++){
+  assert(A->format == FORMAT_CSR);
+  assert(A->type == MATRIX_TYPE_REAL || A->type == MATRIX_TYPE_INTEGER);
+
+  if (A->type != MATRIX_TYPE_REAL && A->type != MATRIX_TYPE_INTEGER){
+    *res = NULL;
+    return;
+  }
+  if (!job.u) job.u = MALLOC(sizeof(double)*((size_t)A->m));
+  multiply_run(&job, multiply_vector_rows);
+  *res = job.u;
+}
+
+/* The product A B, or A B C if C is not NULL, worked out a range of rows at a time: the nonzeros
+   of each row of the product D are counted first, then filled in, in the order of the serial loops. */
+typedef struct {
+  SparseMatrix A, B, C, D;
+  int *start;
+  int *rownz;/* the number of nonzeros of each row of D */
+} product_job;
+
+static void product_count(void *ctx, size_t c){
+  product_job *job = ctx;
+  int *ia = job->A->ia, *ja = job->A->ja, *ib = job->B->ia, *jb = job->B->ja;
+  int *ic = job->C ? job->C->ia : NULL, *jc = job->C ? job->C->ja : NULL;
+  int ncol = job->C ? job->C->n : job->B->n;
+  int *mask = MALLOC(sizeof(int)*((size_t)ncol));
+  int i, j, k, l, jj, ll, nz;
+
+  for (i = 0; i < ncol; i++) mask[i] = -1;
+
+  for (i = job->start[c]; i < job->start[c+1]; i++){
+    nz = 0;
     for (j = ia[i]; j < ia[i+1]; j++){
       jj = ja[j];
-      for (k = ib[jj]; k < ib[jj+1]; k++){
-	if (mask[jb[k]] != -i - 2){
-	  if ((nz+1) <= nz) {
-#ifdef DEBUG_PRINT
-	    fprintf(stderr,"overflow in SparseMatrix_multiply !!!\n");
-#endif
-	    return NULL;
+      if (!jc){
+	for (k = ib[jj]; k < ib[jj+1]; k++){
+	  if (mask[jb[k]] != -i - 2){
+	    nz++;
+	    mask[jb[k]] = -i - 2;
+	  }
+	}
+	continue;
+      }
+      for (l = ib[jj]; l < ib[jj+1]; l++){
+	ll = jb[l];
+	for (k = ic[ll]; k < ic[ll+1]; k++){
+	  if (mask[jc[k]] != -i - 2){
+	    nz++;
+	    mask[jc[k]] = -i - 2;
 	  }
-	  nz++;
-	  mask[jb[k]] = -i - 2;
 	}
       }
     }
+    job->rownz[i] = nz;
   }
+  free(mask);
+}
 
-  C = SparseMatrix_new(m, B->n, nz, type, FORMAT_CSR);
-  if (!C) goto RETURN;
-  ic = C->ia;
-  jc = C->ja;
-  
-  nz = 0;
+static void product_fill(void *ctx, size_t c){
+  product_job *job = ctx;
+  SparseMatrix A = job->A, B = job->B, C = job->C, D = job->D;
+  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja, *id = D->ia, *jd = D->ja;
+  int *mask = MALLOC(sizeof(int)*((size_t)D->n));
+  int i, j, k, l, ll, jj, nz;
 
-  switch (type){
+  for (i = 0; i < D->n; i++) mask[i] = -1;
+  nz = id[job->start[c]];
+
+  if (C){
+    int *ic = C->ia, *jc = C->ja;
+    double *a = (double*) A->a;
+    double *b = (double*) B->a;
+    double *cc = (double*) C->a;
+    double *d = (double*) D->a;
+    for (i = job->start[c]; i < job->start[c+1]; i++){
+      for (j = ia[i]; j < ia[i+1]; j++){
+	jj = ja[j];
+	for (l = ib[jj]; l < ib[jj+1]; l++){
+	  ll = jb[l];
+	  for (k = ic[ll]; k < ic[ll+1]; k++){
+	    if (mask[jc[k]] < id[i]){
+	      mask[jc[k]] = nz;
+	      jd[nz] = jc[k];
+	      d[nz] = a[j]*b[l]*cc[k];
+	      nz++;
+	    } else {
+	      assert(jd[mask[jc[k]]] == jc[k]);
+	      d[mask[jc[k]]] += a[j]*b[l]*cc[k];
+	    }
+	  }
+	}
+      }
+    }
+    free(mask);
+    return;
+  }
+
+  switch (D->type){
   case MATRIX_TYPE_REAL:
     {
       double *a = (double*) A->a;
       double *b = (double*) B->a;
-      double *c = (double*) C->a;
-      ic[0] = 0;
-      for (i = 0; i < m; i++){
+      double *d = (double*) D->a;
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  jj = ja[j];
 	  for (k = ib[jj]; k < ib[jj+1]; k++){
-	    if (mask[jb[k]] < ic[i]){
+	    if (mask[jb[k]] < id[i]){
 	      mask[jb[k]] = nz;
-	      jc[nz] = jb[k];
-	      c[nz] = a[j]*b[k];
+	      jd[nz] = jb[k];
+	      d[nz] = a[j]*b[k];
 	      nz++;
 	    } else {
-	      assert(jc[mask[jb[k]]] == jb[k]);
-	      c[mask[jb[k]]] += a[j]*b[k];
+	      assert(jd[mask[jb[k]]] == jb[k]);
+	      d[mask[jb[k]]] += a[j]*b[k];
 	    }
 	  }
 	}
-	ic[i+1] = nz;
       }
     }
     break;
@@ -1174,29 +1339,24 @@ SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B){
     {
       double *a = (double*) A->a;
       double *b = (double*) B->a;
-      double *c = (double*) C->a;
-      a = (double*) A->a;
-      b = (double*) B->a;
-      c = (double*) C->a;
-      ic[0] = 0;
-      for (i = 0; i < m; i++){
+      double *d = (double*) D->a;
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  jj = ja[j];
 	  for (k = ib[jj]; k < ib[jj+1]; k++){
-	    if (mask[jb[k]] < ic[i]){
+	    if (mask[jb[k]] < id[i]){
 	      mask[jb[k]] = nz;
-	      jc[nz] = jb[k];
-	      c[2*nz] = a[2*j]*b[2*k] - a[2*j+1]*b[2*k+1];/*real part */
-	      c[2*nz+1] = a[2*j]*b[2*k+1] + a[2*j+1]*b[2*k];/*img part */
+	      jd[nz] = jb[k];
+	      d[2*nz] = a[2*j]*b[2*k] - a[2*j+1]*b[2*k+1];/*real part */
+	      d[2*nz+1] = a[2*j]*b[2*k+1] + a[2*j+1]*b[2*k];/*img part */
 	      nz++;
 	    } else {
-	      assert(jc[mask[jb[k]]] == jb[k]);
-	      c[2*mask[jb[k]]] += a[2*j]*b[2*k] - a[2*j+1]*b[2*k+1];/*real part */
-	      c[2*mask[jb[k]]+1] += a[2*j]*b[2*k+1] + a[2*j+1]*b[2*k];/*img part */
+	      assert(jd[mask[jb[k]]] == jb[k]);
+	      d[2*mask[jb[k]]] += a[2*j]*b[2*k] - a[2*j+1]*b[2*k+1];/*real part */
+	      d[2*mask[jb[k]]+1] += a[2*j]*b[2*k+1] + a[2*j+1]*b[2*k];/*img part */
 	    }
 	  }
 	}
-	ic[i+1] = nz;
       }
     }
     break;
@@ -1204,149 +1364,113 @@ SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B){
     {
       int *a = (int*) A->a;
       int *b = (int*) B->a;
-      int *c = (int*) C->a;
-      ic[0] = 0;
-      for (i = 0; i < m; i++){
+      int *d = (int*) D->a;
+      for (i = job->start[c]; i < job->start[c+1]; i++){
 	for (j = ia[i]; j < ia[i+1]; j++){
 	  jj = ja[j];
 	  for (k = ib[jj]; k < ib[jj+1]; k++){
-	    if (mask[jb[k]] < ic[i]){
+	    if (mask[jb[k]] < id[i]){
 	      mask[jb[k]] = nz;
-	      jc[nz] = jb[k];
-	      c[nz] = a[j]*b[k];
+	      jd[nz] = jb[k];
+	      d[nz] = a[j]*b[k];
 	      nz++;
 	    } else {
-	      assert(jc[mask[jb[k]]] == jb[k]);
-	      c[mask[jb[k]]] += a[j]*b[k];
+	      assert(jd[mask[jb[k]]] == jb[k]);
+	      d[mask[jb[k]]] += a[j]*b[k];
 	    }
 	  }
 	}
-	ic[i+1] = nz;
       }
     }
     break;
   case MATRIX_TYPE_PATTERN:
-    ic[0] = 0;
-    for (i = 0; i < m; i++){
+    for (i = job->start[c]; i < job->start[c+1]; i++){
       for (j = ia[i]; j < ia[i+1]; j++){
 	jj = ja[j];
 	for (k = ib[jj]; k < ib[jj+1]; k++){
-	  if (mask[jb[k]] < ic[i]){
+	  if (mask[jb[k]] < id[i]){
 	    mask[jb[k]] = nz;
-	    jc[nz] = jb[k];
+	    jd[nz] = jb[k];
 	    nz++;
 	  } else {
-	    assert(jc[mask[jb[k]]] == jb[k]);
+	    assert(jd[mask[jb[k]]] == jb[k]);
 	  }
 	}
       }
-      ic[i+1] = nz;
     }
     break;
-  case MATRIX_TYPE_UNKNOWN:
   default:
-    SparseMatrix_delete(C);
-    C = NULL; goto RETURN;
-    break;
+    assert(0);
   }
-  
-  C->nz = nz;
-
- RETURN:
   free(mask);
-  return C;
 }
 
+static SparseMatrix product_run(SparseMatrix A, SparseMatrix B, SparseMatrix C){
+  product_job job = {.A = A, .B = B, .C = C};
+  int whole[2] = {0, A->m};
+  int nchunks = row_chunks(A->m, A->nz, 1);
+  long long nz;
+  int i;
 
+  job.start = nchunks > 1 ? row_ranges(A->ia, A->m, nchunks) : whole;
+  job.rownz = MALLOC(sizeof(int)*((size_t)A->m));
 
-SparseMatrix SparseMatrix_multiply3(SparseMatrix A, SparseMatrix B, SparseMatrix C){
-  int m;
-  SparseMatrix D = NULL;
-  int *mask = NULL;
-  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja, *ic = C->ia, *jc = C->ja, *id, *jd;
-  int i, j, k, l, ll, jj, type, nz;
+  gv_parallel_for((size_t)nchunks, num_threads, product_count, &job);
+
+  for (nz = 0, i = 0; i < A->m; i++) nz += job.rownz[i];
+  if (nz > INT_MAX){
+#ifdef DEBUG_PRINT
+    fprintf(stderr,"overflow in SparseMatrix_multiply !!!\n");
+#endif
+    goto RETURN;
+  }
+
+  job.D = SparseMatrix_new(A->m, C ? C->n : B->n, (int) nz, A->type, FORMAT_CSR);
+  if (!job.D) goto RETURN;
+  job.D->ia[0] = 0;
+  for (i = 0; i < A->m; i++) job.D->ia[i+1] = job.D->ia[i] + job.rownz[i];
 
+  gv_parallel_for((size_t)nchunks, num_threads, product_fill, &job);
+  job.D->nz = (int) nz;
+
+ RETURN:
+  free(job.rownz);
+  if (nchunks > 1) free(job.start);
+  return job.D;
+}
+
+SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B){
   assert(A->format == B->format && A->format == FORMAT_CSR);/* other format not yet supported */
 
-  m = A->m;
   if (A->n != B->m) return NULL;
-  if (B->n != C->m) return NULL;
-
-  if (A->type != B->type || B->type != C->type){
+  if (A->type != B->type){
 #ifdef DEBUG
     printf("in SparseMatrix_multiply, the matrix types do not match, right now only multiplication of matrices of the same type is supported\n");
 #endif
     return NULL;
   }
-  type = A->type;
+  if (!(A->type & (MATRIX_TYPE_REAL | MATRIX_TYPE_COMPLEX | MATRIX_TYPE_INTEGER | MATRIX_TYPE_PATTERN)))
+    return NULL;
 
-  assert(type == MATRIX_TYPE_REAL);
+  return product_run(A, B, NULL);
+}
 
-  mask = MALLOC(sizeof(int)*((size_t)(C->n)));
-  if (!mask) return NULL;
+SparseMatrix SparseMatrix_multiply3(SparseMatrix A, SparseMatrix B, SparseMatrix C){
+  assert(A->format == B->format && A->format == FORMAT_CSR);/* other format not yet supported */
 
-  for (i = 0; i < C->n; i++) mask[i] = -1;
+  if (A->n != B->m) return NULL;
+  if (B->n != C->m) return NULL;
 
-  nz = 0;
-  for (i = 0; i < m; i++){
-    for (j = ia[i]; j < ia[i+1]; j++){
-      jj = ja[j];
-      for (l = ib[jj]; l < ib[jj+1]; l++){
-	ll = jb[l];
-	for (k = ic[ll]; k < ic[ll+1]; k++){
-	  if (mask[jc[k]] != -i - 2){
-	    if ((nz+1) <= nz) {
-#ifdef DEBUG_PRINT
-	      fprintf(stderr,"overflow in SparseMatrix_multiply !!!\n");
+  if (A->type != B->type || B->type != C->type){
+#ifdef DEBUG
+    printf("in SparseMatrix_multiply, the matrix types do not match, right now only multiplication of matrices of the same type is supported\n");
 #endif
-	      return NULL;
-	    }
-	    nz++;
-	    mask[jc[k]] = -i - 2;
-	  }
-	}
-      }
-    }
+    return NULL;
   }
 
-  D = SparseMatrix_new(m, C->n, nz, type, FORMAT_CSR);
-  if (!D) goto RETURN;
-  id = D->ia;
-  jd = D->ja;
-  
-  nz = 0;
-
-  double *a = (double*) A->a;
-  double *b = (double*) B->a;
-  double *c = (double*) C->a;
-  double *d = (double*) D->a;
-  id[0] = 0;
-  for (i = 0; i < m; i++){
-    for (j = ia[i]; j < ia[i+1]; j++){
-      jj = ja[j];
-      for (l = ib[jj]; l < ib[jj+1]; l++){
-        ll = jb[l];
-        for (k = ic[ll]; k < ic[ll+1]; k++){
-          if (mask[jc[k]] < id[i]){
-            mask[jc[k]] = nz;
-            jd[nz] = jc[k];
-            d[nz] = a[j]*b[l]*c[k];
-            nz++;
-          } else {
-            assert(jd[mask[jc[k]]] == jc[k]);
-            d[mask[jc[k]]] += a[j]*b[l]*c[k];
-          }
-        }
-      }
-    }
-    id[i+1] = nz;
-  }
-  
-  D->nz = nz;
+  assert(A->type == MATRIX_TYPE_REAL);
 
- RETURN:
-  free(mask);
-  return D;
+  return product_run(A, B, C);
 }
 
 SparseMatrix SparseMatrix_sum_repeat_entries(SparseMatrix A, int what_to_sum){
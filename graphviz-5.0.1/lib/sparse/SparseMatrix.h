@@ -63,6 +63,12 @@ void SparseMatrix_export(FILE *f, SparseMatrix A);/* export into MM format excep
 void SparseMatrix_delete(SparseMatrix A);
 
 SparseMatrix SparseMatrix_add(SparseMatrix A, SparseMatrix B);
+/* The products, SparseMatrix_multiply_vector, SparseMatrix_multiply_dense and SparseMatrix_transpose
+   split large matrices into ranges of rows worked out on up to this many threads (1 by default).
+   The results are the same for any number of threads. Not to be changed while those run. */
+void SparseMatrix_set_num_threads(int nthreads);
+int SparseMatrix_get_num_threads(void);
+
 SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B);
 SparseMatrix SparseMatrix_multiply3(SparseMatrix A, SparseMatrix B, SparseMatrix C);
 
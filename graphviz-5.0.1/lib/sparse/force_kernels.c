@@ -0,0 +1,354 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sparse/force_kernels.h>
+#include <sparse/general.h>
+
+/* The vector versions are compiled for their instruction set with target attributes, so the library
+   still runs on any processor, and are only called once force_kernels_isa has checked for it. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FORCE_X86
+#include <immintrin.h>
+#define FORCE_AVX2 __attribute__((target("avx2")))
+#define FORCE_AVX512 __attribute__((target("avx512f")))
+#endif
+
+static int isa_limit = FORCE_ISA_AVX512;
+
+int force_kernels_isa(void){
+#ifdef FORCE_X86
+  if (isa_limit >= FORCE_ISA_AVX512 && __builtin_cpu_supports("avx512f")) return FORCE_ISA_AVX512;
+  if (isa_limit >= FORCE_ISA_AVX2 && __builtin_cpu_supports("avx2")) return FORCE_ISA_AVX2;
+#endif
+  return FORCE_ISA_SCALAR;
+}
+
+void force_kernels_set_isa(int isa){
+  isa_limit = isa;
+}
+
+/*=============================== repulsion in sfdp ===============================*/
+
+static void repulse_row(const double *x, const double *y, double *fx, double *fy, int i, int j, int j1,
+			double KP, double *sx, double *sy){
+  /* the repulsion between i and j, ..., j1 - 1 */
+  double dx, dy, d;
+
+  for (; j < j1; j++){
+    dx = x[i] - x[j];
+    dy = y[i] - y[j];
+    d = KP/MAX(dx*dx + dy*dy, MINDIST*MINDIST);
+    dx *= d;
+    dy *= d;
+    *sx += dx;
+    *sy += dy;
+    fx[j] -= dx;
+    fy[j] -= dy;
+  }
+}
+
+#ifdef FORCE_X86
+FORCE_AVX2 static double hsum_avx2(__m256d v){
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+FORCE_AVX2 static void repulse_avx2(const double *x, const double *y, double *fx, double *fy, int i0,
+				    int i1, int j0, int j1, double KP){
+  const __m256d kp = _mm256_set1_pd(KP), mind = _mm256_set1_pd(MINDIST*MINDIST);
+  const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+  __m256d xi, yi, dx, dy, d, ax, ay;
+  __m256i m;
+  int i, j;
+
+  for (i = i0; i < i1; i++){
+    xi = _mm256_set1_pd(x[i]);
+    yi = _mm256_set1_pd(y[i]);
+    ax = ay = _mm256_setzero_pd();
+    for (j = i0 == j0 ? i + 1 : j0; j < j1; j += 4){
+      /* the last points of the row in part of the vector */
+      m = _mm256_cmpgt_epi64(_mm256_set1_epi64x(j1 - j), lanes);
+      dx = _mm256_sub_pd(xi, _mm256_maskload_pd(x + j, m));
+      dy = _mm256_sub_pd(yi, _mm256_maskload_pd(y + j, m));
+      d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+      d = _mm256_and_pd(_mm256_castsi256_pd(m), _mm256_div_pd(kp, _mm256_max_pd(d, mind)));
+      dx = _mm256_mul_pd(dx, d);
+      dy = _mm256_mul_pd(dy, d);
+      ax = _mm256_add_pd(ax, dx);
+      ay = _mm256_add_pd(ay, dy);
+      _mm256_maskstore_pd(fx + j, m, _mm256_sub_pd(_mm256_maskload_pd(fx + j, m), dx));
+      _mm256_maskstore_pd(fy + j, m, _mm256_sub_pd(_mm256_maskload_pd(fy + j, m), dy));
+    }
+    fx[i] += hsum_avx2(ax);
+    fy[i] += hsum_avx2(ay);
+  }
+}
+
+FORCE_AVX512 static void repulse_avx512(const double *x, const double *y, double *fx, double *fy, int i0,
+					int i1, int j0, int j1, double KP){
+  const __m512d kp = _mm512_set1_pd(KP), mind = _mm512_set1_pd(MINDIST*MINDIST);
+  __m512d xi, yi, dx, dy, d, ax, ay;
+  __mmask8 m;
+  int i, j;
+
+  for (i = i0; i < i1; i++){
+    xi = _mm512_set1_pd(x[i]);
+    yi = _mm512_set1_pd(y[i]);
+    ax = ay = _mm512_setzero_pd();
+    for (j = i0 == j0 ? i + 1 : j0; j < j1; j += 8){
+      /* the last points of the row in part of the vector */
+      m = j1 - j >= 8 ? 0xff : (__mmask8) ((1u << (j1 - j)) - 1);
+      dx = _mm512_sub_pd(xi, _mm512_maskz_loadu_pd(m, x + j));
+      dy = _mm512_sub_pd(yi, _mm512_maskz_loadu_pd(m, y + j));
+      d = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+      d = _mm512_div_pd(kp, _mm512_max_pd(d, mind));
+      dx = _mm512_maskz_mul_pd(m, dx, d);
+      dy = _mm512_maskz_mul_pd(m, dy, d);
+      ax = _mm512_add_pd(ax, dx);
+      ay = _mm512_add_pd(ay, dy);
+      _mm512_mask_storeu_pd(fx + j, m, _mm512_sub_pd(_mm512_maskz_loadu_pd(m, fx + j), dx));
+      _mm512_mask_storeu_pd(fy + j, m, _mm512_sub_pd(_mm512_maskz_loadu_pd(m, fy + j), dy));
+    }
+    fx[i] += _mm512_reduce_add_pd(ax);
+    fy[i] += _mm512_reduce_add_pd(ay);
+  }
+}
+#endif
+
+void force_repulse(const double *x, const double *y, double *fx, double *fy, int i0, int i1, int j0,
+		   int j1, double KP){
+  double sx, sy;
+  int i;
+
+  switch (force_kernels_isa()){
+#ifdef FORCE_X86
+  case FORCE_ISA_AVX512:
+    repulse_avx512(x, y, fx, fy, i0, i1, j0, j1, KP);
+    return;
+  case FORCE_ISA_AVX2:
+    repulse_avx2(x, y, fx, fy, i0, i1, j0, j1, KP);
+    return;
+#endif
+  default:
+    for (i = i0; i < i1; i++){
+      sx = sy = 0;
+      repulse_row(x, y, fx, fy, i, i0 == j0 ? i + 1 : j0, j1, KP, &sx, &sy);
+      fx[i] += sx;
+      fy[i] += sy;
+    }
+  }
+}
+
+/*=============================== attraction in sfdp ===============================*/
+
+static void attract_row(const double *x, double *f, const int *ja, int i, int j, int j1, double CRK){
+  double dx, dy, dist;
+
+  for (; j < j1; j++){
+    if (ja[j] == i) continue;
+    dx = x[2*i] - x[2*ja[j]];
+    dy = x[2*i+1] - x[2*ja[j]+1];
+    dist = sqrt(dx*dx + dy*dy);
+    f[0] -= CRK*dx*dist;
+    f[1] -= CRK*dy*dist;
+  }
+}
+
+#ifdef FORCE_X86
+FORCE_AVX2 static void attract_avx2(const double *x, double *force, const int *ia, const int *ja, int i0,
+				    int i1, double CRK){
+  /* The neighbors are loaded a point at a time, which is faster than the gather instructions on many
+     processors, and the row is padded with i itself, whose term is 0. */
+  __m256d xi, yi, p01, p23, dx, dy, dist, ax, ay;
+  const double *q[4];
+  int i, j, l;
+
+  for (i = i0; i < i1; i++){
+    xi = _mm256_set1_pd(x[2*i]);
+    yi = _mm256_set1_pd(x[2*i+1]);
+    ax = ay = _mm256_setzero_pd();
+    for (j = ia[i]; j < ia[i+1]; j += 4){
+      for (l = 0; l < 4; l++) q[l] = &x[2*(j + l < ia[i+1] ? ja[j+l] : i)];
+      p01 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(q[0])), _mm_loadu_pd(q[1]), 1);
+      p23 = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(q[2])), _mm_loadu_pd(q[3]), 1);
+      dx = _mm256_sub_pd(xi, _mm256_unpacklo_pd(p01, p23));
+      dy = _mm256_sub_pd(yi, _mm256_unpackhi_pd(p01, p23));
+      dist = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+      ax = _mm256_add_pd(ax, _mm256_mul_pd(dx, dist));
+      ay = _mm256_add_pd(ay, _mm256_mul_pd(dy, dist));
+    }
+    force[2*i] -= CRK*hsum_avx2(ax);
+    force[2*i+1] -= CRK*hsum_avx2(ay);
+  }
+}
+#endif
+
+void force_attract(const double *x, double *force, const int *ia, const int *ja, int i0, int i1,
+		   double CRK){
+  int i;
+
+#ifdef FORCE_X86
+  /* rows are too short for wider vectors to pay */
+  if (force_kernels_isa() >= FORCE_ISA_AVX2){
+    attract_avx2(x, force, ia, ja, i0, i1, CRK);
+    return;
+  }
+#endif
+  for (i = i0; i < i1; i++) attract_row(x, &force[2*i], ja, i, ia[i], ia[i+1], CRK);
+}
+
+/*=============================== fdp ===============================*/
+
+/* The fdp kernels reproduce the plain loops exactly, so the layouts do not depend on the processor.
+   Their vector versions use AVX2 without FMA, which would round differently, even where AVX-512 is
+   available. */
+
+static int fdp_repulse_range(force_block *a, int i, force_block *b, int j, int j1, double K2,
+			     double cutoff2, bool cube, double *sx, double *sy){
+  double xd, yd, d2, force;
+
+  for (; j < j1; j++){
+    if (a == b && j == i) continue;
+    xd = b->x[j] - a->x[i];
+    yd = b->y[j] - a->y[i];
+    d2 = xd*xd + yd*yd;
+    if (!(d2 < cutoff2)) continue;
+    if (d2 == 0.0) return j;
+    if (cube)
+      force = K2/(sqrt(d2)*d2);
+    else
+      force = K2/d2;
+    if (a->port[i] && b->port[j]) force *= 10.0;
+    b->dx[j] += xd*force;
+    b->dy[j] += yd*force;
+    *sx -= xd*force;
+    *sy -= yd*force;
+  }
+  return j1;
+}
+
+#ifdef FORCE_X86
+FORCE_AVX2 static int fdp_repulse_avx2(force_block *a, int i, force_block *b, int j, double K2,
+				       double cutoff2, bool cube, double *sx, double *sy){
+  const __m256d px = _mm256_set1_pd(a->x[i]), py = _mm256_set1_pd(a->y[i]);
+  const __m256d k2 = _mm256_set1_pd(K2), cut = _mm256_set1_pd(cutoff2), zero = _mm256_setzero_pd();
+  const __m256d ten = _mm256_set1_pd(10.0);
+  __m256d xd, yd, d2, force, on, tx, ty;
+  double fx[4], fy[4];
+  int l, ports, z;
+
+  for (; j + 4 <= b->n; j += 4){
+    xd = _mm256_sub_pd(_mm256_loadu_pd(b->x + j), px);
+    yd = _mm256_sub_pd(_mm256_loadu_pd(b->y + j), py);
+    d2 = _mm256_add_pd(_mm256_mul_pd(xd, xd), _mm256_mul_pd(yd, yd));
+    on = _mm256_cmp_pd(d2, cut, _CMP_LT_OQ);
+    if (a == b && i >= j && i < j + 4){
+      on = _mm256_andnot_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_set1_epi64x(i),
+	     _mm256_setr_epi64x(j, j + 1, j + 2, j + 3))), on);
+    }
+    if (!_mm256_movemask_pd(on)) continue;
+    if (_mm256_movemask_pd(_mm256_and_pd(on, _mm256_cmp_pd(d2, zero, _CMP_EQ_OQ)))){
+      /* coincident nodes, which the caller moves apart: up to them, one at a time */
+      z = fdp_repulse_range(a, i, b, j, j + 4, K2, cutoff2, cube, sx, sy);
+      if (z < j + 4) return z;
+      continue;
+    }
+    if (cube)
+      force = _mm256_div_pd(k2, _mm256_mul_pd(_mm256_sqrt_pd(d2), d2));
+    else
+      force = _mm256_div_pd(k2, d2);
+    if (a->port[i]){
+      memcpy(&ports, b->port + j, sizeof(ports));
+      tx = _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(ports)),
+						  _mm256_setzero_si256()));
+      force = _mm256_blendv_pd(force, _mm256_mul_pd(force, ten), tx);
+    }
+    /* nodes left out get +0, which leaves the sums below unchanged */
+    tx = _mm256_and_pd(on, _mm256_mul_pd(xd, force));
+    ty = _mm256_and_pd(on, _mm256_mul_pd(yd, force));
+    _mm256_storeu_pd(b->dx + j, _mm256_blendv_pd(_mm256_loadu_pd(b->dx + j),
+						 _mm256_add_pd(_mm256_loadu_pd(b->dx + j), tx), on));
+    _mm256_storeu_pd(b->dy + j, _mm256_blendv_pd(_mm256_loadu_pd(b->dy + j),
+						 _mm256_add_pd(_mm256_loadu_pd(b->dy + j), ty), on));
+    _mm256_storeu_pd(fx, tx);
+    _mm256_storeu_pd(fy, ty);
+    for (l = 0; l < 4; l++){
+      *sx -= fx[l];
+      *sy -= fy[l];
+    }
+  }
+  return fdp_repulse_range(a, i, b, j, b->n, K2, cutoff2, cube, sx, sy);
+}
+#endif
+
+int force_fdp_repulse(force_block *a, int i, force_block *b, int j0, double K2, double cutoff2,
+		      bool cube){
+  double sx = a->dx[i], sy = a->dy[i];
+  int j;
+
+#ifdef FORCE_X86
+  if (force_kernels_isa() >= FORCE_ISA_AVX2)
+    j = fdp_repulse_avx2(a, i, b, j0, K2, cutoff2, cube, &sx, &sy);
+  else
+#endif
+    j = fdp_repulse_range(a, i, b, j0, b->n, K2, cutoff2, cube, &sx, &sy);
+  a->dx[i] = sx;
+  a->dy[i] = sy;
+  return j;
+}
+
+static void fdp_attract_range(int k, int m, const double *dx, const double *dy, const double *factor,
+			      const double *len, double *force, bool cube){
+  double dist;
+
+  for (; k < m; k++){
+    dist = sqrt(dx[k]*dx[k] + dy[k]*dy[k]);
+    if (cube)
+      force[k] = factor[k]*(dist - len[k])/dist;
+    else
+      force[k] = factor[k]*dist/len[k];
+  }
+}
+
+#ifdef FORCE_X86
+FORCE_AVX2 static void fdp_attract_avx2(int m, const double *dx, const double *dy, const double *factor,
+					const double *len, double *force, bool cube){
+  __m256d x, y, f, l, dist;
+  int k;
+
+  for (k = 0; k + 4 <= m; k += 4){
+    x = _mm256_loadu_pd(dx + k);
+    y = _mm256_loadu_pd(dy + k);
+    f = _mm256_loadu_pd(factor + k);
+    l = _mm256_loadu_pd(len + k);
+    dist = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)));
+    if (cube)
+      f = _mm256_div_pd(_mm256_mul_pd(f, _mm256_sub_pd(dist, l)), dist);
+    else
+      f = _mm256_div_pd(_mm256_mul_pd(f, dist), l);
+    _mm256_storeu_pd(force + k, f);
+  }
+  fdp_attract_range(k, m, dx, dy, factor, len, force, cube);
+}
+#endif
+
+void force_fdp_attract(int m, const double *dx, const double *dy, const double *factor,
+		       const double *len, double *force, bool cube){
+#ifdef FORCE_X86
+  if (force_kernels_isa() >= FORCE_ISA_AVX2){
+    fdp_attract_avx2(m, dx, dy, factor, len, force, cube);
+    return;
+  }
+#endif
+  fdp_attract_range(0, m, dx, dy, factor, len, force, cube);
+}
@@ -0,0 +1,68 @@
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: Details at https://graphviz.org
+ *************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Inner loops of the force directed layouts, in two dimensions, with versions using AVX2 and AVX-512
+   on x86 processors that have them, chosen when called, and plain C versions for other processors and
+   compilers. The points are in arrays per coordinate. */
+
+enum {FORCE_ISA_SCALAR = 0, FORCE_ISA_AVX2, FORCE_ISA_AVX512};
+
+/* the instruction set the kernels use: the widest the processor supports, up to the limit set with
+   force_kernels_set_isa */
+int force_kernels_isa(void);
+
+/* limit the instruction set the kernels use, to compare them. Not to be called while kernels run. */
+void force_kernels_set_isa(int isa);
+
+/* sfdp's repulsive force for p = -1, between the points i0, ..., i1 - 1 and j0, ..., j1 - 1:
+   KP*(x_i - x_j)/|x_i - x_j|^2, the squared distance being at least MINDIST^2, is added to the
+   force on i and subtracted from that on j. If i0 == j0 the ranges are the same, and each pair
+   is taken once. */
+void force_repulse(const double *x, const double *y, double *fx, double *fy, int i0, int i1, int j0,
+		   int j1, double KP);
+
+/* sfdp's attractive force: for each point i = i0, ..., i1 - 1, CRK*|x_i - x_j|*(x_i - x_j) is
+   subtracted from force[2*i], force[2*i+1] for each j in ja[ia[i]], ..., ja[ia[i+1] - 1] other than i.
+   x holds point i at x[2*i], x[2*i+1]. */
+void force_attract(const double *x, double *force, const int *ia, const int *ja, int i0, int i1,
+		   double CRK);
+
+/* the nodes of an fdp grid cell */
+typedef struct {
+  int n;
+  double *x, *y;/* positions */
+  double *dx, *dy;/* displacements */
+  unsigned char *port;/* nonzero for the nodes that are ports */
+} force_block;
+
+/* fdp's repulsion between node i of block a and the nodes j0, ..., b->n - 1 of block b, other than
+   i if a == b, leaving out those at a squared distance of cutoff2 or more. For each, with d the
+   vector from i to j, K2*d/|d|^3 (K2*d/|d|^2 if !cube), ten times as much between ports, is added
+   to the displacement of j and subtracted from that of i, in order, so the results are those of
+   the plain loop. Return the first j at distance 0, whose repulsion is left to the caller, or b->n. */
+int force_fdp_repulse(force_block *a, int i, force_block *b, int j0, double K2, double cutoff2,
+		      bool cube);
+
+/* fdp's attraction along m edges, given the vectors dx, dy between their ends, none 0:
+   force[k] = factor[k]*(|d| - len[k])/|d| (factor[k]*|d|/len[k] if !cube). */
+void force_fdp_attract(int m, const double *dx, const double *dy, const double *factor,
+		       const double *len, double *force, bool cube);
+
+#ifdef __cplusplus
+}
+#endif
@@ -43,6 +43,7 @@ typedef enum {
 	FORMAT_XDOT,
 	FORMAT_XDOT12,
 	FORMAT_XDOT14,
+	FORMAT_GVB,
 } format_type;
 
 #define XDOTVERSION "1.7"
@@ -476,6 +477,7 @@ static void dot_begin_graph(GVJ_t *job)
 
     switch (job->render.id) {
 	case FORMAT_DOT:
+	case FORMAT_GVB:
 	    attach_attrs(g);
 	    break;
 	case FORMAT_CANON:
@@ -520,6 +522,7 @@ static void xdot_end_graph(graph_t* g)
 
 typedef int (*putstrfn) (void *chan, const char *str);
 typedef int (*flushfn) (void *chan);
+typedef size_t (*writefn) (void *chan, const char *buf, size_t len);
 static void dot_end_graph(GVJ_t *job)
 {
     graph_t *g = job->obj->u.g;
@@ -553,6 +556,10 @@ static void dot_end_graph(GVJ_t *job)
 	    if (!(job->flags & OUTPUT_NOT_REQUIRED))
 		agwrite(g, job);
 	    break;
+	case FORMAT_GVB:
+	    if (!(job->flags & OUTPUT_NOT_REQUIRED))
+		agwrite_binaryfn(g, job, (writefn)gvwrite);
+	    break;
 	default:
 	    UNREACHABLE();
     }
@@ -879,5 +886,6 @@ gvplugin_installed_t gvdevice_dot_types[] = {
     {FORMAT_XDOT, "xdot:xdot", 1, NULL, &device_features_dot},
     {FORMAT_XDOT12, "xdot1.2:xdot", 1, NULL, &device_features_dot},
     {FORMAT_XDOT14, "xdot1.4:xdot", 1, NULL, &device_features_dot},
+    {FORMAT_GVB, "gvb:dot", 1, NULL, &device_features_dot},
     {0, NULL, 0, NULL, NULL}
 };
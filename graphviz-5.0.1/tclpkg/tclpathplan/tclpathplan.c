@@ -62,6 +62,7 @@ typedef struct vgpane_s {
     poly *poly;			/* set of polygons */
     int N_poly_alloc;		/* for allocation */
     vconfig_t *vc;		/* visibility graph handle */
+    Pworkspace_t *ws;		/* scratch space for spline routing */
     Tcl_Interp *interp;		/* interpreter that owns the binding */
     char *triangle_cmd;		/* why is this here any more */
 } vgpane_t;
@@ -484,6 +485,7 @@ vgpanecmd(ClientData clientData, Tcl_Interp * interp, int argc,
 	/* delete a vgpane and all memory associated with it */
 	if (vgp->vc)
 	    Pobsclose(vgp->vc);
+	Pworkspace_free(vgp->ws);
 	free(vgp->poly);	/* ### */
 	Tcl_DeleteCommand(interp, argv[0]);
 	free(tclhandleFree(vgpaneTable, argv[0]));
@@ -678,7 +680,8 @@ vgpanecmd(ClientData clientData, Tcl_Interp * interp, int argc,
 	    make_barriers(vgp, pp, qp, &barriers, &n_barriers);
 	    slopes[0].x = slopes[0].y = 0.0;
 	    slopes[1].x = slopes[1].y = 0.0;
-	    Proutespline(barriers, n_barriers, line, slopes, &spline);
+	    Proutespline_ws(vgp->ws, barriers, n_barriers, line, slopes,
+			    &spline);
 
 	    for (i = 0; i < spline.pn; i++) {
 		appendpoint(interp, spline.ps[i]);
@@ -851,6 +854,7 @@ vgpane(ClientData clientData, Tcl_Interp * interp, int argc, char *argv[])
     *(vgpane_t **) tclhandleAlloc(vgpaneTable, vbuf, NULL) = vgp;
 
     vgp->vc = NULL;
+    vgp->ws = Pworkspace_new();
     vgp->Npoly = 0;
     vgp->N_poly_alloc = 250;
     vgp->poly = malloc(vgp->N_poly_alloc * sizeof(poly));
@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief benchmark read and close of a large graph with the default and
+ *   arena memory disciplines
+ *
+ * Usage: cgraph_arena [nodes [edges [repetitions]]]
+ */
+
+#include <cgraph.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double seconds(clock_t start, clock_t end) {
+  return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+/// write a random digraph in DOT syntax to a temporary file
+static FILE *make_graph(long nodes, long edges) {
+  FILE *fp = tmpfile();
+  if (fp == NULL) {
+    perror("tmpfile");
+    exit(EXIT_FAILURE);
+  }
+
+  srand(1);
+  fprintf(fp, "digraph G {\n  node [shape=box];\n");
+  for (long i = 0; i < nodes; ++i) {
+    fprintf(fp, "  n%ld [label=\"node %ld\"];\n", i, i);
+  }
+  for (long i = 0; i < edges; ++i) {
+    long t = rand() % nodes;
+    long h = rand() % nodes;
+    fprintf(fp, "  n%ld -> n%ld [weight=%ld];\n", t, h, i % 5 + 1);
+  }
+  fprintf(fp, "}\n");
+  return fp;
+}
+
+static void run(const char *name, Agmemdisc_t *mem, FILE *fp, int reps) {
+  Agdisc_t disc = {mem, &AgIdDisc, &AgIoDisc};
+  double read = 0, close = 0, churn = 0;
+
+  for (int i = 0; i < reps; ++i) {
+    rewind(fp);
+    clock_t t0 = clock();
+    Agraph_t *g = agread(fp, &disc);
+    clock_t t1 = clock();
+    if (g == NULL) {
+      fprintf(stderr, "failed to read graph\n");
+      exit(EXIT_FAILURE);
+    }
+
+    // delete and recreate a tenth of the nodes to exercise free lists
+    int n = agnnodes(g) / 10;
+    clock_t t2 = clock();
+    for (int j = 0; j < n; ++j) {
+      Agnode_t *v = agfstnode(g);
+      agdelnode(g, v);
+    }
+    for (int j = 0; j < n; ++j) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "new%d", j);
+      Agnode_t *v = agnode(g, buf, 1);
+      if (j > 0) {
+        snprintf(buf, sizeof(buf), "new%d", j - 1);
+        agedge(g, agnode(g, buf, 0), v, NULL, 1);
+      }
+    }
+    clock_t t3 = clock();
+
+    agclose(g);
+    clock_t t4 = clock();
+
+    read += seconds(t0, t1);
+    churn += seconds(t2, t3);
+    close += seconds(t3, t4);
+  }
+
+  printf("%-8s read %8.3fs  delete/create %8.3fs  close %8.3fs\n", name,
+         read / reps, churn / reps, close / reps);
+}
+
+int main(int argc, char **argv) {
+  long nodes = argc > 1 ? atol(argv[1]) : 200000;
+  long edges = argc > 2 ? atol(argv[2]) : 4 * nodes;
+  int reps = argc > 3 ? atoi(argv[3]) : 3;
+
+  if (nodes < 1 || edges < 0 || reps < 1) {
+    fprintf(stderr, "Usage: %s [nodes [edges [repetitions]]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *fp = make_graph(nodes, edges);
+  printf("%ld nodes, %ld edges, mean of %d runs\n", nodes, edges, reps);
+  run("default", &AgMemDisc, fp, reps);
+  run("arena", &AgArenaDisc, fp, reps);
+  fclose(fp);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file
+ * @brief benchmark loading a large graph from DOT text and from a binary
+ *   image
+ *
+ * Usage: cgraph_binary [nodes [edges [repetitions]]]
+ */
+
+#include <cgraph.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double seconds(clock_t start, clock_t end) {
+  return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+/// write a random digraph with attributes and a few clusters in DOT syntax
+/// to a temporary file
+static FILE *make_graph(long nodes, long edges) {
+  FILE *fp = tmpfile();
+  if (fp == NULL) {
+    perror("tmpfile");
+    exit(EXIT_FAILURE);
+  }
+
+  srand(1);
+  fprintf(fp, "digraph G {\n  node [shape=box];\n");
+  for (long i = 0; i < nodes; ++i) {
+    fprintf(fp, "  n%ld [label=\"a node called %ld\", color=%s];\n", i, i,
+            i % 3 ? "black" : "red");
+  }
+  for (long i = 0; i < edges; ++i) {
+    long t = rand() % nodes;
+    long h = rand() % nodes;
+    fprintf(fp, "  n%ld -> n%ld [weight=%ld];\n", t, h, i % 5 + 1);
+  }
+  for (long c = 0; c < 10; ++c) {
+    fprintf(fp, "  subgraph cluster_%ld { label=\"cluster %ld\";", c, c);
+    for (long i = c; i < nodes; i += 100) {
+      fprintf(fp, " n%ld;", i);
+    }
+    fprintf(fp, " }\n");
+  }
+  fprintf(fp, "}\n");
+  rewind(fp);
+  return fp;
+}
+
+static long size(FILE *fp) {
+  fseek(fp, 0, SEEK_END);
+  long len = ftell(fp);
+  rewind(fp);
+  return len;
+}
+
+int main(int argc, char **argv) {
+  long nodes = argc > 1 ? atol(argv[1]) : 200000;
+  long edges = argc > 2 ? atol(argv[2]) : 4 * nodes;
+  int reps = argc > 3 ? atoi(argv[3]) : 3;
+
+  if (nodes < 1 || edges < 0 || reps < 1) {
+    fprintf(stderr, "Usage: %s [nodes [edges [repetitions]]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *text = make_graph(nodes, edges);
+  FILE *bin = tmpfile();
+  if (bin == NULL) {
+    perror("tmpfile");
+    return EXIT_FAILURE;
+  }
+  Agraph_t *g = agread(text, NULL);
+  if (g == NULL || agwrite_binary(g, bin) != 0) {
+    fprintf(stderr, "failed to convert graph\n");
+    return EXIT_FAILURE;
+  }
+  agclose(g);
+
+  double dot = 0, binary = 0;
+  for (int i = 0; i < reps; ++i) {
+    rewind(text);
+    clock_t t0 = clock();
+    g = agread(text, NULL);
+    clock_t t1 = clock();
+    agclose(g);
+
+    rewind(bin);
+    clock_t t2 = clock();
+    g = agread_binary(bin, NULL);
+    clock_t t3 = clock();
+    if (g == NULL) {
+      fprintf(stderr, "failed to read binary image\n");
+      return EXIT_FAILURE;
+    }
+    agclose(g);
+
+    dot += seconds(t0, t1);
+    binary += seconds(t2, t3);
+  }
+
+  printf("%ld nodes, %ld edges, mean of %d runs\n", nodes, edges, reps);
+  printf("DOT    %10ld bytes  read %8.3fs\n", size(text), dot / reps);
+  printf("binary %10ld bytes  read %8.3fs\n", size(bin), binary / reps);
+  fclose(text);
+  fclose(bin);
+
+  return EXIT_SUCCESS;
+}
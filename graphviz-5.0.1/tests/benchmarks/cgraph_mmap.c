@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief benchmark reading a large DOT file with agread and agmmapread
+ *
+ * Each reader runs in its own child process so that its peak resident set
+ * size can be reported separately.
+ *
+ * Usage: cgraph_mmap [nodes [edges]]
+ */
+
+#include <cgraph.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static double now(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+}
+
+/// write a random digraph with labelled nodes in DOT syntax to `path`
+static void make_graph(const char *path, long nodes, long edges) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  srand(1);
+  fprintf(fp, "digraph G {\n");
+  for (long i = 0; i < nodes; ++i) {
+    fprintf(fp, "  node_%ld [label=\"a node called %ld\", shape=box];\n", i,
+            i);
+  }
+  for (long i = 0; i < edges; ++i) {
+    long t = rand() % nodes;
+    long h = rand() % nodes;
+    fprintf(fp, "  node_%ld -> node_%ld [weight=%ld];\n", t, h, i % 5 + 1);
+  }
+  fprintf(fp, "}\n");
+  fclose(fp);
+}
+
+static void run(const char *name, const char *path, int use_mmap) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+
+  if (pid == 0) {
+    double start = now();
+    Agraph_t *g;
+    if (use_mmap) {
+      g = agmmapread(path);
+    } else {
+      FILE *fp = fopen(path, "r");
+      g = fp ? agread(fp, NULL) : NULL;
+      if (fp) {
+        fclose(fp);
+      }
+    }
+    double end = now();
+    if (g == NULL) {
+      fprintf(stderr, "%s: failed to read %s\n", name, path);
+      _exit(EXIT_FAILURE);
+    }
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("%-8s %6d nodes  read %8.3fs  peak RSS %8ld KB\n", name,
+           agnnodes(g), end - start, ru.ru_maxrss);
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+    exit(EXIT_FAILURE);
+  }
+}
+
+int main(int argc, char **argv) {
+  long nodes = argc > 1 ? atol(argv[1]) : 200000;
+  long edges = argc > 2 ? atol(argv[2]) : 4 * nodes;
+
+  if (nodes < 1 || edges < 0) {
+    fprintf(stderr, "Usage: %s [nodes [edges]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  char path[] = "/tmp/cgraph_mmap_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  make_graph(path, nodes, edges);
+
+  printf("%ld nodes, %ld edges\n", nodes, edges);
+  run("agread", path, 0);
+  run("mmap", path, 1);
+
+  unlink(path);
+  return EXIT_SUCCESS;
+}
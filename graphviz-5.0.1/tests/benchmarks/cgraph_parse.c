@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief benchmark parsing a large graph and looking up its nodes and edges
+ *   by name
+ *
+ * Usage: cgraph_parse [nodes [edges [repetitions]]]
+ */
+
+#include <cgraph.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double seconds(clock_t start, clock_t end) {
+  return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+/// write a random digraph in DOT syntax to a temporary file
+///
+/// Every fourth edge carries a key, so that keyed edge lookups are exercised
+/// as well as anonymous ones.
+static FILE *make_graph(long nodes, long edges) {
+  FILE *fp = tmpfile();
+  if (fp == NULL) {
+    perror("tmpfile");
+    exit(EXIT_FAILURE);
+  }
+
+  srand(1);
+  fprintf(fp, "digraph G {\n");
+  for (long i = 0; i < edges; ++i) {
+    long t = rand() % nodes;
+    long h = rand() % nodes;
+    if (i % 4 == 0) {
+      fprintf(fp, "  n%ld -> n%ld [key=k%ld];\n", t, h, i);
+    } else {
+      fprintf(fp, "  n%ld -> n%ld;\n", t, h);
+    }
+  }
+  fprintf(fp, "}\n");
+  return fp;
+}
+
+int main(int argc, char **argv) {
+  long nodes = argc > 1 ? atol(argv[1]) : 200000;
+  long edges = argc > 2 ? atol(argv[2]) : 4 * nodes;
+  int reps = argc > 3 ? atoi(argv[3]) : 3;
+
+  if (nodes < 1 || edges < 0 || reps < 1) {
+    fprintf(stderr, "Usage: %s [nodes [edges [repetitions]]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *fp = make_graph(nodes, edges);
+  double parse = 0, nlookup = 0, elookup = 0;
+  long found = 0;
+
+  for (int i = 0; i < reps; ++i) {
+    rewind(fp);
+    clock_t t0 = clock();
+    Agraph_t *g = agread(fp, NULL);
+    clock_t t1 = clock();
+    if (g == NULL) {
+      fprintf(stderr, "failed to read graph\n");
+      return EXIT_FAILURE;
+    }
+
+    char buf[32];
+    for (long j = 0; j < nodes; ++j) {
+      snprintf(buf, sizeof(buf), "n%ld", j);
+      if (agnode(g, buf, 0) != NULL) {
+        ++found;
+      }
+    }
+    clock_t t2 = clock();
+
+    // look up every edge again through its endpoints and, if any, its key
+    for (Agnode_t *n = agfstnode(g); n != NULL; n = agnxtnode(g, n)) {
+      for (Agedge_t *e = agfstout(g, n); e != NULL; e = agnxtout(g, e)) {
+        if (agedge(g, n, aghead(e), agnameof(e), 0) != NULL) {
+          ++found;
+        }
+      }
+    }
+    clock_t t3 = clock();
+
+    agclose(g);
+
+    parse += seconds(t0, t1);
+    nlookup += seconds(t1, t2);
+    elookup += seconds(t2, t3);
+  }
+
+  printf("%ld nodes, %ld edges, mean of %d runs (%ld lookups hit)\n", nodes,
+         edges, reps, found);
+  printf("parse %8.3fs  node lookup %8.3fs  edge lookup %8.3fs\n",
+         parse / reps, nlookup / reps, elookup / reps);
+  fclose(fp);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @brief benchmark dot's crossing minimization on wide layered graphs
+ *
+ * Each graph has a number of layers of equal width. Every node has a few
+ * edges to random nodes one to three layers further down, so the ranks also
+ * fill with the virtual nodes of long edges. dot is stopped after ranking
+ * and after crossing minimization (the phase attribute), and the difference
+ * is reported as the time spent in mincross.
+ *
+ * Usage: dot_mincross [width [layers [repetitions]]]
+ */
+
+#include <cgraph.h>
+#include <gvc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double seconds(clock_t start, clock_t end) {
+  return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+/// write a random layered digraph in DOT syntax to a temporary file
+static FILE *make_graph(long width, long layers) {
+  FILE *fp = tmpfile();
+  if (fp == NULL) {
+    perror("tmpfile");
+    exit(EXIT_FAILURE);
+  }
+
+  srand(1);
+  fprintf(fp, "digraph G {\n");
+  for (long l = 0; l + 1 < layers; ++l) {
+    for (long i = 0; i < width; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        long down = 1 + rand() % 3;
+        if (l + down >= layers) {
+          down = layers - 1 - l;
+        }
+        fprintf(fp, "  n%ld_%ld -> n%ld_%ld;\n", l, i, l + down,
+                (long)(rand() % width));
+      }
+    }
+  }
+  fprintf(fp, "}\n");
+  return fp;
+}
+
+/// lay out the graph in fp with dot, stopping after the given phase
+static double layout(GVC_t *gvc, FILE *fp, const char *phase) {
+  rewind(fp);
+  Agraph_t *g = agread(fp, NULL);
+  if (g == NULL) {
+    fprintf(stderr, "failed to read graph\n");
+    exit(EXIT_FAILURE);
+  }
+  agattr(g, AGRAPH, "phase", phase);
+
+  clock_t t0 = clock();
+  gvLayout(gvc, g, "dot");
+  clock_t t1 = clock();
+
+  gvFreeLayout(gvc, g);
+  agclose(g);
+  return seconds(t0, t1);
+}
+
+int main(int argc, char **argv) {
+  long width = argc > 1 ? atol(argv[1]) : 200;
+  long layers = argc > 2 ? atol(argv[2]) : 10;
+  int reps = argc > 3 ? atoi(argv[3]) : 3;
+
+  if (width < 1 || layers < 2 || reps < 1) {
+    fprintf(stderr, "Usage: %s [width [layers [repetitions]]]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  GVC_t *gvc = gvContext();
+  FILE *fp = make_graph(width, layers);
+  double rank = 0, order = 0;
+
+  for (int i = 0; i < reps; ++i) {
+    rank += layout(gvc, fp, "1");
+    order += layout(gvc, fp, "2");
+  }
+
+  printf("%ld layers of %ld nodes, mean of %d runs\n", layers, width, reps);
+  printf("rank %8.3fs  rank+mincross %8.3fs  mincross %8.3fs\n", rank / reps,
+         order / reps, (order - rank) / reps);
+  fclose(fp);
+  gvFreeContext(gvc);
+
+  return EXIT_SUCCESS;
+}
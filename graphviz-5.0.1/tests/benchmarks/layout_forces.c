@@ -0,0 +1,263 @@
+/**
+ * @file
+ * @brief benchmark the vectorized force kernels of sfdp and fdp
+ *
+ * Each kernel of lib/sparse/force_kernels.c is run with every instruction
+ * set the processor supports, on inputs shaped like those the layouts give
+ * it: leaves of 16 points for sfdp's repulsion, rows of a sparse graph for
+ * its attraction, and grid cells of fdp against their neighbors. The time
+ * per pair (or edge) is reported, with the largest difference from the
+ * scalar results relative to the largest force. The fdp kernels must match
+ * the scalar ones exactly.
+ *
+ * libsparse is not installed, so this is built from the sources of
+ * lib/sparse; see the Makefile.
+ *
+ * Usage: layout_forces [repetitions]
+ */
+
+#include <math.h>
+#include <sparse/force_kernels.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *isa_names[] = {"scalar", "AVX2", "AVX-512"};
+
+static double uniform(void) { return (rand() + 0.5) / ((double)RAND_MAX + 1); }
+
+static void *xcalloc(size_t n, size_t size) {
+  void *p = calloc(n, size);
+  if (p == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+/// largest difference between a and b, relative to the largest entry of b
+static double difference(const double *a, const double *b, int n) {
+  double big = 0, dmax = 0;
+  for (int i = 0; i < n; ++i) {
+    big = fmax(big, fabs(b[i]));
+    dmax = fmax(dmax, fabs(a[i] - b[i]));
+  }
+  return big > 0 ? dmax / big : 0;
+}
+
+static void report(const char *kernel, int isa, double seconds, double count,
+                   double diff) {
+  printf("%-14s %-8s %7.2f ns per pair, relative difference %.2g\n", kernel,
+         isa_names[isa], 1e9 * seconds / count, diff);
+}
+
+enum { LEAF = 16 };
+
+/// sfdp's repulsion between neighboring leaves of 16 points
+static void bench_repulse(int isa, int reps, double *scalar) {
+  const int n = 1 << 14;
+  double *x = xcalloc((size_t)n, sizeof(double));
+  double *y = xcalloc((size_t)n, sizeof(double));
+  double *f = xcalloc(2 * (size_t)n, sizeof(double));
+
+  srand(1);
+  for (int i = 0; i < n; ++i) {
+    x[i] = uniform();
+    y[i] = uniform();
+  }
+  double pairs = 0;
+  clock_t start = clock();
+  for (int r = 0; r < reps; ++r) {
+    memset(f, 0, sizeof(double) * 2 * (size_t)n);
+    for (int i = 0; i < n; i += LEAF) {
+      // the leaf itself and the next eight
+      for (int j = i; j < n && j < i + 9 * LEAF; j += LEAF) {
+        force_repulse(x, y, f, f + n, i, i + LEAF, j, j + LEAF, 1);
+        pairs += j == i ? LEAF * (LEAF - 1) / 2 : LEAF * LEAF;
+      }
+    }
+  }
+  double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+  if (isa == FORCE_ISA_SCALAR) {
+    memcpy(scalar, f, sizeof(double) * 2 * (size_t)n);
+  }
+  report("sfdp repulse", isa, t, pairs, difference(f, scalar, 2 * n));
+  free(x);
+  free(y);
+  free(f);
+}
+
+/// sfdp's attraction along the edges of a random graph of average degree 6
+static void bench_attract(int isa, int reps, double *scalar) {
+  const int n = 1 << 17, degree = 6;
+  int *ia = xcalloc((size_t)n + 1, sizeof(int));
+  int *ja = xcalloc((size_t)n * degree, sizeof(int));
+  double *x = xcalloc(2 * (size_t)n, sizeof(double));
+  double *f = xcalloc(2 * (size_t)n, sizeof(double));
+
+  srand(1);
+  for (int i = 0; i < 2 * n; ++i) {
+    x[i] = uniform();
+  }
+  // neighbors mostly close by in numbering, as after a reordering
+  for (int i = 0; i < n; ++i) {
+    ia[i + 1] = ia[i] + 1 + rand() % (2 * degree - 1);
+    if (ia[i + 1] > n * degree) {
+      ia[i + 1] = n * degree;
+    }
+    for (int j = ia[i]; j < ia[i + 1]; ++j) {
+      ja[j] = (i + rand() % 1024) % n;
+    }
+  }
+  clock_t start = clock();
+  for (int r = 0; r < reps; ++r) {
+    memset(f, 0, sizeof(double) * 2 * (size_t)n);
+    force_attract(x, f, ia, ja, 0, n, 1);
+  }
+  double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+  if (isa == FORCE_ISA_SCALAR) {
+    memcpy(scalar, f, sizeof(double) * 2 * (size_t)n);
+  }
+  report("sfdp attract", isa, t, (double)reps * ia[n],
+         difference(f, scalar, 2 * n));
+  free(ia);
+  free(ja);
+  free(x);
+  free(f);
+}
+
+static force_block make_block(int n) {
+  force_block b = {.n = n};
+  b.x = xcalloc((size_t)n, sizeof(double));
+  b.y = xcalloc((size_t)n, sizeof(double));
+  b.dx = xcalloc((size_t)n, sizeof(double));
+  b.dy = xcalloc((size_t)n, sizeof(double));
+  b.port = xcalloc((size_t)n, 1);
+  return b;
+}
+
+static void free_block(force_block *b) {
+  free(b->x);
+  free(b->y);
+  free(b->dx);
+  free(b->dy);
+  free(b->port);
+}
+
+/// fdp's repulsion within a grid cell of 9 nodes, and against 8 neighbors
+static void bench_fdp_repulse(int isa, int reps, double *scalar) {
+  const int cells = 1024, size = 9;
+  const double cell = 3, K2 = 1;
+  force_block a = make_block(size), b = make_block(8 * size);
+  double *out = xcalloc(2 * (size_t)cells * 9 * size, sizeof(double));
+  double pairs = 0;
+  clock_t t = 0;
+
+  srand(1);
+  for (int c = 0; c < cells; ++c) {
+    for (int i = 0; i < size; ++i) {
+      a.x[i] = cell * uniform();
+      a.y[i] = cell * uniform();
+      a.dx[i] = a.dy[i] = 0;
+      a.port[i] = rand() % 8 == 0;
+    }
+    for (int i = 0; i < b.n; ++i) {
+      b.x[i] = cell * (3 * uniform() - 1);
+      b.y[i] = cell * (3 * uniform() - 1);
+      b.dx[i] = b.dy[i] = 0;
+      b.port[i] = rand() % 8 == 0;
+    }
+    clock_t start = clock();
+    for (int r = 0; r < reps; ++r) {
+      for (int i = 0; i < a.n; ++i) {
+        force_fdp_repulse(&a, i, &a, 0, K2, HUGE_VAL, true);
+      }
+      for (int i = 0; i < a.n; ++i) {
+        force_fdp_repulse(&a, i, &b, 0, K2, cell * cell, true);
+      }
+    }
+    t += clock() - start;
+    pairs += (double)reps * a.n * (a.n - 1 + b.n);
+    double *o = out + 2 * (size_t)c * 9 * size;
+    memcpy(o, a.dx, sizeof(double) * (size_t)size);
+    memcpy(o + size, a.dy, sizeof(double) * (size_t)size);
+    memcpy(o + 2 * size, b.dx, sizeof(double) * 8 * size);
+    memcpy(o + 10 * size, b.dy, sizeof(double) * 8 * size);
+  }
+  int n = 2 * cells * 9 * size;
+  if (isa == FORCE_ISA_SCALAR) {
+    memcpy(scalar, out, sizeof(double) * (size_t)n);
+  }
+  report("fdp repulse", isa, (double)t / CLOCKS_PER_SEC, pairs,
+         difference(out, scalar, n));
+  if (memcmp(out, scalar, sizeof(double) * (size_t)n) != 0) {
+    printf("fdp repulse: %s results differ from the scalar ones\n",
+           isa_names[isa]);
+  }
+  free_block(&a);
+  free_block(&b);
+  free(out);
+}
+
+/// fdp's attraction along edges
+static void bench_fdp_attract(int isa, int reps, double *scalar) {
+  const int m = 1 << 16;
+  double *dx = xcalloc((size_t)m, sizeof(double));
+  double *dy = xcalloc((size_t)m, sizeof(double));
+  double *factor = xcalloc((size_t)m, sizeof(double));
+  double *len = xcalloc((size_t)m, sizeof(double));
+  double *force = xcalloc((size_t)m, sizeof(double));
+
+  srand(1);
+  for (int k = 0; k < m; ++k) {
+    dx[k] = uniform() - 0.5;
+    dy[k] = uniform() - 0.5;
+    factor[k] = 1;
+    len[k] = uniform();
+  }
+  clock_t start = clock();
+  for (int r = 0; r < reps; ++r) {
+    force_fdp_attract(m, dx, dy, factor, len, force, true);
+  }
+  double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+  if (isa == FORCE_ISA_SCALAR) {
+    memcpy(scalar, force, sizeof(double) * (size_t)m);
+  }
+  report("fdp attract", isa, t, (double)reps * m,
+         difference(force, scalar, m));
+  if (memcmp(force, scalar, sizeof(double) * (size_t)m) != 0) {
+    printf("fdp attract: %s results differ from the scalar ones\n",
+           isa_names[isa]);
+  }
+  free(dx);
+  free(dy);
+  free(factor);
+  free(len);
+  free(force);
+}
+
+int main(int argc, char **argv) {
+  int reps = argc > 1 ? atoi(argv[1]) : 10;
+  double *scalar[4];
+
+  for (int k = 0; k < 4; ++k) {
+    scalar[k] = xcalloc(1 << 18, sizeof(double));
+  }
+  // the scalar kernels first, as the reference for the others
+  for (int isa = FORCE_ISA_SCALAR; isa <= FORCE_ISA_AVX512; ++isa) {
+    force_kernels_set_isa(isa);
+    if (force_kernels_isa() != isa) {
+      break;
+    }
+    bench_repulse(isa, reps, scalar[0]);
+    bench_attract(isa, reps, scalar[1]);
+    bench_fdp_repulse(isa, reps, scalar[2]);
+    bench_fdp_attract(isa, reps, scalar[3]);
+  }
+  for (int k = 0; k < 4; ++k) {
+    free(scalar[k]);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file
+ * @brief benchmark the dense kernels of neato's majorization solver
+ *
+ * The packed symmetric matrix-vector product and the float vector operations
+ * of lib/neatogen/matrix_ops.c, which conjugate_gradient_mkernel spends its
+ * time in, are compared with copies of the plain loops they replaced, for
+ * matrices of 1,000 to 20,000 nodes. The product is run with 1, 2, 4, ...
+ * threads, up to the given maximum. The largest difference from the plain
+ * loops, relative to the largest entry of the result, is reported.
+ *
+ * libneatogen is not installed, so this is built from the sources of
+ * lib/neatogen; see the Makefile.
+ *
+ * Usage: majorization_kernels [max_threads [max_nodes]]
+ */
+
+#include <math.h>
+#include <neatogen/matrix_ops.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum { VECTOR_REPS = 2000 };
+
+/// wall clock time in seconds, as the threads run concurrently
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static float uniform(void) {
+  return (float)((rand() + 0.5) / ((double)RAND_MAX + 1));
+}
+
+static void *xcalloc(size_t n, size_t size) {
+  void *p = calloc(n, size);
+  if (p == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+/// largest difference between a and b, relative to the largest entry of b
+static double difference(const float *a, const float *b, int n) {
+  double big = 0, dmax = 0;
+  for (int i = 0; i < n; ++i) {
+    big = fmax(big, fabs(b[i]));
+    dmax = fmax(dmax, fabs((double)a[i] - b[i]));
+  }
+  return big > 0 ? dmax / big : 0;
+}
+
+// the loops of matrix_ops.c before they were vectorized
+
+static void plain_mult(float *packed_matrix, int n, float *vector,
+                       float *result) {
+  int index = 0;
+  for (int i = 0; i < n; i++) {
+    result[i] = 0;
+  }
+  for (int i = 0; i < n; i++) {
+    float res = 0;
+    float vector_i = vector[i];
+    res += packed_matrix[index++] * vector_i;
+    for (int j = i + 1; j < n; j++, index++) {
+      res += packed_matrix[index] * vector[j];
+      result[j] += packed_matrix[index] * vector_i;
+    }
+    result[i] += res;
+  }
+}
+
+static double plain_inner_product(int n, float *vector1, float *vector2) {
+  double result = 0;
+  for (int i = 0; i < n; i++) {
+    result += vector1[i] * vector2[i];
+  }
+  return result;
+}
+
+static void plain_mult_addition(int n, float *vector1, float alpha,
+                                float *vector2) {
+  for (int i = 0; i < n; i++) {
+    vector1[i] = vector1[i] + alpha * vector2[i];
+  }
+}
+
+static void plain_orthog1(int n, float *vec) {
+  float sum = 0;
+  for (int i = 0; i < n; i++) {
+    sum += vec[i];
+  }
+  sum /= (float)n;
+  for (int i = 0; i < n; i++) {
+    vec[i] -= sum;
+  }
+}
+
+/// the time of one product with the plain loop, and then with 1, 2, 4, ...
+/// threads
+static void bench_mult(int n, int max_threads) {
+  size_t entries = (size_t)n * ((size_t)n + 1) / 2;
+  float *packed = xcalloc(entries, sizeof(float));
+  float *x = xcalloc((size_t)n, sizeof(float));
+  float *y0 = xcalloc((size_t)n, sizeof(float));
+  float *y = xcalloc((size_t)n, sizeof(float));
+
+  for (size_t k = 0; k < entries; ++k) {
+    packed[k] = uniform();
+  }
+  for (int i = 0; i < n; ++i) {
+    x[i] = uniform() - 0.5f;
+  }
+  // enough products for about 10^9 entries
+  int reps = (int)(1e9 / (double)entries) + 1;
+
+  double start = now();
+  for (int r = 0; r < reps; ++r) {
+    plain_mult(packed, n, x, y0);
+  }
+  double plain = (now() - start) / reps;
+  printf("%6d nodes  mult      plain     %8.3f ms  %5.2f ns per entry\n", n,
+         1e3 * plain, 1e9 * plain / (double)entries);
+
+  for (int t = 1; t <= max_threads; t *= 2) {
+    matrix_ops_set_num_threads(t);
+    start = now();
+    for (int r = 0; r < reps; ++r) {
+      right_mult_with_vector_ff(packed, n, x, y);
+    }
+    double seconds = (now() - start) / reps;
+    printf("%6d nodes  mult      %2d thread %8.3f ms  %5.2f ns per entry, "
+           "%.2fx, relative difference %.2g\n",
+           n, t, 1e3 * seconds, 1e9 * seconds / (double)entries,
+           plain / seconds, difference(y, y0, n));
+  }
+  matrix_ops_set_num_threads(1);
+
+  free(packed);
+  free(x);
+  free(y0);
+  free(y);
+}
+
+static void report_vector(int n, const char *op, double plain, double seconds,
+                          double diff) {
+  printf("%6d nodes  %-9s plain %6.2f ns, new %6.2f ns, %.2fx, relative "
+         "difference %.2g\n",
+         n, op, 1e9 * plain, 1e9 * seconds, plain / seconds, diff);
+}
+
+/// the vector operations of each conjugate gradient iteration
+static void bench_vectors(int n) {
+  float *a = xcalloc((size_t)n, sizeof(float));
+  float *b = xcalloc((size_t)n, sizeof(float));
+  float *c = xcalloc((size_t)n, sizeof(float));
+  double sum0 = 0, sum = 0;
+
+  for (int i = 0; i < n; ++i) {
+    a[i] = uniform();
+    b[i] = uniform();
+  }
+
+  double start = now();
+  for (int r = 0; r < VECTOR_REPS; ++r) {
+    sum0 += plain_inner_product(n, a, b);
+  }
+  double plain = (now() - start) / VECTOR_REPS;
+  start = now();
+  for (int r = 0; r < VECTOR_REPS; ++r) {
+    sum += vectors_inner_productf(n, a, b);
+  }
+  double seconds = (now() - start) / VECTOR_REPS;
+  report_vector(n, "inner", plain, seconds, fabs(sum - sum0) / sum0);
+
+  // alternate signs, so the vectors stay bounded
+  memcpy(c, a, sizeof(float) * (size_t)n);
+  start = now();
+  for (int r = 0; r < VECTOR_REPS; ++r) {
+    plain_mult_addition(n, c, r % 2 ? -0.5f : 0.5f, b);
+  }
+  plain = (now() - start) / VECTOR_REPS;
+  start = now();
+  for (int r = 0; r < VECTOR_REPS; ++r) {
+    vectors_mult_additionf(n, a, r % 2 ? -0.5f : 0.5f, b);
+  }
+  seconds = (now() - start) / VECTOR_REPS;
+  report_vector(n, "axpy", plain, seconds, difference(a, c, n));
+
+  start = now();
+  for (int r = 0; r < VECTOR_REPS; ++r) {
+    plain_orthog1(n, c);
+  }
+  plain = (now() - start) / VECTOR_REPS;
+  start = now();
+  for (int r = 0; r < VECTOR_REPS; ++r) {
+    orthog1f(n, a);
+  }
+  seconds = (now() - start) / VECTOR_REPS;
+  report_vector(n, "orthog1", plain, seconds, difference(a, c, n));
+
+  free(a);
+  free(b);
+  free(c);
+}
+
+int main(int argc, char **argv) {
+  int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+  int max_nodes = argc > 2 ? atoi(argv[2]) : 20000;
+  static const int sizes[] = {1000, 2000, 5000, 10000, 20000};
+
+  srand(1);
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    if (sizes[s] > max_nodes) {
+      break;
+    }
+    bench_mult(sizes[s], max_threads);
+    bench_vectors(sizes[s]);
+  }
+  return EXIT_SUCCESS;
+}
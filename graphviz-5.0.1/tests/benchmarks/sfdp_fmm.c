@@ -0,0 +1,108 @@
+/**
+ * @file
+ * @brief benchmark the accuracy and cost of sfdp's repulsive force methods
+ *
+ * The repulsive forces on points drawn uniformly in the unit square are
+ * computed with Barnes-Hut at a few opening constants and with the fast
+ * multipole method at a few expansion orders, all on the linearized
+ * quadtree. Each result is compared to the exact forces, computed pairwise
+ * on a sample of the points, for the repulsive exponents sfdp uses by
+ * default (-1) and for graphs with a power law degree distribution (-1.8).
+ *
+ * libsparse is not installed, so this is built from the sources of
+ * lib/sparse; see the Makefile.
+ *
+ * Usage: sfdp_fmm [points [samples]]
+ */
+
+#include <math.h>
+#include <sparse/LinearQuadTree.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double seconds(clock_t start, clock_t end) {
+  return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+/// relative root mean square error of force at the sampled points
+static double error(const double *force, const double *exact, int n,
+                    int samples) {
+  double err = 0, norm = 0;
+  for (int s = 0; s < samples; ++s) {
+    int i = (int)((long)s * n / samples);
+    for (int k = 0; k < 2; ++k) {
+      err += (force[2 * i + k] - exact[2 * s + k]) *
+             (force[2 * i + k] - exact[2 * s + k]);
+      norm += exact[2 * s + k] * exact[2 * s + k];
+    }
+  }
+  return sqrt(err / norm);
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  int samples = argc > 2 ? atoi(argv[2]) : 200;
+  const double ps[] = {-1, -1.8};
+  const double bhs[] = {0.6, 0.3, 0.15};
+  const int orders[] = {2, 4, 6, 8};
+  double counts[4];
+
+  if (samples > n) {
+    samples = n;
+  }
+  double *x = malloc(sizeof(double) * 2 * (size_t)n);
+  double *force = malloc(sizeof(double) * 2 * (size_t)n);
+  double *exact = malloc(sizeof(double) * 2 * (size_t)samples);
+  if (x == NULL || force == NULL || exact == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  srand(1);
+  for (int i = 0; i < 2 * n; ++i) {
+    x[i] = (rand() + 0.5) / ((double)RAND_MAX + 1);
+  }
+  // the tree sfdp builds for as many points, at its default max_level
+  LinearQuadTree qt = LinearQuadTree_new_from_point_list(2, n, 10, x);
+
+  for (size_t pi = 0; pi < sizeof(ps) / sizeof(ps[0]); ++pi) {
+    double p = ps[pi];
+
+    for (int s = 0; s < samples; ++s) {
+      int i = (int)((long)s * n / samples);
+      exact[2 * s] = exact[2 * s + 1] = 0;
+      for (int j = 0; j < n; ++j) {
+        double dx = x[2 * i] - x[2 * j], dy = x[2 * i + 1] - x[2 * j + 1];
+        double d = pow(dx * dx + dy * dy, (1 - p) / 2);
+        if (j != i) {
+          exact[2 * s] += dx / d;
+          exact[2 * s + 1] += dy / d;
+        }
+      }
+    }
+
+    for (size_t b = 0; b < sizeof(bhs) / sizeof(bhs[0]); ++b) {
+      clock_t start = clock();
+      LinearQuadTree_get_repulsive_force(qt, force, bhs[b], p, 1, counts, 1);
+      clock_t end = clock();
+      printf("p = %.1f, Barnes-Hut, bh = %.2f: %.4fs, relative error %.2g\n",
+             p, bhs[b], seconds(start, end), error(force, exact, n, samples));
+    }
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o) {
+      clock_t start = clock();
+      LinearQuadTree_get_repulsive_force_fmm(qt, force, 0.6, p, 1, orders[o],
+                                             counts);
+      clock_t end = clock();
+      printf("p = %.1f, FMM, order %d:        %.4fs, relative error %.2g\n",
+             p, orders[o], seconds(start, end),
+             error(force, exact, n, samples));
+    }
+  }
+
+  LinearQuadTree_delete(qt);
+  free(x);
+  free(force);
+  free(exact);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief benchmark sfdp's pointer quadtree against the linearized one
+ *
+ * Points are drawn either uniformly in the unit square or in a few tight
+ * Gaussian clusters, which gives deep, unbalanced trees. For each tree the
+ * time to build it from the points and free it again, and the time to
+ * compute the repulsive forces on all points are reported, with the largest
+ * difference between the two sets of forces relative to the largest force.
+ * At the default max_level the two differ slightly in the centers of mass
+ * of cells at the last level, which the pointer tree only approximates.
+ *
+ * libsparse is not installed, so this is built from the sources of
+ * lib/sparse; see the Makefile.
+ *
+ * Usage: sfdp_quadtree [points [max_level [repetitions]]]
+ */
+
+#include <math.h>
+#include <sparse/LinearQuadTree.h>
+#include <sparse/QuadTree.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum { DIM = 2 };
+
+static double seconds(clock_t start, clock_t end) {
+  return (double)(end - start) / CLOCKS_PER_SEC;
+}
+
+static double uniform(void) { return (rand() + 0.5) / ((double)RAND_MAX + 1); }
+
+static void make_points(double *x, int n, int clustered) {
+  srand(1);
+  for (int i = 0; i < n; ++i) {
+    if (!clustered) {
+      for (int k = 0; k < DIM; ++k) {
+        x[i * DIM + k] = uniform();
+      }
+      continue;
+    }
+    // ten clusters, placed by the first draws of each
+    double c = (double)(i % 10);
+    double r = 0.01 * sqrt(-2 * log(uniform()));
+    double a = 2 * M_PI * uniform();
+    x[i * DIM] = cos(c) + r * cos(a);
+    x[i * DIM + 1] = sin(c) + r * sin(a);
+  }
+}
+
+static void run(const char *name, double *x, int n, int max_level, int reps) {
+  // the constants sfdp uses by default
+  const double bh = 0.6, p = -1, KP = 1;
+  double *f0 = calloc((size_t)n * DIM, sizeof(double));
+  double *f1 = calloc((size_t)n * DIM, sizeof(double));
+  double counts[4];
+  int flag = 0;
+  double build0 = 0, build1 = 0, force0 = 0, force1 = 0;
+
+  if (f0 == NULL || f1 == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The linear tree goes first: freeing the many small cells of the pointer
+  // tree leaves work for the allocator that would otherwise be charged to
+  // whatever allocates next.
+  for (int r = 0; r < reps; ++r) {
+    clock_t t0 = clock();
+    LinearQuadTree lqt =
+        LinearQuadTree_new_from_point_list(DIM, n, max_level, x);
+    clock_t t1 = clock();
+    memset(f1, 0, sizeof(double) * (size_t)n * DIM);
+    LinearQuadTree_get_repulsive_force(lqt, f1, bh, p, KP, counts, 1);
+    clock_t t2 = clock();
+    LinearQuadTree_delete(lqt);
+    clock_t t3 = clock();
+    build1 += seconds(t0, t1) + seconds(t2, t3);
+    force1 += seconds(t1, t2);
+  }
+
+  for (int r = 0; r < reps; ++r) {
+    clock_t t0 = clock();
+    QuadTree qt = QuadTree_new_from_point_list(DIM, n, max_level, x);
+    clock_t t1 = clock();
+    memset(f0, 0, sizeof(double) * (size_t)n * DIM);
+    QuadTree_get_repulsive_force(qt, f0, x, bh, p, KP, counts, &flag);
+    clock_t t2 = clock();
+    QuadTree_delete(qt);
+    clock_t t3 = clock();
+    build0 += seconds(t0, t1) + seconds(t2, t3);
+    force0 += seconds(t1, t2);
+  }
+
+  double big = 0, dmax = 0;
+  for (int i = 0; i < n * DIM; ++i) {
+    big = fmax(big, fabs(f0[i]));
+    dmax = fmax(dmax, fabs(f0[i] - f1[i]));
+  }
+
+  printf("%-9s %8d points: build %.4fs -> %.4fs, force %.4fs -> %.4fs, "
+         "relative difference %.2g\n",
+         name, n, build0 / reps, build1 / reps, force0 / reps, force1 / reps,
+         big > 0 ? dmax / big : 0);
+  free(f0);
+  free(f1);
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  int max_level = argc > 2 ? atoi(argv[2]) : 10;
+  int reps = argc > 3 ? atoi(argv[3]) : 3;
+
+  double *x = malloc(sizeof(double) * (size_t)n * DIM);
+  if (x == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  make_points(x, n, 0);
+  run("uniform", x, n, max_level, reps);
+  make_points(x, n, 1);
+  run("clustered", x, n, max_level, reps);
+
+  free(x);
+  return EXIT_SUCCESS;
+}
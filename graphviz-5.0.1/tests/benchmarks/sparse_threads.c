@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief benchmark the threaded sparse matrix kernels of lib/sparse
+ *
+ * A random sparse graph and a prolongation matrix that pairs its nodes up,
+ * as sfdp's multilevel coarsening makes, are used to time the kernels the
+ * layouts spend their matrix work in: matrix-vector and matrix-dense
+ * products, the transpose, and the products A B and R A P. Each is run with
+ * 1, 2, 4, ... threads, up to the given maximum, and its result is checked
+ * to be the same as with one thread, bit for bit.
+ *
+ * libsparse is not installed, so this is built from the sources of
+ * lib/sparse; see the Makefile.
+ *
+ * Usage: sparse_threads [nodes [max_threads]]
+ */
+
+#include <sparse/SparseMatrix.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum { DEGREE = 8, DIM = 2, REPS = 20 };
+
+/// wall clock time in seconds, as the threads run concurrently
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool same_matrix(SparseMatrix A, SparseMatrix B) {
+  return A->m == B->m && A->n == B->n && A->nz == B->nz &&
+         memcmp(A->ia, B->ia, sizeof(int) * ((size_t)A->m + 1)) == 0 &&
+         memcmp(A->ja, B->ja, sizeof(int) * (size_t)A->nz) == 0 &&
+         memcmp(A->a, B->a, sizeof(double) * (size_t)A->nz) == 0;
+}
+
+/// a symmetric graph of n nodes with about DEGREE random neighbors each
+static SparseMatrix make_graph(int n) {
+  int nz = n * DEGREE / 2;
+  int *irn = malloc(sizeof(int) * (size_t)nz);
+  int *jcn = malloc(sizeof(int) * (size_t)nz);
+  double *val = malloc(sizeof(double) * (size_t)nz);
+  if (irn == NULL || jcn == NULL || val == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  srand(1);
+  for (int k = 0; k < nz; ++k) {
+    irn[k] = rand() % n;
+    // mostly nearby nodes, as in graphs with locality, with some far ones
+    jcn[k] = k % 4 ? (irn[k] + rand() % 64) % n : rand() % n;
+    val[k] = (rand() + 0.5) / ((double)RAND_MAX + 1);
+  }
+  SparseMatrix A = SparseMatrix_from_coordinate_arrays(
+      nz, n, n, irn, jcn, val, MATRIX_TYPE_REAL, sizeof(double));
+  SparseMatrix S = SparseMatrix_symmetrize(A, false);
+  SparseMatrix_delete(A);
+  free(irn);
+  free(jcn);
+  free(val);
+  return S;
+}
+
+/// the n x (n + 1) / 2 matrix mapping each pair of nodes to one coarse node
+static SparseMatrix make_prolongation(int n) {
+  int *irn = malloc(sizeof(int) * (size_t)n);
+  int *jcn = malloc(sizeof(int) * (size_t)n);
+  double *val = malloc(sizeof(double) * (size_t)n);
+  if (irn == NULL || jcn == NULL || val == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < n; ++i) {
+    irn[i] = i;
+    jcn[i] = i / 2;
+    val[i] = 1;
+  }
+  SparseMatrix P = SparseMatrix_from_coordinate_arrays(
+      n, n, (n + 1) / 2, irn, jcn, val, MATRIX_TYPE_REAL, sizeof(double));
+  free(irn);
+  free(jcn);
+  free(val);
+  return P;
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 500000;
+  int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+
+  SparseMatrix A = make_graph(n);
+  SparseMatrix P = make_prolongation(n);
+  SparseMatrix R = SparseMatrix_transpose(P);
+  double *x = malloc(sizeof(double) * (size_t)n * DIM);
+  if (x == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < n * DIM; ++i) {
+    x[i] = (rand() + 0.5) / ((double)RAND_MAX + 1);
+  }
+  printf("%d nodes, %d nonzeros\n", n, A->nz);
+
+  double *y1 = NULL, *Y1 = NULL;
+  SparseMatrix T1 = NULL, AA1 = NULL, RAP1 = NULL;
+  bool ok = true;
+
+  for (int t = 1; t <= max_threads; t *= 2) {
+    double *y = NULL, *Y = NULL;
+    SparseMatrix_set_num_threads(t);
+
+    double t0 = now();
+    for (int r = 0; r < REPS; ++r) {
+      SparseMatrix_multiply_vector(A, x, &y);
+    }
+    double t1 = now();
+    for (int r = 0; r < REPS; ++r) {
+      SparseMatrix_multiply_dense(A, x, &Y, DIM);
+    }
+    double t2 = now();
+    SparseMatrix T = SparseMatrix_transpose(A);
+    double t3 = now();
+    SparseMatrix AA = SparseMatrix_multiply(A, A);
+    double t4 = now();
+    SparseMatrix RAP = SparseMatrix_multiply3(R, A, P);
+    double t5 = now();
+
+    printf("%2d threads: A x %.4fs, A X %.4fs, transpose %.4fs, A A %.4fs, "
+           "R A P %.4fs\n",
+           t, (t1 - t0) / REPS, (t2 - t1) / REPS, t3 - t2, t4 - t3, t5 - t4);
+
+    if (t == 1) {
+      y1 = y;
+      Y1 = Y;
+      T1 = T;
+      AA1 = AA;
+      RAP1 = RAP;
+      continue;
+    }
+    if (memcmp(y, y1, sizeof(double) * (size_t)n) != 0 ||
+        memcmp(Y, Y1, sizeof(double) * (size_t)n * DIM) != 0 ||
+        !same_matrix(T, T1) || !same_matrix(AA, AA1) ||
+        !same_matrix(RAP, RAP1)) {
+      fprintf(stderr, "results with %d threads differ from one thread\n", t);
+      ok = false;
+    }
+    free(y);
+    free(Y);
+    SparseMatrix_delete(T);
+    SparseMatrix_delete(AA);
+    SparseMatrix_delete(RAP);
+  }
+
+  free(y1);
+  free(Y1);
+  SparseMatrix_delete(T1);
+  SparseMatrix_delete(AA1);
+  SparseMatrix_delete(RAP1);
+  SparseMatrix_delete(A);
+  SparseMatrix_delete(P);
+  SparseMatrix_delete(R);
+  free(x);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}